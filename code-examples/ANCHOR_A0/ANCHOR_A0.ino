@@ -6,6 +6,35 @@ For ESP32 UWB AT Demo
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
 #include <Arduino.h>
+#include "MaUWB_RangeParser.h"
+#include "MaUWB_Frame.h"
+#include "MaUWB_Tracker.h"
+#include "MaUWB_Capture.h"
+#include "MaUWB_Bitmap.h"
+#include "MaUWB_Logo.h"
+
+// Range output to the host: MAUWB_OUTPUT_JSON lines or MAUWB_OUTPUT_BINARY
+// frames (see MaUWB_Frame.h). "#bin" / "#json" from the host switch it.
+// In binary mode the port carries only frames (and capture records): log
+// text, parse errors and command replies are left out.
+#define OUTPUT_FORMAT MAUWB_OUTPUT_JSON
+
+// 1: solve every tag here and send positions instead of raw ranges (see
+// MaUWB_Tracker.h). "#pos" / "#range" from the host switch it, and
+// "#anc <i> <x> <y> [z]" moves anchor i of the layout below.
+#define OUTPUT_POSITIONS 0
+
+// "#cap" from the host adds every raw line from the module to the output as
+// a timestamped capture record (see MaUWB_Capture.h), "#nocap" stops it.
+// Save the port to a file on the host and replay it with capture_replay.
+
+// Anchor layout used for position output: x, y and mounting height (cm)
+#define ANCHOR_COUNT 4
+const float anchorLayout[ANCHOR_COUNT][3] = {{0, 0, 0}, {0, 1270, 0}, {540, 1270, 0}, {540, 0, 0}};
+
+// Height of the tags (cm). With anchors at other heights the ranges are
+// projected onto this plane before the 2D solve.
+#define TAG_HEIGHT 0
 
 HardwareSerial mySerial2(2);
 
@@ -14,11 +43,18 @@ HardwareSerial mySerial2(2);
 #define IO_RXD2 18
 #define IO_TXD2 17
 
+// Receive buffer for the module's UART (bytes); with many tags reporting it
+// rides out the time spent writing to the host
+#define UART_RX_BUFFER 2048
+
 #define I2C_SDA 39
 #define I2C_SCL 38
 
 Adafruit_SSD1306 display(128, 64, &Wire, -1);
 
+// Per-tag ranges, filter state and sequence numbers for position output
+MaUWB_TagTracker tracker;
+
 void setup()
 {
     pinMode(RESET, OUTPUT);
@@ -27,6 +63,7 @@ void setup()
     Serial.begin(115200);
 
     Serial.print(F("Hello! ESP32-S3 AT command V1.0 Test"));
+    mySerial2.setRxBufferSize(UART_RX_BUFFER);
     mySerial2.begin(115200, SERIAL_8N1, IO_RXD2, IO_TXD2);
 
     mySerial2.println("AT");
@@ -42,52 +79,63 @@ void setup()
     display.clearDisplay();
 
     logoshow();
+
+    tracker.getSolver().setAnchorCount(ANCHOR_COUNT);
+    for (uint8_t i = 0; i < ANCHOR_COUNT; i++)
+    {
+        tracker.getSolver().setAnchor(i, anchorLayout[i][0], anchorLayout[i][1], anchorLayout[i][2]);
+    }
+    tracker.getSolver().setTagHeight(TAG_HEIGHT);
 }
 
 long int runtime = 0;
 
-String response = "";
-String rec_head = "AT+RANGE";
+uint8_t outputFormat = OUTPUT_FORMAT;
+bool outputPositions = OUTPUT_POSITIONS;
+bool capturing = false;
+MaUWB_CaptureWriter captureWriter;
+
+// "#..." command from the host being received
+char hostCommand[24];
+uint8_t hostCommandLength = 0;
+bool inHostCommand = false;
+
+// Line buffer and decoder for the module's output
+MaUWB_RangeParser rangeParser;
 
 void loop()
 {
 
     // put your main code here, to run repeatedly:
-    while (Serial.available() > 0)
-    {
-        mySerial2.write(Serial.read());
-        yield();
-    }
-    while (mySerial2.available() > 0)
+    handleHostInput();
+    int waiting;
+    while ((waiting = mySerial2.available()) > 0)
     {
-        char c = mySerial2.read();
+        // Read what is waiting in one call rather than a byte at a time
+        char chunk[64];
+        size_t count = mySerial2.readBytes(chunk, waiting < (int)sizeof(chunk) ? waiting : sizeof(chunk));
+        if (count == 0)
+            break;
 
-        if (c == '\r')
-            continue;
-        else if (c == '\n' || c == '\r')
+        for (size_t i = 0; i < count; i++)
         {
-            // if(0)
-            if (response.indexOf(rec_head) != -1)
-            {
+            MaUWB_RangeParser::Event event = rangeParser.feed(chunk[i]);
 
-                range_analy(response);
-
-                // Serial.println("-----------Get range msg-----------");
-
-                // String result = response.substring(response.indexOf(rec_head) + rec_head.length());
+            if (capturing && event != MaUWB_RangeParser::NONE)
+            {
+                uint8_t record[MAUWB_CAPTURE_RECORD_MAX];
+                Serial.write(record, captureWriter.encode(micros(), rangeParser.line(), rangeParser.lineLength(), record));
+            }
 
-                // Serial.println(result);
-                // Serial.println("-----------Over-----------");
+            if (event == MaUWB_RangeParser::REPORT)
+            {
+                range_analy(rangeParser.report());
             }
-            else
+            else if (event == MaUWB_RangeParser::LINE && textOutput())
             {
-                Serial.println(response);
+                Serial.println(rangeParser.line());
             }
-
-            response = "";
         }
-        else
-            response += c;
     }
 }
 
@@ -107,75 +155,204 @@ void logoshow(void)
     display.println(F("JSON"));
     display.setCursor(0, 40);
     display.println(F("A0"));
+
+    // Packed bitmap from drawings-for-SD1306, copied into the framebuffer
+    MaUWB_BitmapBlit::draw(display.getBuffer(), display.width(), display.height(), MaUWB_Logo,
+                           display.width() - MaUWB_Logo.width, 0);
     display.display();
     delay(2000);
 }
 
-// AT+RANGE=tid:1,mask:04,seq:63,range:(0,0,30,0,0,0,0,0),rssi:(0.00,0.00,-77.93,0.00,0.00,0.00,0.00,0.00)
+// Forward bytes from the host to the UWB module. A line starting with '#' is
+// a command for the anchor itself and is not forwarded.
+void handleHostInput()
+{
+    while (Serial.available() > 0)
+    {
+        char c = Serial.read();
+
+        if (!inHostCommand && c == '#')
+        {
+            inHostCommand = true;
+            hostCommandLength = 0;
+            continue;
+        }
 
-void range_analy(String data)
+        if (inHostCommand)
+        {
+            if (c == '\n' || c == '\r')
+            {
+                hostCommand[hostCommandLength] = '\0';
+                runHostCommand(hostCommand);
+                inHostCommand = false;
+            }
+            else if (hostCommandLength < sizeof(hostCommand) - 1)
+            {
+                hostCommand[hostCommandLength++] = c;
+            }
+            continue;
+        }
+
+        mySerial2.write(c);
+        yield();
+    }
+}
+
+void runHostCommand(const char *command)
 {
-    String id_str = data.substring(data.indexOf("tid:") + 4, data.indexOf(",mask:"));
-    String range_str = data.substring(data.indexOf("range:"), data.indexOf(",rssi:"));
-    String rssi_str = data.substring(data.indexOf("rssi:"));
+    if (strcmp(command, "bin") == 0)
+    {
+        outputFormat = MAUWB_OUTPUT_BINARY;
+    }
+    else if (strcmp(command, "json") == 0)
+    {
+        outputFormat = MAUWB_OUTPUT_JSON;
+    }
+    else if (strcmp(command, "pos") == 0)
+    {
+        outputPositions = true;
+    }
+    else if (strcmp(command, "range") == 0)
+    {
+        outputPositions = false;
+    }
+    else if (strcmp(command, "cap") == 0)
+    {
+        setCapture(true);
+    }
+    else if (strcmp(command, "nocap") == 0)
+    {
+        setCapture(false);
+    }
+    else if (strncmp(command, "anc ", 4) == 0)
+    {
+        int index;
+        float x, y, z;
+        int fields = sscanf(command + 4, "%d %f %f %f", &index, &x, &y, &z);
+        if (fields < 3 || index < 0 || index >= ANCHOR_COUNT)
+        {
+            if (textOutput())
+            {
+                Serial.print("Bad anchor: #");
+                Serial.println(command);
+            }
+            return;
+        }
+        if (fields == 3)
+        {
+            z = tracker.getSolver().getAnchorZ(index);
+        }
+        tracker.getSolver().setAnchor(index, x, y, z);
+        tracker.clear();
+    }
+    else
+    {
+        if (textOutput())
+        {
+            Serial.print("Unknown command: #");
+            Serial.println(command);
+        }
+        return;
+    }
 
-    // Serial.println(id_str);
-    // Serial.println(range_str);
-    // Serial.println(rssi_str);
+    if (!textOutput())
+    {
+        return;
+    }
+    Serial.print(outputFormat == MAUWB_OUTPUT_BINARY ? "Output: binary" : "Output: JSON");
+    Serial.print(outputPositions ? " positions" : " ranges");
+    Serial.println(capturing ? ", capturing" : "");
+}
 
-    // range:(0,0,51,0,0,0,0,0)
-    // rssi:(0.00,0.00,-78.54,0.00,0.00,0.00,0.00,0.00)
+// Text lines may only go to the host outside binary mode
+bool textOutput()
+{
+    return outputFormat != MAUWB_OUTPUT_BINARY;
+}
 
-    int range_list[8];
-    double rssi_list[8];
-    int count = 0;
+void setCapture(bool enable)
+{
+    capturing = enable;
+    captureWriter.reset();
+}
 
-    count = sscanf(range_str.c_str(), "range:(%d,%d,%d,%d,%d,%d,%d,%d)",
-                   &range_list[0], &range_list[1], &range_list[2], &range_list[3],
-                   &range_list[4], &range_list[5], &range_list[6], &range_list[7]);
+// Send a range report to the p5 sketches: one JSON line, or one MaUWB_Frame in binary mode
+// AT+RANGE=tid:1,mask:04,seq:63,range:(0,0,30,0,0,0,0,0),rssi:(0.00,0.00,-77.93,0.00,0.00,0.00,0.00,0.00)
+// -> {"id":1,"range":[0,0,30,0,0,0,0,0]}
+// or, with position output, {"id":1,"x":250,"y":610}
 
-    if (count != 8)
+void range_analy(const MaUWB_RangeReport &report)
+{
+    if (report.rangeCount != MAUWB_RANGE_SLOTS)
     {
-        Serial.println("RANGE ANALY ERROR");
-        Serial.println(count);
+        if (textOutput())
+        {
+            Serial.println("RANGE ANALY ERROR");
+            Serial.println(report.rangeCount);
+        }
+        return;
+    }
+
+    if (report.rssiCount != MAUWB_RANGE_SLOTS)
+    {
+        if (textOutput())
+        {
+            Serial.println("RSSI ANALY ERROR");
+            Serial.println(report.rssiCount);
+        }
+        return;
+    }
+
+    if (outputPositions)
+    {
+        send_position(report);
         return;
     }
 
-    count = sscanf(rssi_str.c_str(), "rssi:(%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf)",
-                   &rssi_list[0], &rssi_list[1], &rssi_list[2], &rssi_list[3],
-                   &rssi_list[4], &rssi_list[5], &rssi_list[6], &rssi_list[7]);
+    if (outputFormat == MAUWB_OUTPUT_BINARY)
+    {
+        uint8_t frame[MAUWB_FRAME_LENGTH];
+        Serial.write(frame, MaUWB_Frame::encode(report, frame));
+        return;
+    }
+
+    Serial.print("{\"id\":");
+    Serial.print(report.tid);
+    Serial.print(",\"range\":[");
+    for (int i = 0; i < MAUWB_RANGE_SLOTS; i++)
+    {
+        Serial.print((int)report.range[i]);
+        if (i != MAUWB_RANGE_SLOTS - 1)
+            Serial.print(',');
+    }
+    Serial.println("]}");
+}
+
+void send_position(const MaUWB_RangeReport &report)
+{
+    const MaUWB_TagState *tag = tracker.update(report, millis());
+    if (!tag)
+        return;
+
+    MaUWB_PositionReport position;
+    position.tid = tag->tid;
+    position.seq = tag->seq;
+    position.x = (int16_t)lroundf(tag->x);
+    position.y = (int16_t)lroundf(tag->y);
+    position.mask = tag->mask;
 
-    if (count != 8)
+    if (outputFormat == MAUWB_OUTPUT_BINARY)
     {
-        Serial.println("RSSI ANALY ERROR");
-        Serial.println(count);
+        uint8_t frame[MAUWB_POSITION_LENGTH];
+        Serial.write(frame, MaUWB_Frame::encodePosition(position, frame));
         return;
     }
 
-    // Serial Port
-    // Serial.print("TAG ");
-    // Serial.println(id_str);
-    // for (int i = 0; i < 8; i++)
-    // {
-    //     Serial.print("A");
-    //     Serial.print(i);
-    //     Serial.print(" RANGE ");
-    //     Serial.print(range_list[i]);
-    //     Serial.print(" RSSI ");
-    //     Serial.println(rssi_list[i]);
-    // }
-
-    // Serial Port Json
-    String json_str = "";
-    json_str = json_str + "{\"id\":" + id_str + ",";
-    json_str = json_str + "\"range\":[";
-    for (int i = 0; i < 8; i++)
-    {
-        if (i != 7)
-            json_str = json_str + range_list[i] + ",";
-        else
-            json_str = json_str + range_list[i] + "]}";
-    }
-
-    Serial.println(json_str);
-}
\ No newline at end of file
+    Serial.print("{\"id\":");
+    Serial.print(position.tid);
+    Serial.print(",\"x\":");
+    Serial.print(position.x);
+    Serial.print(",\"y\":");
+    Serial.print(position.y);
+    Serial.println("}");
+}
@@ -0,0 +1,16 @@
+// MaUWB_Logo: 16 x 16, 32 bytes
+// Made with drawings-for-SD1306; draw with MaUWB_BitmapBlit or MaUWB_Display::drawBitmap()
+
+#ifndef MAUWB_LOGO_H
+#define MAUWB_LOGO_H
+
+#include "MaUWB_Bitmap.h"
+
+static const uint8_t MaUWB_Logo_data[] PROGMEM = {
+    0x30, 0x10, 0x98, 0xc8, 0xcc, 0x4c, 0x64, 0x64, 0x64, 0x64, 0x4c, 0xcc, 0xc8, 0x98, 0x10, 0x30,
+    0x00, 0x01, 0x01, 0x00, 0x04, 0x06, 0x66, 0xf2, 0xf2, 0x66, 0x06, 0x04, 0x00, 0x01, 0x01, 0x00,
+};
+
+static const MaUWB_Bitmap MaUWB_Logo = {16, 16, 0, sizeof(MaUWB_Logo_data), MaUWB_Logo_data};
+
+#endif // MAUWB_LOGO_H
@@ -21,10 +21,65 @@ Use 2.5.7   Adafruit_SSD1306
 
 #define FREQ_850K
 
+// Range output to the host: MAUWB_OUTPUT_JSON lines or MAUWB_OUTPUT_BINARY
+// frames (see MaUWB_Frame.h). "#bin" / "#json" from the host switch it.
+#define OUTPUT_FORMAT MAUWB_OUTPUT_JSON
+
+// 1: solve every tag here and send positions instead of raw ranges (see
+// MaUWB_Tracker.h). "#pos" / "#range" from the host switch it, and
+// "#anc <i> <x> <y> [z]" moves anchor i of the layout below.
+#define OUTPUT_POSITIONS 0
+
+// "#cap" from the host adds every raw line from the module to the output as
+// a timestamped capture record (see MaUWB_Capture.h), "#nocap" stops it.
+// Save the port to a file on the host and replay it with capture_replay.
+
+// Anchor layout used for position output: x, y and mounting height (cm)
+#define ANCHOR_COUNT 4
+const float anchorLayout[ANCHOR_COUNT][3] = {{0, 0, 0}, {0, 1270, 0}, {540, 1270, 0}, {540, 0, 0}};
+
+// Height of the tags (cm). With anchors at other heights the ranges are
+// projected onto this plane before the 2D solve.
+#define TAG_HEIGHT 0
+
+// Anchor self-survey (see MaUWB_Survey.h). With SURVEY_ON_BOOT 1, anchor i
+// (1..ANCHOR_COUNT-1) runs as tag SURVEY_TID(i) from i to i+1 slots after
+// power-up, so the other anchors range to it; power them up together.
+// Anchor 0 always listens for those tag ids, solves the layout once the
+// last one is done and uses it for position output. "#survey" on anchor 0
+// starts a new collection, "#survey?" prints the last result.
+#define SURVEY_ON_BOOT 0
+#define SURVEY_SLOT_MS 6000
+#define SURVEY_GUARD_MS 2000     // Slot end kept free for the switch back
+#define SURVEY_TID(anchor) (UWB_TAG_COUNT - 1 - (anchor))
+
+// Synthetic load (see MaUWB_SynthLoad.h). With SYNTH_LOAD 1 the module's
+// UART is replaced by SYNTH_TAGS virtual tags walking the anchor layout at
+// SYNTH_RATE_HZ each, with noise, dropouts and lost reports, so the whole
+// range_analy() path and the host visualizers run under a room full of
+// tags. SYNTH_BAUD limits the link as the real UART would (0: no limit).
+// A "#load" line every SYNTH_REPORT_MS gives reports/s, missing reports,
+// lag, arrival jitter, range_analy() time and the heap.
+#define SYNTH_LOAD 0
+#define SYNTH_TAGS 32
+#define SYNTH_RATE_HZ 3          // 32 tags in 10 ms slots
+#define SYNTH_BAUD 115200
+#define SYNTH_REPORT_MS 5000
+
 #include <Wire.h>
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
 #include <Arduino.h>
+#include "MaUWB_AT.h"
+#include "MaUWB_Frame.h"
+#include "MaUWB_Survey.h"
+
+// One tracker entry per tag the anchor is configured for
+#define MAUWB_TRACKER_MAX_TAGS UWB_TAG_COUNT
+#include "MaUWB_Tracker.h"
+#include "MaUWB_Bitmap.h"
+#include "MaUWB_Logo.h"
+#include "MaUWB_SynthLoad.h"
 
 #define SERIAL_LOG Serial
 #define SERIAL_AT mySerial2
@@ -42,6 +97,28 @@ HardwareSerial SERIAL_AT(2);
 
 Adafruit_SSD1306 display(128, 64, &Wire, -1);
 
+// Per-tag ranges, filter state and sequence numbers for position output
+MaUWB_TagTracker tracker;
+
+// Non-blocking AT command link to the UWB module
+MaUWB_AT uwbAt;
+
+// Anchor-to-anchor ranges collected on anchor 0
+MaUWB_Survey survey;
+unsigned long lastSurveyReport = 0;
+bool surveyPending = false;   // Rows came in since the last solve
+bool surveyingAsTag = false;  // This anchor is in its survey slot
+
+#if SYNTH_LOAD
+MaUWB_SynthFleet synthFleet;
+MaUWB_SynthModule synthModule;
+MaUWB_SynthMonitor synthMonitor;
+MaUWB_LatencyHistogram synthLatency;    // Report due until range_analy() is done (us)
+MaUWB_LatencyHistogram synthHandler;    // range_analy() alone (us)
+unsigned long lastLoadReport = 0;
+uint32_t lastLoadReports = 0;
+#endif
+
 void setup()
 {
     pinMode(RESET, OUTPUT);
@@ -50,9 +127,26 @@ void setup()
     SERIAL_LOG.begin(115200);
 
     SERIAL_LOG.print(F("Hello! ESP32-S3 AT command V1.0 Test"));
+    SERIAL_AT.setRxBufferSize(MAUWB_UART_RX_BUFFER);   // Room for bursts while the display updates
     SERIAL_AT.begin(115200, SERIAL_8N1, IO_RXD2, IO_TXD2);
-
-    SERIAL_AT.println("AT");
+#if SYNTH_LOAD
+    // Tag ids below the survey ones
+    MaUWB_SynthConfig synthConfig;
+    synthConfig.tags = min(SYNTH_TAGS, UWB_TAG_COUNT - ANCHOR_COUNT);
+    synthConfig.rateHz = SYNTH_RATE_HZ;
+    synthConfig.tagHeight = TAG_HEIGHT;
+    synthFleet.begin(synthConfig, anchorLayout, ANCHOR_COUNT, esp_random());
+    synthModule.begin(&synthFleet, SYNTH_BAUD, MAUWB_UART_RX_BUFFER);
+    synthMonitor.reset(synthFleet.getPeriod());
+    uwbAt.begin(synthModule);
+#else
+    uwbAt.begin(SERIAL_AT);
+#endif
+    uwbAt.setDebugOutput(&SERIAL_LOG);
+    uwbAt.setLineHandler(handleUwbLine);
+    uwbAt.setReportHandler(handleUwbReport);
+
+    uwbAt.sendAndWait("AT", 1000);
     Wire.begin(I2C_SDA, I2C_SCL);
     delay(1000);
     // SSD1306_SWITCHCAPVCC = generate display voltage from 3.3V internally
@@ -66,63 +160,223 @@ void setup()
 
     logoshow();
 
-    sendData("AT?", 2000, 1);
-    sendData("AT+RESTORE", 5000, 1);
-
-    sendData(config_cmd(), 2000, 1);
-    sendData(cap_cmd(), 2000, 1);
-    sendData("AT+SETRPT=1", 2000, 1);
+    tracker.getSolver().setAnchorCount(ANCHOR_COUNT);
+    for (uint8_t i = 0; i < ANCHOR_COUNT; i++)
+    {
+        tracker.getSolver().setAnchor(i, anchorLayout[i][0], anchorLayout[i][1], anchorLayout[i][2]);
+    }
+    tracker.getSolver().setTagHeight(TAG_HEIGHT);
+    startSurvey();
+
+    MaUWB_ModuleConfig moduleConfig;
+    moduleConfig.id = UWB_INDEX;
+    moduleConfig.role = 1;              // Anchor
+    moduleConfig.rate = 1;              // 6.8 Mbps (0: 850 kbps)
+    moduleConfig.filter = 1;
+    moduleConfig.capacity = UWB_TAG_COUNT;
+    // Time of a single time slot  6.5M : 10MS  850K : 15MS
+    moduleConfig.slotMs = 10;
+    // Extended packets, to pass commands through while ranging
+    moduleConfig.extMode = 1;
+    moduleConfig.report = 1;
     // Antena delay, adjust according to callibration. It will be different for every Anchor.
-    sendData("AT+SETANT=16465", 2000, 1);
-    sendData("AT+SAVE", 2000, 1);
-    sendData("AT+RESTART", 2000, 1);
+    moduleConfig.antennaDelay = 16465;
+
+    // Only rewrites and restarts the module if its stored settings differ
+    uwbAt.configure(moduleConfig);
+
+#if SURVEY_ON_BOOT
+    if (UWB_INDEX > 0 && UWB_INDEX < ANCHOR_COUNT)
+    {
+        runSurveySlot(moduleConfig);
+    }
+#endif
 
     SERIAL_LOG.print(F("Hello! ESP32-S3 AT command V1.0 Test"));
 }
 
 long int runtime = 0;
 
-String response = "";
-String rec_head = "AT+RANGE";
+uint8_t outputFormat = OUTPUT_FORMAT;
+bool outputPositions = OUTPUT_POSITIONS;
+bool capturing = false;
+
+// "#..." command from the host being received
+char hostCommand[24];
+uint8_t hostCommandLength = 0;
+bool inHostCommand = false;
 
 void loop()
 {
 
-    while (SERIAL_LOG.available() > 0)
+    handleHostInput();
+
+    // Read lines from the UWB module; non-reply lines go to handleUwbLine()
+#if SYNTH_LOAD
+    synthModule.update();
+#endif
+    uwbAt.poll();
+
+#if SYNTH_LOAD
+    if (millis() - lastLoadReport >= SYNTH_REPORT_MS)
     {
-        SERIAL_AT.write(SERIAL_LOG.read());
-        yield();
+        printLoadStats();
+    }
+#endif
+
+    // All survey slots are over once no survey tag has been heard for two slots
+    if (surveyPending && millis() - lastSurveyReport > 2 * SURVEY_SLOT_MS)
+    {
+        finishSurvey();
     }
-    while (SERIAL_AT.available() > 0)
+}
+
+void handleUwbLine(const char *line, uint8_t length, void *context)
+{
+    SERIAL_LOG.println(line);
+}
+
+void handleUwbReport(const MaUWB_RangeReport &report, void *context)
+{
+    if (surveyingAsTag)
     {
-        char c = SERIAL_AT.read();
+        return;
+    }
 
-        if (c == '\r')
-            continue;
-        else if (c == '\n' || c == '\r')
+    int8_t from = surveyAnchor(report.tid);
+    if (from > 0)
+    {
+        // Another anchor in its survey slot; not a tag for the host
+        if (UWB_INDEX == 0 && survey.addReport(from, report) > 0)
         {
-            if (response.indexOf(rec_head) != -1)
-            {
+            lastSurveyReport = millis();
+            surveyPending = true;
+        }
+        return;
+    }
 
-                range_analy(response);
+#if SYNTH_LOAD
+    uint32_t start = micros();
+    range_analy(report);
+    uint32_t end = micros();
+    uint32_t due;
+    if (synthModule.takeDue(due))
+    {
+        synthLatency.record(end - due);
+    }
+    synthHandler.record(end - start);
+    synthMonitor.onReport(report, start);
+#else
+    range_analy(report);
+#endif
+}
 
-                // Serial.println("-----------Get range msg-----------");
+// Anchor whose survey tag id this is, -1 for a real tag
+int8_t surveyAnchor(uint16_t tid)
+{
+    for (uint8_t i = 1; i < ANCHOR_COUNT; i++)
+    {
+        if (tid == SURVEY_TID(i))
+            return i;
+    }
+    return -1;
+}
 
-                // String result = response.substring(response.indexOf(rec_head) + rec_head.length());
+// Anchor self-survey
 
-                // Serial.println(result);
-                // Serial.println("-----------Over-----------");
-            }
-            else
+void startSurvey()
+{
+    survey.begin(ANCHOR_COUNT);
+    for (uint8_t i = 0; i < ANCHOR_COUNT; i++)
+    {
+        survey.setHeight(i, anchorLayout[i][2]);
+    }
+    surveyPending = false;
+}
+
+// This anchor's slot: run as a tag so the others range to it, then back
+void runSurveySlot(const MaUWB_ModuleConfig &anchorConfig)
+{
+    unsigned long start = (unsigned long)UWB_INDEX * SURVEY_SLOT_MS;
+    while (millis() < start)
+    {
+        uwbAt.poll();
+    }
+
+    display.clearDisplay();
+    display.setTextSize(2);
+    display.setCursor(0, 20);
+    display.println(F("Survey"));
+    display.display();
+
+    MaUWB_ModuleConfig tagConfig = anchorConfig;
+    tagConfig.id = SURVEY_TID(UWB_INDEX);
+    tagConfig.role = 0;
+    surveyingAsTag = true;
+    uwbAt.configure(tagConfig);
+    while (millis() < start + SURVEY_SLOT_MS - SURVEY_GUARD_MS)
+    {
+        uwbAt.poll();
+    }
+    uwbAt.configure(anchorConfig);
+    surveyingAsTag = false;
+
+    logoshow();
+}
+
+void finishSurvey()
+{
+    surveyPending = false;
+    MaUWB_SurveyResult result = survey.solve();
+    printSurvey(result);
+    if (result != MAUWB_SURVEY_OK)
+    {
+        return;
+    }
+
+    for (uint8_t i = 0; i < ANCHOR_COUNT; i++)
+    {
+        tracker.getSolver().setAnchor(i, survey.getX(i), survey.getY(i), survey.getZ(i));
+    }
+    tracker.clear();
+}
+
+void printSurvey(MaUWB_SurveyResult result)
+{
+    char line[64];
+    snprintf(line, sizeof(line), "Survey: %u of %u pairs measured", survey.getMeasuredPairs(),
+             ANCHOR_COUNT * (ANCHOR_COUNT - 1) / 2);
+    SERIAL_LOG.println(line);
+
+    if (result != MAUWB_SURVEY_OK)
+    {
+        SERIAL_LOG.println(result == MAUWB_SURVEY_DEGENERATE ? "Survey failed: anchors on one line"
+                                                             : "Survey failed: an anchor has fewer than 2 ranges");
+        for (uint8_t j = 1; j < ANCHOR_COUNT; j++)
+        {
+            for (uint8_t i = 0; i < j; i++)
             {
-                SERIAL_LOG.println(response);
+                if (survey.getSamples(i, j) == 0)
+                {
+                    snprintf(line, sizeof(line), "Survey: no range between A%u and A%u", i, j);
+                    SERIAL_LOG.println(line);
+                }
             }
-
-            response = "";
         }
-        else
-            response += c;
+        return;
     }
+
+    // In "#anc" form, ready to send to the other anchors or paste into a sketch
+    for (uint8_t i = 0; i < ANCHOR_COUNT; i++)
+    {
+        snprintf(line, sizeof(line), "Survey: #anc %u %.0f %.0f %.0f", i, survey.getX(i), survey.getY(i),
+                 survey.getZ(i));
+        SERIAL_LOG.println(line);
+    }
+    uint8_t a, b;
+    float worst = survey.getWorstPair(a, b);
+    snprintf(line, sizeof(line), "Survey: rms %.1f cm, worst A%u-A%u %.1f cm", survey.getRms(), a, b, worst);
+    SERIAL_LOG.println(line);
 }
 
 // SSD1306
@@ -155,121 +409,225 @@ void logoshow(void)
     temp = temp + UWB_TAG_COUNT;
     display.println(temp);
 
+    // Packed bitmap from drawings-for-SD1306, copied into the framebuffer
+    MaUWB_BitmapBlit::draw(display.getBuffer(), display.width(), display.height(), MaUWB_Logo,
+                           display.width() - MaUWB_Logo.width, 0);
+
     display.display();
 
     delay(2000);
 }
 
-String sendData(String command, const int timeout, boolean debug)
+// Forward bytes from the host to the UWB module. A line starting with '#' is
+// a command for the anchor itself and is not forwarded.
+void handleHostInput()
 {
-    String response = "";
-    // command = command + "\r\n";
+    while (SERIAL_LOG.available() > 0)
+    {
+        char c = SERIAL_LOG.read();
 
-    SERIAL_LOG.println(command);
-    SERIAL_AT.println(command); // send the read character to the SERIAL_LOG
+        if (!inHostCommand && c == '#')
+        {
+            inHostCommand = true;
+            hostCommandLength = 0;
+            continue;
+        }
+
+        if (inHostCommand)
+        {
+            if (c == '\n' || c == '\r')
+            {
+                hostCommand[hostCommandLength] = '\0';
+                runHostCommand(hostCommand);
+                inHostCommand = false;
+            }
+            else if (hostCommandLength < sizeof(hostCommand) - 1)
+            {
+                hostCommand[hostCommandLength++] = c;
+            }
+            continue;
+        }
 
-    long int time = millis();
+        SERIAL_AT.write(c);
+        yield();
+    }
+}
 
-    while ((time + timeout) > millis())
+void runHostCommand(const char *command)
+{
+    if (strcmp(command, "bin") == 0)
     {
-        while (SERIAL_AT.available())
+        outputFormat = MAUWB_OUTPUT_BINARY;
+    }
+    else if (strcmp(command, "json") == 0)
+    {
+        outputFormat = MAUWB_OUTPUT_JSON;
+    }
+    else if (strcmp(command, "pos") == 0)
+    {
+        outputPositions = true;
+    }
+    else if (strcmp(command, "range") == 0)
+    {
+        outputPositions = false;
+    }
+    else if (strcmp(command, "cap") == 0)
+    {
+        setCapture(true);
+    }
+    else if (strcmp(command, "nocap") == 0)
+    {
+        setCapture(false);
+    }
+    else if (strcmp(command, "survey") == 0)
+    {
+        startSurvey();
+        SERIAL_LOG.println("Survey: waiting for the anchors' survey slots");
+        return;
+    }
+    else if (strcmp(command, "survey?") == 0)
+    {
+        printSurvey(survey.solve());
+        return;
+    }
+    else if (strncmp(command, "anc ", 4) == 0)
+    {
+        int index;
+        float x, y, z;
+        int fields = sscanf(command + 4, "%d %f %f %f", &index, &x, &y, &z);
+        if (fields < 3 || index < 0 || index >= ANCHOR_COUNT)
         {
-
-            // The esp has data so display its output to the serial window
-            char c = SERIAL_AT.read(); // read the next character.
-            response += c;
+            SERIAL_LOG.print("Bad anchor: #");
+            SERIAL_LOG.println(command);
+            return;
         }
+        if (fields == 3)
+        {
+            z = tracker.getSolver().getAnchorZ(index);
+        }
+        tracker.getSolver().setAnchor(index, x, y, z);
+        tracker.clear();
     }
-
-    if (debug)
+    else
     {
-        SERIAL_LOG.println(response);
+        SERIAL_LOG.print("Unknown command: #");
+        SERIAL_LOG.println(command);
+        return;
     }
 
-    return response;                
+    SERIAL_LOG.print(outputFormat == MAUWB_OUTPUT_BINARY ? "Output: binary" : "Output: JSON");
+    SERIAL_LOG.print(outputPositions ? " positions" : " ranges");
+    SERIAL_LOG.println(capturing ? ", capturing" : "");
 }
 
-String config_cmd()
+#if SYNTH_LOAD
+// #load reports/s, missing, resyncs, latency and handler p50/p99/max (us),
+// jitter p99 (us), free heap, lowest free heap and largest free block
+void printLoadStats()
 {
-    String temp = "AT+SETCFG=";
-
-    // Set device id
-    temp = temp + UWB_INDEX;
-    
-    // Set device role
-    //x2:Device Role(0:Tag / 1:Anchor)
-    temp = temp + ",1";
-
-
-    // Set frequence 850k or 6.8M
-
-    temp = temp + ",1";
-
-    // Set range filter
-    temp = temp + ",1";
-
-    return temp;
+    unsigned long now = millis();
+    uint32_t reports = synthMonitor.getReports();
+    char line[160];
+    snprintf(line, sizeof(line),
+             "#load %lu/s missing %lu/%lu resync %lu | latency %lu/%lu/%lu | handler %lu/%lu/%lu"
+             " | jitter %lu | heap %lu min %lu block %lu",
+             (unsigned long)((reports - lastLoadReports) * 1000UL / (now - lastLoadReport)),
+             (unsigned long)synthMonitor.getMissing(), (unsigned long)synthFleet.getGenerated(),
+             (unsigned long)synthFleet.getResyncs(),
+             (unsigned long)synthLatency.getPercentile(0.5f), (unsigned long)synthLatency.getPercentile(0.99f),
+             (unsigned long)synthLatency.getMax(),
+             (unsigned long)synthHandler.getPercentile(0.5f), (unsigned long)synthHandler.getPercentile(0.99f),
+             (unsigned long)synthHandler.getMax(),
+             (unsigned long)synthMonitor.getJitter().getPercentile(0.99f),
+             (unsigned long)ESP.getFreeHeap(), (unsigned long)ESP.getMinFreeHeap(),
+             (unsigned long)ESP.getMaxAllocHeap());
+    SERIAL_LOG.println(line);
+    // Each line covers one window, so creep shows from line to line
+    synthLatency.reset();
+    synthHandler.reset();
+    synthMonitor.getJitter().reset();
+    lastLoadReports = reports;
+    lastLoadReport = now;
 }
+#endif
 
-String cap_cmd()
+void setCapture(bool enable)
 {
-    String temp = "AT+SETCAP=";
-
-    // Set Tag capacity
-    temp = temp + UWB_TAG_COUNT;
-
-    //  Time of a single time slot  6.5M : 10MS  850K ： 15MS
-    temp = temp + ",10";
-    
-    //X3:extMode, whether to increase the passthrough command when transmitting
-    //(0: normal packet when communicating, 1: extended packet when communicating)
-    temp = temp + ",1";
-
-    return temp;
+    capturing = enable;
+    uwbAt.setCaptureOutput(enable ? &SERIAL_LOG : nullptr);
 }
 
-void range_analy(String data)
-{
-    String id_str = data.substring(data.indexOf("tid:") + 4, data.indexOf(",mask:"));
-    String range_str = data.substring(data.indexOf("range:"), data.indexOf(",rssi:"));
-    String rssi_str = data.substring(data.indexOf("rssi:"));
-
-    int range_list[8];
-    double rssi_list[8];
-    int count = 0;
+// Send a range report to the p5 sketches: one JSON line, or one MaUWB_Frame in binary mode
+// AT+RANGE=tid:1,mask:04,seq:63,range:(0,0,30,0,0,0,0,0),rssi:(0.00,0.00,-77.93,0.00,0.00,0.00,0.00,0.00)
+// -> {"id":1,"range":[0,0,30,0,0,0,0,0]}
+// or, with position output, {"id":1,"x":250,"y":610}
 
-    count = sscanf(range_str.c_str(), "range:(%d,%d,%d,%d,%d,%d,%d,%d)",
-                   &range_list[0], &range_list[1], &range_list[2], &range_list[3],
-                   &range_list[4], &range_list[5], &range_list[6], &range_list[7]);
-
-    if (count != 8)
+void range_analy(const MaUWB_RangeReport &report)
+{
+    if (report.rangeCount != MAUWB_RANGE_SLOTS)
     {
         SERIAL_LOG.println("RANGE ANALY ERROR");
-        SERIAL_LOG.println(count);
+        SERIAL_LOG.println(report.rangeCount);
         return;
     }
 
-    count = sscanf(rssi_str.c_str(), "rssi:(%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf)",
-                   &rssi_list[0], &rssi_list[1], &rssi_list[2], &rssi_list[3],
-                   &rssi_list[4], &rssi_list[5], &rssi_list[6], &rssi_list[7]);
-
-    if (count != 8)
+    if (report.rssiCount != MAUWB_RANGE_SLOTS)
     {
         SERIAL_LOG.println("RSSI ANALY ERROR");
-        SERIAL_LOG.println(count);
+        SERIAL_LOG.println(report.rssiCount);
+        return;
+    }
+
+    if (outputPositions)
+    {
+        send_position(report);
         return;
     }
 
-    String json_str = "";
-    json_str = json_str + "{\"id\":" + id_str + ",";
-    json_str = json_str + "\"range\":[";
-    for (int i = 0; i < 8; i++)
+    if (outputFormat == MAUWB_OUTPUT_BINARY)
     {
-        if (i != 7)
-            json_str = json_str + range_list[i] + ",";
-        else
-            json_str = json_str + range_list[i] + "]}";
+        uint8_t frame[MAUWB_FRAME_LENGTH];
+        SERIAL_LOG.write(frame, MaUWB_Frame::encode(report, frame));
+        return;
     }
 
-    SERIAL_LOG.println(json_str);
-}
\ No newline at end of file
+    SERIAL_LOG.print("{\"id\":");
+    SERIAL_LOG.print(report.tid);
+    SERIAL_LOG.print(",\"range\":[");
+    for (int i = 0; i < MAUWB_RANGE_SLOTS; i++)
+    {
+        SERIAL_LOG.print((int)report.range[i]);
+        if (i != MAUWB_RANGE_SLOTS - 1)
+            SERIAL_LOG.print(',');
+    }
+    SERIAL_LOG.println("]}");
+}
+
+void send_position(const MaUWB_RangeReport &report)
+{
+    const MaUWB_TagState *tag = tracker.update(report, millis());
+    if (!tag)
+        return;
+
+    MaUWB_PositionReport position;
+    position.tid = tag->tid;
+    position.seq = tag->seq;
+    position.x = (int16_t)lroundf(tag->x);
+    position.y = (int16_t)lroundf(tag->y);
+    position.mask = tag->mask;
+
+    if (outputFormat == MAUWB_OUTPUT_BINARY)
+    {
+        uint8_t frame[MAUWB_POSITION_LENGTH];
+        SERIAL_LOG.write(frame, MaUWB_Frame::encodePosition(position, frame));
+        return;
+    }
+
+    SERIAL_LOG.print("{\"id\":");
+    SERIAL_LOG.print(position.tid);
+    SERIAL_LOG.print(",\"x\":");
+    SERIAL_LOG.print(position.x);
+    SERIAL_LOG.print(",\"y\":");
+    SERIAL_LOG.print(position.y);
+    SERIAL_LOG.println("}");
+}
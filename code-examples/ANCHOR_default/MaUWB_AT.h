@@ -0,0 +1,636 @@
+/*
+ * MaUWB_AT.h - Non-blocking AT command engine for the MaUWB module
+ *
+ * Commands are queued and sent one at a time. poll() must be called from
+ * loop(); it reads whatever the module has sent, in chunks of up to
+ * MAUWB_AT_READ_CHUNK bytes, completes the command in
+ * flight when an OK / ERROR / expected-prefix line arrives, and expires it
+ * when its deadline passes. Incoming lines are decoded by MaUWB_RangeParser;
+ * range reports go to the report handler and lines that do not answer a
+ * command (echoes, notices) go to the line handler. With a capture output
+ * set, every received line is also written there as a MaUWB_Capture record.
+ * With MAUWB_LATENCY set to 1 each line is timestamped (MaUWB_Latency.h).
+ *
+ * configure() brings the module to a MaUWB_ModuleConfig at boot. It reads
+ * the stored settings back first (AT+GETCFG? / GETCAP? / GETRPT?, and
+ * GETANT? when an antenna delay is given) and only runs the full
+ * RESTORE / SET... / SAVE / RESTART sequence when one differs or cannot be
+ * read, so a module that is already set up is ready in a few replies rather
+ * than seconds.
+ *
+ * Usage:
+ *   MaUWB_AT uwbAt;
+ *   uwbAt.begin(Serial2);
+ *   uwbAt.setLineHandler(handleUwbLine);
+ *   uwbAt.setReportHandler(handleUwbReport);
+ *   uwbAt.send("AT+RANGE", 100, nullptr, nullptr, "AT+RANGE=");
+ *   // In loop:
+ *   uwbAt.poll();
+ */
+
+#ifndef MAUWB_AT_H
+#define MAUWB_AT_H
+
+#include <Arduino.h>
+#include "MaUWB_RangeParser.h"
+#include "MaUWB_Capture.h"
+#include "MaUWB_Latency.h"
+
+// Maximum number of queued commands
+#ifndef MAUWB_AT_QUEUE_SIZE
+#define MAUWB_AT_QUEUE_SIZE 8
+#endif
+
+// Longest command string, including terminator
+#ifndef MAUWB_AT_COMMAND_MAX
+#define MAUWB_AT_COMMAND_MAX 48
+#endif
+
+// Bytes taken from the port per read call in poll()
+#ifndef MAUWB_AT_READ_CHUNK
+#define MAUWB_AT_READ_CHUNK 64
+#endif
+
+// Receive buffer to give the module's UART (setRxBufferSize()), bytes. At
+// 115200 baud it holds about 180 ms of data.
+#ifndef MAUWB_UART_RX_BUFFER
+#define MAUWB_UART_RX_BUFFER 2048
+#endif
+
+// Reply time allowed for a settings query (ms)
+#ifndef MAUWB_AT_QUERY_TIMEOUT
+#define MAUWB_AT_QUERY_TIMEOUT 300
+#endif
+
+// Time allowed for the module to answer "AT" after power-up or AT+RESTART (ms)
+#ifndef MAUWB_AT_BOOT_TIMEOUT
+#define MAUWB_AT_BOOT_TIMEOUT 3000
+#endif
+
+// Settings queries read back by configMatches(), as command and key. The
+// reply line holding the key (case ignored) must carry the values in the
+// order of the matching SET command; they are read as the integers after
+// the key, whatever separates them. These formats are assumed from the SET
+// commands, not checked against the AT manual of every firmware:
+//   AT+GETCFG?  getcfg ID:<id>, Role:<role>, Rate:<rate>, Filter:<filter>
+//   AT+GETCAP?  getcap Capacity:<tags>, Slot:<ms>, Ext:<ext>
+//   AT+GETRPT?  getrpt <report>
+//   AT+GETANT?  getant <delay>
+// A module that words them differently misses the warm boot every time;
+// with a debug output set, configMatches() prints the line it could not read.
+#ifndef MAUWB_AT_GETCFG
+#define MAUWB_AT_GETCFG "AT+GETCFG?"
+#endif
+#ifndef MAUWB_AT_GETCFG_KEY
+#define MAUWB_AT_GETCFG_KEY "getcfg"
+#endif
+#ifndef MAUWB_AT_GETCAP
+#define MAUWB_AT_GETCAP "AT+GETCAP?"
+#endif
+#ifndef MAUWB_AT_GETCAP_KEY
+#define MAUWB_AT_GETCAP_KEY "getcap"
+#endif
+#ifndef MAUWB_AT_GETRPT
+#define MAUWB_AT_GETRPT "AT+GETRPT?"
+#endif
+#ifndef MAUWB_AT_GETRPT_KEY
+#define MAUWB_AT_GETRPT_KEY "getrpt"
+#endif
+#ifndef MAUWB_AT_GETANT
+#define MAUWB_AT_GETANT "AT+GETANT?"
+#endif
+#ifndef MAUWB_AT_GETANT_KEY
+#define MAUWB_AT_GETANT_KEY "getant"
+#endif
+
+// Settings the module is brought to by MaUWB_AT::configure()
+struct MaUWB_ModuleConfig {
+    uint16_t id;             // SETCFG x1: device index
+    uint8_t role;            // SETCFG x2: 0 tag, 1 anchor
+    uint8_t rate;            // SETCFG x3: 0 850 kbps, 1 6.8 Mbps
+    uint8_t filter;          // SETCFG x4: range filter on (1) / off (0)
+    uint8_t capacity;        // SETCAP x1: tag slots
+    uint8_t slotMs;          // SETCAP x2: slot time (ms)
+    uint8_t extMode;         // SETCAP x3: extended packets
+    uint8_t report;          // SETRPT: automatic range reports
+    uint16_t antennaDelay;   // SETANT, 0 leaves it as stored
+};
+
+class MaUWB_AT {
+public:
+    enum Result {
+        AT_OK,       // Module answered "OK"
+        AT_ERROR,    // Module answered with an error
+        AT_MATCH,    // A line starting with the expected prefix arrived
+        AT_TIMEOUT   // Deadline passed without a reply
+    };
+
+    // reply is the terminating line, or nullptr on timeout
+    typedef void (*ReplyCallback)(Result result, const char* reply, void* context);
+    typedef void (*LineHandler)(const char* line, uint8_t length, void* context);
+    typedef void (*ReportHandler)(const MaUWB_RangeReport& report, void* context);
+
+    MaUWB_AT();
+
+    void begin(Stream& port);
+
+    // Queue a command. expect (optional) must point to a string that outlives
+    // the command, normally a literal. Returns false if the queue is full or
+    // the command is too long.
+    bool send(const char* command, unsigned long timeoutMs,
+              ReplyCallback callback = nullptr, void* context = nullptr,
+              const char* expect = nullptr);
+
+    // Queue a command and service the link until it completes, after any
+    // commands queued ahead of it. Returns that command's result, as soon as
+    // its reply is seen; intended for setup().
+    Result sendAndWait(const char* command, unsigned long timeoutMs,
+                       const char* expect = nullptr);
+
+    // Service the link - call this in loop()
+    void poll();
+
+    bool isBusy() const { return inFlight || queueCount > 0; }
+    uint8_t pending() const { return queueCount + (inFlight ? 1 : 0); }
+
+    void setLineHandler(LineHandler handler, void* context = nullptr);
+
+    // Decoded range reports; without a report handler they reach the line handler
+    void setReportHandler(ReportHandler handler, void* context = nullptr);
+
+    // Most bytes found waiting in the port by poll(), to size the RX buffer
+    uint16_t getRxHighWater() const { return rxHighWater; }
+    void resetRxHighWater() { rxHighWater = 0; }
+
+    // Print commands and replies to this output (nullptr to disable)
+    void setDebugOutput(Print* output) { debugOutput = output; }
+
+    // Record every line from the module, timestamped with micros(), to this
+    // output (a File, or Serial alongside the logs; nullptr to stop)
+    void setCaptureOutput(Print* output);
+
+    // Send a query and wait for its reply. The line containing key (case is
+    // ignored) is copied to reply; returns AT_MATCH if one arrived.
+    Result queryAndWait(const char* command, const char* key, char* reply, size_t size,
+                        unsigned long timeoutMs = MAUWB_AT_QUERY_TIMEOUT);
+
+    // Ping with "AT" until the module answers. Returns false on timeout.
+    bool waitReady(unsigned long timeoutMs = MAUWB_AT_BOOT_TIMEOUT);
+
+    // True if the module's stored settings are those in config
+    bool configMatches(const MaUWB_ModuleConfig& config);
+
+    // Bring the module to config, rewriting and restarting it only if its
+    // stored settings differ. Returns AT_MATCH if they already matched and
+    // AT_OK once a rewritten module answers again with config read back.
+    // Otherwise the setup stops at the first failure: AT_TIMEOUT if the
+    // module does not answer "AT" before or after the restart, the result of
+    // the first step not answered with OK, or AT_ERROR if the settings still
+    // differ after the restart.
+    Result configure(const MaUWB_ModuleConfig& config);
+
+#if MAUWB_LATENCY
+    // Timestamps of the line last handed to a handler; valid inside it
+    const MaUWB_LineTiming& getLineTiming() const { return lineTiming; }
+#endif
+
+private:
+    struct Command {
+        char text[MAUWB_AT_COMMAND_MAX];
+        const char* expect;
+        unsigned long timeoutMs;
+        ReplyCallback callback;
+        void* context;
+    };
+
+    Stream* port;
+
+    // Command queue (ring buffer)
+    Command queue[MAUWB_AT_QUEUE_SIZE];
+    uint8_t queueHead;
+    uint8_t queueCount;
+
+    // Command in flight
+    Command current;
+    bool inFlight;
+    unsigned long sentAt;
+
+    // Receive line buffer and report decoder
+    MaUWB_RangeParser parser;
+
+    LineHandler lineHandler;
+    void* lineContext;
+    ReportHandler reportHandler;
+    void* reportContext;
+    Print* debugOutput;
+    Print* captureOutput;
+    MaUWB_CaptureWriter captureWriter;
+
+    uint16_t rxHighWater;
+
+    // Reply wanted by queryAndWait()
+    const char* queryKey;
+    char* queryReply;
+    size_t querySize;
+    bool queryFound;
+
+#if MAUWB_LATENCY
+    MaUWB_LineTiming lineTiming;
+    bool lineStarted;
+#endif
+
+    // Completion of a sendAndWait() command
+    struct Wait {
+        Result result;
+        bool done;
+    };
+    static void finishWait(Result result, const char* reply, void* context);
+
+    void startNext();
+    void complete(Result result, const char* reply);
+    void handleLine(MaUWB_RangeParser::Event event);
+    Result setupStep(const char* command, unsigned long timeoutMs);
+    bool queryMatches(const char* command, const char* key, const int32_t* wanted, uint8_t count);
+    static const char* findKey(const char* line, const char* key);
+    static uint8_t parseNumbers(const char* text, int32_t* values, uint8_t maxValues);
+};
+
+// Implementation
+
+inline MaUWB_AT::MaUWB_AT()
+    : port(nullptr), queueHead(0), queueCount(0), inFlight(false), sentAt(0),
+      lineHandler(nullptr), lineContext(nullptr),
+      reportHandler(nullptr), reportContext(nullptr), debugOutput(nullptr), captureOutput(nullptr),
+      rxHighWater(0), queryKey(nullptr), queryReply(nullptr), querySize(0), queryFound(false) {
+#if MAUWB_LATENCY
+    lineTiming.firstByte = lineTiming.complete = lineTiming.parsed = 0;
+    lineStarted = false;
+#endif
+}
+
+inline void MaUWB_AT::begin(Stream& port) {
+    this->port = &port;
+    parser.reset();
+}
+
+inline bool MaUWB_AT::send(const char* command, unsigned long timeoutMs,
+                           ReplyCallback callback, void* context, const char* expect) {
+    size_t length = strlen(command);
+    if (queueCount >= MAUWB_AT_QUEUE_SIZE || length >= MAUWB_AT_COMMAND_MAX) {
+        return false;
+    }
+
+    Command& slot = queue[(queueHead + queueCount) % MAUWB_AT_QUEUE_SIZE];
+    memcpy(slot.text, command, length + 1);
+    slot.expect = expect;
+    slot.timeoutMs = timeoutMs;
+    slot.callback = callback;
+    slot.context = context;
+    queueCount++;
+
+    if (!inFlight) {
+        startNext();
+    }
+    return true;
+}
+
+inline MaUWB_AT::Result MaUWB_AT::sendAndWait(const char* command, unsigned long timeoutMs,
+                                              const char* expect) {
+    Wait wait = {AT_ERROR, false};
+    if (!port || !send(command, timeoutMs, finishWait, &wait, expect)) {
+        return AT_ERROR;
+    }
+
+    // Not isBusy(): a callback may queue more behind this command, and the
+    // result must be this command's, not the last one's
+    while (!wait.done) {
+        poll();
+        yield();
+    }
+    return wait.result;
+}
+
+inline void MaUWB_AT::finishWait(Result result, const char*, void* context) {
+    Wait* wait = (Wait*)context;
+    wait->result = result;
+    wait->done = true;
+}
+
+inline MaUWB_AT::Result MaUWB_AT::queryAndWait(const char* command, const char* key,
+                                               char* reply, size_t size, unsigned long timeoutMs) {
+    if (size == 0) {
+        return AT_ERROR;
+    }
+    reply[0] = '\0';
+    queryKey = key;
+    queryReply = reply;
+    querySize = size;
+    queryFound = false;
+
+    // Completes on the OK after the data line, so that OK is not taken as
+    // the answer to the next command
+    Result result = sendAndWait(command, timeoutMs);
+    queryKey = nullptr;
+    return queryFound ? AT_MATCH : result;
+}
+
+inline bool MaUWB_AT::waitReady(unsigned long timeoutMs) {
+    unsigned long start = millis();
+    do {
+        if (sendAndWait("AT", 100) == AT_OK) {
+            return true;
+        }
+    } while (millis() - start < timeoutMs);
+    return false;
+}
+
+// Query and compare the leading numbers of the reply with wanted. With a
+// debug output, a missing reply, one that does not parse and a setting that
+// differs are each reported, so a format miss is told apart from a mismatch.
+inline bool MaUWB_AT::queryMatches(const char* command, const char* key,
+                                   const int32_t* wanted, uint8_t count) {
+    char reply[MAUWB_RANGE_LINE_MAX];
+    if (queryAndWait(command, key, reply, sizeof(reply)) != AT_MATCH) {
+        if (debugOutput) {
+            debugOutput->print(F("No reply with key "));
+            debugOutput->print(key);
+            debugOutput->print(F(" to "));
+            debugOutput->println(command);
+        }
+        return false;
+    }
+
+    // Read after the key so digits in a prefix are not taken as values
+    const char* text = findKey(reply, key) + strlen(key);
+
+    int32_t values[8];
+    if (parseNumbers(text, values, 8) < count) {
+        if (debugOutput) {
+            debugOutput->print(F("Unreadable reply to "));
+            debugOutput->print(command);
+            debugOutput->print(F(": "));
+            debugOutput->println(reply);
+        }
+        return false;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        if (values[i] != wanted[i]) {
+            if (debugOutput) {
+                debugOutput->print(F("Setting differs: "));
+                debugOutput->println(reply);
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool MaUWB_AT::configMatches(const MaUWB_ModuleConfig& config) {
+    const int32_t cfg[4] = {config.id, config.role, config.rate, config.filter};
+    const int32_t cap[3] = {config.capacity, config.slotMs, config.extMode};
+    const int32_t rpt[1] = {config.report};
+    const int32_t ant[1] = {config.antennaDelay};
+    return queryMatches(MAUWB_AT_GETCFG, MAUWB_AT_GETCFG_KEY, cfg, 4) &&
+           queryMatches(MAUWB_AT_GETCAP, MAUWB_AT_GETCAP_KEY, cap, 3) &&
+           queryMatches(MAUWB_AT_GETRPT, MAUWB_AT_GETRPT_KEY, rpt, 1) &&
+           (config.antennaDelay == 0 || queryMatches(MAUWB_AT_GETANT, MAUWB_AT_GETANT_KEY, ant, 1));
+}
+
+inline MaUWB_AT::Result MaUWB_AT::configure(const MaUWB_ModuleConfig& config) {
+    if (!waitReady()) {
+        if (debugOutput) {
+            debugOutput->println(F("Module not answering, setup skipped"));
+        }
+        return AT_TIMEOUT;
+    }
+    if (configMatches(config)) {
+        if (debugOutput) {
+            debugOutput->println(F("Module settings match, skipping setup"));
+        }
+        return AT_MATCH;
+    }
+
+    // Each step must answer OK; the first that does not ends the setup
+    char command[MAUWB_AT_COMMAND_MAX];
+    Result result = setupStep("AT+RESTORE", 5000);
+    if (result != AT_OK) return result;
+
+    snprintf(command, sizeof(command), "AT+SETCFG=%u,%u,%u,%u",
+             config.id, config.role, config.rate, config.filter);
+    result = setupStep(command, 500);
+    if (result != AT_OK) return result;
+    snprintf(command, sizeof(command), "AT+SETCAP=%u,%u,%u",
+             config.capacity, config.slotMs, config.extMode);
+    result = setupStep(command, 500);
+    if (result != AT_OK) return result;
+    snprintf(command, sizeof(command), "AT+SETRPT=%u", config.report);
+    result = setupStep(command, 500);
+    if (result != AT_OK) return result;
+    if (config.antennaDelay != 0) {
+        snprintf(command, sizeof(command), "AT+SETANT=%u", config.antennaDelay);
+        result = setupStep(command, 500);
+        if (result != AT_OK) return result;
+    }
+
+    result = setupStep("AT+SAVE", 2000);
+    if (result != AT_OK) return result;
+    result = setupStep("AT+RESTART", 1000);
+    if (result != AT_OK) return result;
+    if (!waitReady()) {
+        return AT_TIMEOUT;
+    }
+
+    // Read back what the module kept after the restart
+    if (!configMatches(config)) {
+        if (debugOutput) {
+            debugOutput->println(F("Module settings still differ after setup"));
+        }
+        return AT_ERROR;
+    }
+    return AT_OK;
+}
+
+// One command of the configure() sequence; reports a failed step
+inline MaUWB_AT::Result MaUWB_AT::setupStep(const char* command, unsigned long timeoutMs) {
+    Result result = sendAndWait(command, timeoutMs);
+    if (result != AT_OK && debugOutput) {
+        debugOutput->print(F("Setup failed at "));
+        debugOutput->println(command);
+    }
+    return result;
+}
+
+inline void MaUWB_AT::poll() {
+    if (!port) return;
+
+    int waiting;
+    while ((waiting = port->available()) > 0) {
+        if (waiting > rxHighWater) {
+            rxHighWater = waiting > 0xFFFF ? 0xFFFF : waiting;
+        }
+
+        // One driver call per chunk instead of one per byte; no more than is
+        // waiting, so readBytes() does not wait for its timeout
+        char chunk[MAUWB_AT_READ_CHUNK];
+        size_t count = port->readBytes(chunk, waiting < MAUWB_AT_READ_CHUNK ? waiting : MAUWB_AT_READ_CHUNK);
+        if (count == 0) {
+            break;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            char c = chunk[i];
+#if MAUWB_LATENCY
+            if (!lineStarted) {
+                lineTiming.firstByte = micros();
+                lineStarted = true;
+            }
+            if (c == '\n') {
+                lineTiming.complete = micros();
+                lineStarted = false;
+            }
+#endif
+            MaUWB_RangeParser::Event event = parser.feed(c);
+            if (event != MaUWB_RangeParser::NONE) {
+#if MAUWB_LATENCY
+                lineTiming.parsed = micros();
+#endif
+                if (captureOutput) {
+                    uint8_t record[MAUWB_CAPTURE_RECORD_MAX];
+                    captureOutput->write(record, captureWriter.encode(micros(), parser.line(), parser.lineLength(), record));
+                }
+                handleLine(event);
+            }
+        }
+    }
+
+    if (inFlight && millis() - sentAt >= current.timeoutMs) {
+        if (debugOutput) {
+            debugOutput->print(F("TIMEOUT: "));
+            debugOutput->println(current.text);
+        }
+        complete(AT_TIMEOUT, nullptr);
+    }
+}
+
+inline void MaUWB_AT::setLineHandler(LineHandler handler, void* context) {
+    lineHandler = handler;
+    lineContext = context;
+}
+
+inline void MaUWB_AT::setCaptureOutput(Print* output) {
+    captureOutput = output;
+    captureWriter.reset();
+}
+
+inline void MaUWB_AT::setReportHandler(ReportHandler handler, void* context) {
+    reportHandler = handler;
+    reportContext = context;
+}
+
+// Send the next queued command, if any
+inline void MaUWB_AT::startNext() {
+    if (queueCount == 0 || !port) return;
+
+    current = queue[queueHead];
+    queueHead = (queueHead + 1) % MAUWB_AT_QUEUE_SIZE;
+    queueCount--;
+
+    if (debugOutput) {
+        debugOutput->print(F("CMD: "));
+        debugOutput->println(current.text);
+    }
+
+    port->println(current.text);
+    sentAt = millis();
+    inFlight = true;
+}
+
+inline void MaUWB_AT::complete(Result result, const char* reply) {
+    inFlight = false;
+
+    if (debugOutput && reply) {
+        debugOutput->print(F("RESP: "));
+        debugOutput->println(reply);
+    }
+
+    if (current.callback) {
+        current.callback(result, reply, current.context);
+    }
+
+    // The callback may already have queued and started a follow-up command
+    if (!inFlight) {
+        startNext();
+    }
+}
+
+// Match a complete line against the command in flight
+inline void MaUWB_AT::handleLine(MaUWB_RangeParser::Event event) {
+    const char* line = parser.line();
+    bool forward = true;
+
+    // The reply to a query; an echo of the command also contains the key
+    if (inFlight && queryKey && !queryFound && strcmp(line, current.text) != 0 &&
+        findKey(line, queryKey)) {
+        size_t length = parser.lineLength() < querySize - 1 ? parser.lineLength() : querySize - 1;
+        memcpy(queryReply, line, length);
+        queryReply[length] = '\0';
+        queryFound = true;
+        return;
+    }
+
+    if (inFlight) {
+        if (current.expect && strncmp(line, current.expect, strlen(current.expect)) == 0) {
+            // Data replies are still passed on to the line handler below
+            complete(AT_MATCH, line);
+        } else if (strncmp(line, "OK", 2) == 0) {
+            complete(AT_OK, line);
+            forward = false;
+        } else if (strstr(line, "ERR") != nullptr) {
+            complete(AT_ERROR, line);
+            forward = false;
+        }
+    }
+
+    if (!forward) return;
+
+    if (event == MaUWB_RangeParser::REPORT && reportHandler) {
+        reportHandler(parser.report(), reportContext);
+    } else if (lineHandler) {
+        lineHandler(line, parser.lineLength(), lineContext);
+    }
+}
+
+// First occurrence of key in line, ignoring case, or nullptr
+inline const char* MaUWB_AT::findKey(const char* line, const char* key) {
+    size_t length = strlen(key);
+    for (; *line; line++) {
+        size_t i = 0;
+        while (i < length && line[i] && tolower((unsigned char)line[i]) == tolower((unsigned char)key[i])) {
+            i++;
+        }
+        if (i == length) {
+            return line;
+        }
+    }
+    return nullptr;
+}
+
+// Integers in text, in order, whatever separates them ("7,0,1,1" or
+// "ID:7, Role:0, ..."). Returns how many were read.
+inline uint8_t MaUWB_AT::parseNumbers(const char* text, int32_t* values, uint8_t maxValues) {
+    uint8_t count = 0;
+    while (*text && count < maxValues) {
+        if (*text >= '0' && *text <= '9') {
+            int32_t value = 0;
+            while (*text >= '0' && *text <= '9') {
+                value = value * 10 + (*text++ - '0');
+            }
+            values[count++] = value;
+        } else {
+            text++;
+        }
+    }
+    return count;
+}
+
+#endif // MAUWB_AT_H
@@ -4,6 +4,10 @@
 // Create UWB tag instance
 MaUWB_TAG uwbTag(7, 50);  // Tag index 7, 50ms refresh rate
 
+// Stream fixes over ESP-NOW to a STREAM_BRIDGE board (optional)
+// #include "MaUWB_StreamSink.h"
+// MaUWB_EspNowSink radio;
+
 void setup() {
     // Configure anchor positions before initializing
     // Example: Custom anchor layout
@@ -18,11 +22,44 @@ void setup() {
     // uwbTag.anchor2(330, 550);
     // uwbTag.anchor3(330, 50);
     
+    // Anchors mounted at different heights (x, y, z in cm), 3D mode (optional)
+    // uwbTag.anchor0(0, 0, 250);
+    // uwbTag.setTagHeight(100);                  // Known tag height, or:
+    // uwbTag.setHeightEstimation(true, 0, 250);  // estimate it per fix
+    
+    // Position smoothing (optional - Kalman filter by default)
+    // uwbTag.setFilterMode(MAUWB_FILTER_MOVING_AVERAGE);
+    // uwbTag.setPositionHistoryLength(5);
+    
+    // Outlier rejection (optional - useful with 5 or more anchors)
+    // uwbTag.setOutlierRejection(20);   // Try at most 20 anchor triplets per fix
+    
+    // Drop anchors that answer in fewer than half of the recent reports (optional)
+    // uwbTag.setMinAnchorDelivery(0.5f);
+    
+    // Zones (optional): onZoneChange() runs when the tag enters or leaves one
+    // uwbTag.getZoneMap().begin(0, 0, 380, 600);              // Room bounds, 10 cm cells
+    // uwbTag.getZoneMap().addRectangle(0, -50, 400, 430, 650); // Zone 0: far end of the room
+    
+    // Record raw module output for offline replay (optional - see MaUWB_Capture.h)
+    // uwbTag.setCaptureOutput(&Serial);   // or a LittleFS / SD File
+    
+    // Send batched fixes over the radio (optional - see MaUWB_Stream.h)
+    // radio.begin(1);                   // WiFi channel of the bridge
+    // uwbTag.setStreamSink(&radio);
+
+    // Range at 50 ms while moving, back off to 1 s at rest (optional)
+    // uwbTag.setAdaptiveRate(true, 1000);
+    // uwbTag.setLightSleep(true);         // Sleep between polls at rest; USB serial drops out
+    
     // Enable debug output (optional - disabled by default)
     // uwbTag.enableDebug();
     
     // Initialize the UWB tag system
     uwbTag.begin();
+    
+    // Dual-core mode (optional): ranging on core 1, display and logging on core 0
+    // uwbTag.startDualCore();
 }
 
 void loop() {
@@ -31,12 +68,25 @@ void loop() {
     
     // Example: Toggle debug with serial commands
     // Send 'd' to enable debug, 'q' to disable debug
+    // Send 'c' to start capturing raw module output to Serial, 'x' to stop
+    // Send 's' to print report loss and per-anchor delivery
+    // Send 'l' to print hot-path latencies (#define MAUWB_LATENCY 1), 'r' to reset them
     if (Serial.available()) {
         char cmd = Serial.read();
         if (cmd == 'd' || cmd == 'D') {
             uwbTag.enableDebug(true);
         } else if (cmd == 'q' || cmd == 'Q') {
             uwbTag.disableDebug();
+        } else if (cmd == 'c' || cmd == 'C') {
+            uwbTag.setCaptureOutput(&Serial);
+        } else if (cmd == 'x' || cmd == 'X') {
+            uwbTag.setCaptureOutput(nullptr);
+        } else if (cmd == 's' || cmd == 'S') {
+            uwbTag.printLinkStats(Serial);
+        } else if (cmd == 'l' || cmd == 'L') {
+            uwbTag.printLatencyStats(Serial);
+        } else if (cmd == 'r' || cmd == 'R') {
+            uwbTag.resetLatencyStats();
         }
     }
     
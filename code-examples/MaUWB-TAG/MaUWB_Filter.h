@@ -0,0 +1,260 @@
+/*
+ * MaUWB_Filter.h - Position filter stage for MaUWB tags
+ *
+ * A filter takes each raw fix and returns the smoothed position. Two are
+ * built in:
+ *
+ *   MaUWB_MovingAverage  - mean of the last N fixes, kept as running sums so
+ *                          an update is O(1) whatever the window length
+ *   MaUWB_KalmanFilter   - 2D constant-velocity Kalman filter. It tracks
+ *                          velocity, so it smooths without the lag a long
+ *                          averaging window adds to a moving tag.
+ *
+ * Other filters can be plugged in by deriving from MaUWB_PositionFilter.
+ *
+ * Both built-in filters are templates on their number type (see
+ * MaUWB_Numeric.h); the names above are MaUWB_Real instances. The
+ * interface stays in float cm either way.
+ *
+ * Only needs the C library, so it also builds on a desktop compiler.
+ */
+
+#ifndef MAUWB_FILTER_H
+#define MAUWB_FILTER_H
+
+#include <stdint.h>
+#include "MaUWB_Numeric.h"
+
+// Longest moving-average window
+#ifndef MAUWB_FILTER_MAX_WINDOW
+#define MAUWB_FILTER_MAX_WINDOW 10
+#endif
+
+// Gap between fixes after which the Kalman filter restarts from the next fix (s)
+#ifndef MAUWB_KALMAN_RESTART_GAP
+#define MAUWB_KALMAN_RESTART_GAP 2.0f
+#endif
+
+enum MaUWB_FilterMode {
+    MAUWB_FILTER_NONE,            // Raw fixes
+    MAUWB_FILTER_MOVING_AVERAGE,  // Mean of the last N fixes
+    MAUWB_FILTER_KALMAN,          // Constant-velocity Kalman filter
+    MAUWB_FILTER_CUSTOM           // User filter set with setFilter()
+};
+
+class MaUWB_PositionFilter {
+public:
+    virtual ~MaUWB_PositionFilter() {}
+
+    // Forget all state; the next fix passes through unchanged
+    virtual void reset() = 0;
+
+    // Feed a raw fix taken dt seconds after the previous one (cm)
+    virtual void update(float x, float y, float dt, float& outX, float& outY) = 0;
+};
+
+// Moving average over the last N fixes, for windows up to W
+template <typename T, uint8_t W = MAUWB_FILTER_MAX_WINDOW>
+class MaUWB_MovingAverageT : public MaUWB_PositionFilter {
+    static_assert(W >= 1, "window of at least one fix");
+
+public:
+    static const uint8_t MAX_WINDOW = W;
+
+    explicit MaUWB_MovingAverageT(uint8_t length = 5);
+
+    // Window length, 1..W; resets the filter
+    void setLength(uint8_t length);
+    uint8_t getLength() const { return length; }
+
+    void reset() override;
+    void update(float x, float y, float dt, float& outX, float& outY) override;
+
+private:
+    typedef MaUWB_Numeric<T> Num;
+
+    // In solver units (MaUWB_Numeric<T>::unit())
+    T historyX[W];
+    T historyY[W];
+    T sumX, sumY;
+    uint8_t length;
+    uint8_t index;
+    uint8_t filled;
+};
+
+// Constant-velocity Kalman filter. Both axes see the same noise and time
+// step, so they share one 2x2 covariance and the gain is computed once.
+template <typename T>
+class MaUWB_KalmanFilterT : public MaUWB_PositionFilter {
+public:
+    // processNoise: acceleration noise density (cm^2/s^3)
+    // measurementNoise: variance of a raw fix (cm^2)
+    MaUWB_KalmanFilterT(float processNoise = 2000.0f, float measurementNoise = 100.0f);
+
+    void setNoise(float processNoise, float measurementNoise);
+
+    // Tie the smoothing to a history length: larger N trusts the motion
+    // model more (process noise scales with 1/N^2)
+    void setSmoothing(uint8_t length);
+
+    // cm/s
+    float getVelocityX() const { return Num::toFloat(velX) * Num::unit(); }
+    float getVelocityY() const { return Num::toFloat(velY) * Num::unit(); }
+
+    void reset() override;
+    void update(float x, float y, float dt, float& outX, float& outY) override;
+
+private:
+    typedef MaUWB_Numeric<T> Num;
+
+    float baseProcessNoise;
+    uint8_t smoothing;
+
+    // State in solver units (MaUWB_Numeric<T>::unit()) and seconds
+    T processNoise;
+    T measurementNoise;
+
+    bool initialized;
+    T posX, posY;
+    T velX, velY;
+    T p00, p01, p11;   // Shared covariance of [position, velocity]
+};
+
+typedef MaUWB_MovingAverageT<MaUWB_Real> MaUWB_MovingAverage;
+typedef MaUWB_KalmanFilterT<MaUWB_Real> MaUWB_KalmanFilter;
+
+// Implementation
+
+template <typename T, uint8_t W>
+inline MaUWB_MovingAverageT<T, W>::MaUWB_MovingAverageT(uint8_t length) : length(1) {
+    setLength(length);
+}
+
+template <typename T, uint8_t W>
+inline void MaUWB_MovingAverageT<T, W>::setLength(uint8_t length) {
+    if (length < 1) length = 1;
+    if (length > W) length = W;
+    this->length = length;
+    reset();
+}
+
+template <typename T, uint8_t W>
+inline void MaUWB_MovingAverageT<T, W>::reset() {
+    sumX = 0;
+    sumY = 0;
+    index = 0;
+    filled = 0;
+}
+
+template <typename T, uint8_t W>
+inline void MaUWB_MovingAverageT<T, W>::update(float x, float y, float /*dt*/, float& outX, float& outY) {
+    T fixX = Num::fromFloat(x / Num::unit());
+    T fixY = Num::fromFloat(y / Num::unit());
+
+    // Swap the oldest fix out of the running sums
+    if (filled == length) {
+        sumX -= historyX[index];
+        sumY -= historyY[index];
+    } else {
+        filled++;
+    }
+
+    historyX[index] = fixX;
+    historyY[index] = fixY;
+    sumX += fixX;
+    sumY += fixY;
+    index = (index + 1) % length;
+
+    // Re-sum once per cycle so float rounding in the running sums cannot build up
+    if (index == 0 && filled == length) {
+        sumX = 0;
+        sumY = 0;
+        for (uint8_t i = 0; i < length; i++) {
+            sumX += historyX[i];
+            sumY += historyY[i];
+        }
+    }
+
+    outX = Num::toFloat(sumX / T((int)filled)) * Num::unit();
+    outY = Num::toFloat(sumY / T((int)filled)) * Num::unit();
+}
+
+template <typename T>
+inline MaUWB_KalmanFilterT<T>::MaUWB_KalmanFilterT(float processNoise, float measurementNoise)
+    : baseProcessNoise(processNoise), smoothing(1) {
+    setNoise(processNoise, measurementNoise);
+    reset();
+}
+
+template <typename T>
+inline void MaUWB_KalmanFilterT<T>::setNoise(float processNoise, float measurementNoise) {
+    baseProcessNoise = processNoise;
+    this->measurementNoise = Num::fromFloat(measurementNoise / (Num::unit() * Num::unit()));
+    setSmoothing(smoothing);
+}
+
+template <typename T>
+inline void MaUWB_KalmanFilterT<T>::setSmoothing(uint8_t length) {
+    if (length < 1) length = 1;
+    smoothing = length;
+    processNoise = Num::fromFloat(baseProcessNoise / ((float)length * length) / (Num::unit() * Num::unit()));
+}
+
+template <typename T>
+inline void MaUWB_KalmanFilterT<T>::reset() {
+    initialized = false;
+    posX = posY = 0;
+    velX = velY = 0;
+    p00 = p01 = p11 = 0;
+}
+
+template <typename T>
+inline void MaUWB_KalmanFilterT<T>::update(float x, float y, float dt, float& outX, float& outY) {
+    T fixX = Num::fromFloat(x / Num::unit());
+    T fixY = Num::fromFloat(y / Num::unit());
+
+    if (!initialized || dt <= 0 || dt > MAUWB_KALMAN_RESTART_GAP) {
+        // Start at the fix with unknown velocity
+        initialized = true;
+        posX = fixX;
+        posY = fixY;
+        velX = velY = 0;
+        p00 = measurementNoise;
+        p01 = 0;
+        p11 = Num::fromFloat(1e4f / (Num::unit() * Num::unit()));   // (100 cm/s)^2
+        outX = x;
+        outY = y;
+        return;
+    }
+
+    // Predict: x' = x + v dt, P' = F P F^T + Q (white acceleration)
+    T step = Num::fromFloat(dt);
+    posX += velX * step;
+    posY += velY * step;
+
+    T qdt = processNoise * step;
+    T n00 = p00 + T(2) * step * p01 + step * step * p11 + qdt * step * step / T(3);
+    T n01 = p01 + step * p11 + qdt * step / T(2);
+    T n11 = p11 + qdt;
+
+    // Update with the position measurement; same gain for both axes
+    T s = n00 + measurementNoise;
+    T k0 = n00 / s;
+    T k1 = n01 / s;
+
+    T innovX = fixX - posX;
+    T innovY = fixY - posY;
+    posX += k0 * innovX;
+    posY += k0 * innovY;
+    velX += k1 * innovX;
+    velY += k1 * innovY;
+
+    p00 = (T(1) - k0) * n00;
+    p01 = (T(1) - k0) * n01;
+    p11 = n11 - k1 * n01;
+
+    outX = Num::toFloat(posX) * Num::unit();
+    outY = Num::toFloat(posY) * Num::unit();
+}
+
+#endif // MAUWB_FILTER_H
@@ -0,0 +1,168 @@
+/*
+ * MaUWB_Frame.h - Compact binary range and position frames for host visualizers
+ *
+ * A JSON line per range report costs 40-80 bytes and a JSON.parse on the
+ * host. The binary frame carries the same report in 28 bytes:
+ *
+ *   offset  size  field
+ *   0       1     sync byte 0xA5
+ *   1       1     tid (low byte)
+ *   2       1     seq (low byte)
+ *   3       16    8 x uint16 range in cm, little endian (0 = no reply)
+ *   19      8     8 x int8 RSSI in dBm
+ *   27      1     CRC-8 (poly 0x07, init 0) over bytes 1..26
+ *
+ * With anchor-side tracking (MaUWB_Tracker.h) the anchor sends positions
+ * instead, in a 9-byte frame:
+ *
+ *   offset  size  field
+ *   0       1     sync byte 0xA6
+ *   1       1     tid (low byte)
+ *   2       1     seq (low byte)
+ *   3       2     x in cm, int16 little endian
+ *   5       2     y in cm, int16 little endian
+ *   7       1     mask of the anchors in the report
+ *   8       1     CRC-8 over bytes 1..7
+ *
+ * Neither sync byte occurs in the anchors' ASCII text output, so frames
+ * and log lines can share one serial stream; a decoder treats everything
+ * outside a frame as text. The matching JavaScript decoder is uwb_frame.js
+ * in the p5 sketch folders.
+ *
+ * Only needs the C library, so it also builds on a desktop compiler.
+ */
+
+#ifndef MAUWB_FRAME_H
+#define MAUWB_FRAME_H
+
+#include <stdint.h>
+#include "MaUWB_RangeParser.h"
+
+#define MAUWB_FRAME_SYNC 0xA5
+#define MAUWB_FRAME_SLOTS 8
+#define MAUWB_FRAME_LENGTH (3 + MAUWB_FRAME_SLOTS * 2 + MAUWB_FRAME_SLOTS + 1)
+
+#define MAUWB_POSITION_SYNC 0xA6
+#define MAUWB_POSITION_LENGTH 9
+
+// Host output formats for the anchors
+#define MAUWB_OUTPUT_JSON 0
+#define MAUWB_OUTPUT_BINARY 1
+
+// One tag position as carried by a position frame
+struct MaUWB_PositionReport {
+    uint16_t tid;
+    uint16_t seq;
+    int16_t x;      // cm
+    int16_t y;      // cm
+    uint8_t mask;   // Anchors that answered
+};
+
+class MaUWB_Frame {
+public:
+    // Write a report into out (MAUWB_FRAME_LENGTH bytes). Returns the length.
+    static uint8_t encode(const MaUWB_RangeReport& report, uint8_t* out);
+
+    // Check and decode a complete frame. The report's mask is rebuilt from
+    // the non-zero ranges.
+    static bool decode(const uint8_t* frame, MaUWB_RangeReport& out);
+
+    // Same for position frames (MAUWB_POSITION_LENGTH bytes)
+    static uint8_t encodePosition(const MaUWB_PositionReport& position, uint8_t* out);
+    static bool decodePosition(const uint8_t* frame, MaUWB_PositionReport& out);
+
+    static uint8_t crc8(const uint8_t* data, uint8_t length);
+};
+
+// Implementation
+
+inline uint8_t MaUWB_Frame::encode(const MaUWB_RangeReport& report, uint8_t* out) {
+    out[0] = MAUWB_FRAME_SYNC;
+    out[1] = (uint8_t)report.tid;
+    out[2] = (uint8_t)report.seq;
+
+    uint8_t* ranges = out + 3;
+    int8_t* rssi = (int8_t*)(out + 3 + MAUWB_FRAME_SLOTS * 2);
+
+    for (uint8_t i = 0; i < MAUWB_FRAME_SLOTS; i++) {
+        float range = i < report.rangeCount && i < MAUWB_RANGE_SLOTS ? report.range[i] : 0;
+        float level = i < report.rssiCount && i < MAUWB_RANGE_SLOTS ? report.rssi[i] : 0;
+
+        uint16_t cm = range <= 0 ? 0 : range >= 65535.0f ? 65535 : (uint16_t)(range + 0.5f);
+        ranges[i * 2] = (uint8_t)cm;
+        ranges[i * 2 + 1] = (uint8_t)(cm >> 8);
+
+        long dbm = (long)(level < 0 ? level - 0.5f : level + 0.5f);
+        rssi[i] = (int8_t)(dbm < -128 ? -128 : dbm > 127 ? 127 : dbm);
+    }
+
+    out[MAUWB_FRAME_LENGTH - 1] = crc8(out + 1, MAUWB_FRAME_LENGTH - 2);
+    return MAUWB_FRAME_LENGTH;
+}
+
+inline bool MaUWB_Frame::decode(const uint8_t* frame, MaUWB_RangeReport& out) {
+    if (frame[0] != MAUWB_FRAME_SYNC ||
+        crc8(frame + 1, MAUWB_FRAME_LENGTH - 2) != frame[MAUWB_FRAME_LENGTH - 1]) {
+        return false;
+    }
+
+    memset(&out, 0, sizeof(out));
+    out.tid = frame[1];
+    out.seq = frame[2];
+
+    const uint8_t* ranges = frame + 3;
+    const int8_t* rssi = (const int8_t*)(frame + 3 + MAUWB_FRAME_SLOTS * 2);
+    uint8_t slots = MAUWB_FRAME_SLOTS < MAUWB_RANGE_SLOTS ? MAUWB_FRAME_SLOTS : MAUWB_RANGE_SLOTS;
+
+    for (uint8_t i = 0; i < slots; i++) {
+        uint16_t cm = ranges[i * 2] | (ranges[i * 2 + 1] << 8);
+        out.range[i] = cm;
+        out.rssi[i] = rssi[i];
+        if (cm > 0 && i < 8) {
+            out.mask |= 1 << i;
+        }
+    }
+    out.rangeCount = slots;
+    out.rssiCount = slots;
+    return true;
+}
+
+inline uint8_t MaUWB_Frame::encodePosition(const MaUWB_PositionReport& position, uint8_t* out) {
+    out[0] = MAUWB_POSITION_SYNC;
+    out[1] = (uint8_t)position.tid;
+    out[2] = (uint8_t)position.seq;
+    out[3] = (uint8_t)position.x;
+    out[4] = (uint8_t)((uint16_t)position.x >> 8);
+    out[5] = (uint8_t)position.y;
+    out[6] = (uint8_t)((uint16_t)position.y >> 8);
+    out[7] = position.mask;
+    out[8] = crc8(out + 1, MAUWB_POSITION_LENGTH - 2);
+    return MAUWB_POSITION_LENGTH;
+}
+
+inline bool MaUWB_Frame::decodePosition(const uint8_t* frame, MaUWB_PositionReport& out) {
+    if (frame[0] != MAUWB_POSITION_SYNC ||
+        crc8(frame + 1, MAUWB_POSITION_LENGTH - 2) != frame[MAUWB_POSITION_LENGTH - 1]) {
+        return false;
+    }
+
+    out.tid = frame[1];
+    out.seq = frame[2];
+    out.x = (int16_t)(frame[3] | (frame[4] << 8));
+    out.y = (int16_t)(frame[5] | (frame[6] << 8));
+    out.mask = frame[7];
+    return true;
+}
+
+inline uint8_t MaUWB_Frame::crc8(const uint8_t* data, uint8_t length) {
+    uint8_t crc = 0;
+    for (uint8_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+#endif // MAUWB_FRAME_H
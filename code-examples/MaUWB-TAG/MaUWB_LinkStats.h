@@ -0,0 +1,128 @@
+/*
+ * MaUWB_LinkStats.h - Report loss and per-anchor delivery from seq and mask
+ *
+ * Every range report carries a sequence number and the mask of anchors that
+ * answered. MaUWB_LinkStats counts the reports lost between two that
+ * arrived (gaps in seq) and, for each anchor slot, how many reports had a
+ * range from it. A recent delivery rate per anchor (moving average over
+ * about MAUWB_LINK_WINDOW reports) shows which anchors are dropping out now
+ * rather than since boot; getReliableMask() turns it into the set of anchors
+ * worth solving with.
+ *
+ * Usage:
+ *   MaUWB_LinkStats link;
+ *   link.update(report);
+ *   link.getLossRate();              // Fraction of reports lost
+ *   link.getDeliveryRate(2);         // Recent fraction with a range from anchor 2
+ *   link.getReliableMask(0.5f);      // Anchors answering at least half the time
+ *
+ * About 80 bytes. Only needs the C library, so it also builds on a desktop
+ * compiler.
+ */
+
+#ifndef MAUWB_LINK_STATS_H
+#define MAUWB_LINK_STATS_H
+
+#include <stdint.h>
+#include "MaUWB_RangeParser.h"
+
+// Reports the recent delivery rate averages over
+#ifndef MAUWB_LINK_WINDOW
+#define MAUWB_LINK_WINDOW 32
+#endif
+
+class MaUWB_LinkStats {
+public:
+    MaUWB_LinkStats() { reset(); }
+
+    void reset();
+
+    // Count one report. Returns the number of reports lost just before it.
+    uint16_t update(const MaUWB_RangeReport& report);
+
+    uint32_t getReports() const { return reports; }
+    uint32_t getLost() const { return lost; }
+    uint32_t getRestarts() const { return restarts; }   // seq jumped back
+    float getLossRate() const;                            // lost / (received + lost)
+
+    // Reports with a range from the anchor slot, since reset()
+    uint32_t getDelivered(uint8_t slot) const { return slot < MAUWB_RANGE_SLOTS ? delivered[slot] : 0; }
+
+    // Recent fraction of reports with a range from the anchor slot (0..1)
+    float getDeliveryRate(uint8_t slot) const { return slot < MAUWB_RANGE_SLOTS ? rate[slot] : 0; }
+
+    // Anchor slots whose recent delivery rate is at least minRate, bit per slot
+    uint8_t getReliableMask(float minRate) const;
+
+    // Mask of the last report
+    uint8_t getLastMask() const { return lastMask; }
+
+private:
+    uint32_t reports;
+    uint32_t lost;
+    uint32_t restarts;
+    uint32_t delivered[MAUWB_RANGE_SLOTS];
+    float rate[MAUWB_RANGE_SLOTS];
+    uint16_t lastSeq;
+    uint8_t lastMask;
+};
+
+// Implementation
+
+inline void MaUWB_LinkStats::reset() {
+    reports = 0;
+    lost = 0;
+    restarts = 0;
+    for (uint8_t i = 0; i < MAUWB_RANGE_SLOTS; i++) {
+        delivered[i] = 0;
+        rate[i] = 0;
+    }
+    lastSeq = 0;
+    lastMask = 0;
+}
+
+inline uint16_t MaUWB_LinkStats::update(const MaUWB_RangeReport& report) {
+    uint16_t gap = 0;
+    if (reports > 0) {
+        // As in MaUWB_TagTracker: seq is one byte on some firmware, so only a
+        // small forward step is loss and a step back is a module restart
+        uint8_t step = (uint8_t)(report.seq - lastSeq);
+        if (step > 1 && step < 128) {
+            gap = step - 1;
+            lost += gap;
+        } else if (step >= 128) {
+            restarts++;
+        }
+    }
+    lastSeq = report.seq;
+    lastMask = report.mask;
+    reports++;
+
+    // Cumulative mean until the window is full, then a moving average
+    uint32_t window = reports < MAUWB_LINK_WINDOW ? reports : MAUWB_LINK_WINDOW;
+    for (uint8_t i = 0; i < MAUWB_RANGE_SLOTS; i++) {
+        float answered = report.answered(i) ? 1.0f : 0.0f;
+        if (answered > 0) {
+            delivered[i]++;
+        }
+        rate[i] += (answered - rate[i]) / window;
+    }
+    return gap;
+}
+
+inline float MaUWB_LinkStats::getLossRate() const {
+    uint32_t sent = reports + lost;
+    return sent ? (float)lost / sent : 0;
+}
+
+inline uint8_t MaUWB_LinkStats::getReliableMask(float minRate) const {
+    uint8_t mask = 0;
+    for (uint8_t i = 0; i < MAUWB_RANGE_SLOTS; i++) {
+        if (rate[i] >= minRate && rate[i] > 0) {
+            mask |= 1 << i;
+        }
+    }
+    return mask;
+}
+
+#endif // MAUWB_LINK_STATS_H
@@ -0,0 +1,179 @@
+/*
+ * MaUWB_Motion.h - Motion-adaptive ranging interval for MaUWB tags
+ *
+ * A tag lying on a table does not need 20 fixes a second. The motion rate
+ * watches two things of every fix:
+ *
+ *   - speed: the filter's velocity estimate (cm/s)
+ *   - innovation: how far the raw fix is from where the filter predicted
+ *     it (cm), taken before the filter update; the part of the movement
+ *     the filter has not followed yet
+ *
+ * Either one over its threshold drops the interval to the fast one at once.
+ * The next fix has to confirm it before the tag counts as moving; a single
+ * noisy fix only costs one fast poll before the tag goes back to its rest
+ * interval. Once the running averages of both have stayed below half their
+ * thresholds for MAUWB_MOTION_REST_MS the tag is at rest, and the interval
+ * doubles every further MAUWB_MOTION_REST_MS up to the slow one. The tag
+ * uses it as its poll and display interval, and sleeps in between.
+ *
+ * A tag at rest notices that it was picked up on its next fix, so the slow
+ * interval plus one fast one is the worst-case delay before it counts as
+ * moving.
+ *
+ * Usage:
+ *   MaUWB_MotionRate motion;
+ *   motion.configure(50, 1000);       // Fast and slow interval (ms)
+ *   motion.begin(millis());
+ *   // For every fix:
+ *   if (motion.update(millis(), speed, innovation)) {
+ *       scheduler.setMinPollInterval(motion.getInterval());
+ *   }
+ *
+ * Only needs the C library, so it also builds on a desktop compiler.
+ */
+
+#ifndef MAUWB_MOTION_H
+#define MAUWB_MOTION_H
+
+#include <stdint.h>
+
+// Speed above which the tag counts as moving (cm/s)
+#ifndef MAUWB_MOTION_SPEED
+#define MAUWB_MOTION_SPEED 15.0f
+#endif
+
+// Innovation above which the tag counts as moving (cm). At rest it is the
+// noise of the raw fix plus that of the prediction, so this is a few times
+// the range noise and one noisy fix does not wake the tag.
+#ifndef MAUWB_MOTION_INNOVATION
+#define MAUWB_MOTION_INNOVATION 35.0f
+#endif
+
+// Quiet time before the tag is at rest, and before each further doubling
+// of the interval (ms)
+#ifndef MAUWB_MOTION_REST_MS
+#define MAUWB_MOTION_REST_MS 2000
+#endif
+
+// Default slow interval (ms)
+#ifndef MAUWB_MOTION_SLOW_MS
+#define MAUWB_MOTION_SLOW_MS 1000
+#endif
+
+class MaUWB_MotionRate {
+public:
+    MaUWB_MotionRate();
+
+    // Interval while moving and the longest one at rest (ms)
+    void configure(unsigned long fastMs, unsigned long slowMs = MAUWB_MOTION_SLOW_MS);
+    void setThresholds(float speed, float innovation);
+
+    // Start out moving, at the fast interval
+    void begin(unsigned long now);
+
+    // Feed one fix. Returns true when the interval changed.
+    bool update(unsigned long now, float speed, float innovation);
+
+    bool isMoving() const { return moving; }
+    unsigned long getInterval() const { return interval; }
+    unsigned long getFastInterval() const { return fastInterval; }
+    unsigned long getSlowInterval() const { return slowInterval; }
+    uint32_t getWakeups() const { return wakeups; }   // Rest -> moving transitions
+
+private:
+    unsigned long fastInterval;
+    unsigned long slowInterval;
+    float speedThreshold;
+    float innovationThreshold;
+
+    bool moving;
+    bool probing;              // At rest, last fix over a threshold: checking at the fast interval
+    float averageSpeed;
+    float averageInnovation;
+    unsigned long lastActive;  // Last fix with an average above the lower (rest) thresholds
+    unsigned long lastStep;    // Last time the interval was doubled
+    unsigned long interval;
+    unsigned long restInterval;  // Interval to go back to after a probe
+    uint32_t wakeups;
+};
+
+// Implementation
+
+inline MaUWB_MotionRate::MaUWB_MotionRate()
+    : fastInterval(50), slowInterval(MAUWB_MOTION_SLOW_MS), speedThreshold(MAUWB_MOTION_SPEED),
+      innovationThreshold(MAUWB_MOTION_INNOVATION), moving(true), probing(false), averageSpeed(0),
+      averageInnovation(0), lastActive(0), lastStep(0), interval(50), restInterval(50), wakeups(0) {
+}
+
+inline void MaUWB_MotionRate::configure(unsigned long fastMs, unsigned long slowMs) {
+    if (fastMs < 1) fastMs = 1;
+    if (slowMs < fastMs) slowMs = fastMs;
+    fastInterval = fastMs;
+    slowInterval = slowMs;
+    if (interval < fastInterval || moving) interval = fastInterval;
+    if (interval > slowInterval) interval = slowInterval;
+}
+
+inline void MaUWB_MotionRate::setThresholds(float speed, float innovation) {
+    speedThreshold = speed;
+    innovationThreshold = innovation;
+}
+
+inline void MaUWB_MotionRate::begin(unsigned long now) {
+    moving = true;
+    probing = false;
+    averageSpeed = 0;
+    averageInnovation = 0;
+    lastActive = now;
+    lastStep = now;
+    interval = fastInterval;
+}
+
+inline bool MaUWB_MotionRate::update(unsigned long now, float speed, float innovation) {
+    unsigned long old = interval;
+
+    bool over = speed > speedThreshold || innovation > innovationThreshold;
+    if (!moving) {
+        if (over && probing) {
+            wakeups++;
+            moving = true;
+            probing = false;
+            // Start from the new motion, not the rest averages
+            averageSpeed = speed;
+            averageInnovation = innovation;
+            lastActive = now;
+        } else if (over) {
+            probing = true;
+            restInterval = interval;
+            interval = fastInterval;
+            return interval != old;
+        } else if (probing) {
+            probing = false;
+            interval = restInterval;
+            return interval != old;
+        }
+    }
+
+    // Hysteresis: the rest decision looks at averages under half the
+    // thresholds, so single noisy fixes neither keep the tag awake nor wake it
+    averageSpeed += (speed - averageSpeed) / 4;
+    averageInnovation += (innovation - averageInnovation) / 4;
+    if (averageSpeed > speedThreshold / 2 || averageInnovation > innovationThreshold / 2) {
+        lastActive = now;
+        lastStep = now;
+    } else if (moving) {
+        if (now - lastActive >= MAUWB_MOTION_REST_MS) {
+            moving = false;
+            lastStep = now;
+            interval = fastInterval * 2 < slowInterval ? fastInterval * 2 : slowInterval;
+        }
+    } else if (now - lastStep >= MAUWB_MOTION_REST_MS && interval < slowInterval) {
+        lastStep = now;
+        interval = interval * 2 < slowInterval ? interval * 2 : slowInterval;
+    }
+
+    return interval != old;
+}
+
+#endif // MAUWB_MOTION_H
@@ -0,0 +1,204 @@
+/*
+ * MaUWB_Scheduler.h - Range request scheduling for MaUWB tags
+ *
+ * With AT+SETRPT=1 the module pushes a range report every TDMA cycle on its
+ * own, so sending AT+RANGE on a timer as well only doubles the UART traffic
+ * and lands in the middle of the tag's slot. The scheduler decides when an
+ * explicit poll is actually needed:
+ *
+ *   - auto-report on: stay passive while reports keep arriving, and only
+ *     poll when none has been seen for MAUWB_SCHED_STALL_CYCLES cycles
+ *   - auto-report off: poll once per cycle (or per minimum interval)
+ *
+ * The cycle is the tag count times the slot time from AT+SETCAP. Polls are
+ * kept on a grid of whole cycles anchored at the arrival of the last report,
+ * which marks where this tag's slot falls.
+ *
+ * Usage:
+ *   MaUWB_RangeScheduler scheduler;
+ *   scheduler.configure(UWB_TAG_COUNT, MAUWB_SLOT_MS);
+ *   scheduler.setAutoReport(true);
+ *   scheduler.begin(millis());
+ *
+ *   // For every range report:      scheduler.reportReceived(millis());
+ *   // In loop():
+ *   if (scheduler.pollDue(millis()) && !uwbAt.isBusy()) {
+ *       uwbAt.send("AT+RANGE", ...);
+ *       scheduler.pollSent(millis());
+ *   }
+ *
+ * Only needs the C library, so it also builds on a desktop compiler.
+ */
+
+#ifndef MAUWB_SCHEDULER_H
+#define MAUWB_SCHEDULER_H
+
+#include <stdint.h>
+
+// Time of one TDMA slot passed to AT+SETCAP (ms). 6.8M: 10 ms, 850K: 15 ms.
+#ifndef MAUWB_SLOT_MS
+#define MAUWB_SLOT_MS 10
+#endif
+
+// Missed cycles after which auto-reporting is considered stalled and
+// explicit polls resume
+#ifndef MAUWB_SCHED_STALL_CYCLES
+#define MAUWB_SCHED_STALL_CYCLES 4
+#endif
+
+class MaUWB_RangeScheduler {
+public:
+    MaUWB_RangeScheduler();
+
+    // Cycle period = tagCount * slotMs, as configured with AT+SETCAP
+    void configure(uint8_t tagCount, uint16_t slotMs);
+
+    // Whether the module was set up with AT+SETRPT=1
+    void setAutoReport(bool enabled) { autoReport = enabled; }
+    bool isAutoReport() const { return autoReport; }
+
+    // Shortest gap between explicit polls (ms); rounded up to whole cycles.
+    // May change while running: a shorter gap pulls the next poll in.
+    void setMinPollInterval(unsigned long intervalMs);
+
+    // Start timing; the module gets one stall window to start reporting
+    void begin(unsigned long now);
+
+    // A range report arrived (pushed or in reply to a poll)
+    void reportReceived(unsigned long now);
+
+    // True when an explicit AT+RANGE should be sent now
+    bool pollDue(unsigned long now);
+    void pollSent(unsigned long now);
+
+    // Time left until pollDue() (ms), 0 if it already is
+    unsigned long timeToPoll(unsigned long now) const;
+
+    // Auto-reports are arriving and no polls are being sent
+    bool isPassive(unsigned long now) const;
+
+    unsigned long getCyclePeriod() const { return cyclePeriod; }
+    float getUpdateRate(unsigned long now) const;  // Achieved report rate (Hz), 0 if stalled
+    float getExpectedRate() const;                 // One report per cycle (Hz)
+    uint32_t getPollCount() const { return pollCount; }
+
+private:
+    unsigned long cyclePeriod;
+    unsigned long minPollInterval;
+    bool autoReport;
+
+    bool haveReport;
+    bool awaitingReply;
+    bool lastPushed;       // Last report came without a poll
+    unsigned long lastReport;
+    unsigned long lastPoll;
+    unsigned long nextPoll;
+    float averageInterval;   // Smoothed gap between reports (ms)
+    uint32_t pollCount;
+
+    unsigned long pollStep() const;
+    unsigned long stallWindow() const { return cyclePeriod * MAUWB_SCHED_STALL_CYCLES; }
+    static bool reached(unsigned long now, unsigned long deadline) {
+        return (long)(now - deadline) >= 0;
+    }
+};
+
+// Implementation
+
+inline MaUWB_RangeScheduler::MaUWB_RangeScheduler()
+    : cyclePeriod(100), minPollInterval(0), autoReport(false), haveReport(false),
+      awaitingReply(false), lastPushed(false), lastReport(0), lastPoll(0), nextPoll(0), averageInterval(0),
+      pollCount(0) {
+}
+
+inline void MaUWB_RangeScheduler::configure(uint8_t tagCount, uint16_t slotMs) {
+    if (tagCount < 1) tagCount = 1;
+    if (slotMs < 1) slotMs = 1;
+    cyclePeriod = (unsigned long)tagCount * slotMs;
+}
+
+inline void MaUWB_RangeScheduler::setMinPollInterval(unsigned long intervalMs) {
+    minPollInterval = intervalMs;
+
+    // Without auto-reports the next poll was a whole old step ahead
+    if (!autoReport && haveReport) {
+        unsigned long latest = (awaitingReply || !lastPushed ? lastPoll : lastReport) + pollStep();
+        if ((long)(nextPoll - latest) > 0) {
+            nextPoll = latest;
+        }
+    }
+}
+
+inline void MaUWB_RangeScheduler::begin(unsigned long now) {
+    haveReport = false;
+    awaitingReply = false;
+    lastPushed = false;
+    averageInterval = 0;
+    lastReport = now;
+    nextPoll = autoReport ? now + stallWindow() : now;
+}
+
+inline void MaUWB_RangeScheduler::reportReceived(unsigned long now) {
+    if (haveReport) {
+        unsigned long gap = now - lastReport;
+        // Gaps from a stall would swamp the average; restart it instead
+        if (averageInterval <= 0 || gap > stallWindow()) {
+            averageInterval = (float)gap;
+        } else {
+            averageInterval += ((float)gap - averageInterval) / 8;
+        }
+    }
+    haveReport = true;
+    lastReport = now;
+
+    // A report shortly after a poll is its reply and leaves the poll grid
+    // alone; anything else was pushed and marks where this tag's slot falls
+    bool reply = awaitingReply && (now - lastPoll) < cyclePeriod / 2;
+    awaitingReply = false;
+    lastPushed = !reply;
+
+    if (!reply) {
+        nextPoll = now + (autoReport ? stallWindow() : pollStep());
+    }
+}
+
+inline bool MaUWB_RangeScheduler::pollDue(unsigned long now) {
+    return reached(now, nextPoll);
+}
+
+inline void MaUWB_RangeScheduler::pollSent(unsigned long now) {
+    pollCount++;
+    awaitingReply = true;
+    lastPoll = now;
+
+    // Stay on the cycle grid; skip the slots we were too late for
+    unsigned long step = pollStep();
+    do {
+        nextPoll += step;
+    } while (reached(now, nextPoll));
+}
+
+inline unsigned long MaUWB_RangeScheduler::timeToPoll(unsigned long now) const {
+    return reached(now, nextPoll) ? 0 : nextPoll - now;
+}
+
+inline bool MaUWB_RangeScheduler::isPassive(unsigned long now) const {
+    return autoReport && lastPushed && (now - lastReport) <= stallWindow();
+}
+
+inline float MaUWB_RangeScheduler::getUpdateRate(unsigned long now) const {
+    if (!haveReport || averageInterval <= 0 || (now - lastReport) > stallWindow()) return 0;
+    return 1000.0f / averageInterval;
+}
+
+inline float MaUWB_RangeScheduler::getExpectedRate() const {
+    return 1000.0f / cyclePeriod;
+}
+
+inline unsigned long MaUWB_RangeScheduler::pollStep() const {
+    unsigned long cycles = (minPollInterval + cyclePeriod - 1) / cyclePeriod;
+    if (cycles < 1) cycles = 1;
+    return cycles * cyclePeriod;
+}
+
+#endif // MAUWB_SCHEDULER_H
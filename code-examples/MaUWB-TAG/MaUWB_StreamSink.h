@@ -0,0 +1,101 @@
+/*
+ * MaUWB_StreamSink.h - ESP-NOW and UDP transports for MaUWB_Stream packets
+ *
+ * MaUWB_EspNowSink sends each packet as one ESP-NOW frame, by default to
+ * the broadcast address so any bridge on the same channel hears every tag
+ * without pairing. No access point is needed; the bridge (STREAM_BRIDGE)
+ * writes the positions to its USB port for the p5 sketches. esp_now_send()
+ * only queues the frame, so a send costs tens of microseconds.
+ *
+ * MaUWB_UdpSink sends each packet as one datagram to a host on the WiFi
+ * network. Connecting to the network is left to the sketch.
+ *
+ * Usage:
+ *   MaUWB_EspNowSink radio;
+ *   radio.begin(1);                          // WiFi channel of the bridge
+ *   uwbTag.setStreamSink(&radio);
+ *
+ *   MaUWB_UdpSink udp;                       // After WiFi.begin() has connected
+ *   udp.begin(IPAddress(192, 168, 1, 20), MAUWB_STREAM_UDP_PORT);
+ *
+ * ESP32 only.
+ */
+
+#ifndef MAUWB_STREAM_SINK_H
+#define MAUWB_STREAM_SINK_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <esp_now.h>
+#include <esp_wifi.h>
+#include "MaUWB_Stream.h"
+
+// Port the UDP sink sends to by default and stream_listener listens on
+#ifndef MAUWB_STREAM_UDP_PORT
+#define MAUWB_STREAM_UDP_PORT 47800
+#endif
+
+class MaUWB_EspNowSink : public MaUWB_StreamSink {
+public:
+    MaUWB_EspNowSink() : started(false) {
+        memset(peer, 0xFF, sizeof(peer));
+    }
+
+    // Start ESP-NOW on the given WiFi channel. peer is the bridge's MAC
+    // address; nullptr broadcasts. Returns false if ESP-NOW did not start.
+    bool begin(uint8_t channel = 1, const uint8_t* peerAddress = nullptr) {
+        if (peerAddress) {
+            memcpy(peer, peerAddress, sizeof(peer));
+        }
+        WiFi.mode(WIFI_STA);
+        esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
+        if (esp_now_init() != ESP_OK) {
+            return false;
+        }
+
+        esp_now_peer_info_t info;
+        memset(&info, 0, sizeof(info));
+        memcpy(info.peer_addr, peer, sizeof(peer));
+        info.channel = channel;
+        info.encrypt = false;
+        started = esp_now_add_peer(&info) == ESP_OK;
+        return started;
+    }
+
+    bool send(const uint8_t* data, uint16_t length) override {
+        return started && esp_now_send(peer, data, length) == ESP_OK;
+    }
+
+private:
+    uint8_t peer[6];
+    bool started;
+};
+
+class MaUWB_UdpSink : public MaUWB_StreamSink {
+public:
+    MaUWB_UdpSink() : port(0) {}
+
+    void begin(IPAddress host, uint16_t port = MAUWB_STREAM_UDP_PORT) {
+        this->host = host;
+        this->port = port;
+    }
+
+    bool send(const uint8_t* data, uint16_t length) override {
+        if (port == 0 || WiFi.status() != WL_CONNECTED) {
+            return false;
+        }
+        if (!udp.beginPacket(host, port)) {
+            return false;
+        }
+        udp.write(data, length);
+        return udp.endPacket() == 1;
+    }
+
+private:
+    WiFiUDP udp;
+    IPAddress host;
+    uint16_t port;
+};
+
+#endif // MAUWB_STREAM_SINK_H
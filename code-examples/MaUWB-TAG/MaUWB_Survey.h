@@ -0,0 +1,549 @@
+/*
+ * MaUWB_Survey.h - Anchor layout from anchor-to-anchor ranges
+ *
+ * During a survey each anchor in turn runs as a tag for a few seconds
+ * (ANCHOR_default, SURVEY_ON_BOOT), so the others range to it. The host
+ * anchor feeds those reports in with addReport(), and solve() turns the
+ * distances into anchor coordinates:
+ *
+ *   1. Median of the samples per pair, projected onto the floor plane if
+ *      the mounting heights are known (setHeight())
+ *   2. Pairs without a range get the shortest path through the others
+ *   3. Classical MDS: double-centred squared distances, the two largest
+ *      eigenvectors (Jacobi) give a first layout
+ *   4. Levenberg-Marquardt on the measured pairs only
+ *   5. Anchor 0 moved to the origin, anchor 1 onto the +y axis and
+ *      anchor 2 to x > 0, as in the default layout (0,0) (0,600) (380,600)
+ *
+ * Every anchor needs ranges to at least two others. getRms() is the fit
+ * residual over the measured pairs; a few cm is normal, tens of cm mean a
+ * blocked pair (getWorstPair()).
+ *
+ * Usage:
+ *   MaUWB_Survey survey;
+ *   survey.begin(4);
+ *   // For each report of anchor i running as a tag:
+ *   survey.addReport(i, report);
+ *   if (survey.solve() == MAUWB_SURVEY_OK) {
+ *       uwbTag.applySurvey(survey);    // or setAnchorPosition() per anchor
+ *   }
+ *
+ * Only needs the C math library, so it also builds on a desktop compiler.
+ */
+
+#ifndef MAUWB_SURVEY_H
+#define MAUWB_SURVEY_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "MaUWB_RangeParser.h"
+
+// Anchors in a survey; a report carries MAUWB_RANGE_SLOTS ranges
+#ifndef MAUWB_SURVEY_MAX_ANCHORS
+#define MAUWB_SURVEY_MAX_ANCHORS MAUWB_RANGE_SLOTS
+#endif
+
+// Samples kept per pair for the median
+#ifndef MAUWB_SURVEY_SAMPLES
+#define MAUWB_SURVEY_SAMPLES 16
+#endif
+
+// Levenberg-Marquardt steps after MDS
+#ifndef MAUWB_SURVEY_ITERATIONS
+#define MAUWB_SURVEY_ITERATIONS 30
+#endif
+
+#define MAUWB_SURVEY_PAIRS (MAUWB_SURVEY_MAX_ANCHORS * (MAUWB_SURVEY_MAX_ANCHORS - 1) / 2)
+
+enum MaUWB_SurveyResult {
+    MAUWB_SURVEY_OK,
+    MAUWB_SURVEY_TOO_FEW_RANGES,   // An anchor has ranges to fewer than two others
+    MAUWB_SURVEY_DEGENERATE        // The anchors are (nearly) on one line
+};
+
+class MaUWB_Survey {
+public:
+    MaUWB_Survey() : count(0), rms(0) { begin(0); }
+
+    // Start over with this many anchors
+    void begin(uint8_t anchorCount);
+
+    // Known mounting height of an anchor (cm, default 0)
+    void setHeight(uint8_t anchor, float z) {
+        if (anchor < MAUWB_SURVEY_MAX_ANCHORS) height[anchor] = z;
+    }
+
+    // One range between anchors a and b (cm); the order does not matter
+    void addRange(uint8_t a, uint8_t b, float cm);
+
+    // Every range of a report, with anchor from running as the tag.
+    // Returns the number of ranges taken.
+    uint8_t addReport(uint8_t from, const MaUWB_RangeReport& report);
+
+    uint8_t getAnchorCount() const { return count; }
+    uint8_t getSamples(uint8_t a, uint8_t b) const;
+    uint8_t getMeasuredPairs() const;
+
+    // Median of the samples (cm, 3D distance), 0 if there are none
+    float getRange(uint8_t a, uint8_t b) const;
+
+    MaUWB_SurveyResult solve();
+
+    // Layout from the last successful solve() (cm)
+    float getX(uint8_t anchor) const { return x[anchor]; }
+    float getY(uint8_t anchor) const { return y[anchor]; }
+    float getZ(uint8_t anchor) const { return height[anchor]; }
+
+    // RMS of (layout distance - measured distance) over the measured pairs
+    float getRms() const { return rms; }
+
+    // Fitted minus measured floor distance of a pair, 0 if not measured
+    float getResidual(uint8_t a, uint8_t b) const;
+
+    // The measured pair with the largest residual; returns its magnitude
+    float getWorstPair(uint8_t& a, uint8_t& b) const;
+
+private:
+    uint8_t count;
+    float height[MAUWB_SURVEY_MAX_ANCHORS];
+    uint16_t samples[MAUWB_SURVEY_PAIRS][MAUWB_SURVEY_SAMPLES];   // cm
+    uint8_t sampleCount[MAUWB_SURVEY_PAIRS];
+    uint8_t sampleNext[MAUWB_SURVEY_PAIRS];
+
+    float x[MAUWB_SURVEY_MAX_ANCHORS];
+    float y[MAUWB_SURVEY_MAX_ANCHORS];
+    float rms;
+
+    static uint8_t pairIndex(uint8_t a, uint8_t b) {
+        if (a > b) { uint8_t t = a; a = b; b = t; }
+        return b * (b - 1) / 2 + a;
+    }
+
+    // Measured distance projected onto the floor, 0 if not measured
+    float floorRange(uint8_t a, uint8_t b) const;
+
+    void initialLayout(const float* target, float* outX, float* outY, bool& degenerate) const;
+    float cost(const float* px, const float* py, const float* ranges) const;
+    void refine();
+    void align();
+    static bool solveLinear(float* a, float* b, uint8_t n);
+};
+
+// Implementation
+
+inline void MaUWB_Survey::begin(uint8_t anchorCount) {
+    count = anchorCount <= MAUWB_SURVEY_MAX_ANCHORS ? anchorCount : MAUWB_SURVEY_MAX_ANCHORS;
+    memset(sampleCount, 0, sizeof(sampleCount));
+    memset(sampleNext, 0, sizeof(sampleNext));
+    for (uint8_t i = 0; i < MAUWB_SURVEY_MAX_ANCHORS; i++) {
+        height[i] = 0;
+        x[i] = 0;
+        y[i] = 0;
+    }
+    rms = 0;
+}
+
+inline void MaUWB_Survey::addRange(uint8_t a, uint8_t b, float cm) {
+    if (a >= count || b >= count || a == b || !(cm > 0) || cm > 65535.0f) {
+        return;
+    }
+    uint8_t pair = pairIndex(a, b);
+    samples[pair][sampleNext[pair]] = (uint16_t)(cm + 0.5f);
+    sampleNext[pair] = (sampleNext[pair] + 1) % MAUWB_SURVEY_SAMPLES;
+    if (sampleCount[pair] < MAUWB_SURVEY_SAMPLES) {
+        sampleCount[pair]++;
+    }
+}
+
+inline uint8_t MaUWB_Survey::addReport(uint8_t from, const MaUWB_RangeReport& report) {
+    uint8_t taken = 0;
+    for (uint8_t i = 0; i < count && i < report.rangeCount; i++) {
+        if (i != from && report.answered(i) && report.range[i] > 0) {
+            addRange(from, i, report.range[i]);
+            taken++;
+        }
+    }
+    return taken;
+}
+
+inline uint8_t MaUWB_Survey::getSamples(uint8_t a, uint8_t b) const {
+    return a < count && b < count && a != b ? sampleCount[pairIndex(a, b)] : 0;
+}
+
+inline uint8_t MaUWB_Survey::getMeasuredPairs() const {
+    uint8_t measured = 0;
+    for (uint8_t i = 0; i < count * (count - 1) / 2; i++) {
+        if (sampleCount[i] > 0) measured++;
+    }
+    return measured;
+}
+
+inline float MaUWB_Survey::getRange(uint8_t a, uint8_t b) const {
+    uint8_t n = getSamples(a, b);
+    if (n == 0) {
+        return 0;
+    }
+    // Insertion sort of a copy; at most MAUWB_SURVEY_SAMPLES values
+    uint16_t sorted[MAUWB_SURVEY_SAMPLES];
+    const uint16_t* values = samples[pairIndex(a, b)];
+    for (uint8_t i = 0; i < n; i++) {
+        uint16_t v = values[i];
+        uint8_t j = i;
+        while (j > 0 && sorted[j - 1] > v) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+    }
+    return n % 2 ? sorted[n / 2] : 0.5f * (sorted[n / 2 - 1] + sorted[n / 2]);
+}
+
+inline float MaUWB_Survey::floorRange(uint8_t a, uint8_t b) const {
+    float d = getRange(a, b);
+    if (d <= 0) {
+        return 0;
+    }
+    float dz = height[a] - height[b];
+    float squared = d * d - dz * dz;
+    // A range shorter than the height difference is noise; keep it usable
+    return squared > 1.0f ? sqrtf(squared) : 1.0f;
+}
+
+inline float MaUWB_Survey::getResidual(uint8_t a, uint8_t b) const {
+    float d = floorRange(a, b);
+    if (d <= 0) {
+        return 0;
+    }
+    float dx = x[a] - x[b];
+    float dy = y[a] - y[b];
+    return sqrtf(dx * dx + dy * dy) - d;
+}
+
+inline float MaUWB_Survey::getWorstPair(uint8_t& a, uint8_t& b) const {
+    float worst = 0;
+    a = b = 0;
+    for (uint8_t j = 1; j < count; j++) {
+        for (uint8_t i = 0; i < j; i++) {
+            float r = fabsf(getResidual(i, j));
+            if (r > worst) {
+                worst = r;
+                a = i;
+                b = j;
+            }
+        }
+    }
+    return worst;
+}
+
+inline MaUWB_SurveyResult MaUWB_Survey::solve() {
+    const uint8_t n = count;
+    if (n < 3) {
+        return MAUWB_SURVEY_TOO_FEW_RANGES;
+    }
+
+    // Floor distances; every anchor needs two to be pinned down in the plane
+    float target[MAUWB_SURVEY_MAX_ANCHORS * MAUWB_SURVEY_MAX_ANCHORS];
+    for (uint8_t i = 0; i < n; i++) {
+        uint8_t ranged = 0;
+        for (uint8_t j = 0; j < n; j++) {
+            float d = i == j ? 0 : floorRange(i, j);
+            if (i != j && d > 0) ranged++;
+            target[i * n + j] = i == j || d > 0 ? d : INFINITY;
+        }
+        if (ranged < 2) {
+            return MAUWB_SURVEY_TOO_FEW_RANGES;
+        }
+    }
+
+    // Missing pairs: shortest path through the others (Floyd-Warshall)
+    for (uint8_t k = 0; k < n; k++) {
+        for (uint8_t i = 0; i < n; i++) {
+            for (uint8_t j = 0; j < n; j++) {
+                float through = target[i * n + k] + target[k * n + j];
+                if (through < target[i * n + j]) {
+                    target[i * n + j] = through;
+                }
+            }
+        }
+    }
+
+    bool degenerate;
+    float px[MAUWB_SURVEY_MAX_ANCHORS];
+    float py[MAUWB_SURVEY_MAX_ANCHORS];
+    initialLayout(target, px, py, degenerate);
+    if (degenerate) {
+        return MAUWB_SURVEY_DEGENERATE;
+    }
+    memcpy(x, px, sizeof(px));
+    memcpy(y, py, sizeof(py));
+
+    refine();
+    align();
+
+    uint8_t measured = 0;
+    float sum = 0;
+    for (uint8_t j = 1; j < n; j++) {
+        for (uint8_t i = 0; i < j; i++) {
+            if (sampleCount[pairIndex(i, j)] > 0) {
+                float r = getResidual(i, j);
+                sum += r * r;
+                measured++;
+            }
+        }
+    }
+    rms = measured ? sqrtf(sum / measured) : 0;
+    return MAUWB_SURVEY_OK;
+}
+
+// Classical MDS: B = -1/2 J D^2 J, coordinates from its two largest
+// eigenpairs. Jacobi rotations are plenty for a handful of anchors.
+inline void MaUWB_Survey::initialLayout(const float* target, float* outX, float* outY, bool& degenerate) const {
+    const uint8_t n = count;
+    float b[MAUWB_SURVEY_MAX_ANCHORS][MAUWB_SURVEY_MAX_ANCHORS];
+    float rowMean[MAUWB_SURVEY_MAX_ANCHORS];
+    float mean = 0;
+    for (uint8_t i = 0; i < n; i++) {
+        rowMean[i] = 0;
+        for (uint8_t j = 0; j < n; j++) {
+            // Symmetrise: the two directions may have been filled in differently
+            float d = 0.5f * (target[i * n + j] + target[j * n + i]);
+            b[i][j] = d * d;
+            rowMean[i] += b[i][j];
+        }
+        rowMean[i] /= n;
+        mean += rowMean[i];
+    }
+    mean /= n;
+    for (uint8_t i = 0; i < n; i++) {
+        for (uint8_t j = 0; j < n; j++) {
+            b[i][j] = -0.5f * (b[i][j] - rowMean[i] - rowMean[j] + mean);
+        }
+    }
+
+    float v[MAUWB_SURVEY_MAX_ANCHORS][MAUWB_SURVEY_MAX_ANCHORS];
+    for (uint8_t i = 0; i < n; i++) {
+        for (uint8_t j = 0; j < n; j++) {
+            v[i][j] = i == j ? 1.0f : 0.0f;
+        }
+    }
+    float scale = 0;
+    for (uint8_t i = 0; i < n; i++) {
+        for (uint8_t j = 0; j < n; j++) {
+            scale += b[i][j] * b[i][j];
+        }
+    }
+    for (uint8_t sweep = 0; sweep < 30; sweep++) {
+        float off = 0;
+        for (uint8_t p = 0; p < n; p++) {
+            for (uint8_t q = p + 1; q < n; q++) {
+                off += b[p][q] * b[p][q];
+            }
+        }
+        if (off <= 1e-10f * scale) break;
+
+        for (uint8_t p = 0; p < n; p++) {
+            for (uint8_t q = p + 1; q < n; q++) {
+                if (b[p][q] == 0) continue;
+                float theta = 0.5f * atan2f(2 * b[p][q], b[q][q] - b[p][p]);
+                float c = cosf(theta), s = sinf(theta);
+                for (uint8_t k = 0; k < n; k++) {
+                    float bkp = b[k][p], bkq = b[k][q];
+                    b[k][p] = c * bkp - s * bkq;
+                    b[k][q] = s * bkp + c * bkq;
+                }
+                for (uint8_t k = 0; k < n; k++) {
+                    float bpk = b[p][k], bqk = b[q][k];
+                    b[p][k] = c * bpk - s * bqk;
+                    b[q][k] = s * bpk + c * bqk;
+                }
+                for (uint8_t k = 0; k < n; k++) {
+                    float vkp = v[k][p], vkq = v[k][q];
+                    v[k][p] = c * vkp - s * vkq;
+                    v[k][q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+
+    // Two largest eigenvalues
+    uint8_t first = 0, second = 1;
+    if (b[1][1] > b[0][0]) { first = 1; second = 0; }
+    for (uint8_t i = 2; i < n; i++) {
+        if (b[i][i] > b[first][first]) {
+            second = first;
+            first = i;
+        } else if (b[i][i] > b[second][second]) {
+            second = i;
+        }
+    }
+    float l1 = b[first][first], l2 = b[second][second];
+    // The second axis carries the room's width; next to nothing means a line
+    degenerate = !(l1 > 0) || l2 < 1e-3f * l1;
+    float s1 = l1 > 0 ? sqrtf(l1) : 0, s2 = l2 > 0 ? sqrtf(l2) : 0;
+    for (uint8_t i = 0; i < n; i++) {
+        outX[i] = s1 * v[i][first];
+        outY[i] = s2 * v[i][second];
+    }
+}
+
+// Sum of squared residuals over the measured pairs (ranges per pairIndex())
+inline float MaUWB_Survey::cost(const float* px, const float* py, const float* ranges) const {
+    float sum = 0;
+    for (uint8_t j = 1; j < count; j++) {
+        for (uint8_t i = 0; i < j; i++) {
+            float d = ranges[pairIndex(i, j)];
+            if (d <= 0) continue;
+            float dx = px[i] - px[j], dy = py[i] - py[j];
+            float r = sqrtf(dx * dx + dy * dy) - d;
+            sum += r * r;
+        }
+    }
+    return sum;
+}
+
+// Levenberg-Marquardt over all 2n coordinates. The layout can still move
+// and turn freely; the damping keeps the normal equations regular.
+inline void MaUWB_Survey::refine() {
+    const uint8_t n = count;
+    const uint8_t m = 2 * n;
+    float lambda = 1e-3f;
+
+    float ranges[MAUWB_SURVEY_PAIRS];
+    for (uint8_t j = 1; j < n; j++) {
+        for (uint8_t i = 0; i < j; i++) {
+            ranges[pairIndex(i, j)] = floorRange(i, j);
+        }
+    }
+    float current = cost(x, y, ranges);
+
+    for (uint8_t iteration = 0; iteration < MAUWB_SURVEY_ITERATIONS; iteration++) {
+        float jtj[2 * MAUWB_SURVEY_MAX_ANCHORS * 2 * MAUWB_SURVEY_MAX_ANCHORS];
+        float jtr[2 * MAUWB_SURVEY_MAX_ANCHORS];
+        memset(jtj, 0, sizeof(float) * m * m);
+        memset(jtr, 0, sizeof(float) * m);
+
+        for (uint8_t j = 1; j < n; j++) {
+            for (uint8_t i = 0; i < j; i++) {
+                float d = ranges[pairIndex(i, j)];
+                if (d <= 0) continue;
+                float dx = x[i] - x[j], dy = y[i] - y[j];
+                float length = sqrtf(dx * dx + dy * dy);
+                if (length < 1e-3f) continue;
+                float r = length - d;
+                // dr/dxi = ux, dr/dyi = uy, and the negatives for j
+                float ux = dx / length, uy = dy / length;
+                const uint8_t index[4] = {(uint8_t)(2 * i), (uint8_t)(2 * i + 1), (uint8_t)(2 * j), (uint8_t)(2 * j + 1)};
+                const float g[4] = {ux, uy, -ux, -uy};
+                for (uint8_t a = 0; a < 4; a++) {
+                    jtr[index[a]] += g[a] * r;
+                    for (uint8_t c = 0; c < 4; c++) {
+                        jtj[index[a] * m + index[c]] += g[a] * g[c];
+                    }
+                }
+            }
+        }
+
+        bool accepted = false;
+        for (uint8_t attempt = 0; attempt < 8 && !accepted; attempt++) {
+            float a[2 * MAUWB_SURVEY_MAX_ANCHORS * 2 * MAUWB_SURVEY_MAX_ANCHORS];
+            float step[2 * MAUWB_SURVEY_MAX_ANCHORS];
+            memcpy(a, jtj, sizeof(float) * m * m);
+            for (uint8_t k = 0; k < m; k++) {
+                a[k * m + k] += lambda * (jtj[k * m + k] + 1e-3f);
+                step[k] = -jtr[k];
+            }
+            if (!solveLinear(a, step, m)) {
+                lambda *= 10;
+                continue;
+            }
+            float nx[MAUWB_SURVEY_MAX_ANCHORS], ny[MAUWB_SURVEY_MAX_ANCHORS];
+            for (uint8_t k = 0; k < n; k++) {
+                nx[k] = x[k] + step[2 * k];
+                ny[k] = y[k] + step[2 * k + 1];
+            }
+            float next = cost(nx, ny, ranges);
+            if (!(next < current)) {
+                lambda *= 10;
+                continue;
+            }
+            memcpy(x, nx, sizeof(float) * n);
+            memcpy(y, ny, sizeof(float) * n);
+            float gain = current - next;
+            current = next;
+            lambda = lambda > 1e-6f ? lambda * 0.3f : lambda;
+            accepted = true;
+            if (gain <= 1e-6f * current) {
+                return;   // Converged
+            }
+        }
+        if (!accepted) {
+            return;
+        }
+    }
+}
+
+// Anchor 0 at the origin, anchor 1 on +y, anchor 2 at x > 0
+inline void MaUWB_Survey::align() {
+    const uint8_t n = count;
+    float ox = x[0], oy = y[0];
+    for (uint8_t i = 0; i < n; i++) {
+        x[i] -= ox;
+        y[i] -= oy;
+    }
+    float angle = atan2f(x[1], y[1]);
+    float c = cosf(angle), s = sinf(angle);
+    for (uint8_t i = 0; i < n; i++) {
+        float rx = x[i] * c - y[i] * s;
+        float ry = x[i] * s + y[i] * c;
+        x[i] = rx;
+        y[i] = ry;
+    }
+    x[1] = 0;
+    if (x[2] < 0) {
+        for (uint8_t i = 0; i < n; i++) {
+            x[i] = -x[i];
+        }
+    }
+}
+
+// Gaussian elimination with partial pivoting; a is n x n, b is replaced by the solution
+inline bool MaUWB_Survey::solveLinear(float* a, float* b, uint8_t n) {
+    for (uint8_t col = 0; col < n; col++) {
+        uint8_t pivot = col;
+        for (uint8_t row = col + 1; row < n; row++) {
+            if (fabsf(a[row * n + col]) > fabsf(a[pivot * n + col])) pivot = row;
+        }
+        if (fabsf(a[pivot * n + col]) < 1e-12f) {
+            return false;
+        }
+        if (pivot != col) {
+            for (uint8_t k = 0; k < n; k++) {
+                float t = a[col * n + k];
+                a[col * n + k] = a[pivot * n + k];
+                a[pivot * n + k] = t;
+            }
+            float t = b[col];
+            b[col] = b[pivot];
+            b[pivot] = t;
+        }
+        for (uint8_t row = col + 1; row < n; row++) {
+            float f = a[row * n + col] / a[col * n + col];
+            if (f == 0) continue;
+            for (uint8_t k = col; k < n; k++) {
+                a[row * n + k] -= f * a[col * n + k];
+            }
+            b[row] -= f * b[col];
+        }
+    }
+    for (int row = n - 1; row >= 0; row--) {
+        float sum = b[row];
+        for (uint8_t k = row + 1; k < n; k++) {
+            sum -= a[row * n + k] * b[k];
+        }
+        b[row] = sum / a[row * n + row];
+    }
+    return true;
+}
+
+#endif // MAUWB_SURVEY_H
@@ -0,0 +1,561 @@
+/*
+ * MaUWB_SynthLoad.h - Synthetic multi-tag load for anchors and visualizers
+ *
+ * The synthTests check one tag at a few points. To find out what an anchor
+ * and the host visualizers can take when a room full of tags reports, this
+ * generates the module's side of the link for a whole fleet:
+ *
+ *   MaUWB_SynthFleet    N virtual tags walking around the room, each
+ *                       writing AT+RANGE lines as the module does, at its
+ *                       own rate with jitter, interleaved in time order.
+ *                       Range noise, the noise patterns of the
+ *                       robust_multilateration_test (MaUWB_SynthNoise),
+ *                       anchors that miss a reply (mask bit cleared) and
+ *                       reports lost on the air (seq gap).
+ *   MaUWB_SynthMonitor  The receiving end: reports seen, reports missing
+ *                       (seq gaps), arrival jitter per tag and latency.
+ *   MaUWB_SynthModule   (Arduino) A Stream standing in for the module's
+ *                       UART: MaUWB_AT reads the fleet's lines from it at
+ *                       the link's baud rate and every command gets an
+ *                       "OK".
+ *
+ * Usage, host or board:
+ *   MaUWB_SynthConfig config;        // 64 tags at 1.5 Hz by default
+ *   MaUWB_SynthFleet fleet;
+ *   fleet.begin(config, anchors, 4);
+ *   char line[MAUWB_SYNTH_LINE_MAX];
+ *   uint16_t length;
+ *   while ((length = fleet.poll(micros(), line, sizeof(line))) > 0) {
+ *       // Feed the line to whatever reads the module
+ *   }
+ *
+ * Times are micros() values (they wrap after about 71 minutes; every
+ * comparison is wrap-safe, so soak runs can go on for days).
+ *
+ * The generators only need the C library, so they also build on a desktop
+ * compiler; MaUWB_SynthModule needs Arduino's Stream.
+ */
+
+#ifndef MAUWB_SYNTH_LOAD_H
+#define MAUWB_SYNTH_LOAD_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+#include "MaUWB_RangeParser.h"
+#include "MaUWB_Latency.h"
+#if defined(ARDUINO)
+#include <Arduino.h>
+#endif
+
+// Most virtual tags a fleet can hold
+#ifndef MAUWB_SYNTH_MAX_TAGS
+#define MAUWB_SYNTH_MAX_TAGS 64
+#endif
+
+// Longest generated AT+RANGE line, terminator included
+#define MAUWB_SYNTH_LINE_MAX 160
+
+// A fleet this far behind its schedule (us) starts again from now instead
+// of sending the backlog all at once
+#ifndef MAUWB_SYNTH_MAX_LAG_US
+#define MAUWB_SYNTH_MAX_LAG_US 1000000UL
+#endif
+
+// Noise patterns, numbered as in robust_multilateration_test
+enum MaUWB_NoisePattern {
+    MAUWB_NOISE_NONE = 0,
+    MAUWB_NOISE_RANDOM = 1,        // Every range off by up to +-10%
+    MAUWB_NOISE_BAD_ANCHOR = 2,    // Anchor 0 50% long (temporary obstruction)
+    MAUWB_NOISE_MULTIPATH = 3,     // All ranges 15-25% long
+    MAUWB_NOISE_PROGRESSIVE = 4,   // All ranges 2% to 20% long, growing with step
+    MAUWB_NOISE_TRIANGLE = 5,      // Anchor 0 half as long: violates the triangle inequality
+    MAUWB_NOISE_PATTERNS = 6
+};
+
+// xorshift32 with Box-Muller; a fixed seed gives the same fleet every run
+class MaUWB_SynthRandom {
+public:
+    explicit MaUWB_SynthRandom(uint32_t seed = 0x2545F491) : state(seed ? seed : 1) {}
+
+    void seed(uint32_t value) { state = value ? value : 1; }
+
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // Uniform in (0, 1)
+    float uniform() { return ((next() >> 8) + 0.5f) / 16777216.0f; }
+
+    // Integer in [low, high), like Arduino's random(low, high)
+    int32_t between(int32_t low, int32_t high) {
+        return high > low ? low + (int32_t)(next() % (uint32_t)(high - low)) : low;
+    }
+
+    float gaussian(float sigma) {
+        return sigma * sqrtf(-2.0f * logf(uniform())) * cosf(6.2831853f * uniform());
+    }
+
+private:
+    uint32_t state;
+};
+
+class MaUWB_SynthNoise {
+public:
+    // Distort count ideal ranges in place with a MaUWB_NoisePattern. step
+    // (0..9) is the iteration of MAUWB_NOISE_PROGRESSIVE. Returns a short
+    // description of what was applied.
+    static const char* apply(uint8_t pattern, float* ranges, uint8_t count, uint8_t step,
+                             MaUWB_SynthRandom& random) {
+        static const float multipath[4] = {1.2f, 1.15f, 1.25f, 1.18f};
+        switch (pattern) {
+            case MAUWB_NOISE_RANDOM:
+                for (uint8_t i = 0; i < count; i++) {
+                    ranges[i] *= 1.0f + random.between(-10, 10) / 100.0f;
+                }
+                return "random noise (+-10%)";
+            case MAUWB_NOISE_BAD_ANCHOR:
+                ranges[0] *= 1.5f;
+                return "50% error on anchor 0";
+            case MAUWB_NOISE_MULTIPATH:
+                for (uint8_t i = 0; i < count; i++) {
+                    ranges[i] *= multipath[i % 4];
+                }
+                return "multipath (all ranges too long)";
+            case MAUWB_NOISE_PROGRESSIVE:
+                for (uint8_t i = 0; i < count; i++) {
+                    ranges[i] *= 1.0f + (step % 10 + 1) * 0.02f;
+                }
+                return "progressive noise";
+            case MAUWB_NOISE_TRIANGLE:
+                ranges[0] *= 0.5f;
+                return "triangle inequality violation";
+            default:
+                return "no noise";
+        }
+    }
+};
+
+struct MaUWB_SynthConfig {
+    uint8_t tags;           // Virtual tags (1..MAUWB_SYNTH_MAX_TAGS)
+    uint16_t firstTid;      // Tag ids firstTid .. firstTid + tags - 1
+    float rateHz;           // Reports per second per tag; 64 tags in 10 ms TDMA slots get about 1.5
+    float jitter;           // Each interval varies by up to +-jitter of the period
+    float sigma;            // Gaussian range noise (cm)
+    uint8_t pattern;        // MaUWB_NoisePattern laid over some reports
+    float patternShare;     // Share of reports (0..1) that get the pattern
+    float dropout;          // Chance (0..1) that an anchor does not answer
+    float loss;             // Chance (0..1) that a whole report is lost
+    float speed;            // Walking speed of the tags (cm/s)
+    float width, height;    // Room the tags walk in (cm)
+    float tagHeight;        // z of the tags (cm)
+
+    MaUWB_SynthConfig()
+        : tags(MAUWB_SYNTH_MAX_TAGS), firstTid(0), rateHz(1.5f), jitter(0.1f), sigma(5), pattern(MAUWB_NOISE_NONE),
+          patternShare(0.05f), dropout(0.02f), loss(0.01f), speed(60), width(540), height(1270), tagHeight(0) {}
+};
+
+class MaUWB_SynthFleet {
+public:
+    MaUWB_SynthFleet() : tagCount(0), anchorCount(0), generated(0), lost(0), bytes(0), resyncs(0), lastTid(0),
+                         lastDue(0), started(false) {}
+
+    // anchors: count rows of x, y, z (cm), count up to MAUWB_RANGE_SLOTS
+    void begin(const MaUWB_SynthConfig& config, const float (*anchors)[3], uint8_t count, uint32_t seed = 0x2545F491);
+
+    // Next line that is due at now: writes it to line and returns its
+    // length, or 0 when no tag is due yet. Lost reports are counted but
+    // not written, so the receiver sees a seq gap.
+    uint16_t poll(uint32_t now, char* line, uint16_t size);
+
+    // Time until the next report is due (us, 0 when one is due)
+    uint32_t timeToNext(uint32_t now) const;
+
+    const MaUWB_SynthConfig& getConfig() const { return config; }
+    uint32_t getPeriod() const { return period; }
+    uint32_t getGenerated() const { return generated; }   // Including lost ones
+    uint32_t getLost() const { return lost; }
+    uint32_t getBytes() const { return bytes; }
+    uint32_t getResyncs() const { return resyncs; }      // Times it fell MAUWB_SYNTH_MAX_LAG_US behind
+    uint16_t getLastTid() const { return lastTid; }
+    uint32_t getLastDue() const { return lastDue; }      // When the last line was due (us)
+    MaUWB_LatencyHistogram& getLag() { return lag; }     // How late lines were taken (us)
+
+    // Where virtual tag tid is at the moment (cm)
+    bool getTruth(uint16_t tid, float& x, float& y) const;
+
+private:
+    struct Tag {
+        float x, y;
+        float targetX, targetY;   // Waypoint it walks to
+        uint32_t due;             // Next report (us)
+        uint32_t moved;           // Time x, y are for
+        uint8_t seq;
+    };
+
+    MaUWB_SynthConfig config;
+    Tag tags[MAUWB_SYNTH_MAX_TAGS];
+    uint8_t tagCount;
+    float anchors[MAUWB_RANGE_SLOTS][3];
+    uint8_t anchorCount;
+    uint32_t period;
+    MaUWB_SynthRandom random;
+    MaUWB_LatencyHistogram lag;
+
+    uint32_t generated;
+    uint32_t lost;
+    uint32_t bytes;
+    uint32_t resyncs;
+    uint16_t lastTid;
+    uint32_t lastDue;
+    bool started;
+
+    void pickWaypoint(Tag& tag);
+    void walk(Tag& tag, uint32_t now);
+    uint32_t nextInterval();
+    uint16_t writeReport(Tag& tag, uint16_t tid, char* line, uint16_t size);
+};
+
+// Receiving end: reports seen per tag, seq gaps and arrival jitter
+class MaUWB_SynthMonitor {
+public:
+    MaUWB_SynthMonitor() { reset(0); }
+
+    // period: nominal report interval (us) the jitter is measured against
+    void reset(uint32_t period);
+
+    // A report arrived at now (us)
+    void onReport(const MaUWB_RangeReport& report, uint32_t now);
+
+    uint32_t getReports() const { return reports; }
+    uint32_t getMissing() const { return missing; }     // Seq gaps
+    uint32_t getUnknown() const { return unknown; }     // Tag ids past MAUWB_SYNTH_MAX_TAGS
+    MaUWB_LatencyHistogram& getJitter() { return jitter; }   // |arrival interval - period| (us)
+
+private:
+    struct Seen {
+        bool valid;
+        uint8_t seq;
+        uint32_t time;
+    };
+
+    Seen seen[MAUWB_SYNTH_MAX_TAGS];
+    uint32_t period;
+    uint32_t reports;
+    uint32_t missing;
+    uint32_t unknown;
+    MaUWB_LatencyHistogram jitter;
+};
+
+// Implementation
+
+inline void MaUWB_SynthFleet::begin(const MaUWB_SynthConfig& config, const float (*anchors)[3], uint8_t count,
+                                    uint32_t seed) {
+    this->config = config;
+    tagCount = config.tags < MAUWB_SYNTH_MAX_TAGS ? config.tags : MAUWB_SYNTH_MAX_TAGS;
+    anchorCount = count < MAUWB_RANGE_SLOTS ? count : MAUWB_RANGE_SLOTS;
+    for (uint8_t i = 0; i < anchorCount; i++) {
+        for (uint8_t k = 0; k < 3; k++) {
+            this->anchors[i][k] = anchors[i][k];
+        }
+    }
+    period = config.rateHz > 0 ? (uint32_t)(1e6f / config.rateHz) : 1000000;
+    random.seed(seed);
+    lag.reset();
+    generated = lost = bytes = resyncs = 0;
+    started = false;
+
+    for (uint8_t i = 0; i < tagCount; i++) {
+        Tag& tag = tags[i];
+        tag.x = random.uniform() * config.width;
+        tag.y = random.uniform() * config.height;
+        pickWaypoint(tag);
+        tag.seq = (uint8_t)random.next();
+        tag.due = 0;
+        tag.moved = 0;
+    }
+}
+
+inline void MaUWB_SynthFleet::pickWaypoint(Tag& tag) {
+    tag.targetX = random.uniform() * config.width;
+    tag.targetY = random.uniform() * config.height;
+}
+
+inline void MaUWB_SynthFleet::walk(Tag& tag, uint32_t now) {
+    float step = config.speed * (uint32_t)(now - tag.moved) / 1e6f;
+    tag.moved = now;
+    float dx = tag.targetX - tag.x;
+    float dy = tag.targetY - tag.y;
+    float left = sqrtf(dx * dx + dy * dy);
+    if (left <= step) {
+        tag.x = tag.targetX;
+        tag.y = tag.targetY;
+        pickWaypoint(tag);
+    } else if (left > 0) {
+        tag.x += dx * step / left;
+        tag.y += dy * step / left;
+    }
+}
+
+inline uint32_t MaUWB_SynthFleet::nextInterval() {
+    float factor = 1.0f + config.jitter * (2.0f * random.uniform() - 1.0f);
+    return factor > 0.05f ? (uint32_t)(period * factor) : period / 20;
+}
+
+inline uint32_t MaUWB_SynthFleet::timeToNext(uint32_t now) const {
+    if (!started || tagCount == 0) return 0;
+    int32_t soonest = 0x7FFFFFFF;
+    for (uint8_t i = 0; i < tagCount; i++) {
+        int32_t wait = (int32_t)(tags[i].due - now);
+        if (wait < soonest) soonest = wait;
+    }
+    return soonest > 0 ? (uint32_t)soonest : 0;
+}
+
+inline uint16_t MaUWB_SynthFleet::poll(uint32_t now, char* line, uint16_t size) {
+    if (tagCount == 0 || anchorCount == 0) return 0;
+
+    // Spread the first reports over one period, as tags joining a TDMA cycle
+    if (!started) {
+        started = true;
+        for (uint8_t i = 0; i < tagCount; i++) {
+            tags[i].due = now + (uint32_t)((uint64_t)period * i / tagCount);
+            tags[i].moved = now;
+        }
+    }
+
+    for (;;) {
+        // Earliest due tag
+        uint8_t next = 0;
+        for (uint8_t i = 1; i < tagCount; i++) {
+            if ((int32_t)(tags[i].due - tags[next].due) < 0) next = i;
+        }
+        Tag& tag = tags[next];
+        int32_t late = (int32_t)(now - tag.due);
+        if (late < 0) return 0;
+
+        uint32_t due = tag.due;
+        if ((uint32_t)late > MAUWB_SYNTH_MAX_LAG_US) {
+            resyncs++;
+            for (uint8_t i = 0; i < tagCount; i++) {
+                tags[i].due = now + (uint32_t)((uint64_t)period * i / tagCount);
+            }
+            continue;
+        }
+        tag.due = due + nextInterval();
+        walk(tag, due);
+        tag.seq++;
+        generated++;
+
+        if (random.uniform() < config.loss) {
+            lost++;
+            continue;
+        }
+
+        uint16_t length = writeReport(tag, config.firstTid + next, line, size);
+        if (length == 0) return 0;
+        lag.record((uint32_t)late);
+        bytes += length;
+        lastTid = config.firstTid + next;
+        lastDue = due;
+        return length;
+    }
+}
+
+inline uint16_t MaUWB_SynthFleet::writeReport(Tag& tag, uint16_t tid, char* line, uint16_t size) {
+    float ranges[MAUWB_RANGE_SLOTS] = {0};
+    float rssi[MAUWB_RANGE_SLOTS] = {0};
+    for (uint8_t i = 0; i < anchorCount; i++) {
+        float dx = tag.x - anchors[i][0];
+        float dy = tag.y - anchors[i][1];
+        float dz = config.tagHeight - anchors[i][2];
+        ranges[i] = sqrtf(dx * dx + dy * dy + dz * dz);
+    }
+    if (config.pattern != MAUWB_NOISE_NONE && random.uniform() < config.patternShare) {
+        MaUWB_SynthNoise::apply(config.pattern, ranges, anchorCount, tag.seq % 10, random);
+    }
+
+    uint8_t mask = 0;
+    for (uint8_t i = 0; i < anchorCount; i++) {
+        if (random.uniform() < config.dropout) {
+            ranges[i] = 0;
+            continue;
+        }
+        // Free-space falloff from -58 dBm at 1 m
+        float distance = ranges[i] > 50 ? ranges[i] : 50;
+        rssi[i] = -58.0f - 20.0f * log10f(distance / 100.0f) + random.gaussian(1.5f);
+        ranges[i] += config.sigma > 0 ? random.gaussian(config.sigma) : 0;
+        if (ranges[i] < 1) ranges[i] = 1;
+        mask |= 1 << i;
+    }
+
+    int length = snprintf(line, size,
+                          "AT+RANGE=tid:%u,mask:%02X,seq:%u,range:(%d,%d,%d,%d,%d,%d,%d,%d),"
+                          "rssi:(%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f)\r\n",
+                          tid, mask, tag.seq, (int)ranges[0], (int)ranges[1], (int)ranges[2], (int)ranges[3],
+                          (int)ranges[4], (int)ranges[5], (int)ranges[6], (int)ranges[7], rssi[0], rssi[1], rssi[2],
+                          rssi[3], rssi[4], rssi[5], rssi[6], rssi[7]);
+    return length > 0 && length < size ? (uint16_t)length : 0;
+}
+
+inline bool MaUWB_SynthFleet::getTruth(uint16_t tid, float& x, float& y) const {
+    if (tid < config.firstTid || tid - config.firstTid >= tagCount) return false;
+    x = tags[tid - config.firstTid].x;
+    y = tags[tid - config.firstTid].y;
+    return true;
+}
+
+inline void MaUWB_SynthMonitor::reset(uint32_t period) {
+    this->period = period;
+    for (uint8_t i = 0; i < MAUWB_SYNTH_MAX_TAGS; i++) {
+        seen[i].valid = false;
+    }
+    reports = missing = unknown = 0;
+    jitter.reset();
+}
+
+inline void MaUWB_SynthMonitor::onReport(const MaUWB_RangeReport& report, uint32_t now) {
+    reports++;
+    if (report.tid >= MAUWB_SYNTH_MAX_TAGS) {
+        unknown++;
+        return;
+    }
+    Seen& tag = seen[report.tid];
+    uint8_t seq = (uint8_t)report.seq;
+    if (tag.valid) {
+        uint8_t step = seq - tag.seq;
+        if (step > 1 && step < 128) {
+            missing += step - 1;
+        }
+        // Interval against the nominal one, per report it spans
+        uint32_t interval = now - tag.time;
+        uint32_t expected = period * (step ? step : 1);
+        if (period && step && step < 128) {
+            jitter.record(interval > expected ? interval - expected : expected - interval);
+        }
+    }
+    tag.valid = true;
+    tag.seq = seq;
+    tag.time = now;
+}
+
+#if defined(ARDUINO)
+
+// The module's UART as MaUWB_AT sees it, fed by a fleet. update() before
+// each MaUWB_AT::poll() hands over the bytes a real UART would have
+// received since the last call at the given baud rate, up to its receive
+// buffer; lines the link has no time for stay in the fleet and come late.
+// Every command written is answered with "OK"; queries that expect a value
+// time out, so MaUWB_AT::configure() runs its full sequence against it.
+class MaUWB_SynthModule : public Stream {
+public:
+    MaUWB_SynthModule() : fleet(nullptr), baud(0), rxBuffer(0), lastUpdate(0), carry(0), budget(0), length(0),
+                          position(0), replying(false), replyPending(0), commandLength(0), dueHead(0),
+                          dueCount(0) {}
+
+    // baud 0: no line limit, rxBuffer bytes per update()
+    void begin(MaUWB_SynthFleet* fleet, uint32_t baud = 115200, uint16_t rxBuffer = 2048) {
+        this->fleet = fleet;
+        this->baud = baud;
+        this->rxBuffer = rxBuffer;
+        lastUpdate = micros();
+        carry = 0;
+        budget = 0;
+    }
+
+    void update() {
+        uint32_t now = micros();
+        if (baud == 0) {
+            budget = rxBuffer;
+        } else {
+            // 10 bits per byte; the remainder carries over to the next call
+            uint64_t bits = (uint64_t)(uint32_t)(now - lastUpdate) * baud + carry;
+            uint64_t bytes = bits / 10000000ULL;
+            carry = bits % 10000000ULL;
+            budget = budget + bytes < rxBuffer ? budget + (uint16_t)bytes : rxBuffer;
+        }
+        lastUpdate = now;
+    }
+
+    int available() override {
+        if (position >= length && !refill()) return 0;
+        if (replying) return length - position;
+        return length - position < budget ? length - position : budget;
+    }
+    int read() override {
+        if (available() == 0) return -1;
+        if (!replying) budget--;
+        return (uint8_t)line[position++];
+    }
+    int peek() override {
+        if (available() == 0) return -1;
+        return (uint8_t)line[position];
+    }
+
+    size_t write(uint8_t c) override {
+        if (c == '\n') {
+            if (commandLength > 0) replyPending++;
+            commandLength = 0;
+        } else if (c != '\r') {
+            commandLength++;
+        }
+        return 1;
+    }
+    using Print::write;
+
+    // When the oldest report not yet handed on was due (us); call once
+    // per report, in order, to measure the latency up to that point
+    bool takeDue(uint32_t& due) {
+        if (dueCount == 0) return false;
+        due = dues[dueHead];
+        dueHead = (dueHead + 1) % DUE_QUEUE;
+        dueCount--;
+        return true;
+    }
+
+private:
+    static const uint8_t DUE_QUEUE = 16;
+
+    bool refill() {
+        position = length = 0;
+        replying = replyPending > 0;
+        if (replying) {
+            replyPending--;
+            memcpy(line, "OK\r\n", 4);
+            length = 4;
+            return true;
+        }
+        if (!fleet || budget == 0) return false;
+        length = fleet->poll(micros(), line, sizeof(line));
+        if (length == 0) return false;
+        if (dueCount == DUE_QUEUE) {
+            dueHead = (dueHead + 1) % DUE_QUEUE;   // Nobody is taking them: keep the newest
+            dueCount--;
+        }
+        dues[(dueHead + dueCount++) % DUE_QUEUE] = fleet->getLastDue();
+        return true;
+    }
+
+    MaUWB_SynthFleet* fleet;
+    uint32_t baud;
+    uint16_t rxBuffer;
+    uint32_t lastUpdate;
+    uint64_t carry;
+    uint16_t budget;          // Bytes the UART has received and not yet handed on
+    char line[MAUWB_SYNTH_LINE_MAX];
+    uint16_t length;
+    uint16_t position;
+    bool replying;            // line holds an "OK" rather than a report
+    uint8_t replyPending;
+    uint8_t commandLength;
+    uint32_t dues[DUE_QUEUE];
+    uint8_t dueHead;
+    uint8_t dueCount;
+};
+
+#endif // ARDUINO
+
+#endif // MAUWB_SYNTH_LOAD_H
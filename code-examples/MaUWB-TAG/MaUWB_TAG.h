@@ -3,6 +3,20 @@
  * 
  * Object-oriented UWB tag implementation with configurable parameters
  * and expandable anchor system.
+ *
+ * MaUWB_BasicTAG<NAnchors, NHistory, Callbacks> is the class template.
+ * MaUWB_TAG is the runtime-configurable form: room for 10 anchors, any
+ * count up to that, and virtual callbacks a derived class overrides. For a
+ * fixed room the template can be specialised instead:
+ *
+ *   struct RoomCallbacks : MaUWB_NoCallbacks {
+ *       void onZoneChange(uint8_t zone, bool entered) { digitalWrite(LED, entered); }
+ *   };
+ *   MaUWB_BasicTAG<4, 5, RoomCallbacks> uwbTag(7, 50);
+ *
+ * The arrays, the solver's triplet cache and the moving average are then
+ * sized for exactly 4 anchors and 5 fixes, the per-anchor loops in the tag
+ * have a constant trip count, and the callbacks are plain inline calls.
  */
 
 #ifndef MAUWB_TAG_H
@@ -12,12 +26,157 @@
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
 #include <Arduino.h>
+#include "MaUWB_AT.h"
+#include "MaUWB_LinkStats.h"
+#include "MaUWB_Zones.h"
+#include "MaUWB_Solver.h"
+#include "MaUWB_Filter.h"
+#include "MaUWB_Scheduler.h"
+#include "MaUWB_Motion.h"
+#include "MaUWB_Sleep.h"
+#include "MaUWB_Display.h"
+#include "MaUWB_Logo.h"
+#include "MaUWB_SpscQueue.h"
+#include "MaUWB_Log.h"
+#include "MaUWB_Stream.h"
+#include "MaUWB_Survey.h"
 
-class MaUWB_TAG {
+// ESP32S3 pins
+#ifndef MAUWB_RESET_PIN
+#define MAUWB_RESET_PIN 16
+#endif
+#ifndef MAUWB_RXD_PIN
+#define MAUWB_RXD_PIN 18
+#endif
+#ifndef MAUWB_TXD_PIN
+#define MAUWB_TXD_PIN 17
+#endif
+#ifndef MAUWB_I2C_SDA
+#define MAUWB_I2C_SDA 39
+#endif
+#ifndef MAUWB_I2C_SCL
+#define MAUWB_I2C_SCL 38
+#endif
+
+// Dual-core mode (startDualCore) needs FreeRTOS; define MAUWB_TAG_NO_TASKS to leave it out
+#if defined(ARDUINO_ARCH_ESP32) && !defined(MAUWB_TAG_NO_TASKS)
+#define MAUWB_TAG_TASKS 1
+#else
+#define MAUWB_TAG_TASKS 0
+#endif
+
+// 1: zone map checked on every fix (MaUWB_Zones.h, 10 KB of RAM by default)
+#ifndef MAUWB_TAG_ZONES
+#define MAUWB_TAG_ZONES 1
+#endif
+
+// Baud rate the module starts at
+#ifndef MAUWB_UART_BAUD
+#define MAUWB_UART_BAUD 115200
+#endif
+
+// 1: honour setModuleBaud(). Experimental: MAUWB_BAUD_COMMAND is not in the
+// module's AT manual, so the link stays at MAUWB_UART_BAUD unless this is on.
+#ifndef MAUWB_BAUD_SWITCH
+#define MAUWB_BAUD_SWITCH 0
+#endif
+
+// Command asking the module to change its baud rate (%lu: the rate). Not
+// every AT firmware has one; without an OK the link stays at MAUWB_UART_BAUD.
+#ifndef MAUWB_BAUD_COMMAND
+#define MAUWB_BAUD_COMMAND "AT+SETUART=%lu"
+#endif
+
+// Longest the module goes unread when no data arrives (ms): the ranging task's
+// sleep in dual-core mode, the gap between reads from update() otherwise
+#ifndef MAUWB_TAG_IDLE_WAIT_MS
+#define MAUWB_TAG_IDLE_WAIT_MS 5
+#endif
+
+// Module lines (not range reports) logged per second with debug on
+#ifndef MAUWB_TAG_LOG_LINE_RATE
+#define MAUWB_TAG_LOG_LINE_RATE 20
+#endif
+
+// Fixes buffered between the solver and the stream sink (power of two)
+#ifndef MAUWB_TAG_STREAM_QUEUE
+#define MAUWB_TAG_STREAM_QUEUE 16
+#endif
+
+// Dual-core mode: position samples buffered between the ranging and display tasks
+#ifndef MAUWB_TAG_SAMPLE_QUEUE
+#define MAUWB_TAG_SAMPLE_QUEUE 8
+#endif
+#ifndef MAUWB_TAG_TASK_STACK
+#define MAUWB_TAG_TASK_STACK 4096
+#endif
+#ifndef MAUWB_TAG_RANGING_PRIORITY
+#define MAUWB_TAG_RANGING_PRIORITY 3
+#endif
+#ifndef MAUWB_TAG_DISPLAY_PRIORITY
+#define MAUWB_TAG_DISPLAY_PRIORITY 1
+#endif
+
+// Callback policies: the tag derives from one and calls onPositionUpdate(),
+// onDistanceUpdate() and onZoneChange() on it
+
+// Virtual hooks for a derived class (MaUWB_TAG)
+class MaUWB_VirtualCallbacks {
+public:
+    virtual ~MaUWB_VirtualCallbacks() {}
+    virtual void onPositionUpdate(float x, float y) {}
+    virtual void onDistanceUpdate(uint8_t anchorIndex, float distance) {}
+    virtual void onZoneChange(uint8_t zone, bool entered) {}
+};
+
+// Empty inline hooks; derive from it and hide the ones needed
+struct MaUWB_NoCallbacks {
+    void onPositionUpdate(float x, float y) {}
+    void onDistanceUpdate(uint8_t anchorIndex, float distance) {}
+    void onZoneChange(uint8_t zone, bool entered) {}
+};
+
+// NAnchors: 0 = any count up to MAUWB_SOLVER_MAX_ANCHORS, set at runtime;
+// otherwise exactly that many. NHistory: longest position history.
+template <uint8_t NAnchors = 0, uint8_t NHistory = MAUWB_FILTER_MAX_WINDOW,
+          class Callbacks = MaUWB_VirtualCallbacks>
+class MaUWB_BasicTAG : public Callbacks {
+public:
+    static const uint8_t DISPLAY_ANCHOR_ROWS = 4;
+    
+    // One fix as handed from ranging to display and logging
+    struct Sample {
+        float x, y;          // Filtered position (cm)
+        float rawX, rawY;    // Fix before filtering
+        bool valid;          // false when the report gave no position
+        uint8_t anchorCount;
+        uint16_t rejected;   // Anchors dropped as outliers, bit per anchor
+        float distances[DISPLAY_ANCHOR_ROWS];
+        unsigned long time;  // millis() when the report arrived
+    };
+    
+    // Hot-path stages timed with MAUWB_LATENCY (see MaUWB_Latency.h)
+    enum LatencyStage {
+        LATENCY_RECEIVE,    // First byte of the line read -> line complete
+        LATENCY_PARSE,      // Line complete -> report decoded
+        LATENCY_SOLVE,      // Decoded -> fix solved (weights, solver)
+        LATENCY_FILTER,     // Solved -> filtered
+        LATENCY_CALLBACK,   // Filtered -> zone map and onPositionUpdate() done
+        LATENCY_TOTAL,      // First byte -> onPositionUpdate() returned
+        LATENCY_STAGES
+    };
+    
+    // Log categories, each with its own rate limit (see getLog())
+    enum LogCategory {
+        LOG_MODULE,         // Lines from the module that are not range reports
+        LOG_SAMPLE          // Distances and position of each fix
+    };
+    
 private:
     // Configuration parameters
     uint8_t tagIndex;
-    unsigned long refreshRate;
+    unsigned long refreshRate;      // Shortest gap between explicit range polls
+    bool autoReport;                // Module pushes reports (AT+SETRPT=1)
     unsigned long displayUpdateInterval;
     uint8_t maxTags;
     uint8_t positionHistoryLength;
@@ -25,169 +184,534 @@ private:
     // Hardware components
     Adafruit_SSD1306* display;
     bool displayInitialized;
+    HardwareSerial* uwbSerial;
+    uint32_t moduleBaud;            // Rate asked for with setModuleBaud()
+    uint32_t linkBaud;              // Rate in use
+    
+    // UART receive errors, counted by the driver's event task
+    volatile uint32_t rxOverflows;  // Hardware FIFO or RX buffer overflowed: bytes lost
+    volatile uint32_t rxErrors;     // Framing, parity and break errors
+    
+    // Single-core mode: set by the driver's receive event, cleared by the read
+    volatile bool rxEvent;
+    unsigned long lastRxRead;
+    
+    // Status screen; only changed fields are sent to the OLED
+    MaUWB_Display screen;
+    int8_t xField, yField;
+    int8_t distanceFields[DISPLAY_ANCHOR_ROWS];
+    uint8_t layoutAnchorRows;   // Rows in the drawn layout, 0xFF = not drawn yet
+    const MaUWB_Bitmap* displayLogo;   // Top right of the status screen, in flash
     
-    // Anchor configuration
-    static const uint8_t MAX_ANCHORS = 10;
+    // AT command link to the UWB module
+    MaUWB_AT at;
+    
+    // Decides when AT+RANGE is needed on top of the module's auto-reports
+    MaUWB_RangeScheduler scheduler;
+    
+    // Motion-adaptive rate: poll and display interval from refreshRate
+    // while moving up to the slow interval at rest, light sleep in between
+    MaUWB_MotionRate motion;
+    bool adaptiveRate;
+    bool lightSleep;
+    MaUWB_PollSleep sleeper;        // Light sleep setLightSleep() asks for (MaUWB_Sleep.h)
+    void updateMotion(float lastX, float lastY, float dt, float innovation);
+    unsigned long displayInterval() const;
+    void sleepUntilPoll();
+    
+    // Anchor configuration; the solver holds the anchor positions and
+    // caches the geometry derived from them
+    static const uint8_t MAX_ANCHORS = NAnchors ? NAnchors : MAUWB_SOLVER_MAX_ANCHORS;
     uint8_t numAnchors;
-    float anchorX[MAX_ANCHORS];
-    float anchorY[MAX_ANCHORS];
+    MaUWB_SolverT<MaUWB_Real, MAX_ANCHORS> solver;
+    
+    // A compile-time constant when NAnchors is set, so the loops over it unroll
+    uint8_t anchorCount() const { return NAnchors ? NAnchors : numAnchors; }
     
-    // Distance measurements
+    // Distance measurements, the RSSI of each reply (dBm) and the weight
+    // each range gets in the solve
     float distances[MAX_ANCHORS];
+    float rssi[MAX_ANCHORS];
+    float weights[MAX_ANCHORS];
+    bool anchorWeighting;
     
-    // Position data
+    // Report loss and per-anchor delivery, and the anchors left out of the
+    // solve for answering too rarely
+    MaUWB_LinkStats linkStats;
+    float minAnchorDelivery;
+    uint8_t excludedAnchors;
+    
+    // Position data (filtered, and the fix it was derived from)
     float currentX;
     float currentY;
+    float rawX;
+    float rawY;
     
     // Position filtering
-    static const uint8_t MAX_HISTORY = 10;
-    float positionXHistory[MAX_HISTORY];
-    float positionYHistory[MAX_HISTORY];
-    uint8_t positionHistoryIndex;
-    bool positionHistoryFilled;
+    static const uint8_t MAX_HISTORY = NHistory;
+    MaUWB_FilterMode filterMode;
+    MaUWB_MovingAverageT<MaUWB_Real, NHistory> movingAverage;
+    MaUWB_KalmanFilter kalmanFilter;
+    MaUWB_PositionFilter* customFilter;
+    unsigned long lastFixTime;
       // Timing
     unsigned long lastDisplayUpdate;
-    unsigned long lastRangeRequest;
     bool newData;
     
     // Debug control
     bool debugEnabled;
+    MaUWB_Log logger;               // Written on the ranging path, drained by update() or the display task
+    
+    // Network output: fixes are queued on the ranging path and batched into
+    // packets by update() or the display task
+    MaUWB_PositionStreamer streamer;
+    MaUWB_SpscQueue<MaUWB_StreamSample, MAUWB_TAG_STREAM_QUEUE> streamQueue;
+    bool streaming;
+    void serviceStream();
+    
+#if MAUWB_TAG_ZONES
+    MaUWB_ZoneMap zones;
+    static void handleZoneChange(uint8_t zone, bool entered, void* context);
+#endif
     
-    // Serial communication
-    String response;
+#if MAUWB_LATENCY
+    MaUWB_LatencyHistogram latency[LATENCY_STAGES];
+#endif
+    
+#if MAUWB_TAG_TASKS
+    // Dual-core mode: the ranging task owns the module link and the solver,
+    // the display task gets samples through a lock-free queue
+    TaskHandle_t rangingTask;
+    TaskHandle_t displayTask;
+    SemaphoreHandle_t moduleLock;   // Recursive; guards the AT link and solver inputs
+    MaUWB_SpscQueue<Sample, MAUWB_TAG_SAMPLE_QUEUE> samples;
+    
+    static void rangingTaskEntry(void* context);
+    static void displayTaskEntry(void* context);
+    void stopDualCore();
+#endif
     
     // Private methods
     void initializeHardware();
-    void configureUWBModule();
-    void parseRangeData(String data);
-    void calculatePosition();
-    bool calculatePositionFromTriplet(int a1, int a2, int a3, float& x, float& y);
-    void updatePositionHistory(float x, float y);
-    void updateDisplay();
-    void displayAnchorDistance(int x, int y, int anchorNum, float distance);
-    String sendCommand(String command, const int timeout, boolean debug = false);
+    bool configureUWBModule();
+    void findModule();
+    void negotiateBaud();
+    void rangingStep(unsigned long now);
+    void handleRangeReport(const MaUWB_RangeReport& report);
+    bool calculatePosition();
+    void applyFilter(float x, float y);
+    Sample makeSample(bool valid) const;
+    void logSample(const Sample& sample);
+    void drawDisplayLayout(uint8_t anchorRows);
+    void updateDisplay(const Sample& sample);
+    void lockModule();
+    void unlockModule();
+    static void handleModuleLine(const char* line, uint8_t length, void* context);
+    static void handleModuleReport(const MaUWB_RangeReport& report, void* context);
     
 public:
     // Constructor
-    MaUWB_TAG(uint8_t tagIndex, unsigned long refreshRate = 50);
+    MaUWB_BasicTAG(uint8_t tagIndex, unsigned long refreshRate = 50);
     
     // Destructor
-    ~MaUWB_TAG();
+    ~MaUWB_BasicTAG();
     
     // Initialization
     bool begin();
     
     // Main update function - call this in loop()
     void update();
+    
+#if MAUWB_TAG_TASKS
+    // Optional dual-core mode, call after begin(). Ranging and the solver run
+    // on rangingCore, display and debug logging on displayCore, so a slow I2C
+    // transfer no longer delays range parsing. update() then only forwards
+    // serial commands. onPositionUpdate()/onDistanceUpdate() are called from
+    // the ranging task.
+    bool startDualCore(uint8_t rangingCore = 1, uint8_t displayCore = 0);
+    bool isDualCore() const { return rangingTask != nullptr; }
+    uint32_t getDroppedSamples() const { return samples.getDropped(); }
+#endif
       // Configuration methods
     void setDisplayRefreshRate(unsigned long intervalMs);
+    // Bitmap in the top right corner of the status screen (MaUWB_Bitmap.h,
+    // made with drawings-for-SD1306); nullptr for none. At most 16 pixels
+    // wide to stay clear of the fields.
+    void setDisplayLogo(const MaUWB_Bitmap* logo) { displayLogo = logo; layoutAnchorRows = 0xFF; }
     void setMaxTags(uint8_t maxTags);
     void setPositionHistoryLength(uint8_t length);
+    void setRefinementIterations(uint8_t iterations);
+    void setAnchorWeighting(bool enable) { anchorWeighting = enable; }  // RSSI/consistency weights, default on
+    // Drop anchors whose ranges disagree with the fix; tries at most maxTriplets anchor triplets (0 = off)
+    void setOutlierRejection(uint8_t maxTriplets, float thresholdCm = MAUWB_RANSAC_THRESHOLD);
+    // Leave out anchors answering in fewer than minRate (0..1) of recent reports, while 3 others remain (0 = off)
+    void setMinAnchorDelivery(float minRate) { minAnchorDelivery = minRate; }
+    void setAutoReport(bool enable);   // Call before begin(); default on
+    // Range at refreshRate while the tag moves and back off to slowMs at
+    // rest (MaUWB_Motion.h). Call before begin(); the module is then polled
+    // instead of auto-reporting, so a resting tag leaves its TDMA slots idle.
+    void setAdaptiveRate(bool enable, unsigned long slowMs = MAUWB_MOTION_SLOW_MS);
+    // Light sleep between polls while at rest. USB serial drops out while
+    // asleep, so leave it off when debugging over USB. ESP32, single-core mode.
+    void setLightSleep(bool enable) { lightSleep = enable; }
+    // Switch the module link to this baud rate after setup, if the firmware
+    // accepts MAUWB_BAUD_COMMAND (call before begin(); 0 = stay at MAUWB_UART_BAUD).
+    // Ignored unless MAUWB_BAUD_SWITCH is 1.
+    void setModuleBaud(uint32_t baud) { moduleBaud = MAUWB_BAUD_SWITCH ? baud : 0; }
+    uint32_t getLinkBaud() const { return linkBaud; }
+    
+    // Position filter stage (default: Kalman, smoothing set by the history length)
+    void setFilterMode(MaUWB_FilterMode mode);
+    MaUWB_FilterMode getFilterMode() const { return filterMode; }
+    void setFilter(MaUWB_PositionFilter* filter);  // Custom filter, selects MAUWB_FILTER_CUSTOM
+    void setKalmanNoise(float processNoise, float measurementNoise);
     
     // Debug control
     void enableDebug(bool enable = true);
     void disableDebug() { enableDebug(false); }
     bool isDebugEnabled() const;
+    MaUWB_Log& getLog() { return logger; }   // Debug log buffer; rate limits per LogCategory
+
+    // Record raw module output for offline replay (MaUWB_Capture.h); nullptr stops
+    void setCaptureOutput(Print* output);
+    
+    // Per-stage latency table (count, min, mean, p99, max in us); needs
+    // MAUWB_LATENCY 1, otherwise it only says so
+    void printLatencyStats(Print& out);
+    void resetLatencyStats();
       // Anchor management
     void setAnchorCount(uint8_t count);
-    void setAnchorPosition(uint8_t anchorIndex, float x, float y);
+    void setAnchorPosition(uint8_t anchorIndex, float x, float y, float z = 0);  // z: mounting height
     void setDefaultAnchors();
+    // Layout solved from anchor-to-anchor ranges (MaUWB_Survey.h); moves
+    // every anchor of the survey and restarts the filter
+    void applySurvey(const MaUWB_Survey& survey);
+    
+    // 3D mode: with anchors at different heights, give the tag's height or
+    // let each fix estimate it within minZ..maxZ (cm)
+    void setTagHeight(float z);
+    void setHeightEstimation(bool enable, float minZ = 0, float maxZ = 300);
     
     // Individual anchor position setters (convenience methods)
-    void anchor0(float x, float y) { setAnchorPosition(0, x, y); }
-    void anchor1(float x, float y) { setAnchorPosition(1, x, y); }
-    void anchor2(float x, float y) { setAnchorPosition(2, x, y); }
-    void anchor3(float x, float y) { setAnchorPosition(3, x, y); }
-    void anchor4(float x, float y) { setAnchorPosition(4, x, y); }
-    void anchor5(float x, float y) { setAnchorPosition(5, x, y); }
-    void anchor6(float x, float y) { setAnchorPosition(6, x, y); }
-    void anchor7(float x, float y) { setAnchorPosition(7, x, y); }
-    void anchor8(float x, float y) { setAnchorPosition(8, x, y); }
-    void anchor9(float x, float y) { setAnchorPosition(9, x, y); }
+    void anchor0(float x, float y, float z = 0) { setAnchorPosition(0, x, y, z); }
+    void anchor1(float x, float y, float z = 0) { setAnchorPosition(1, x, y, z); }
+    void anchor2(float x, float y, float z = 0) { setAnchorPosition(2, x, y, z); }
+    void anchor3(float x, float y, float z = 0) { setAnchorPosition(3, x, y, z); }
+    void anchor4(float x, float y, float z = 0) { setAnchorPosition(4, x, y, z); }
+    void anchor5(float x, float y, float z = 0) { setAnchorPosition(5, x, y, z); }
+    void anchor6(float x, float y, float z = 0) { setAnchorPosition(6, x, y, z); }
+    void anchor7(float x, float y, float z = 0) { setAnchorPosition(7, x, y, z); }
+    void anchor8(float x, float y, float z = 0) { setAnchorPosition(8, x, y, z); }
+    void anchor9(float x, float y, float z = 0) { setAnchorPosition(9, x, y, z); }
     
     // Data access methods
     float getPositionX() const { return currentX; }
     float getPositionY() const { return currentY; }
+    float getRawPositionX() const { return rawX; }
+    float getRawPositionY() const { return rawY; }
+    float getPositionZ() const { return solver.getLastZ(); }  // Known or estimated height
     float getDistance(uint8_t anchorIndex) const;
+    float getAnchorWeight(uint8_t anchorIndex) const;  // Weight of the range in the last fix
+    uint16_t getRejectedAnchors() const { return solver.getRejectedMask(); }  // Outliers in the last fix, bit per anchor
+    uint8_t getExcludedAnchors() const { return excludedAnchors; }  // Left out for low delivery, bit per anchor
+    
+    // Link statistics from the seq and mask of each report
+    const MaUWB_LinkStats& getLinkStats() const { return linkStats; }
+    uint32_t getReportsLost() const { return linkStats.getLost(); }
+    float getAnchorDeliveryRate(uint8_t anchorIndex) const { return linkStats.getDeliveryRate(anchorIndex); }
+    void printLinkStats(Print& out);
+    
+    // Position streaming (MaUWB_Stream.h): every fix is sent in batches of
+    // MAUWB_STREAM_BATCH to the sink, e.g. a MaUWB_EspNowSink (nullptr stops)
+    void setStreamSink(MaUWB_StreamSink* sink);
+    uint32_t getStreamPacketsSent() const { return streamer.getPacketsSent(); }
+    uint32_t getStreamDropped() const { return streamQueue.getDropped() + streamer.getSendFailures(); }
+    
+    // UART receive health: bytes lost to overflow, line errors, and the most
+    // bytes found waiting at once (against MAUWB_UART_RX_BUFFER)
+    uint32_t getRxOverflows() const { return rxOverflows; }
+    uint32_t getRxErrors() const { return rxErrors; }
+    uint16_t getRxHighWater() const { return at.getRxHighWater(); }
+    
+#if MAUWB_TAG_ZONES
+    // Zones checked on every fix; onZoneChange() runs when one is entered or left
+    MaUWB_ZoneMap& getZoneMap() { return zones; }
+    uint16_t getActiveZones() const { return zones.getActive(); }  // Bit per zone
+    bool isInZone(uint8_t zone) const { return zones.isInZone(zone); }
+#endif
     bool hasValidPosition() const;
+    float getUpdateRate() const { return scheduler.getUpdateRate(millis()); }  // Reports/s
+    bool isPassiveRanging() const { return scheduler.isPassive(millis()); }
+    bool isMoving() const { return motion.isMoving(); }
+    unsigned long getRangingInterval() const { return adaptiveRate ? motion.getInterval() : refreshRate; }
+    uint32_t getSleepTime() const { return sleeper.getSleepTime(); }   // ms in light sleep since begin()
     
     // Utility methods
     void requestRangeData();
     void processSerialData();
+    bool rxDue(unsigned long now);
+    void listenForData();
     void forwardSerialCommands();
-      // Event callbacks (can be overridden by user)
-    virtual void onPositionUpdate(float x, float y);
-    virtual void onDistanceUpdate(uint8_t anchorIndex, float distance);
+    
+    // Queue a command for the UWB module; the reply arrives via callback
+    bool sendCommand(const char* command, unsigned long timeoutMs,
+                     MaUWB_AT::ReplyCallback callback = nullptr, void* context = nullptr,
+                     const char* expect = nullptr);
+    MaUWB_AT::Result sendCommandAndWait(const char* command, unsigned long timeoutMs);
+    bool isCommandPending() const { return at.isBusy(); }
+      // Event callbacks come from the Callbacks policy: onPositionUpdate(x, y),
+    // onDistanceUpdate(anchorIndex, distance), onZoneChange(zone, entered)
 };
 
+// Runtime anchor count, virtual callbacks
+typedef MaUWB_BasicTAG<> MaUWB_TAG;
+
 // Implementation
 
 // Constructor
-inline MaUWB_TAG::MaUWB_TAG(uint8_t tagIndex, unsigned long refreshRate) 
-    : tagIndex(tagIndex), refreshRate(refreshRate), displayUpdateInterval(refreshRate),
-      maxTags(8), positionHistoryLength(5), display(nullptr), displayInitialized(false),
-      numAnchors(4), currentX(0), currentY(0), positionHistoryIndex(0), 
-      positionHistoryFilled(false), lastDisplayUpdate(0), lastRangeRequest(0),
-      newData(false), debugEnabled(false) {
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::MaUWB_BasicTAG(uint8_t tagIndex, unsigned long refreshRate) 
+    : tagIndex(tagIndex), refreshRate(refreshRate), autoReport(true),
+      displayUpdateInterval(refreshRate),
+      maxTags(8), positionHistoryLength(NHistory < 5 ? NHistory : 5), display(nullptr), displayInitialized(false),
+      uwbSerial(&Serial2), moduleBaud(0), linkBaud(MAUWB_UART_BAUD), rxOverflows(0), rxErrors(0), rxEvent(false), lastRxRead(0), xField(-1), yField(-1), layoutAnchorRows(0xFF),
+      displayLogo(&MaUWB_Logo),
+      adaptiveRate(false), lightSleep(false), numAnchors(NAnchors ? NAnchors : 4), anchorWeighting(true),
+      minAnchorDelivery(0), excludedAnchors(0), currentX(0), currentY(0), rawX(0), rawY(0),
+      filterMode(MAUWB_FILTER_KALMAN), movingAverage(positionHistoryLength), customFilter(nullptr), lastFixTime(0),
+      lastDisplayUpdate(0),
+      newData(false), debugEnabled(false), streaming(false)
+#if MAUWB_TAG_TASKS
+      , rangingTask(nullptr), displayTask(nullptr), moduleLock(nullptr)
+#endif
+{
     
     // Initialize arrays
     for (int i = 0; i < MAX_ANCHORS; i++) {
         distances[i] = 0.0;
-        anchorX[i] = 0.0;
-        anchorY[i] = 0.0;
+        rssi[i] = 0.0;
+        weights[i] = 0.0;
     }
     
-    for (int i = 0; i < MAX_HISTORY; i++) {
-        positionXHistory[i] = 0.0;
-        positionYHistory[i] = 0.0;
-    }
+    kalmanFilter.setSmoothing(positionHistoryLength);
+    logger.setRateLimit(LOG_MODULE, MAUWB_TAG_LOG_LINE_RATE, MAUWB_TAG_LOG_LINE_RATE);
+    
+#if MAUWB_TAG_ZONES
+    zones.setCallback(handleZoneChange, this);
+#endif
     
     // Set default anchor positions
+    solver.setAnchorCount(numAnchors);
     setDefaultAnchors();
 }
 
 // Destructor
-inline MaUWB_TAG::~MaUWB_TAG() {
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::~MaUWB_BasicTAG() {
+#if MAUWB_TAG_TASKS
+    stopDualCore();
+#endif
     if (display) {
         delete display;
     }
 }
 
 // Initialize the UWB tag system
-inline bool MaUWB_TAG::begin() {
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline bool MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::begin() {
+    pinMode(MAUWB_RESET_PIN, OUTPUT);
+    digitalWrite(MAUWB_RESET_PIN, HIGH);
+    
     Serial.begin(115200);
     Serial.println("Starting MaUWB-TAG system...");
     
     initializeHardware();
-    configureUWBModule();
+    findModule();
+    if (!configureUWBModule()) {
+        Serial.println("UWB module setup failed");
+        return false;
+    }
+    negotiateBaud();
     
     Serial.println("MaUWB-TAG initialized successfully");
     return true;
 }
 
 // Main update function
-inline void MaUWB_TAG::update() {
-    processSerialData();
-    forwardSerialCommands();
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::update() {
+#if MAUWB_TAG_TASKS
+    if (rangingTask) {
+        // Ranging and display run on their own tasks
+        forwardSerialCommands();
+        return;
+    }
+#endif
     
     unsigned long currentTime = millis();
-    
-    // Request range data periodically
-    if (currentTime - lastRangeRequest >= refreshRate) {
-        requestRangeData();
-        lastRangeRequest = currentTime;
-    }
+    rangingStep(currentTime);
+    forwardSerialCommands();
     
     // Update display if new data available and enough time has passed
-    if (newData && (currentTime - lastDisplayUpdate >= displayUpdateInterval)) {
-        updateDisplay();
+    if (newData && (currentTime - lastDisplayUpdate >= displayInterval())) {
+        updateDisplay(makeSample(hasValidPosition()));
         lastDisplayUpdate = currentTime;
         newData = false;
     }
+    
+    serviceStream();
+    
+    // Only what the USB-CDC buffer takes without blocking; the rest waits
+    logger.drain(Serial, MAUWB_LOG_DRAIN_MAX, true);
+    
+    sleepUntilPoll();
+}
+
+// Read the module and send a range poll if one is due
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::rangingStep(unsigned long now) {
+    if (rxDue(now)) {
+        processSerialData();
+    }
+    
+    // Poll only when auto-reports are off or have stalled, on the slot grid
+    if (scheduler.pollDue(now)) {
+        requestRangeData();
+    }
+}
+
+#if MAUWB_TAG_TASKS
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline bool MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::startDualCore(uint8_t rangingCore, uint8_t displayCore) {
+    if (rangingTask) return true;
+    
+    moduleLock = xSemaphoreCreateRecursiveMutex();
+    if (!moduleLock) return false;
+    
+    // Display first, so no sample is pushed before anyone reads the queue
+    if (xTaskCreatePinnedToCore(displayTaskEntry, "uwb_display", MAUWB_TAG_TASK_STACK, this,
+                                MAUWB_TAG_DISPLAY_PRIORITY, &displayTask, displayCore) != pdPASS ||
+        xTaskCreatePinnedToCore(rangingTaskEntry, "uwb_ranging", MAUWB_TAG_TASK_STACK, this,
+                                MAUWB_TAG_RANGING_PRIORITY, &rangingTask, rangingCore) != pdPASS) {
+        stopDualCore();
+        return false;
+    }
+    
+    // Wake the ranging task as soon as the driver has bytes (FIFO threshold
+    // or a pause in the line) instead of it polling the port
+    TaskHandle_t ranging = rangingTask;
+    uwbSerial->onReceive([ranging]() { xTaskNotifyGive(ranging); });
+    
+    if (debugEnabled) {
+        Serial.printf("Dual-core mode: ranging on core %u, display on core %u\n", rangingCore, displayCore);
+    }
+    return true;
+}
+
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::stopDualCore() {
+    listenForData();
+    if (rangingTask) {
+        vTaskDelete(rangingTask);
+        rangingTask = nullptr;
+    }
+    if (displayTask) {
+        vTaskDelete(displayTask);
+        displayTask = nullptr;
+    }
+    if (moduleLock) {
+        vSemaphoreDelete(moduleLock);
+        moduleLock = nullptr;
+    }
+}
+
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::rangingTaskEntry(void* context) {
+    MaUWB_BasicTAG* tag = static_cast<MaUWB_BasicTAG*>(context);
+    for (;;) {
+        unsigned long now = millis();
+        tag->rangingStep(now);
+        // Sleep until the UART driver has data (see startDualCore), or long
+        // enough for the poll schedule; the driver buffers what arrives.
+        // A polled tag at rest only needs to wake for its next poll.
+        unsigned long wait = MAUWB_TAG_IDLE_WAIT_MS;
+        if (tag->adaptiveRate && !tag->at.isBusy()) {
+            unsigned long due = tag->scheduler.timeToPoll(now);
+            if (due > wait) wait = due;
+        }
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait));
+    }
+}
+
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::displayTaskEntry(void* context) {
+    MaUWB_BasicTAG* tag = static_cast<MaUWB_BasicTAG*>(context);
+    Sample sample;
+    bool pending = false;
+    
+    for (;;) {
+        // Show only the newest sample
+        while (tag->samples.pop(sample)) {
+            pending = true;
+        }
+        tag->serviceStream();
+        tag->logger.drain(Serial, MAUWB_LOG_RECORDS);
+        
+        unsigned long now = millis();
+        if (pending && now - tag->lastDisplayUpdate >= tag->displayInterval()) {
+            tag->updateDisplay(sample);
+            tag->lastDisplayUpdate = now;
+            pending = false;
+        }
+        
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+}
+#endif
+
+// Serialize access to the module link and solver in dual-core mode
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::lockModule() {
+#if MAUWB_TAG_TASKS
+    if (moduleLock) xSemaphoreTakeRecursive(moduleLock, portMAX_DELAY);
+#endif
+}
+
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::unlockModule() {
+#if MAUWB_TAG_TASKS
+    if (moduleLock) xSemaphoreGiveRecursive(moduleLock);
+#endif
 }
 
 // Initialize hardware components
-inline void MaUWB_TAG::initializeHardware() {
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::initializeHardware() {
+    // Initialize UWB module serial. The larger RX buffer rides out a slow
+    // display update or solve without the driver dropping bytes.
+#if defined(ARDUINO_ARCH_ESP32)
+    uwbSerial->setRxBufferSize(MAUWB_UART_RX_BUFFER);
+#endif
+    uwbSerial->begin(MAUWB_UART_BAUD, SERIAL_8N1, MAUWB_RXD_PIN, MAUWB_TXD_PIN);
+    linkBaud = MAUWB_UART_BAUD;
+#if defined(ARDUINO_ARCH_ESP32)
+    uwbSerial->onReceiveError([this](hardwareSerial_error_t error) {
+        if (error == UART_FIFO_OVF_ERROR || error == UART_BUFFER_FULL_ERROR) {
+            rxOverflows++;
+        } else {
+            rxErrors++;
+        }
+    });
+#endif
+    listenForData();
+    at.begin(*uwbSerial);
+    at.setLineHandler(handleModuleLine, this);
+    at.setReportHandler(handleModuleReport, this);
+    at.setDebugOutput(debugEnabled ? &Serial : nullptr);
+    
+    // Initialize I2C for display
+    Wire.begin(MAUWB_I2C_SDA, MAUWB_I2C_SCL);
+    
     // Initialize OLED display
     display = new Adafruit_SSD1306(128, 64, &Wire, -1);
     
@@ -201,6 +725,8 @@ inline void MaUWB_TAG::initializeHardware() {
         display->println("Initializing...");
         display->display();
         
+        screen.begin(display, &Wire, 0x3C);
+        
         if (debugEnabled) {
             Serial.println("OLED display initialized");
         }
@@ -213,263 +739,698 @@ inline void MaUWB_TAG::initializeHardware() {
 }
 
 // Configure UWB module
-inline void MaUWB_TAG::configureUWBModule() {
-    Serial.println("AT+anchor_tag=0");
-    delay(100);
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline bool MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::configureUWBModule() {
+    MaUWB_ModuleConfig config;
+    config.id = tagIndex;
+    config.role = 0;          // Tag
+    config.rate = 1;          // 6.8 Mbps
+    config.filter = 1;
+    config.capacity = maxTags;
+    config.slotMs = MAUWB_SLOT_MS;
+    config.extMode = 1;
+    config.report = autoReport && !adaptiveRate ? 1 : 0;
+    config.antennaDelay = 0;  // Calibrated on the anchors
+    
+    // Rewrites and restarts the module only if its stored settings differ
+    lockModule();
+    MaUWB_AT::Result result = at.configure(config);
+    unlockModule();
+    if (result != MaUWB_AT::AT_OK && result != MaUWB_AT::AT_MATCH) {
+        return false;
+    }
+    
+    scheduler.configure(maxTags, MAUWB_SLOT_MS);
+    scheduler.setAutoReport(autoReport && !adaptiveRate);
+    scheduler.setMinPollInterval(refreshRate);
+    scheduler.begin(millis());
+    motion.configure(refreshRate, motion.getSlowInterval());
+    motion.begin(millis());
+    
+    if (debugEnabled) {
+        Serial.printf("UWB module configured as tag %u%s\n", tagIndex, result == MaUWB_AT::AT_MATCH ? " (settings kept)" : "");
+    }
+    return true;
+}
+
+// Wait for the module's first answer. It may still be at a faster rate
+// from setModuleBaud() if it kept that across a reset, so both are tried.
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::findModule() {
+    unsigned long start = millis();
+    lockModule();
+    do {
+        if (at.waitReady(100)) break;
+        if (moduleBaud > MAUWB_UART_BAUD) {
+            linkBaud = linkBaud == MAUWB_UART_BAUD ? moduleBaud : MAUWB_UART_BAUD;
+            uwbSerial->updateBaudRate(linkBaud);
+        }
+    } while (millis() - start < MAUWB_AT_BOOT_TIMEOUT);
+    unlockModule();
+}
+
+// Ask the module for moduleBaud and follow it once it has answered OK to
+// that command; back to the old rate if it does not answer there
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::negotiateBaud() {
+    if (moduleBaud <= MAUWB_UART_BAUD || linkBaud == moduleBaud) {
+        return;
+    }
     
-    String networkIdCommand = "AT+networkid=" + String(tagIndex);
-    Serial.println(networkIdCommand);
-    delay(100);
+    char command[MAUWB_AT_COMMAND_MAX];
+    snprintf(command, sizeof(command), MAUWB_BAUD_COMMAND, (unsigned long)moduleBaud);
+    lockModule();
+    if (at.sendAndWait(command, 500) == MaUWB_AT::AT_OK) {
+        uwbSerial->flush();
+        uwbSerial->updateBaudRate(moduleBaud);
+        if (at.waitReady(500)) {
+            linkBaud = moduleBaud;
+        } else {
+            uwbSerial->updateBaudRate(linkBaud);
+            at.waitReady(500);
+        }
+    }
+    unlockModule();
     
     if (debugEnabled) {
-        Serial.println("UWB module configured as tag " + String(tagIndex));
+        Serial.printf("Module link at %lu baud\n", (unsigned long)linkBaud);
     }
 }
 
 // Request range data from anchors
-inline void MaUWB_TAG::requestRangeData() {
-    String command = "AT+RANGE_CDS_ALL=" + String(tagIndex) + ",0,1,2,3";
-    String response = sendCommand(command, 1000, debugEnabled);
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::requestRangeData() {
+    // Never stack up polls behind a slow reply
+    if (at.isBusy()) return;
     
-    if (response.length() > 0) {
-        parseRangeData(response);
+    lockModule();
+    if (sendCommand("AT+RANGE", 100, nullptr, nullptr, "AT+RANGE=")) {
+        scheduler.pollSent(millis());
     }
+    unlockModule();
 }
 
 // Process incoming serial data
-inline void MaUWB_TAG::processSerialData() {
-    while (Serial.available()) {
-        char c = Serial.read();
-        
-        if (c == '\n' || c == '\r') {
-            if (response.length() > 0) {
-                parseRangeData(response);
-                response = "";
-            }
-        } else {
-            response += c;
-        }
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::processSerialData() {
+    lockModule();
+    at.poll();
+    unlockModule();
+}
+
+// Single-core mode reads the module when the UART driver has reported bytes
+// (listenForData), while a reply is awaited (for its timeout), and at least
+// every MAUWB_TAG_IDLE_WAIT_MS. The ranging task is woken by the same event.
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline bool MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::rxDue(unsigned long now) {
+#if defined(ARDUINO_ARCH_ESP32)
+#if MAUWB_TAG_TASKS
+    if (rangingTask) return true;
+#endif
+    if (!rxEvent && !at.isBusy() && now - lastRxRead < MAUWB_TAG_IDLE_WAIT_MS) {
+        return false;
+    }
+    rxEvent = false;
+    lastRxRead = now;
+#endif
+    return true;
+}
+
+// Flag the driver's receive events (FIFO threshold or a pause in the line)
+// for rxDue(); startDualCore() replaces this with a task notification
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::listenForData() {
+#if defined(ARDUINO_ARCH_ESP32)
+    uwbSerial->onReceive([this]() { rxEvent = true; });
+#endif
+}
+
+// Lines from the module that are neither command replies nor range reports
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::handleModuleLine(const char* line, uint8_t length, void* context) {
+    MaUWB_BasicTAG* tag = static_cast<MaUWB_BasicTAG*>(context);
+    if (tag->debugEnabled) {
+        tag->logger.log(LOG_MODULE, "UWB: %s", line);
     }
 }
 
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::handleModuleReport(const MaUWB_RangeReport& report, void* context) {
+    static_cast<MaUWB_BasicTAG*>(context)->handleRangeReport(report);
+}
+
 // Forward serial commands from user
-inline void MaUWB_TAG::forwardSerialCommands() {
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::forwardSerialCommands() {
     // This is handled in the main loop example
 }
 
-// Parse range data from UWB module
-inline void MaUWB_TAG::parseRangeData(String data) {
-    if (data.indexOf("+RANGE_CDS_ALL:") >= 0) {
-        // Parse format: +RANGE_CDS_ALL:7,AN0,1.23,AN1,2.34,AN2,3.45,AN3,4.56
-        int startIndex = data.indexOf(':') + 1;
-        String rangeData = data.substring(startIndex);
-        
-        // Split by commas
-        int commaIndex = 0;
-        int lastComma = -1;
-        int anchorIndex = 0;
-        
-        for (int i = 0; i < rangeData.length() && anchorIndex < numAnchors; i++) {
-            if (rangeData.charAt(i) == ',' || i == rangeData.length() - 1) {
-                commaIndex++;
-                
-                if (commaIndex % 2 == 0) { // Even comma indices have distance values
-                    String distanceStr = rangeData.substring(lastComma + 1, i == rangeData.length() - 1 ? i + 1 : i);
-                    float distance = distanceStr.toFloat();
-                    
-                    if (distance > 0 && anchorIndex < numAnchors) {
-                        distances[anchorIndex] = distance;
-                        onDistanceUpdate(anchorIndex, distance);
-                        anchorIndex++;
-                    }
-                }
-                lastComma = i;
-            }
-        }
-        
-        calculatePosition();
-        newData = true;
-        
-        if (debugEnabled) {
-            Serial.print("Distances: ");
-            for (int i = 0; i < numAnchors; i++) {
-                Serial.print("AN" + String(i) + ":" + String(distances[i]) + " ");
-            }
-            Serial.println();
+// Apply a decoded range report from the UWB module
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::handleRangeReport(const MaUWB_RangeReport& report) {
+    scheduler.reportReceived(millis());
+    linkStats.update(report);
+    
+    // range[n] is anchor n; slots the mask leaves out read 0 rather than a
+    // stale value
+    for (uint8_t anchorIndex = 0; anchorIndex < anchorCount(); anchorIndex++) {
+        float distance = report.answered(anchorIndex) ? report.range[anchorIndex] : 0;
+        distances[anchorIndex] = distance;
+        rssi[anchorIndex] = distance > 0 && anchorIndex < report.rssiCount ? report.rssi[anchorIndex] : 0;
+        if (distance > 0) {
+            this->onDistanceUpdate(anchorIndex, distance);
         }
     }
+    
+    bool positionFound = calculatePosition();
+    newData = true;
+    
+    if (debugEnabled) {
+        logSample(makeSample(positionFound));
+    }
+    
+#if MAUWB_TAG_TASKS
+    if (rangingTask) {
+        // The display task shows it and drains the log
+        samples.push(makeSample(positionFound));
+    }
+#endif
 }
 
-// Calculate position using trilateration
-inline void MaUWB_TAG::calculatePosition() {
+// Calculate position by least squares over all anchors with a range
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline bool MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::calculatePosition() {
     float newX = 0, newY = 0;
-    bool positionFound = false;
-    
-    // Try different combinations of three anchors for trilateration
-    for (int i = 0; i < numAnchors - 2 && !positionFound; i++) {
-        for (int j = i + 1; j < numAnchors - 1 && !positionFound; j++) {
-            for (int k = j + 1; k < numAnchors && !positionFound; k++) {
-                if (distances[i] > 0 && distances[j] > 0 && distances[k] > 0) {
-                    if (calculatePositionFromTriplet(i, j, k, newX, newY)) {
-                        // Validate position is reasonable
-                        if (newX >= -100 && newX <= 500 && newY >= -100 && newY <= 700) {
-                            currentX = newX;
-                            currentY = newY;
-                            updatePositionHistory(newX, newY);
-                            onPositionUpdate(newX, newY);
-                            positionFound = true;
-                        }
-                    }
+    const float* ranges = distances;
+    float kept[MAX_ANCHORS];
+    excludedAnchors = 0;
+    
+    // An anchor that only answers now and then is usually at the edge of
+    // its link, and its ranges are the least reliable ones
+    if (minAnchorDelivery > 0) {
+        uint8_t reliable = linkStats.getReliableMask(minAnchorDelivery);
+        uint8_t remaining = 0;
+        for (uint8_t i = 0; i < anchorCount(); i++) {
+            kept[i] = distances[i];
+            if (distances[i] <= 0) continue;
+            if (i < MAUWB_RANGE_SLOTS && (reliable & (1 << i))) {
+                remaining++;
+            } else {
+                excludedAnchors |= 1 << i;
+                kept[i] = 0;
+            }
+        }
+        if (excludedAnchors && remaining >= 3) {
+            ranges = kept;
+        } else {
+            excludedAnchors = 0;
+        }
+    }
+    
+    // Least-squares fix over all anchors, or the first plausible triplet.
+    // Weighting keeps a blocked anchor from dragging the fix off.
+    if (anchorWeighting) {
+        solver.computeWeights(ranges, rssi, weights);
+    }
+    bool positionFound = solver.solveChecked(ranges, newX, newY, anchorWeighting ? weights : nullptr);
+    
+#if MAUWB_LATENCY
+    const MaUWB_LineTiming& line = at.getLineTiming();
+    uint32_t solved = micros();
+    latency[LATENCY_RECEIVE].record(line.complete - line.firstByte);
+    latency[LATENCY_PARSE].record(line.parsed - line.complete);
+    latency[LATENCY_SOLVE].record(solved - line.parsed);
+#endif
+    
+    if (positionFound) {
+        applyFilter(newX, newY);
+#if MAUWB_LATENCY
+        uint32_t filtered = micros();
+#endif
+#if MAUWB_TAG_ZONES
+        zones.update(currentX, currentY);
+#endif
+        if (streaming) {
+            MaUWB_StreamSample sample;
+            sample.time = millis();
+            sample.x = MaUWB_StreamCodec::toCm(currentX);
+            sample.y = MaUWB_StreamCodec::toCm(currentY);
+            sample.z = MaUWB_StreamCodec::toCm(getPositionZ());
+            sample.mask = 0;
+            for (uint8_t i = 0; i < anchorCount() && i < 8; i++) {
+                if (ranges[i] > 0 && !(getRejectedAnchors() & (1 << i))) {
+                    sample.mask |= 1 << i;
                 }
             }
+            streamQueue.push(sample);
         }
+        this->onPositionUpdate(currentX, currentY);
+#if MAUWB_LATENCY
+        uint32_t done = micros();
+        latency[LATENCY_FILTER].record(filtered - solved);
+        latency[LATENCY_CALLBACK].record(done - filtered);
+        latency[LATENCY_TOTAL].record(done - line.firstByte);
+#endif
     }
     
-    if (debugEnabled && positionFound) {
-        Serial.println("Position: (" + String(currentX) + ", " + String(currentY) + ")");
+    return positionFound;
+}
+
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::setStreamSink(MaUWB_StreamSink* sink) {
+    lockModule();
+    streaming = false;
+    streamer.begin(sink, tagIndex);
+    streaming = sink != nullptr;
+    unlockModule();
+}
+
+// Batch queued fixes and send full or aged packets
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::serviceStream() {
+    if (!streaming) {
+        return;
+    }
+    MaUWB_StreamSample sample;
+    while (streamQueue.pop(sample)) {
+        streamer.add(sample);
     }
+    streamer.poll(millis());
 }
 
-// Calculate position from three anchor points using trilateration
-inline bool MaUWB_TAG::calculatePositionFromTriplet(int a1, int a2, int a3, float& x, float& y) {
-    float x1 = anchorX[a1], y1 = anchorY[a1], r1 = distances[a1];
-    float x2 = anchorX[a2], y2 = anchorY[a2], r2 = distances[a2];
-    float x3 = anchorX[a3], y3 = anchorY[a3], r3 = distances[a3];
+// Run a raw fix through the selected filter stage
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::applyFilter(float x, float y) {
+    unsigned long now = millis();
+    bool firstFix = lastFixTime == 0;
+    float dt = (now - lastFixTime) / 1000.0f;
+    lastFixTime = now;
+    float lastX = currentX;
+    float lastY = currentY;
     
-    // Trilateration algorithm
-    float A = 2 * (x2 - x1);
-    float B = 2 * (y2 - y1);
-    float C = pow(r1, 2) - pow(r2, 2) - pow(x1, 2) + pow(x2, 2) - pow(y1, 2) + pow(y2, 2);
-    float D = 2 * (x3 - x2);
-    float E = 2 * (y3 - y2);
-    float F = pow(r2, 2) - pow(r3, 2) - pow(x2, 2) + pow(x3, 2) - pow(y2, 2) + pow(y3, 2);
+    rawX = x;
+    rawY = y;
     
-    float denominator = A * E - B * D;
-    
-    if (abs(denominator) < 0.0001) {
-        return false; // Points are collinear
+    // Innovation: the fix against the filter's prediction for it, before
+    // the update; the Kalman filter carries on at its velocity, the others
+    // stay where they were
+    float predictedX = lastX;
+    float predictedY = lastY;
+    if (filterMode == MAUWB_FILTER_KALMAN) {
+        predictedX += kalmanFilter.getVelocityX() * dt;
+        predictedY += kalmanFilter.getVelocityY() * dt;
     }
+    float ix = x - predictedX;
+    float iy = y - predictedY;
+    float innovation = sqrtf(ix * ix + iy * iy);
     
-    x = (C * E - F * B) / denominator;
-    y = (A * F - D * C) / denominator;
+    switch (filterMode) {
+        case MAUWB_FILTER_MOVING_AVERAGE:
+            movingAverage.update(x, y, dt, currentX, currentY);
+            break;
+        case MAUWB_FILTER_KALMAN:
+            kalmanFilter.update(x, y, dt, currentX, currentY);
+            break;
+        case MAUWB_FILTER_CUSTOM:
+            if (customFilter) {
+                customFilter->update(x, y, dt, currentX, currentY);
+                break;
+            }
+            // No filter set: fall through to raw
+        case MAUWB_FILTER_NONE:
+        default:
+            currentX = x;
+            currentY = y;
+            break;
+    }
     
-    return true;
+    // The first fix has no previous one: its innovation would be the whole
+    // distance from the origin
+    if (adaptiveRate && !firstFix) {
+        updateMotion(lastX, lastY, dt, innovation);
+    }
+}
+
+// Speed from the Kalman velocity, or from the step of the filtered position
+// with the other filters
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::updateMotion(float lastX, float lastY, float dt,
+                                                                          float innovation) {
+    float speed;
+    if (filterMode == MAUWB_FILTER_KALMAN) {
+        float vx = kalmanFilter.getVelocityX();
+        float vy = kalmanFilter.getVelocityY();
+        speed = sqrtf(vx * vx + vy * vy);
+    } else if (dt > 0) {
+        float dx = currentX - lastX;
+        float dy = currentY - lastY;
+        speed = sqrtf(dx * dx + dy * dy) / dt;
+    } else {
+        speed = 0;
+    }
+    if (motion.update(millis(), speed, innovation)) {
+        scheduler.setMinPollInterval(motion.getInterval());
+        if (debugEnabled) {
+            logger.log(LOG_SAMPLE, "Ranging every %lu ms (%s)", motion.getInterval(),
+                       motion.isMoving() ? "moving" : "at rest");
+        }
+    }
+}
+
+// At rest the screen only needs to follow the ranging rate
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline unsigned long MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::displayInterval() const {
+    if (adaptiveRate && motion.getInterval() > displayUpdateInterval) {
+        return motion.getInterval();
+    }
+    return displayUpdateInterval;
+}
+
+// Light-sleep the CPU until shortly before the next poll. Only at rest,
+// with no reply awaited and nothing waiting in the UART, log or stream:
+// a polled module stays quiet until it is asked.
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::sleepUntilPoll() {
+    if (!lightSleep || !adaptiveRate || motion.isMoving() || streaming) {
+        return;
+    }
+    sleeper.sleepUntilPoll(scheduler, *uwbSerial, !at.isBusy() && logger.pending() == 0);
+}
+
+// Poll at the motion-adaptive interval instead of taking auto-reports
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::setAdaptiveRate(bool enable, unsigned long slowMs) {
+    adaptiveRate = enable;
+    motion.configure(refreshRate, slowMs);
 }
 
-// Update position history for filtering
-inline void MaUWB_TAG::updatePositionHistory(float x, float y) {
-    positionXHistory[positionHistoryIndex] = x;
-    positionYHistory[positionHistoryIndex] = y;
+// Snapshot of the current fix and distances
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline typename MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::Sample MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::makeSample(bool valid) const {
+    Sample sample;
+    sample.x = currentX;
+    sample.y = currentY;
+    sample.rawX = rawX;
+    sample.rawY = rawY;
+    sample.valid = valid;
+    sample.anchorCount = anchorCount() < DISPLAY_ANCHOR_ROWS ? anchorCount() : DISPLAY_ANCHOR_ROWS;
+    sample.rejected = valid ? solver.getRejectedMask() : 0;
+    for (uint8_t i = 0; i < DISPLAY_ANCHOR_ROWS; i++) {
+        sample.distances[i] = i < anchorCount() ? distances[i] : 0;
+    }
+    sample.time = millis();
+    return sample;
+}
+
+// Queue the sample for the log; formatted when the log is drained
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::logSample(const Sample& sample) {
+    const float* d = sample.distances;
+    switch (sample.anchorCount < DISPLAY_ANCHOR_ROWS ? sample.anchorCount : DISPLAY_ANCHOR_ROWS) {
+        case 1: logger.log(LOG_SAMPLE, "Distances: AN0:%.2f", d[0]); break;
+        case 2: logger.log(LOG_SAMPLE, "Distances: AN0:%.2f AN1:%.2f", d[0], d[1]); break;
+        case 3: logger.log(LOG_SAMPLE, "Distances: AN0:%.2f AN1:%.2f AN2:%.2f", d[0], d[1], d[2]); break;
+        case 4: logger.log(LOG_SAMPLE, "Distances: AN0:%.2f AN1:%.2f AN2:%.2f AN3:%.2f", d[0], d[1], d[2], d[3]); break;
+        default: break;
+    }
     
-    positionHistoryIndex = (positionHistoryIndex + 1) % positionHistoryLength;
+    if (sample.valid) {
+        logger.log(LOG_SAMPLE, "Position: (%.2f, %.2f)", sample.x, sample.y);
+    }
     
-    if (positionHistoryIndex == 0) {
-        positionHistoryFilled = true;
+    if (sample.rejected) {
+        logger.log(LOG_SAMPLE, "Rejected: anchor mask 0x%04x", sample.rejected);
     }
 }
 
-// Update OLED display
-inline void MaUWB_TAG::updateDisplay() {
-    if (!displayInitialized) return;
+// Draw the static parts of the status screen and register its fields
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::drawDisplayLayout(uint8_t anchorRows) {
+    layoutAnchorRows = anchorRows;
     
     display->clearDisplay();
     display->setTextSize(1);
     display->setTextColor(WHITE);
     display->setCursor(0, 0);
+    display->print("MaUWB-TAG ");
+    display->print(tagIndex);
+    display->setCursor(0, 8);
+    display->print("Position:");
+    display->setCursor(0, 16);
+    display->print("X: ");
+    display->setCursor(0, 24);
+    display->print("Y: ");
     
-    display->println("MaUWB-TAG " + String(tagIndex));
-    display->println("Position:");
-    display->println("X: " + String(currentX, 1) + " cm");
-    display->println("Y: " + String(currentY, 1) + " cm");
+    screen.clearFields();
+    xField = screen.addField(18, 16, 12);
+    yField = screen.addField(18, 24, 12);
     
-    // Display anchor distances
-    for (int i = 0; i < min(numAnchors, 4); i++) {
-        displayAnchorDistance(0, 35 + i * 7, i, distances[i]);
+    for (uint8_t i = 0; i < layoutAnchorRows; i++) {
+        display->setCursor(0, 32 + i * 8);
+        display->print("AN");
+        display->print(i);
+        display->print(": ");
+        distanceFields[i] = screen.addField(30, 32 + i * 8, 12);
     }
     
-    display->display();
-}
-
-// Display anchor distance on OLED
-inline void MaUWB_TAG::displayAnchorDistance(int x, int y, int anchorNum, float distance) {
-    display->setCursor(x, y);
-    display->print("AN" + String(anchorNum) + ": " + String(distance, 1) + "m");
+    if (displayLogo) {
+        screen.drawBitmap(*displayLogo, display->width() - displayLogo->width, 0);
+    }
+    screen.pushAll();
 }
 
-// Send command to UWB module and wait for response
-inline String MaUWB_TAG::sendCommand(String command, const int timeout, boolean debug) {
-    Serial.println(command);
+// Update OLED display; only fields whose text changed are sent
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::updateDisplay(const Sample& sample) {
+    if (!displayInitialized) return;
     
-    unsigned long start = millis();
-    String response = "";
-    
-    while (millis() - start < timeout) {
-        while (Serial.available()) {
-            char c = Serial.read();
-            response += c;
-            
-            if (response.endsWith("\n") || response.endsWith("\r\n")) {
-                if (debug) {
-                    Serial.print("Response: " + response);
-                }
-                return response;
-            }
-        }
+    if (sample.anchorCount != layoutAnchorRows) {
+        drawDisplayLayout(sample.anchorCount);
     }
     
-    if (debug) {
-        Serial.println("Timeout waiting for response");
+    screen.setNumber(xField, sample.x, 1, " cm");
+    screen.setNumber(yField, sample.y, 1, " cm");
+    
+    for (uint8_t i = 0; i < layoutAnchorRows; i++) {
+        if (sample.distances[i] > 0) {
+            screen.setNumber(distanceFields[i], sample.distances[i], 1, " cm");
+        } else {
+            screen.setText(distanceFields[i], "---");
+        }
     }
     
-    return "";
+    screen.push();
+}
+
+// Queue a command for the UWB module
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline bool MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::sendCommand(const char* command, unsigned long timeoutMs,
+                                   MaUWB_AT::ReplyCallback callback, void* context,
+                                   const char* expect) {
+    lockModule();
+    bool queued = at.send(command, timeoutMs, callback, context, expect);
+    unlockModule();
+    return queued;
+}
+
+// Send a command and wait until the module answers or the timeout expires
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline MaUWB_AT::Result MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::sendCommandAndWait(const char* command, unsigned long timeoutMs) {
+    lockModule();
+    MaUWB_AT::Result result = at.sendAndWait(command, timeoutMs);
+    unlockModule();
+    return result;
 }
 
 // Configuration methods
-inline void MaUWB_TAG::setDisplayRefreshRate(unsigned long intervalMs) {
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::setDisplayRefreshRate(unsigned long intervalMs) {
     displayUpdateInterval = intervalMs;
 }
 
-inline void MaUWB_TAG::setMaxTags(uint8_t maxTags) {
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::setMaxTags(uint8_t maxTags) {
     this->maxTags = maxTags;
 }
 
-inline void MaUWB_TAG::setPositionHistoryLength(uint8_t length) {
-    if (length <= MAX_HISTORY) {
+// Moving-average window, and the matching Kalman smoothing (1..MAX_HISTORY)
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::setPositionHistoryLength(uint8_t length) {
+    if (length >= 1 && length <= MAX_HISTORY) {
         positionHistoryLength = length;
-        positionHistoryIndex = 0;
-        positionHistoryFilled = false;
+        movingAverage.setLength(length);
+        kalmanFilter.setSmoothing(length);
+        kalmanFilter.reset();
     }
 }
 
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::setFilterMode(MaUWB_FilterMode mode) {
+    lockModule();
+    filterMode = mode;
+    movingAverage.reset();
+    kalmanFilter.reset();
+    if (customFilter) {
+        customFilter->reset();
+    }
+    unlockModule();
+}
+
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::setFilter(MaUWB_PositionFilter* filter) {
+    lockModule();
+    customFilter = filter;
+    setFilterMode(MAUWB_FILTER_CUSTOM);
+    unlockModule();
+}
+
+// processNoise in cm^2/s^3, measurementNoise (variance of a fix) in cm^2
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::setKalmanNoise(float processNoise, float measurementNoise) {
+    kalmanFilter.setNoise(processNoise, measurementNoise);
+}
+
+// Whether the module pushes range reports on its own (AT+SETRPT). With it
+// on, AT+RANGE is only sent if the reports stop.
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::setAutoReport(bool enable) {
+    autoReport = enable;
+}
+
+// Gauss-Newton steps after the least-squares solve (0 = linear solve only)
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::setRefinementIterations(uint8_t iterations) {
+    solver.setRefinementIterations(iterations);
+}
+
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::setOutlierRejection(uint8_t maxTriplets, float thresholdCm) {
+    lockModule();
+    solver.setOutlierRejection(maxTriplets, thresholdCm);
+    unlockModule();
+}
+
 // Debug control methods
-inline void MaUWB_TAG::enableDebug(bool enable) {
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::enableDebug(bool enable) {
     debugEnabled = enable;
+    at.setDebugOutput(enable ? &Serial : nullptr);
     Serial.println(enable ? "Debug enabled" : "Debug disabled");
 }
 
-inline bool MaUWB_TAG::isDebugEnabled() const {
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline bool MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::isDebugEnabled() const {
     return debugEnabled;
 }
 
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::setCaptureOutput(Print* output) {
+    lockModule();
+    at.setCaptureOutput(output);
+    unlockModule();
+}
+
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::printLinkStats(Print& out) {
+    lockModule();
+    MaUWB_LinkStats link = linkStats;
+    uint8_t excluded = excludedAnchors;
+    unlockModule();
+    
+    char row[80];
+    snprintf(row, sizeof(row), "reports %lu, lost %lu (%.1f%%), restarts %lu",
+             (unsigned long)link.getReports(), (unsigned long)link.getLost(),
+             link.getLossRate() * 100, (unsigned long)link.getRestarts());
+    out.println(row);
+    for (uint8_t i = 0; i < anchorCount() && i < MAUWB_RANGE_SLOTS; i++) {
+        snprintf(row, sizeof(row), "anchor %u: %lu ranges, recent %3.0f%%%s", i,
+                 (unsigned long)link.getDelivered(i), link.getDeliveryRate(i) * 100,
+                 (excluded & (1 << i)) ? ", excluded" : "");
+        out.println(row);
+    }
+    snprintf(row, sizeof(row), "uart %lu baud: %lu overflows, %lu errors, peak %u bytes",
+             (unsigned long)linkBaud, (unsigned long)rxOverflows, (unsigned long)rxErrors, at.getRxHighWater());
+    out.println(row);
+}
+
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::printLatencyStats(Print& out) {
+#if MAUWB_LATENCY
+    static const char* const names[LATENCY_STAGES] = {
+        "receive", "parse", "solve", "filter", "callback", "total"
+    };
+    
+    out.println(F("stage       count    min    avg    p99    max (us)"));
+    for (uint8_t i = 0; i < LATENCY_STAGES; i++) {
+        // Copy under the lock, print without holding up the ranging task
+        lockModule();
+        MaUWB_LatencyHistogram stage = latency[i];
+        unlockModule();
+        
+        char row[64];
+        snprintf(row, sizeof(row), "%-8s %8lu %6lu %6lu %6lu %6lu", names[i],
+                 (unsigned long)stage.getCount(), (unsigned long)stage.getMin(),
+                 (unsigned long)stage.getMean(), (unsigned long)stage.getPercentile(0.99f),
+                 (unsigned long)stage.getMax());
+        out.println(row);
+    }
+#else
+    out.println(F("Latency timers not compiled in (#define MAUWB_LATENCY 1)"));
+#endif
+}
+
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::resetLatencyStats() {
+#if MAUWB_LATENCY
+    lockModule();
+    for (uint8_t i = 0; i < LATENCY_STAGES; i++) {
+        latency[i].reset();
+    }
+    unlockModule();
+#endif
+}
+
 // Anchor management methods
-inline void MaUWB_TAG::setAnchorCount(uint8_t count) {
-    if (count <= MAX_ANCHORS) {
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::setAnchorCount(uint8_t count) {
+    // A fixed count cannot change
+    if (count <= MAX_ANCHORS && (NAnchors == 0 || count == NAnchors)) {
+        lockModule();
         numAnchors = count;
+        solver.setAnchorCount(count);
+        unlockModule();
     }
 }
 
-inline void MaUWB_TAG::setAnchorPosition(uint8_t anchorIndex, float x, float y) {
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::setAnchorPosition(uint8_t anchorIndex, float x, float y, float z) {
     if (anchorIndex < MAX_ANCHORS) {
-        anchorX[anchorIndex] = x;
-        anchorY[anchorIndex] = y;
+        lockModule();
+        solver.setAnchor(anchorIndex, x, y, z);
+        unlockModule();
         
         if (debugEnabled) {
-            Serial.println("Anchor " + String(anchorIndex) + " set to (" + String(x) + ", " + String(y) + ")");
+            Serial.printf("Anchor %u set to (%.2f, %.2f, %.2f)\n", anchorIndex, x, y, z);
         }
     }
 }
 
-inline void MaUWB_TAG::setDefaultAnchors() {
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::setTagHeight(float z) {
+    lockModule();
+    solver.setTagHeight(z);
+    unlockModule();
+}
+
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::setHeightEstimation(bool enable, float minZ, float maxZ) {
+    lockModule();
+    solver.setHeightEstimation(enable, minZ, maxZ);
+    unlockModule();
+}
+
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::setDefaultAnchors() {
     // Default rectangular layout
     setAnchorPosition(0, 0, 0);        // Top-left
     setAnchorPosition(1, 0, 600);      // Bottom-left  
@@ -477,25 +1438,49 @@ inline void MaUWB_TAG::setDefaultAnchors() {
     setAnchorPosition(3, 380, 0);      // Top-right
 }
 
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::applySurvey(const MaUWB_Survey& survey) {
+    lockModule();
+    setAnchorCount(survey.getAnchorCount());
+    for (uint8_t i = 0; i < survey.getAnchorCount() && i < MAX_ANCHORS; i++) {
+        setAnchorPosition(i, survey.getX(i), survey.getY(i), survey.getZ(i));
+    }
+    // Fixes on the old layout would drag the filtered position
+    movingAverage.reset();
+    kalmanFilter.reset();
+    if (customFilter) {
+        customFilter->reset();
+    }
+    unlockModule();
+}
+
 // Data access methods
-inline float MaUWB_TAG::getDistance(uint8_t anchorIndex) const {
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline float MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::getDistance(uint8_t anchorIndex) const {
     if (anchorIndex < MAX_ANCHORS) {
         return distances[anchorIndex];
     }
     return 0.0;
 }
 
-inline bool MaUWB_TAG::hasValidPosition() const {
-    return (currentX != 0 || currentY != 0);
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline float MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::getAnchorWeight(uint8_t anchorIndex) const {
+    if (anchorIndex < anchorCount()) {
+        return anchorWeighting ? weights[anchorIndex] : (distances[anchorIndex] > 0 ? 1.0 : 0.0);
+    }
+    return 0.0;
 }
 
-// Event callbacks (default implementations)
-inline void MaUWB_TAG::onPositionUpdate(float x, float y) {
-    // Default: do nothing, user can override
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline bool MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::hasValidPosition() const {
+    return (currentX != 0 || currentY != 0);
 }
 
-inline void MaUWB_TAG::onDistanceUpdate(uint8_t anchorIndex, float distance) {
-    // Default: do nothing, user can override
+#if MAUWB_TAG_ZONES
+template <uint8_t NAnchors, uint8_t NHistory, class Callbacks>
+inline void MaUWB_BasicTAG<NAnchors, NHistory, Callbacks>::handleZoneChange(uint8_t zone, bool entered, void* context) {
+    static_cast<MaUWB_BasicTAG*>(context)->onZoneChange(zone, entered);
 }
+#endif
 
 #endif // MAUWB_TAG_H
@@ -0,0 +1,232 @@
+/*
+ * MaUWB_Tracker.h - Anchor-side position tracking for many tags at once
+ *
+ * The anchor that talks to the host sees the range reports of every tag
+ * (up to UWB_TAG_COUNT). MaUWB_TagTracker keeps one entry per tid with the
+ * last ranges, sequence number and Kalman filter state, and solves each
+ * report on arrival with a single MaUWB_Solver shared by all tags, so the
+ * anchor layout geometry is prepared once for the whole table. Ranges are
+ * weighted by RSSI and consistency as in MaUWB_Solver::computeWeights().
+ *
+ * Usage:
+ *   MaUWB_TagTracker tracker;
+ *   tracker.getSolver().setAnchorCount(4);
+ *   tracker.getSolver().setAnchor(0, 0, 0);   // ... one per anchor
+ *
+ *   const MaUWB_TagState* tag = tracker.update(report, millis());
+ *   if (tag) { send tag->tid, tag->x, tag->y }
+ *
+ * Each entry is about 120 bytes, so the default 64 tags take ~8 KB of RAM.
+ * Tags not heard from for MAUWB_TRACKER_TIMEOUT_MS free their entry.
+ *
+ * Only needs the C math library, so it also builds on a desktop compiler.
+ */
+
+#ifndef MAUWB_TRACKER_H
+#define MAUWB_TRACKER_H
+
+#include <stdint.h>
+#include "MaUWB_RangeParser.h"
+#include "MaUWB_Solver.h"
+#include "MaUWB_Filter.h"
+
+// Tags tracked at once (match UWB_TAG_COUNT on the anchor)
+#ifndef MAUWB_TRACKER_MAX_TAGS
+#define MAUWB_TRACKER_MAX_TAGS 64
+#endif
+
+// Silence after which a tag's entry is freed for another tid (ms)
+#ifndef MAUWB_TRACKER_TIMEOUT_MS
+#define MAUWB_TRACKER_TIMEOUT_MS 5000
+#endif
+
+struct MaUWB_TagState {
+    uint16_t tid;
+    bool active;                              // Entry in use
+    bool hasFix;                              // x, y hold a position
+    uint16_t seq;                             // Sequence number of the last report
+    uint8_t mask;                             // Anchors in the last report
+    float ranges[MAUWB_SOLVER_MAX_ANCHORS];   // Last ranges per anchor (cm, 0 = no reply)
+    float x, y;                               // Filtered position (cm)
+    float rawX, rawY;                         // Unfiltered fix (cm)
+    uint32_t lastReport;                      // Time of the last report (ms)
+    uint32_t lastFix;                         // Time of the last fix (ms)
+    uint32_t reports;                         // Reports received
+    uint32_t missed;                          // Reports lost, from gaps in seq
+    MaUWB_KalmanFilter filter;
+};
+
+class MaUWB_TagTracker {
+public:
+    MaUWB_TagTracker();
+
+    // Solver holding the anchor layout shared by all tags
+    MaUWB_Solver& getSolver() { return solver; }
+
+    // Run fixes through each tag's Kalman filter (default on)
+    void setFiltering(bool enable) { filtering = enable; }
+
+    // Weight ranges by RSSI and triangle-inequality consistency (default on)
+    void setWeighting(bool enable) { weighting = enable; }
+    void setKalmanNoise(float processNoise, float measurementNoise);
+
+    // Feed one range report received at now (ms). Returns the tag's entry if
+    // the report gave a new fix, nullptr if it did not (too few anchors, no
+    // plausible position, or the table is full).
+    const MaUWB_TagState* update(const MaUWB_RangeReport& report, uint32_t now);
+
+    // Entry for tid, or nullptr if the tag is not being tracked
+    const MaUWB_TagState* find(uint16_t tid) const;
+
+    // Tags heard from within the timeout
+    uint16_t getActiveCount(uint32_t now) const;
+
+    // Reports dropped because all entries were taken
+    uint32_t getTableFullDrops() const { return tableFullDrops; }
+
+    // Forget all tags
+    void clear();
+
+private:
+    MaUWB_TagState tags[MAUWB_TRACKER_MAX_TAGS];
+    MaUWB_Solver solver;
+    bool filtering;
+    bool weighting;
+    float processNoise;
+    float measurementNoise;
+    uint32_t tableFullDrops;
+
+    MaUWB_TagState* lookup(uint16_t tid, uint32_t now);
+    bool isLive(const MaUWB_TagState& tag, uint32_t now) const;
+};
+
+// Implementation
+
+inline MaUWB_TagTracker::MaUWB_TagTracker()
+    : filtering(true), weighting(true), processNoise(2000.0f), measurementNoise(100.0f), tableFullDrops(0) {
+    clear();
+}
+
+inline void MaUWB_TagTracker::clear() {
+    for (uint16_t i = 0; i < MAUWB_TRACKER_MAX_TAGS; i++) {
+        tags[i].active = false;
+        tags[i].hasFix = false;
+        tags[i].filter.reset();
+    }
+    tableFullDrops = 0;
+}
+
+inline void MaUWB_TagTracker::setKalmanNoise(float processNoise, float measurementNoise) {
+    this->processNoise = processNoise;
+    this->measurementNoise = measurementNoise;
+    for (uint16_t i = 0; i < MAUWB_TRACKER_MAX_TAGS; i++) {
+        tags[i].filter.setNoise(processNoise, measurementNoise);
+    }
+}
+
+inline bool MaUWB_TagTracker::isLive(const MaUWB_TagState& tag, uint32_t now) const {
+    return tag.active && (uint32_t)(now - tag.lastReport) < MAUWB_TRACKER_TIMEOUT_MS;
+}
+
+// Find the entry for tid, or claim a free or timed-out one. Tag ids are
+// usually 0..UWB_TAG_COUNT-1, so the entry at tid % size is tried first.
+inline MaUWB_TagState* MaUWB_TagTracker::lookup(uint16_t tid, uint32_t now) {
+    MaUWB_TagState* home = &tags[tid % MAUWB_TRACKER_MAX_TAGS];
+    if (home->active && home->tid == tid) {
+        return home;
+    }
+
+    MaUWB_TagState* freeEntry = isLive(*home, now) ? nullptr : home;
+    for (uint16_t i = 0; i < MAUWB_TRACKER_MAX_TAGS; i++) {
+        MaUWB_TagState& tag = tags[i];
+        if (tag.active && tag.tid == tid) {
+            return &tag;
+        }
+        if (!freeEntry && !isLive(tag, now)) {
+            freeEntry = &tag;
+        }
+    }
+
+    if (freeEntry) {
+        freeEntry->tid = tid;
+        freeEntry->active = true;
+        freeEntry->hasFix = false;
+        freeEntry->seq = 0;
+        freeEntry->reports = 0;
+        freeEntry->missed = 0;
+        freeEntry->filter.setNoise(processNoise, measurementNoise);
+        freeEntry->filter.reset();
+    }
+    return freeEntry;
+}
+
+inline const MaUWB_TagState* MaUWB_TagTracker::update(const MaUWB_RangeReport& report, uint32_t now) {
+    MaUWB_TagState* tag = lookup(report.tid, now);
+    if (!tag) {
+        tableFullDrops++;
+        return nullptr;
+    }
+
+    if (tag->reports > 0) {
+        // The module counts seq in one byte on some firmware; either way a
+        // small forward gap is lost reports, anything else a restart
+        uint8_t gap = (uint8_t)(report.seq - tag->seq);
+        if (gap > 1 && gap < 128) {
+            tag->missed += gap - 1;
+        }
+    }
+    tag->seq = report.seq;
+    tag->mask = report.mask;
+    tag->lastReport = now;
+    tag->reports++;
+
+    float rssi[MAUWB_SOLVER_MAX_ANCHORS];
+    for (uint8_t i = 0; i < MAUWB_SOLVER_MAX_ANCHORS; i++) {
+        tag->ranges[i] = i < MAUWB_RANGE_SLOTS && report.answered(i) ? report.range[i] : 0;
+        rssi[i] = i < report.rssiCount && i < MAUWB_RANGE_SLOTS ? report.rssi[i] : 0;
+    }
+
+    float weights[MAUWB_SOLVER_MAX_ANCHORS];
+    if (weighting) {
+        solver.computeWeights(tag->ranges, rssi, weights);
+    }
+
+    float x, y;
+    if (!solver.solveChecked(tag->ranges, x, y, weighting ? weights : nullptr)) {
+        return nullptr;
+    }
+
+    tag->rawX = x;
+    tag->rawY = y;
+    if (filtering) {
+        float dt = tag->hasFix ? (now - tag->lastFix) / 1000.0f : 0;
+        tag->filter.update(x, y, dt, tag->x, tag->y);
+    } else {
+        tag->x = x;
+        tag->y = y;
+    }
+    tag->hasFix = true;
+    tag->lastFix = now;
+    return tag;
+}
+
+inline const MaUWB_TagState* MaUWB_TagTracker::find(uint16_t tid) const {
+    for (uint16_t i = 0; i < MAUWB_TRACKER_MAX_TAGS; i++) {
+        if (tags[i].active && tags[i].tid == tid) {
+            return &tags[i];
+        }
+    }
+    return nullptr;
+}
+
+inline uint16_t MaUWB_TagTracker::getActiveCount(uint32_t now) const {
+    uint16_t active = 0;
+    for (uint16_t i = 0; i < MAUWB_TRACKER_MAX_TAGS; i++) {
+        if (isLive(tags[i], now)) {
+            active++;
+        }
+    }
+    return active;
+}
+
+#endif // MAUWB_TRACKER_H
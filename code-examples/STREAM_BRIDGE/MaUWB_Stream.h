@@ -0,0 +1,248 @@
+/*
+ * MaUWB_Stream.h - Batched position packets for ESP-NOW / UDP streaming
+ *
+ * A tag that solves its own position can send it over the air instead of
+ * through an anchor's serial port. Fixes are collected into one packet of
+ * up to MAUWB_STREAM_BATCH samples, sent when it is full or its oldest
+ * sample is MAUWB_STREAM_MAX_AGE_MS old:
+ *
+ *   offset  size  field
+ *   0       1     sync byte 0xA7
+ *   1       1     version (1)
+ *   2       2     tid, little endian
+ *   4       2     packet seq; a gap on the host is a lost packet
+ *   6       4     millis() of the first sample on the tag
+ *   10      1     sample count n
+ *   11      9n    per sample: dt (uint16 ms after the first sample),
+ *                 x, y, z (int16 cm), mask of the anchors used
+ *   11+9n   1     CRC-8 (as MaUWB_Frame) over bytes 1..10+9n
+ *
+ * With the default batch of 8 a packet is 84 bytes, well inside an ESP-NOW
+ * frame (250) and a UDP datagram. The transports (MaUWB_StreamSink.h) only
+ * move bytes; a bridge or host decodes the packets with decode().
+ *
+ * Usage:
+ *   MaUWB_EspNowSink radio;           // or MaUWB_UdpSink
+ *   MaUWB_PositionStreamer stream;
+ *   radio.begin();
+ *   stream.begin(&radio, UWB_INDEX);
+ *   // For every fix:
+ *   stream.add(millis(), x, y, z, mask);
+ *   // In loop(), to send a partial batch once it is old enough:
+ *   stream.poll(millis());
+ *
+ * Only needs the C library, so it also builds on a desktop compiler.
+ */
+
+#ifndef MAUWB_STREAM_H
+#define MAUWB_STREAM_H
+
+#include <stdint.h>
+#include <string.h>
+#include "MaUWB_Frame.h"
+
+#define MAUWB_STREAM_SYNC 0xA7
+#define MAUWB_STREAM_VERSION 1
+#define MAUWB_STREAM_HEADER 11
+#define MAUWB_STREAM_SAMPLE_SIZE 9
+
+// Samples per packet (at most 26 to stay in one ESP-NOW frame)
+#ifndef MAUWB_STREAM_BATCH
+#define MAUWB_STREAM_BATCH 8
+#endif
+
+// Oldest a sample may get before a partial packet is sent (ms)
+#ifndef MAUWB_STREAM_MAX_AGE_MS
+#define MAUWB_STREAM_MAX_AGE_MS 100
+#endif
+
+#define MAUWB_STREAM_PACKET_MAX (MAUWB_STREAM_HEADER + MAUWB_STREAM_BATCH * MAUWB_STREAM_SAMPLE_SIZE + 1)
+
+struct MaUWB_StreamSample {
+    uint32_t time;   // millis() of the fix
+    int16_t x;       // cm
+    int16_t y;
+    int16_t z;
+    uint8_t mask;    // Anchors used for the fix
+};
+
+struct MaUWB_StreamPacket {
+    uint16_t tid;
+    uint16_t seq;
+    uint8_t count;
+    MaUWB_StreamSample samples[MAUWB_STREAM_BATCH];
+};
+
+// A transport: sends one packet, returns false if it could not
+class MaUWB_StreamSink {
+public:
+    virtual ~MaUWB_StreamSink() {}
+    virtual bool send(const uint8_t* data, uint16_t length) = 0;
+};
+
+class MaUWB_StreamCodec {
+public:
+    // Write count samples into out (MAUWB_STREAM_PACKET_MAX bytes). Returns the length.
+    static uint16_t encode(uint16_t tid, uint16_t seq, const MaUWB_StreamSample* samples,
+                           uint8_t count, uint8_t* out);
+
+    // Check and decode a received packet of the given length
+    static bool decode(const uint8_t* packet, uint16_t length, MaUWB_StreamPacket& out);
+
+    // Rounded to whole cm and clamped to int16
+    static int16_t toCm(float value);
+
+private:
+    static void put16(uint8_t* out, uint16_t value) {
+        out[0] = (uint8_t)value;
+        out[1] = (uint8_t)(value >> 8);
+    }
+    static uint16_t get16(const uint8_t* in) { return (uint16_t)(in[0] | (in[1] << 8)); }
+};
+
+// Collects fixes and hands full (or aged) packets to a sink
+class MaUWB_PositionStreamer {
+public:
+    MaUWB_PositionStreamer() : sink(nullptr), tid(0), seq(0), count(0), sent(0), failed(0) {}
+
+    void begin(MaUWB_StreamSink* sink, uint16_t tid) {
+        this->sink = sink;
+        this->tid = tid;
+        count = 0;
+    }
+
+    // Queue a fix (cm); sends the packet once it is full
+    void add(uint32_t now, float x, float y, float z, uint8_t mask);
+    void add(const MaUWB_StreamSample& sample);
+
+    // Send a partial packet whose first sample is MAUWB_STREAM_MAX_AGE_MS old
+    void poll(uint32_t now);
+
+    // Send whatever is queued
+    void flush();
+
+    uint32_t getPacketsSent() const { return sent; }
+    uint32_t getSendFailures() const { return failed; }
+
+private:
+    MaUWB_StreamSink* sink;
+    uint16_t tid;
+    uint16_t seq;
+    uint8_t count;
+    MaUWB_StreamSample batch[MAUWB_STREAM_BATCH];
+    uint32_t sent;
+    uint32_t failed;
+};
+
+// Implementation
+
+inline uint16_t MaUWB_StreamCodec::encode(uint16_t tid, uint16_t seq, const MaUWB_StreamSample* samples,
+                                          uint8_t count, uint8_t* out) {
+    if (count > MAUWB_STREAM_BATCH) {
+        count = MAUWB_STREAM_BATCH;
+    }
+    uint32_t base = count ? samples[0].time : 0;
+
+    out[0] = MAUWB_STREAM_SYNC;
+    out[1] = MAUWB_STREAM_VERSION;
+    put16(out + 2, tid);
+    put16(out + 4, seq);
+    put16(out + 6, (uint16_t)base);
+    put16(out + 8, (uint16_t)(base >> 16));
+    out[10] = count;
+
+    uint8_t* sample = out + MAUWB_STREAM_HEADER;
+    for (uint8_t i = 0; i < count; i++, sample += MAUWB_STREAM_SAMPLE_SIZE) {
+        uint32_t dt = samples[i].time - base;
+        put16(sample, dt > 0xFFFF ? 0xFFFF : (uint16_t)dt);
+        put16(sample + 2, (uint16_t)samples[i].x);
+        put16(sample + 4, (uint16_t)samples[i].y);
+        put16(sample + 6, (uint16_t)samples[i].z);
+        sample[8] = samples[i].mask;
+    }
+
+    uint16_t length = MAUWB_STREAM_HEADER + count * MAUWB_STREAM_SAMPLE_SIZE;
+    out[length] = MaUWB_Frame::crc8(out + 1, (uint8_t)(length - 1));
+    return length + 1;
+}
+
+inline bool MaUWB_StreamCodec::decode(const uint8_t* packet, uint16_t length, MaUWB_StreamPacket& out) {
+    if (length < MAUWB_STREAM_HEADER + 1 || packet[0] != MAUWB_STREAM_SYNC ||
+        packet[1] != MAUWB_STREAM_VERSION) {
+        return false;
+    }
+    uint8_t count = packet[10];
+    if (count > MAUWB_STREAM_BATCH ||
+        length != MAUWB_STREAM_HEADER + count * MAUWB_STREAM_SAMPLE_SIZE + 1 ||
+        MaUWB_Frame::crc8(packet + 1, (uint8_t)(length - 2)) != packet[length - 1]) {
+        return false;
+    }
+
+    out.tid = get16(packet + 2);
+    out.seq = get16(packet + 4);
+    out.count = count;
+    uint32_t base = get16(packet + 6) | ((uint32_t)get16(packet + 8) << 16);
+
+    const uint8_t* sample = packet + MAUWB_STREAM_HEADER;
+    for (uint8_t i = 0; i < count; i++, sample += MAUWB_STREAM_SAMPLE_SIZE) {
+        out.samples[i].time = base + get16(sample);
+        out.samples[i].x = (int16_t)get16(sample + 2);
+        out.samples[i].y = (int16_t)get16(sample + 4);
+        out.samples[i].z = (int16_t)get16(sample + 6);
+        out.samples[i].mask = sample[8];
+    }
+    return true;
+}
+
+inline int16_t MaUWB_StreamCodec::toCm(float value) {
+    if (!(value > -32767.0f)) return -32767;   // Also NaN
+    if (value > 32767.0f) return 32767;
+    return (int16_t)(value < 0 ? value - 0.5f : value + 0.5f);
+}
+
+inline void MaUWB_PositionStreamer::add(uint32_t now, float x, float y, float z, uint8_t mask) {
+    MaUWB_StreamSample sample;
+    sample.time = now;
+    sample.x = MaUWB_StreamCodec::toCm(x);
+    sample.y = MaUWB_StreamCodec::toCm(y);
+    sample.z = MaUWB_StreamCodec::toCm(z);
+    sample.mask = mask;
+    add(sample);
+}
+
+inline void MaUWB_PositionStreamer::add(const MaUWB_StreamSample& sample) {
+    if (!sink) {
+        return;
+    }
+    // dt is 16 bit: a sample too far after the first starts a new packet
+    if (count > 0 && sample.time - batch[0].time > 0xFFFF) {
+        flush();
+    }
+
+    batch[count++] = sample;
+    if (count >= MAUWB_STREAM_BATCH) {
+        flush();
+    }
+}
+
+inline void MaUWB_PositionStreamer::poll(uint32_t now) {
+    if (count > 0 && now - batch[0].time >= MAUWB_STREAM_MAX_AGE_MS) {
+        flush();
+    }
+}
+
+inline void MaUWB_PositionStreamer::flush() {
+    if (count == 0 || !sink) {
+        return;
+    }
+    uint8_t packet[MAUWB_STREAM_PACKET_MAX];
+    uint16_t length = MaUWB_StreamCodec::encode(tid, seq++, batch, count, packet);
+    if (sink->send(packet, length)) {
+        sent++;
+    } else {
+        failed++;
+    }
+    count = 0;
+}
+
+#endif // MAUWB_STREAM_H
@@ -0,0 +1,224 @@
+/*
+ESP32S3 position stream bridge
+
+Receives the position packets tags stream over ESP-NOW (MaUWB_Stream.h,
+MaUWB_TAG::setStreamSink() with a MaUWB_EspNowSink) and writes every sample
+to the USB port in the anchors' position format, so the p5 sketches can
+draw dozens of tags through one board. Any ESP32-S3 works; no UWB module
+or access point is needed.
+
+Host output: {"id":1,"x":250,"y":610} per sample, or 9-byte binary position
+frames (MaUWB_Frame.h). "#bin" / "#json" from the host switch it, "#stats"
+prints packets and losses per tag. Other '#' commands (the p5 sketches send
+their anchor layout) are ignored.
+*/
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_now.h>
+#include <esp_wifi.h>
+#include "MaUWB_Frame.h"
+#include "MaUWB_Stream.h"
+#include "MaUWB_SpscQueue.h"
+
+// WiFi channel the tags send on (MaUWB_EspNowSink::begin())
+#define WIFI_CHANNEL 1
+
+// MAUWB_OUTPUT_JSON lines or MAUWB_OUTPUT_BINARY position frames
+#define OUTPUT_FORMAT MAUWB_OUTPUT_JSON
+
+// Tags with their own statistics (tid 0..MAX_TAGS-1)
+#define MAX_TAGS 64
+
+#define SERIAL_LOG Serial
+
+// One packet as received; the WiFi task pushes, loop() pops
+struct ReceivedPacket {
+    uint8_t length;
+    uint8_t data[MAUWB_STREAM_PACKET_MAX];
+};
+MaUWB_SpscQueue<ReceivedPacket, 16> received;
+
+// Per tag: packet seq, packets received and lost (seq gaps), and a running
+// sample counter for the binary frames' seq byte
+struct TagStats {
+    bool seen;
+    uint16_t lastSeq;
+    uint32_t packets;
+    uint32_t lost;
+    uint8_t sampleSeq;
+};
+TagStats tags[MAX_TAGS];
+uint32_t badPackets = 0;
+
+uint8_t outputFormat = OUTPUT_FORMAT;
+
+// "#..." command from the host being received
+char hostCommand[24];
+uint8_t hostCommandLength = 0;
+bool inHostCommand = false;
+
+// Runs in the WiFi task: copy the packet out and return
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+void onReceive(const esp_now_recv_info_t *info, const uint8_t *data, int length)
+#else
+void onReceive(const uint8_t *mac, const uint8_t *data, int length)
+#endif
+{
+    if (length <= 0 || length > MAUWB_STREAM_PACKET_MAX)
+    {
+        return;
+    }
+    ReceivedPacket packet;
+    packet.length = length;
+    memcpy(packet.data, data, length);
+    received.push(packet);
+}
+
+void setup()
+{
+    SERIAL_LOG.begin(115200);
+
+    WiFi.mode(WIFI_STA);
+    esp_wifi_set_channel(WIFI_CHANNEL, WIFI_SECOND_CHAN_NONE);
+    if (esp_now_init() != ESP_OK)
+    {
+        SERIAL_LOG.println(F("ESP-NOW init failed"));
+        for (;;)
+            ; // Don't proceed, loop forever
+    }
+    esp_now_register_recv_cb(onReceive);
+
+    SERIAL_LOG.print(F("Stream bridge on channel "));
+    SERIAL_LOG.print(WIFI_CHANNEL);
+    SERIAL_LOG.print(F(", MAC "));
+    SERIAL_LOG.println(WiFi.macAddress());
+}
+
+void loop()
+{
+    handleHostInput();
+
+    ReceivedPacket packet;
+    MaUWB_StreamPacket decoded;
+    while (received.pop(packet))
+    {
+        if (!MaUWB_StreamCodec::decode(packet.data, packet.length, decoded))
+        {
+            badPackets++;
+            continue;
+        }
+        countPacket(decoded);
+        for (uint8_t i = 0; i < decoded.count; i++)
+        {
+            send_position(decoded.tid, decoded.samples[i]);
+        }
+    }
+}
+
+void countPacket(const MaUWB_StreamPacket &packet)
+{
+    if (packet.tid >= MAX_TAGS)
+    {
+        return;
+    }
+    TagStats &tag = tags[packet.tid];
+    uint16_t step = packet.seq - tag.lastSeq;
+    if (tag.seen && step > 1 && step < 0x8000)
+    {
+        tag.lost += step - 1;
+    }
+    tag.seen = true;
+    tag.lastSeq = packet.seq;
+    tag.packets++;
+}
+
+void send_position(uint16_t tid, const MaUWB_StreamSample &sample)
+{
+    if (outputFormat == MAUWB_OUTPUT_BINARY)
+    {
+        MaUWB_PositionReport position;
+        position.tid = tid;
+        position.seq = tid < MAX_TAGS ? tags[tid].sampleSeq++ : 0;
+        position.x = sample.x;
+        position.y = sample.y;
+        position.mask = sample.mask;
+
+        uint8_t frame[MAUWB_POSITION_LENGTH];
+        SERIAL_LOG.write(frame, MaUWB_Frame::encodePosition(position, frame));
+        return;
+    }
+
+    SERIAL_LOG.print("{\"id\":");
+    SERIAL_LOG.print(tid);
+    SERIAL_LOG.print(",\"x\":");
+    SERIAL_LOG.print(sample.x);
+    SERIAL_LOG.print(",\"y\":");
+    SERIAL_LOG.print(sample.y);
+    SERIAL_LOG.println("}");
+}
+
+void printStats()
+{
+    char row[64];
+    for (uint8_t i = 0; i < MAX_TAGS; i++)
+    {
+        if (!tags[i].seen)
+            continue;
+        uint32_t sent = tags[i].packets + tags[i].lost;
+        snprintf(row, sizeof(row), "tag %u: %lu packets, %lu lost (%.1f%%)", i,
+                 (unsigned long)tags[i].packets, (unsigned long)tags[i].lost,
+                 sent ? 100.0f * tags[i].lost / sent : 0.0f);
+        SERIAL_LOG.println(row);
+    }
+    SERIAL_LOG.print(F("bad packets "));
+    SERIAL_LOG.print(badPackets);
+    SERIAL_LOG.print(F(", queue full "));
+    SERIAL_LOG.println(received.getDropped());
+}
+
+// Commands from the host start with '#' and end with a newline
+void handleHostInput()
+{
+    while (SERIAL_LOG.available() > 0)
+    {
+        char c = SERIAL_LOG.read();
+
+        if (!inHostCommand && c == '#')
+        {
+            inHostCommand = true;
+            hostCommandLength = 0;
+            continue;
+        }
+
+        if (inHostCommand)
+        {
+            if (c == '\n' || c == '\r')
+            {
+                hostCommand[hostCommandLength] = '\0';
+                runHostCommand(hostCommand);
+                inHostCommand = false;
+            }
+            else if (hostCommandLength < sizeof(hostCommand) - 1)
+            {
+                hostCommand[hostCommandLength++] = c;
+            }
+        }
+    }
+}
+
+void runHostCommand(const char *command)
+{
+    if (strcmp(command, "bin") == 0)
+    {
+        outputFormat = MAUWB_OUTPUT_BINARY;
+    }
+    else if (strcmp(command, "json") == 0)
+    {
+        outputFormat = MAUWB_OUTPUT_JSON;
+    }
+    else if (strcmp(command, "stats") == 0)
+    {
+        printStats();
+    }
+}
@@ -0,0 +1,228 @@
+/*
+ * MaUWB_Capture.h - Record and replay raw module output for offline tuning
+ *
+ * Synthetic AT+RANGE strings never have the dropouts, zero fields and mask
+ * changes of a real room. A capture keeps every line the module sent, as
+ * received, with a microsecond timestamp, so it can be replayed later into
+ * the parser and solver on a desktop.
+ *
+ * Each line becomes one record:
+ *
+ *   offset  size  field
+ *   0       1     sync byte 0xA7
+ *   1       1-5   microseconds since the previous record, LEB128 varint
+ *   ..      1     line length n (without CR/LF)
+ *   ..      n     line bytes
+ *   ..      1     CRC-8 (poly 0x07, init 0, as MaUWB_Frame) over varint..line
+ *
+ * A report line costs its own length plus 4 bytes. Like the frames in
+ * MaUWB_Frame.h the sync byte never occurs in ASCII, so records can share a
+ * serial port with log text: the reader skips everything outside a record
+ * and resynchronises on the next sync byte after a CRC error. A capture
+ * can therefore be saved on the host straight from the port, or written
+ * to any Print (Serial, a LittleFS or SD File). MaUWB_AT::setCaptureOutput()
+ * records everything the module sends; synthTests/host_benchmark has the
+ * capture_replay driver.
+ *
+ * Usage:
+ *   MaUWB_CaptureWriter writer;
+ *   uint8_t record[MAUWB_CAPTURE_RECORD_MAX];
+ *   out.write(record, writer.encode(micros(), line, length, record));
+ *
+ *   MaUWB_CaptureReader reader;
+ *   if (reader.feed(byte) == MaUWB_CaptureReader::RECORD) {
+ *       // reader.timestamp(), reader.line()
+ *   }
+ *
+ * Only needs the C library, so it also builds on a desktop compiler.
+ */
+
+#ifndef MAUWB_CAPTURE_H
+#define MAUWB_CAPTURE_H
+
+#include <stdint.h>
+#include <string.h>
+#include "MaUWB_RangeParser.h"
+
+#define MAUWB_CAPTURE_SYNC 0xA7
+
+// Longest line kept in a record; the parser's line limit
+#define MAUWB_CAPTURE_LINE_MAX (MAUWB_RANGE_LINE_MAX - 1)
+
+// Sync + varint + length + line + CRC
+#define MAUWB_CAPTURE_RECORD_MAX (1 + 5 + 1 + MAUWB_CAPTURE_LINE_MAX + 1)
+
+class MaUWB_CaptureWriter {
+public:
+    MaUWB_CaptureWriter() : started(false), last(0) {}
+
+    // The next record restarts the timestamps at 0
+    void reset() { started = false; }
+
+    // Write a record for a line received at timestamp (micros()) into out
+    // (MAUWB_CAPTURE_RECORD_MAX bytes). Returns its length.
+    uint8_t encode(uint32_t timestamp, const char* line, uint8_t length, uint8_t* out);
+
+    // One byte of the CRC-8 of MaUWB_Frame::crc8(), for the reader
+    static uint8_t crcStep(uint8_t crc, uint8_t byte);
+
+private:
+    bool started;
+    uint32_t last;
+};
+
+class MaUWB_CaptureReader {
+public:
+    enum Event {
+        NONE,     // No record complete yet
+        RECORD,   // A record was decoded into timestamp() / line()
+        BAD_CRC   // A record failed its CRC and was dropped
+    };
+
+    MaUWB_CaptureReader() { reset(); }
+
+    void reset();
+
+    // Feed one byte of a capture or of a raw serial dump
+    Event feed(uint8_t byte);
+
+    // Microseconds since the first record, without 32-bit wrap-around
+    uint64_t timestamp() const { return time; }
+    const char* line() const { return buffer; }
+    uint8_t lineLength() const { return length; }
+
+    uint32_t getRecords() const { return records; }
+    uint32_t getCrcErrors() const { return crcErrors; }
+
+private:
+    enum State { SYNC, DELTA, LENGTH, DATA, CHECK };
+
+    State state;
+    uint32_t delta;
+    uint8_t shift;
+    uint8_t length;
+    uint8_t fill;
+    uint8_t crc;
+    uint64_t time;
+    uint32_t records;
+    uint32_t crcErrors;
+    char buffer[MAUWB_CAPTURE_LINE_MAX + 1];
+
+    void crcByte(uint8_t byte);
+};
+
+// Implementation
+
+inline uint8_t MaUWB_CaptureWriter::crcStep(uint8_t crc, uint8_t byte) {
+    crc ^= byte;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+        crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+inline uint8_t MaUWB_CaptureWriter::encode(uint32_t timestamp, const char* line, uint8_t length,
+                                           uint8_t* out) {
+    if (length > MAUWB_CAPTURE_LINE_MAX) {
+        length = MAUWB_CAPTURE_LINE_MAX;
+    }
+
+    // micros() wraps every ~71 minutes; unsigned subtraction still gives the gap
+    uint32_t delta = started ? timestamp - last : 0;
+    started = true;
+    last = timestamp;
+
+    uint8_t n = 0;
+    out[n++] = MAUWB_CAPTURE_SYNC;
+    do {
+        uint8_t byte = delta & 0x7F;
+        delta >>= 7;
+        out[n++] = delta ? (uint8_t)(byte | 0x80) : byte;
+    } while (delta);
+
+    out[n++] = length;
+    memcpy(out + n, line, length);
+    n += length;
+
+    uint8_t crc = 0;
+    for (uint8_t i = 1; i < n; i++) {
+        crc = crcStep(crc, out[i]);
+    }
+    out[n] = crc;
+    return n + 1;
+}
+
+inline void MaUWB_CaptureReader::reset() {
+    state = SYNC;
+    length = 0;
+    time = 0;
+    records = 0;
+    crcErrors = 0;
+    buffer[0] = '\0';
+}
+
+inline void MaUWB_CaptureReader::crcByte(uint8_t byte) {
+    crc = MaUWB_CaptureWriter::crcStep(crc, byte);
+}
+
+inline MaUWB_CaptureReader::Event MaUWB_CaptureReader::feed(uint8_t byte) {
+    switch (state) {
+    case SYNC:
+        if (byte == MAUWB_CAPTURE_SYNC) {
+            state = DELTA;
+            delta = 0;
+            shift = 0;
+            crc = 0;
+        }
+        return NONE;
+
+    case DELTA:
+        crcByte(byte);
+        if (shift > 28) {
+            // Longer than five bytes: not a record
+            state = SYNC;
+            return NONE;
+        }
+        delta |= (uint32_t)(byte & 0x7F) << shift;
+        shift += 7;
+        if (!(byte & 0x80)) {
+            state = LENGTH;
+        }
+        return NONE;
+
+    case LENGTH:
+        crcByte(byte);
+        if (byte > MAUWB_CAPTURE_LINE_MAX) {
+            state = SYNC;
+            return NONE;
+        }
+        length = byte;
+        fill = 0;
+        state = length > 0 ? DATA : CHECK;
+        return NONE;
+
+    case DATA:
+        crcByte(byte);
+        buffer[fill++] = (char)byte;
+        if (fill == length) {
+            state = CHECK;
+        }
+        return NONE;
+
+    case CHECK:
+        state = SYNC;
+        if (byte != crc) {
+            crcErrors++;
+            length = 0;
+            buffer[0] = '\0';
+            return BAD_CRC;
+        }
+        buffer[length] = '\0';
+        time += delta;
+        records++;
+        return RECORD;
+    }
+    return NONE;
+}
+
+#endif // MAUWB_CAPTURE_H
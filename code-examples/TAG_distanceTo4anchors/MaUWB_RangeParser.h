@@ -0,0 +1,262 @@
+/*
+ * MaUWB_RangeParser.h - Zero-allocation parser for MaUWB range reports
+ *
+ * Decodes the module's range report
+ *
+ *   AT+RANGE=tid:1,mask:04,seq:63,range:(0,0,30,0,0,0,0,0),rssi:(0.00,0.00,-77.93,0.00,0.00,0.00,0.00,0.00)
+ *
+ * into a MaUWB_RangeReport without String, sscanf or heap use. Bytes are fed
+ * one at a time into a fixed line buffer; when a line is complete it is
+ * scanned in place. parse() can also be used on a line that is already
+ * buffered elsewhere.
+ *
+ * Usage:
+ *   MaUWB_RangeParser parser;
+ *   while (SERIAL_AT.available() > 0) {
+ *       if (parser.feed(SERIAL_AT.read()) == MaUWB_RangeParser::REPORT) {
+ *           const MaUWB_RangeReport& report = parser.report();
+ *           // report.range[0] ... report.range[7]
+ *       }
+ *   }
+ *
+ * Only needs the C library, so it also builds on a desktop compiler.
+ */
+
+#ifndef MAUWB_RANGE_PARSER_H
+#define MAUWB_RANGE_PARSER_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Number of anchor slots in a range report
+#ifndef MAUWB_RANGE_SLOTS
+#define MAUWB_RANGE_SLOTS 8
+#endif
+
+// Longest line accepted, including terminator. Longer lines are truncated.
+#ifndef MAUWB_RANGE_LINE_MAX
+#define MAUWB_RANGE_LINE_MAX 192
+#endif
+
+#define MAUWB_RANGE_PREFIX "AT+RANGE="
+
+struct MaUWB_RangeReport {
+    uint16_t tid;                       // Reporting tag id
+    uint8_t mask;                       // Bit n set when anchor n answered
+    uint16_t seq;                       // Report sequence number
+    uint8_t rangeCount;                 // Values found in range:(...)
+    uint8_t rssiCount;                  // Values found in rssi:(...)
+    float range[MAUWB_RANGE_SLOTS];     // Distance per anchor slot in cm (0 = no reply)
+    float rssi[MAUWB_RANGE_SLOTS];      // Signal strength per anchor slot in dBm
+
+    // Whether the anchor slot answered: its mask bit is set and its range is
+    // not 0. Slots stay in place, so range[n] is always anchor n. Firmware
+    // that sends no mask (0) falls back to the range alone.
+    bool answered(uint8_t slot) const {
+        return slot < rangeCount && range[slot] > 0 && (mask == 0 || (mask & (1 << slot)));
+    }
+};
+
+class MaUWB_RangeParser {
+public:
+    enum Event {
+        NONE,    // Line not complete yet
+        LINE,    // A line that is not a range report is available in line()
+        REPORT   // A range report was decoded into report(); line() has the raw text
+    };
+
+    MaUWB_RangeParser() : fill(0), length(0) { buffer[0] = '\0'; clearReport(decoded); }
+
+    // Feed one received byte. '\r' is ignored, '\n' ends the line.
+    Event feed(char c);
+
+    void reset() { fill = 0; length = 0; buffer[0] = '\0'; }
+
+    const char* line() const { return buffer; }
+    uint8_t lineLength() const { return length; }
+    const MaUWB_RangeReport& report() const { return decoded; }
+
+    // Decode a complete, NUL-terminated line. Returns false if the line is not
+    // a range report or has no range list; out is only valid on true.
+    static bool parse(const char* line, MaUWB_RangeReport& out);
+
+private:
+    char buffer[MAUWB_RANGE_LINE_MAX];
+    uint8_t fill;      // Bytes of the line being received
+    uint8_t length;    // Length of the last complete line
+    MaUWB_RangeReport decoded;
+
+    static void clearReport(MaUWB_RangeReport& report);
+    static const char* parseUnsigned(const char* p, uint16_t& value);
+    static const char* parseHex(const char* p, uint8_t& value);
+    static const char* parseDecimal(const char* p, float& value);
+    static const char* parseList(const char* p, float* values, uint8_t& count);
+    static const char* skipField(const char* p);
+};
+
+// Implementation
+
+inline MaUWB_RangeParser::Event MaUWB_RangeParser::feed(char c) {
+    if (c == '\r') {
+        return NONE;
+    }
+
+    if (c != '\n') {
+        if (fill < MAUWB_RANGE_LINE_MAX - 1) {
+            buffer[fill++] = c;
+        }
+        return NONE;
+    }
+
+    if (fill == 0) {
+        return NONE;  // Blank line
+    }
+
+    // The next byte starts a new line; until then line() stays readable
+    buffer[fill] = '\0';
+    length = fill;
+    fill = 0;
+    return parse(buffer, decoded) ? REPORT : LINE;
+}
+
+inline bool MaUWB_RangeParser::parse(const char* line, MaUWB_RangeReport& out) {
+    static const uint8_t prefixLength = sizeof(MAUWB_RANGE_PREFIX) - 1;
+
+    const char* p = strstr(line, MAUWB_RANGE_PREFIX);
+    if (!p) {
+        return false;
+    }
+    p += prefixLength;
+
+    clearReport(out);
+    bool haveRange = false;
+
+    while (*p) {
+        while (*p == ' ' || *p == ',') p++;
+
+        if (strncmp(p, "tid:", 4) == 0) {
+            p = parseUnsigned(p + 4, out.tid);
+        } else if (strncmp(p, "mask:", 5) == 0) {
+            p = parseHex(p + 5, out.mask);
+        } else if (strncmp(p, "seq:", 4) == 0) {
+            p = parseUnsigned(p + 4, out.seq);
+        } else if (strncmp(p, "range:(", 7) == 0) {
+            p = parseList(p + 7, out.range, out.rangeCount);
+            haveRange = true;
+        } else if (strncmp(p, "rssi:(", 6) == 0) {
+            p = parseList(p + 6, out.rssi, out.rssiCount);
+        } else if (*p) {
+            p = skipField(p);
+        }
+    }
+
+    return haveRange;
+}
+
+inline void MaUWB_RangeParser::clearReport(MaUWB_RangeReport& report) {
+    memset(&report, 0, sizeof(report));
+}
+
+inline const char* MaUWB_RangeParser::parseUnsigned(const char* p, uint16_t& value) {
+    uint16_t result = 0;
+    while (*p >= '0' && *p <= '9') {
+        result = result * 10 + (*p - '0');
+        p++;
+    }
+    value = result;
+    return p;
+}
+
+// The mask is hex, with or without a 0x prefix ("04", "0x0F")
+inline const char* MaUWB_RangeParser::parseHex(const char* p, uint8_t& value) {
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        p += 2;
+    }
+
+    uint8_t result = 0;
+    for (;;) {
+        char c = *p;
+        uint8_t digit;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+        else break;
+        result = (result << 4) | digit;
+        p++;
+    }
+    value = result;
+    return p;
+}
+
+// Signed decimal such as "30", "123.4" or "-77.93". Accumulates in integers
+// and divides once, which is cheaper than strtof on the ESP32.
+inline const char* MaUWB_RangeParser::parseDecimal(const char* p, float& value) {
+    bool negative = false;
+    if (*p == '-') {
+        negative = true;
+        p++;
+    } else if (*p == '+') {
+        p++;
+    }
+
+    uint32_t whole = 0;
+    while (*p >= '0' && *p <= '9') {
+        whole = whole * 10 + (*p - '0');
+        p++;
+    }
+
+    uint32_t fraction = 0;
+    uint32_t scale = 1;
+    if (*p == '.') {
+        p++;
+        while (*p >= '0' && *p <= '9') {
+            if (scale < 100000) {  // Extra digits are below float precision here
+                fraction = fraction * 10 + (*p - '0');
+                scale *= 10;
+            }
+            p++;
+        }
+    }
+
+    float result = (float)whole + (float)fraction / (float)scale;
+    value = negative ? -result : result;
+    return p;
+}
+
+// Comma separated values up to the closing ')'. Values beyond
+// MAUWB_RANGE_SLOTS are skipped.
+inline const char* MaUWB_RangeParser::parseList(const char* p, float* values, uint8_t& count) {
+    count = 0;
+    while (*p && *p != ')') {
+        while (*p == ' ') p++;
+
+        const char* start = p;
+        float value;
+        p = parseDecimal(p, value);
+        if (p == start) {
+            // Not a number - skip to the next separator
+            while (*p && *p != ',' && *p != ')') p++;
+        } else if (count < MAUWB_RANGE_SLOTS) {
+            values[count++] = value;
+        }
+
+        while (*p == ' ') p++;
+        if (*p == ',') p++;
+    }
+    if (*p == ')') p++;
+    return p;
+}
+
+// Skip an unknown key:value field, including a parenthesised list
+inline const char* MaUWB_RangeParser::skipField(const char* p) {
+    uint8_t depth = 0;
+    while (*p) {
+        if (*p == '(') depth++;
+        else if (*p == ')' && depth > 0) depth--;
+        else if (*p == ',' && depth == 0) break;
+        p++;
+    }
+    return p;
+}
+
+#endif // MAUWB_RANGE_PARSER_H
@@ -14,6 +14,9 @@ Libraries needed:
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
 #include <Arduino.h>
+#include "MaUWB_AT.h"
+#include "MaUWB_Display.h"
+#include "MaUWB_Scheduler.h"
 
 // Define tag ID
 #define UWB_INDEX 0
@@ -34,6 +37,16 @@ Libraries needed:
 
 Adafruit_SSD1306 display(128, 64, &Wire, -1);
 
+// Status screen; only changed fields are sent over I2C
+MaUWB_Display screen;
+int8_t distanceFields[4];
+
+// Non-blocking AT command link to the UWB module
+MaUWB_AT uwbAt;
+
+// Listens to the module's auto-reports, polls only when they stop
+MaUWB_RangeScheduler rangeScheduler;
+
 // Distance measurements to anchors (using anchors 0-3)
 float dist_to_a0 = 0.0;
 float dist_to_a1 = 0.0;
@@ -44,6 +57,7 @@ float dist_to_a3 = 0.0;
 long last_display_update = 0;
 bool new_data = false;
 bool display_initialized = false;
+bool layout_drawn = false;
 
 void setup()
 {
@@ -56,7 +70,12 @@ void setup()
     SERIAL_LOG.println(F("\n\n----- ESP32S3 UWB TAG - DISTANCE DISPLAY -----"));
     
     // Initialize UWB module serial
+    SERIAL_AT.setRxBufferSize(MAUWB_UART_RX_BUFFER);   // Room for bursts while the display updates
     SERIAL_AT.begin(115200, SERIAL_8N1, IO_RXD2, IO_TXD2);
+    uwbAt.begin(SERIAL_AT);
+    uwbAt.setDebugOutput(&SERIAL_LOG);
+    uwbAt.setLineHandler(handleUwbLine);
+    uwbAt.setReportHandler(handleUwbReport);
     SERIAL_LOG.println(F("Serial2 initialized"));
 
     // Initialize I2C for display
@@ -73,6 +92,7 @@ void setup()
     }
     
     display_initialized = true;
+    screen.begin(&display);
     SERIAL_LOG.println(F("SSD1306 display initialized successfully"));
     
     display.clearDisplay();
@@ -89,26 +109,32 @@ void setup()
     
     // Configure the UWB module as a tag
     SERIAL_LOG.println(F("Configuring UWB module as TAG..."));
-    SERIAL_AT.println("AT");
+    MaUWB_ModuleConfig moduleConfig;
+    moduleConfig.id = UWB_INDEX;
+    moduleConfig.role = 0;              // Tag
+    moduleConfig.rate = 1;              // 6.8 Mbps
+    moduleConfig.filter = 1;
+    moduleConfig.capacity = UWB_TAG_COUNT;
+    moduleConfig.slotMs = MAUWB_SLOT_MS;
+    moduleConfig.extMode = 1;
+    moduleConfig.report = 1;
+    moduleConfig.antennaDelay = 0;      // Calibrated on the anchors
     
-    sendData("AT?", 500, 1);
-    sendData("AT+RESTORE", 1000, 1);
-
-    // Configure as tag (role=0)
-    String cfg = "AT+SETCFG=" + String(UWB_INDEX) + ",0,1,1";  // ID,role,freq,filter
-    SERIAL_LOG.print(F("Config: "));
-    SERIAL_LOG.println(cfg);
-    sendData(cfg, 500, 1);
-    
-    // Set capacity
-    String cap = "AT+SETCAP=" + String(UWB_TAG_COUNT) + ",10,1";  // count,time,mode
-    SERIAL_LOG.print(F("Capacity: "));
-    SERIAL_LOG.println(cap);
-    sendData(cap, 500, 1);
+    // Only rewrites and restarts the module if its stored settings differ
+    MaUWB_AT::Result configured = uwbAt.configure(moduleConfig);
+    if (configured == MaUWB_AT::AT_MATCH) {
+        SERIAL_LOG.println(F("Module already configured"));
+    } else if (configured == MaUWB_AT::AT_TIMEOUT) {
+        SERIAL_LOG.println(F("UWB module not answering"));
+    } else if (configured != MaUWB_AT::AT_OK) {
+        SERIAL_LOG.println(F("UWB module setup failed"));
+    }
     
-    sendData("AT+SETRPT=1", 500, 1);
-    sendData("AT+SAVE", 500, 1);
-    sendData("AT+RESTART", 1000, 1);
+    // One report per TDMA cycle of UWB_TAG_COUNT slots
+    rangeScheduler.configure(UWB_TAG_COUNT, MAUWB_SLOT_MS);
+    rangeScheduler.setAutoReport(true);
+    rangeScheduler.setMinPollInterval(500);  // Fallback polls at most every 500 ms
+    rangeScheduler.begin(millis());
     
     // Show display is ready
     display.clearDisplay();
@@ -121,34 +147,12 @@ void setup()
     display.display();
     
     SERIAL_LOG.println(F("Setup complete - Reading distances to anchors"));
-    delay(1000);  // Give the UWB module time to initialize
 }
 
-String response = "";
-
 void loop()
 {
-    // Check for incoming data from UWB module
-    while (SERIAL_AT.available() > 0)
-    {
-        char c = SERIAL_AT.read();
-
-        if (c == '\r')
-            continue;
-        else if (c == '\n') {
-            if (response.length() > 0) {
-                SERIAL_LOG.print(F("UWB RESPONSE: "));
-                SERIAL_LOG.println(response);
-                
-                // Parse any range information in the response
-                parseRangeData(response);
-                response = "";
-            }
-        }
-        else {
-            response += c;
-        }
-    }
+    // Read data from the UWB module and complete any pending command
+    uwbAt.poll();
 
     // Forward commands from Serial Monitor to UWB module
     while (SERIAL_LOG.available() > 0)
@@ -164,159 +168,92 @@ void loop()
         last_display_update = millis();
     }
     
-    // Request range data periodically (every 500ms)
-    static long last_range_request = 0;
-    if (millis() - last_range_request > 500) {
+    // Request range data only when the module is not reporting on its own
+    unsigned long currentTime = millis();
+    if (rangeScheduler.pollDue(currentTime) && !uwbAt.isBusy()) {
         SERIAL_LOG.println(F("Requesting range data..."));
         
-        // Based on the AT command manual, we only need to send a single request
-        // and the module will return distances to all anchors in one response
-        sendData("AT+RANGE", 100, 1);  // Request all ranges at once
-        
-        last_range_request = millis();
+        // Queue the request; the reply is handled by uwbAt.poll()
+        if (uwbAt.send("AT+RANGE", 100, nullptr, nullptr, "AT+RANGE=")) {
+            rangeScheduler.pollSent(currentTime);
+        }
     }
 }
 
-// Parse range information from UWB module
-void parseRangeData(String data) {
-    // According to the AT command manual, the response format is:
-    // AT+RANGE=tid:x1,mask:x2,seq:x3,range:(x4,x5,x6,x7,x8,x9,x10,x11), rssi:(x12,x13,x14,x15,x16,x17,x18,x19)
-    
-    // Look for "range:(" in the response
-    int range_start = data.indexOf("range:(");
-    if (range_start >= 0) {
-        // Find the end of the range array
-        int range_end = data.indexOf(")", range_start);
-        if (range_end > range_start) {
-            // Extract just the range values
-            String range_values = data.substring(range_start + 7, range_end);
-            SERIAL_LOG.print(F("Range values: "));
-            SERIAL_LOG.println(range_values);
-            
-            // Split the range values by commas
-            int commaIndex = 0;
-            int startIndex = 0;
-            int valueIndex = 0;
-            
-            // We're only interested in the first 4 values (0-3)
-            float distances[4] = {0, 0, 0, 0};
-            
-            // Parse each value
-            while (valueIndex < 4 && startIndex < range_values.length()) {
-                commaIndex = range_values.indexOf(',', startIndex);
-                
-                if (commaIndex == -1) {
-                    // Last value
-                    commaIndex = range_values.length();
-                }
-                
-                String valueStr = range_values.substring(startIndex, commaIndex);
-                distances[valueIndex] = valueStr.toFloat();
-                
-                SERIAL_LOG.print(F("Distance "));
-                SERIAL_LOG.print(valueIndex);
-                SERIAL_LOG.print(F(": "));
-                SERIAL_LOG.println(distances[valueIndex]);
-                
-                valueIndex++;
-                startIndex = commaIndex + 1;
-            }
-            
-            // Update our distance variables
-            dist_to_a0 = distances[0];
-            dist_to_a1 = distances[1];
-            dist_to_a2 = distances[2];
-            dist_to_a3 = distances[3];
-            
-            new_data = true;
-        }
-    }
+// Handle a line from the UWB module that is neither a command reply nor a range report
+void handleUwbLine(const char* line, uint8_t length, void* context)
+{
+    SERIAL_LOG.print(F("UWB RESPONSE: "));
+    SERIAL_LOG.println(line);
 }
 
-// Update the display with the latest distance measurements
-void updateDistanceDisplay() {
-    if (!display_initialized) {
-        return;
+// Handle a range report decoded by the AT engine
+// AT+RANGE=tid:x1,mask:x2,seq:x3,range:(x4,x5,x6,x7,x8,x9,x10,x11),rssi:(x12,x13,x14,x15,x16,x17,x18,x19)
+void handleUwbReport(const MaUWB_RangeReport& report, void* context)
+{
+    rangeScheduler.reportReceived(millis());
+    
+    for (uint8_t i = 0; i < 4; i++) {
+        SERIAL_LOG.print(F("Distance "));
+        SERIAL_LOG.print(i);
+        SERIAL_LOG.print(F(": "));
+        SERIAL_LOG.println(report.range[i]);
     }
     
-    display.clearDisplay();
+    // We're only interested in the first 4 values (0-3). Each slot is one
+    // anchor; slots not in the mask or missing read 0
+    dist_to_a0 = report.answered(0) ? report.range[0] : 0;
+    dist_to_a1 = report.answered(1) ? report.range[1] : 0;
+    dist_to_a2 = report.answered(2) ? report.range[2] : 0;
+    dist_to_a3 = report.answered(3) ? report.range[3] : 0;
+    
+    new_data = true;
+}
 
-    // Display header
+// Draw the static parts of the screen once and register the value fields
+void drawDisplayLayout() {
+    display.clearDisplay();
     display.setTextSize(1);
+    display.setTextColor(SSD1306_WHITE);
+
+    // Header
     display.setCursor(0, 0);
     display.println(F("UWB TAG - DISTANCES"));
     display.drawLine(0, 9, 128, 9, SSD1306_WHITE);
-    
-    // Display distances with larger text for better visibility
-    display.setCursor(0, 12);
-    display.print(F("A0: "));
-    
-    // Show "---" if no measurement
-    if (dist_to_a0 > 0) {
-        display.print(dist_to_a0, 1);
-        display.println(F(" cm"));
-    } else {
-        display.println(F("--- cm"));
-    }
-    
-    display.setCursor(0, 24);
-    display.print(F("A1: "));
-    if (dist_to_a1 > 0) {
-        display.print(dist_to_a1, 1);
-        display.println(F(" cm"));
-    } else {
-        display.println(F("--- cm"));
-    }
-    
-    display.setCursor(0, 36);
-    display.print(F("A2: "));
-    if (dist_to_a2 > 0) {
-        display.print(dist_to_a2, 1);
-        display.println(F(" cm"));
-    } else {
-        display.println(F("--- cm"));
-    }
-    
-    display.setCursor(0, 48);
-    display.print(F("A3: "));
-    if (dist_to_a3 > 0) {
-        display.print(dist_to_a3, 1);
-        display.println(F(" cm"));
-    } else {
-        display.println(F("--- cm"));
+
+    // One anchor per row
+    for (uint8_t i = 0; i < 4; i++) {
+        int16_t y = 12 + i * 12;
+        display.setCursor(0, y);
+        display.print(F("A"));
+        display.print(i);
+        display.print(F(": "));
+        distanceFields[i] = screen.addField(24, y, 12);
     }
-    
-    display.display();
-}
 
-// Send command to the UWB module and get response
-String sendData(String command, const int timeout, boolean debug)
-{
-    String response = "";
+    screen.pushAll();
+    layout_drawn = true;
+}
 
-    if (debug) {
-        SERIAL_LOG.print(F("CMD: "));
-        SERIAL_LOG.println(command);
+// Update the display with the latest distance measurements.
+// Only fields whose text changed are sent to the OLED.
+void updateDistanceDisplay() {
+    if (!display_initialized) {
+        return;
     }
-    
-    SERIAL_AT.println(command);
 
-    long int time = millis();
-
-    while ((time + timeout) > millis())
-    {
-        while (SERIAL_AT.available())
-        {
-            char c = SERIAL_AT.read();
-            response += c;
-        }
+    if (!layout_drawn) {
+        drawDisplayLayout();
     }
 
-    if (debug && response.length() > 0)
-    {
-        SERIAL_LOG.print(F("RESP: "));
-        SERIAL_LOG.println(response);
+    const float distances[4] = {dist_to_a0, dist_to_a1, dist_to_a2, dist_to_a3};
+    for (uint8_t i = 0; i < 4; i++) {
+        if (distances[i] > 0) {
+            screen.setNumber(distanceFields[i], distances[i], 1, " cm");
+        } else {
+            screen.setText(distanceFields[i], "--- cm");
+        }
     }
 
-    return response;
-}
\ No newline at end of file
+    screen.push();
+}
@@ -0,0 +1,130 @@
+/*
+ * MaUWB_Latency.h - Hot-path latency histograms
+ *
+ * With MAUWB_LATENCY set to 1, MaUWB_AT timestamps each line from the
+ * module with micros() (first byte read, line complete, parsed) and
+ * MaUWB_TAG adds solved, filtered and callback returned, feeding the gap
+ * between each pair into a MaUWB_LatencyHistogram. Left at 0 (default)
+ * none of the timestamps or histograms are compiled in.
+ *
+ * A histogram has four buckets per power of two (values under 16 us are
+ * exact). Min, max and mean are exact; a percentile is within 13%.
+ * It takes about 400 bytes, and record() is a few shifts and adds.
+ *
+ * Only needs the C library, so it also builds on a desktop compiler.
+ */
+
+#ifndef MAUWB_LATENCY_H
+#define MAUWB_LATENCY_H
+
+#include <stdint.h>
+
+// 1: compile in the latency timers
+#ifndef MAUWB_LATENCY
+#define MAUWB_LATENCY 0
+#endif
+
+// micros() of one line from the module
+struct MaUWB_LineTiming {
+    uint32_t firstByte;   // First byte read by poll() (not its arrival in the UART)
+    uint32_t complete;    // Line terminator read
+    uint32_t parsed;      // Decoded by MaUWB_RangeParser
+};
+
+class MaUWB_LatencyHistogram {
+public:
+    // 16 exact buckets, then 4 per power of two up to 2^24 us (~17 s)
+    static const uint8_t BUCKETS = 16 + 20 * 4;
+
+    MaUWB_LatencyHistogram() { reset(); }
+
+    void reset();
+    void record(uint32_t us);
+
+    uint32_t getCount() const { return count; }
+    uint32_t getMin() const { return count ? minimum : 0; }
+    uint32_t getMax() const { return maximum; }
+    uint32_t getMean() const { return count ? (uint32_t)(sum / count) : 0; }
+
+    // Value below which the given fraction (0..1) of samples fall (us); the
+    // middle of its bucket, clamped to the exact min and max
+    uint32_t getPercentile(float fraction) const;
+
+private:
+    uint32_t buckets[BUCKETS];
+    uint32_t count;
+    uint32_t minimum;
+    uint32_t maximum;
+    uint64_t sum;
+
+    static uint8_t bucketOf(uint32_t us);
+    static uint32_t bucketStart(uint8_t bucket);
+};
+
+// Implementation
+
+inline void MaUWB_LatencyHistogram::reset() {
+    for (uint8_t i = 0; i < BUCKETS; i++) {
+        buckets[i] = 0;
+    }
+    count = 0;
+    minimum = 0xFFFFFFFF;
+    maximum = 0;
+    sum = 0;
+}
+
+inline uint8_t MaUWB_LatencyHistogram::bucketOf(uint32_t us) {
+    if (us < 16) {
+        return (uint8_t)us;
+    }
+    if (us >= ((uint32_t)1 << 24)) {
+        return BUCKETS - 1;
+    }
+
+    uint8_t exponent = 4;   // us is in [2^exponent, 2^(exponent + 1))
+    while (us >> (exponent + 1)) {
+        exponent++;
+    }
+    return 16 + (exponent - 4) * 4 + ((us >> (exponent - 2)) & 3);
+}
+
+inline uint32_t MaUWB_LatencyHistogram::bucketStart(uint8_t bucket) {
+    if (bucket < 16) {
+        return bucket;
+    }
+    uint8_t exponent = 4 + (bucket - 16) / 4;
+    return (4 + (bucket - 16) % 4) << (exponent - 2);
+}
+
+inline void MaUWB_LatencyHistogram::record(uint32_t us) {
+    buckets[bucketOf(us)]++;
+    count++;
+    sum += us;
+    if (us < minimum) minimum = us;
+    if (us > maximum) maximum = us;
+}
+
+inline uint32_t MaUWB_LatencyHistogram::getPercentile(float fraction) const {
+    if (count == 0) {
+        return 0;
+    }
+
+    uint32_t rank = (uint32_t)(fraction * count);
+    if (rank >= count) rank = count - 1;
+
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen > rank) {
+            uint32_t start = bucketStart(i);
+            uint32_t end = i + 1 < BUCKETS ? bucketStart(i + 1) : maximum + 1;
+            uint32_t value = start + (end - start) / 2;
+            if (value < minimum) value = minimum;
+            if (value > maximum) value = maximum;
+            return value;
+        }
+    }
+    return maximum;
+}
+
+#endif // MAUWB_LATENCY_H
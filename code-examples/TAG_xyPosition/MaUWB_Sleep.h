@@ -0,0 +1,85 @@
+/*
+ * MaUWB_Sleep.h - Light sleep between range polls at rest
+ *
+ * A tag that polls the module (auto-reports off) has nothing to do between
+ * polls while it rests: the module stays quiet until it is asked.
+ * MaUWB_PollSleep light-sleeps the ESP32 until MAUWB_TAG_SLEEP_GUARD_MS
+ * before the scheduler's next poll, if that is at least
+ * MAUWB_TAG_SLEEP_MIN_MS away and nothing is waiting in the module's UART.
+ * Whether the tag is at rest and otherwise idle (no reply awaited, log and
+ * stream drained) is the caller's to say. MaUWB_BasicTAG and TAG_xyPosition
+ * both sleep through it.
+ *
+ * Usage:
+ *   MaUWB_PollSleep sleeper;
+ *   // In loop(), after the log is drained:
+ *   if (!motion.isMoving()) {
+ *       sleeper.sleepUntilPoll(scheduler, Serial2, !uwbAt.isBusy() && logger.pending() == 0);
+ *   }
+ *
+ * ESP32 only. Elsewhere, or with MAUWB_TAG_NO_SLEEP defined, it never sleeps.
+ * USB serial drops out while the chip sleeps.
+ */
+
+#ifndef MAUWB_SLEEP_H
+#define MAUWB_SLEEP_H
+
+#include <Arduino.h>
+#include "MaUWB_Scheduler.h"
+
+#if defined(ARDUINO_ARCH_ESP32) && !defined(MAUWB_TAG_NO_SLEEP)
+#define MAUWB_TAG_LIGHT_SLEEP 1
+#include <esp_sleep.h>
+#else
+#define MAUWB_TAG_LIGHT_SLEEP 0
+#endif
+
+// Shortest light sleep worth entering, and how long before a poll to wake (ms)
+#ifndef MAUWB_TAG_SLEEP_MIN_MS
+#define MAUWB_TAG_SLEEP_MIN_MS 20
+#endif
+#ifndef MAUWB_TAG_SLEEP_GUARD_MS
+#define MAUWB_TAG_SLEEP_GUARD_MS 2
+#endif
+
+class MaUWB_PollSleep {
+public:
+    MaUWB_PollSleep() : sleepTime(0) {}
+
+    // Sleep until shortly before scheduler's next poll if idle and link has
+    // nothing waiting. Returns true if it slept.
+    bool sleepUntilPoll(const MaUWB_RangeScheduler& scheduler, Stream& link, bool idle);
+
+    uint32_t getSleepTime() const { return sleepTime; }   // ms in light sleep
+
+private:
+    uint32_t sleepTime;
+};
+
+// Implementation
+
+inline bool MaUWB_PollSleep::sleepUntilPoll(const MaUWB_RangeScheduler& scheduler, Stream& link, bool idle) {
+#if MAUWB_TAG_LIGHT_SLEEP
+    if (!idle || link.available() > 0) {
+        return false;
+    }
+    unsigned long start = millis();
+    unsigned long due = scheduler.timeToPoll(start);
+    if (due < MAUWB_TAG_SLEEP_MIN_MS) {
+        return false;
+    }
+
+    link.flush();
+    esp_sleep_enable_timer_wakeup((uint64_t)(due - MAUWB_TAG_SLEEP_GUARD_MS) * 1000);
+    esp_light_sleep_start();
+    sleepTime += millis() - start;
+    return true;
+#else
+    (void)scheduler;
+    (void)link;
+    (void)idle;
+    return false;
+#endif
+}
+
+#endif // MAUWB_SLEEP_H
@@ -0,0 +1,75 @@
+/*
+ * MaUWB_SpscQueue.h - Lock-free single-producer/single-consumer ring buffer
+ *
+ * Passes samples from one task to another without a mutex: only the
+ * producer writes the head index and only the consumer writes the tail, so
+ * std::atomic loads and stores with acquire/release ordering are enough.
+ * With exactly one task pushing and one task popping it is safe across the
+ * two ESP32-S3 cores.
+ *
+ * Usage:
+ *   MaUWB_SpscQueue<MaUWB_PositionSample, 8> queue;
+ *   queue.push(sample);               // Producer; false when full (counted as dropped)
+ *   while (queue.pop(sample)) { }     // Consumer
+ *
+ * Only needs the C++ standard library, so it also builds on a desktop
+ * compiler.
+ */
+
+#ifndef MAUWB_SPSC_QUEUE_H
+#define MAUWB_SPSC_QUEUE_H
+
+#include <stdint.h>
+#include <atomic>
+
+template <typename T, uint16_t Capacity>
+class MaUWB_SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "MaUWB_SpscQueue capacity must be a power of two");
+
+public:
+    MaUWB_SpscQueue() : head(0), tail(0), dropped(0) {}
+
+    // Producer side. Returns false and counts a drop when the queue is full.
+    bool push(const T& item) {
+        uint16_t h = head.load(std::memory_order_relaxed);
+        uint16_t t = tail.load(std::memory_order_acquire);
+        if ((uint16_t)(h - t) == Capacity) {
+            dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+        items[h & (Capacity - 1)] = item;
+        head.store((uint16_t)(h + 1), std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false when the queue is empty.
+    bool pop(T& item) {
+        uint16_t t = tail.load(std::memory_order_relaxed);
+        uint16_t h = head.load(std::memory_order_acquire);
+        if (h == t) {
+            return false;
+        }
+        item = items[t & (Capacity - 1)];
+        tail.store((uint16_t)(t + 1), std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when called while the other side is running
+    uint16_t size() const {
+        return (uint16_t)(head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire));
+    }
+    bool empty() const { return size() == 0; }
+    uint16_t capacity() const { return Capacity; }
+
+    // Items the producer could not push because the queue was full
+    uint32_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    T items[Capacity];
+    std::atomic<uint16_t> head;      // Next slot to write (producer)
+    std::atomic<uint16_t> tail;      // Next slot to read (consumer)
+    std::atomic<uint32_t> dropped;   // Written by the producer only
+};
+
+#endif // MAUWB_SPSC_QUEUE_H
@@ -18,6 +18,13 @@ Libraries needed:
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
 #include <Arduino.h>
+#include "MaUWB_AT.h"
+#include "MaUWB_Display.h"
+#include "MaUWB_Scheduler.h"
+#include "MaUWB_Motion.h"
+#include "MaUWB_Sleep.h"
+#include "MaUWB_Solver.h"
+#include "MaUWB_Log.h"
 
 // Define tag ID
 #define UWB_INDEX 7
@@ -26,8 +33,19 @@ Libraries needed:
 #define UWB_TAG_COUNT 10
 #define DISPLAY_UPDATE_INTERVAL 50  // Update display every 100ms
 
-// Data request rate in milliseconds
-unsigned long refreshRate = 50;  // Request range data every 500ms
+// Shortest gap between explicit range polls in milliseconds. With
+// auto-report on, polls are only sent if the module stops reporting.
+unsigned long refreshRate = 50;
+
+// Motion-adaptive rate: poll every refreshRate ms while the tag moves and
+// back off to REST_INTERVAL at rest. Setting this to 1 switches the module
+// from auto-reports (AT+SETRPT=1) to polling, so a resting tag leaves its
+// TDMA slots idle but takes up to REST_INTERVAL to notice it was picked up.
+#define ADAPTIVE_RATE 0
+#define REST_INTERVAL 1000
+
+// Light-sleep between polls at rest (USB serial drops out while asleep)
+#define LIGHT_SLEEP 0
 
 // Position filtering configuration
 #define POSITION_HISTORY_LENGTH 1  // Number of positions to average
@@ -44,6 +62,30 @@ unsigned long refreshRate = 50;  // Request range data every 500ms
 
 Adafruit_SSD1306 display(128, 64, &Wire, -1);
 
+// Status screen; only changed fields are sent over I2C
+MaUWB_Display screen;
+int8_t distanceFields[4];
+int8_t xField, yField;
+
+// Non-blocking AT command link to the UWB module
+MaUWB_AT uwbAt;
+
+// Log lines are queued on the ranging path and written at the end of loop()
+MaUWB_Log logger;
+enum LogCategory {
+    LOG_POSITION,   // Ranges and position of each fix
+    LOG_MODULE,     // Module lines that are not range reports
+    LOG_STATUS      // Fixes that could not be used
+};
+
+// Listens to the module's auto-reports, polls only when they stop
+MaUWB_RangeScheduler rangeScheduler;
+
+// Poll interval from the speed and innovation of each fix
+MaUWB_MotionRate motionRate;
+MaUWB_PollSleep pollSleep;           // LIGHT_SLEEP: shared with MaUWB_BasicTAG
+unsigned long last_fix_time = 0;
+
 // Distance measurements to anchors (using anchors 0-3)
 float dist_to_a0 = 0.0;
 float dist_to_a1 = 0.0;
@@ -58,6 +100,14 @@ float dist_to_a3 = 0.0;
 const float anchor_x[4] = {0, 0, 380, 380};
 const float anchor_y[4] = {0, 600, 600, 0};
 
+// Mounting height of each anchor and height of the tag (cm). When they
+// differ, the ranges are projected onto the tag's plane before solving.
+const float anchor_z[4] = {0, 0, 0, 0};
+const float tag_z = 0;
+
+// Anchor geometry cache for the position solve, loaded in setup()
+MaUWB_Solver solver;
+
 // Position of the tag
 float positionX = 0.0;
 float positionY = 0.0;
@@ -72,9 +122,17 @@ bool position_history_filled = false;
 long last_display_update = 0;
 bool new_data = false;
 bool display_initialized = false;
+bool layout_drawn = false;
 
 void setup()
 {
+    // Load the anchor layout; the solver rebuilds its geometry cache once
+    solver.setAnchorCount(4);
+    for (uint8_t i = 0; i < 4; i++) {
+        solver.setAnchor(i, anchor_x[i], anchor_y[i], anchor_z[i]);
+    }
+    solver.setTagHeight(tag_z);
+    
     pinMode(RESET, OUTPUT);
     digitalWrite(RESET, HIGH);
 
@@ -84,7 +142,14 @@ void setup()
     SERIAL_LOG.println(F("\n\n----- ESP32S3 UWB TAG - DISTANCE & POSITION DISPLAY -----"));
     
     // Initialize UWB module serial
+    SERIAL_AT.setRxBufferSize(MAUWB_UART_RX_BUFFER);   // Room for bursts while the display updates
     SERIAL_AT.begin(115200, SERIAL_8N1, IO_RXD2, IO_TXD2);
+    uwbAt.begin(SERIAL_AT);
+    uwbAt.setDebugOutput(&SERIAL_LOG);
+    uwbAt.setLineHandler(handleUwbLine);
+    uwbAt.setReportHandler(handleUwbReport);
+    logger.setRateLimit(LOG_MODULE, 20, 20);
+    logger.setRateLimit(LOG_STATUS, 2, 2);    // A missing anchor would otherwise repeat on every report
     SERIAL_LOG.println(F("Serial2 initialized"));
 
     // Initialize I2C for display
@@ -101,6 +166,7 @@ void setup()
     }
     
     display_initialized = true;
+    screen.begin(&display);
     SERIAL_LOG.println(F("SSD1306 display initialized successfully"));
     
     display.clearDisplay();
@@ -118,26 +184,34 @@ void setup()
     
     // Configure the UWB module as a tag
     SERIAL_LOG.println(F("Configuring UWB module as TAG..."));
-    SERIAL_AT.println("AT");
-    
-    sendData("AT?", 500, 1);
-    sendData("AT+RESTORE", 1000, 1);
-
-    // Configure as tag (role=0)
-    String cfg = "AT+SETCFG=" + String(UWB_INDEX) + ",0,1,1";  // ID,role,freq,filter
-    SERIAL_LOG.print(F("Config: "));
-    SERIAL_LOG.println(cfg);
-    sendData(cfg, 500, 1);
-    
-    // Set capacity
-    String cap = "AT+SETCAP=" + String(UWB_TAG_COUNT) + ",10,1";  // count,time,mode
-    SERIAL_LOG.print(F("Capacity: "));
-    SERIAL_LOG.println(cap);
-    sendData(cap, 500, 1);
+    MaUWB_ModuleConfig moduleConfig;
+    moduleConfig.id = UWB_INDEX;
+    moduleConfig.role = 0;              // Tag
+    moduleConfig.rate = 1;              // 6.8 Mbps
+    moduleConfig.filter = 1;
+    moduleConfig.capacity = UWB_TAG_COUNT;
+    moduleConfig.slotMs = MAUWB_SLOT_MS;
+    moduleConfig.extMode = 1;
+    moduleConfig.report = ADAPTIVE_RATE ? 0 : 1;
+    moduleConfig.antennaDelay = 0;      // Calibrated on the anchors
+    
+    // Only rewrites and restarts the module if its stored settings differ
+    MaUWB_AT::Result configured = uwbAt.configure(moduleConfig);
+    if (configured == MaUWB_AT::AT_MATCH) {
+        SERIAL_LOG.println(F("Module already configured"));
+    } else if (configured == MaUWB_AT::AT_TIMEOUT) {
+        SERIAL_LOG.println(F("UWB module not answering"));
+    } else if (configured != MaUWB_AT::AT_OK) {
+        SERIAL_LOG.println(F("UWB module setup failed"));
+    }
     
-    sendData("AT+SETRPT=1", 500, 1);
-    sendData("AT+SAVE", 500, 1);
-    sendData("AT+RESTART", 1000, 1);
+    // One report per TDMA cycle of UWB_TAG_COUNT slots
+    rangeScheduler.configure(UWB_TAG_COUNT, MAUWB_SLOT_MS);
+    rangeScheduler.setAutoReport(!ADAPTIVE_RATE);
+    rangeScheduler.setMinPollInterval(refreshRate);
+    rangeScheduler.begin(millis());
+    motionRate.configure(refreshRate, REST_INTERVAL);
+    motionRate.begin(millis());
     
     // Show display is ready
     display.clearDisplay();
@@ -151,34 +225,12 @@ void setup()
     display.display();
     
     SERIAL_LOG.println(F("Setup complete - Reading distances to anchors"));
-    delay(1000);  // Give the UWB module time to initialize
 }
 
-String response = "";
-
 void loop()
 {
-    // Check for incoming data from UWB module
-    while (SERIAL_AT.available() > 0)
-    {
-        char c = SERIAL_AT.read();
-
-        if (c == '\r')
-            continue;
-        else if (c == '\n') {
-            if (response.length() > 0) {
-                SERIAL_LOG.print(F("UWB RESPONSE: "));
-                SERIAL_LOG.println(response);
-                
-                // Parse any range information in the response
-                parseRangeData(response);
-                response = "";
-            }
-        }
-        else {
-            response += c;
-        }
-    }
+    // Read data from the UWB module and complete any pending command
+    uwbAt.poll();
 
     // Forward commands from Serial Monitor to UWB module
     while (SERIAL_LOG.available() > 0)
@@ -187,206 +239,104 @@ void loop()
         yield();
     }
     
-    // Update display on fixed interval or when new data arrives
-    if ((millis() - last_display_update > DISPLAY_UPDATE_INTERVAL) || new_data) {
+    // Update display on fixed interval or when new data arrives; at rest
+    // no more often than the tag ranges
+    unsigned long displayInterval = DISPLAY_UPDATE_INTERVAL;
+    if (ADAPTIVE_RATE && motionRate.getInterval() > displayInterval) {
+        displayInterval = motionRate.getInterval();
+    }
+    if ((millis() - last_display_update > displayInterval) || new_data) {
         updateDistanceDisplay();
         new_data = false;
         last_display_update = millis();
     }
     
-    // Request range data periodically based on refreshRate
-    static unsigned long last_range_request = 0;
+    // Request range data only when the module is not reporting on its own
     unsigned long currentTime = millis();
-    if (currentTime - last_range_request > refreshRate) {
+    if (rangeScheduler.pollDue(currentTime) && !uwbAt.isBusy()) {
         #ifdef DEBUG_MODE
-        SERIAL_LOG.println(F("Requesting range data..."));
+        logger.log(LOG_STATUS, "Requesting range data...");
         #endif
         
-        // Request all ranges at once
-        sendData("AT+RANGE", 100, 1);
-        
-        last_range_request = currentTime;
+        // Queue the request; the reply is handled by uwbAt.poll()
+        if (uwbAt.send("AT+RANGE", 100, nullptr, nullptr, "AT+RANGE=")) {
+            rangeScheduler.pollSent(currentTime);
+        }
     }
-}
+    
+    // Write what the USB-CDC buffer takes without blocking; the rest waits
+    logger.drain(SERIAL_LOG, MAUWB_LOG_DRAIN_MAX, true);
 
-// Parse range information from UWB module
-void parseRangeData(String data) {
-    // According to the AT command manual, the response format is:
-    // AT+RANGE=tid:x1,mask:x2,seq:x3,range:(x4,x5,x6,x7,x8,x9,x10,x11), rssi:(x12,x13,x14,x15,x16,x17,x18,x19)
-    
-    // Look for "range:(" in the response
-    int range_start = data.indexOf("range:(");
-    if (range_start >= 0) {
-        // Find the end of the range array
-        int range_end = data.indexOf(")", range_start);
-        if (range_end > range_start) {
-            // We're only interested in the first 4 values (0-3)
-            float distances[4] = {0, 0, 0, 0};
-            
-            // Optimization: Parse directly from the original string without creating substrings
-            int startIndex = range_start + 7;  // Skip "range:("
-            int valueIndex = 0;
-            
-            #ifdef DEBUG_MODE
-            SERIAL_LOG.print(F("Range values: "));
-            #endif
-            
-            // Parse each value directly
-            while (valueIndex < 4 && startIndex < range_end) {
-                // Find the next comma or the end parenthesis
-                int commaIndex = data.indexOf(',', startIndex);
-                if (commaIndex == -1 || commaIndex > range_end) {
-                    commaIndex = range_end;
-                }
-                
-                // Convert this segment directly to float
-                char buffer[10]; // Temporary buffer for number conversion
-                int len = commaIndex - startIndex;
-                if (len < 10) {
-                    strncpy(buffer, data.c_str() + startIndex, len);
-                    buffer[len] = '\0';
-                    distances[valueIndex] = atof(buffer);
-                }
-                
-                #ifdef DEBUG_MODE
-                SERIAL_LOG.print(distances[valueIndex]);
-                if (valueIndex < 3) SERIAL_LOG.print(F(", "));
-                #endif
-                
-                valueIndex++;
-                startIndex = commaIndex + 1;
-            }
-            
-            #ifdef DEBUG_MODE
-            SERIAL_LOG.println();
-            #endif
-            
-            // Update our distance variables
-            dist_to_a0 = distances[0];
-            dist_to_a1 = distances[1];
-            dist_to_a2 = distances[2];
-            dist_to_a3 = distances[3];
-            
-            // Calculate 2D position
-            calculatePosition();
-            
-            // Respond to position data
-            tagResponse(positionX, positionY);
-            
-            new_data = true;
-        }
+    #if LIGHT_SLEEP
+    // At rest, with no reply awaited, sleep until just before the next poll;
+    // the polled module stays quiet until it is asked
+    if (ADAPTIVE_RATE && !motionRate.isMoving()) {
+        pollSleep.sleepUntilPoll(rangeScheduler, SERIAL_AT, !uwbAt.isBusy() && logger.pending() == 0);
     }
+    #endif
 }
 
-// Calculate 2D position using enhanced multilateration with all 4 anchors
-void calculatePosition() {
-    // Check if we have valid distances from all 4 anchors
-    if (dist_to_a0 <= 0 || dist_to_a1 <= 0 || dist_to_a2 <= 0 || dist_to_a3 <= 0) {
-        SERIAL_LOG.println(F("Cannot calculate position - need distances from all 4 anchors"));
-        return;
-    }
+// Handle a line from the UWB module that is neither a command reply nor a range report
+void handleUwbLine(const char* line, uint8_t length, void* context)
+{
+    logger.log(LOG_MODULE, "UWB RESPONSE: %s", line);
+}
+
+// Handle a range report decoded by the AT engine
+// AT+RANGE=tid:x1,mask:x2,seq:x3,range:(x4,x5,x6,x7,x8,x9,x10,x11),rssi:(x12,x13,x14,x15,x16,x17,x18,x19)
+void handleUwbReport(const MaUWB_RangeReport& report, void* context)
+{
+    rangeScheduler.reportReceived(millis());
     
-    // Work directly in cm to avoid unnecessary conversions
-    // This is a non-iterative multilateration approach using all 4 anchors
-    
-    // We'll calculate 3 separate positions using different triplets of anchors,
-    // then take the weighted average
-    float x1 = 0, y1 = 0;  // Position calculated from anchors 0,1,2
-    float x2 = 0, y2 = 0;  // Position calculated from anchors 0,1,3
-    float x3 = 0, y3 = 0;  // Position calculated from anchors 0,2,3
-    
-    // Precompute squared distances and other repeated values
-    float dist_to_a0_sq = dist_to_a0 * dist_to_a0;
-    float dist_to_a1_sq = dist_to_a1 * dist_to_a1;
-    float dist_to_a2_sq = dist_to_a2 * dist_to_a2;
-    float dist_to_a3_sq = dist_to_a3 * dist_to_a3;
-    
-    // Precompute anchor position terms
-    float a0_sq = anchor_x[0] * anchor_x[0] + anchor_y[0] * anchor_y[0];
-    float a1_sq = anchor_x[1] * anchor_x[1] + anchor_y[1] * anchor_y[1];
-    float a2_sq = anchor_x[2] * anchor_x[2] + anchor_y[2] * anchor_y[2];
-    float a3_sq = anchor_x[3] * anchor_x[3] + anchor_y[3] * anchor_y[3];
-    
-    // Common calculations for equations involving anchors 0-1
-    float A_01 = 2 * (anchor_x[1] - anchor_x[0]);
-    float B_01 = 2 * (anchor_y[1] - anchor_y[0]);
-    float C_01 = dist_to_a0_sq - dist_to_a1_sq - a0_sq + a1_sq;
-    
-    // Common calculations for other anchor pairs
-    float A_12 = 2 * (anchor_x[2] - anchor_x[1]);
-    float B_12 = 2 * (anchor_y[2] - anchor_y[1]);
-    float C_12 = dist_to_a1_sq - dist_to_a2_sq - a1_sq + a2_sq;
-    
-    float A_13 = 2 * (anchor_x[3] - anchor_x[1]);
-    float B_13 = 2 * (anchor_y[3] - anchor_y[1]);
-    float C_13 = dist_to_a1_sq - dist_to_a3_sq - a1_sq + a3_sq;
-    
-    float A_02 = 2 * (anchor_x[2] - anchor_x[0]);
-    float B_02 = 2 * (anchor_y[2] - anchor_y[0]);
-    float C_02 = dist_to_a0_sq - dist_to_a2_sq - a0_sq + a2_sq;
-    
-    float A_23 = 2 * (anchor_x[3] - anchor_x[2]);
-    float B_23 = 2 * (anchor_y[3] - anchor_y[2]);
-    float C_23 = dist_to_a2_sq - dist_to_a3_sq - a2_sq + a3_sq;
-    
-    // Solve using anchors 0,1,2
-    float den1 = (A_01 * B_12 - B_01 * A_12);
-    if (abs(den1) > 0.000001) {
-        x1 = (C_01 * B_12 - C_12 * B_01) / den1;
-        y1 = (A_01 * C_12 - C_01 * A_12) / den1;
-    }
+    #ifdef DEBUG_MODE
+    logger.log(LOG_POSITION, "Range values: %.2f, %.2f, %.2f, %.2f",
+               report.range[0], report.range[1], report.range[2], report.range[3]);
+    #endif
     
-    // Solve using anchors 0,1,3
-    float den2 = (A_01 * B_13 - B_01 * A_13);
-    if (abs(den2) > 0.000001) {
-        x2 = (C_01 * B_13 - C_13 * B_01) / den2;
-        y2 = (A_01 * C_13 - C_01 * A_13) / den2;
-    }
+    // We're only interested in the first 4 values (0-3). Each slot is one
+    // anchor; slots not in the mask or missing read 0
+    dist_to_a0 = report.answered(0) ? report.range[0] : 0;
+    dist_to_a1 = report.answered(1) ? report.range[1] : 0;
+    dist_to_a2 = report.answered(2) ? report.range[2] : 0;
+    dist_to_a3 = report.answered(3) ? report.range[3] : 0;
     
-    // Solve using anchors 0,2,3
-    float den3 = (A_02 * B_23 - B_02 * A_23);
-    if (abs(den3) > 0.000001) {
-        x3 = (C_02 * B_23 - C_23 * B_02) / den3;
-        y3 = (A_02 * C_23 - C_02 * A_23) / den3;
-    }
+    // Calculate 2D position
+    calculatePosition();
     
-    // Count valid solutions
-    int validSolutions = 0;
-    if (abs(den1) > 0.000001) validSolutions++;
-    if (abs(den2) > 0.000001) validSolutions++;
-    if (abs(den3) > 0.000001) validSolutions++;
+    // Respond to position data
+    tagResponse(positionX, positionY);
     
-    if (validSolutions == 0) {
-        SERIAL_LOG.println(F("Cannot calculate position - no valid solutions"));
+    new_data = true;
+}
+
+// Calculate 2D position by least squares over every anchor that answered
+void calculatePosition() {
+    // Slots without a reply read 0 and are left out of the solve
+    const float ranges[4] = {dist_to_a0, dist_to_a1, dist_to_a2, dist_to_a3};
+    uint8_t answered = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+        if (ranges[i] > 0) answered++;
+    }
+    if (answered < 3) {
+        logger.log(LOG_STATUS, "Cannot calculate position - need distances from at least 3 anchors");
         return;
     }
     
-    // Calculate position as average of valid solutions
+    // One least-squares fix; if it is implausible, the first anchor
+    // triplet that gives a plausible one
     float x = 0.0, y = 0.0;
-    
-    if (abs(den1) > 0.000001) {
-        x += x1;
-        y += y1;
-    }
-    if (abs(den2) > 0.000001) {
-        x += x2;
-        y += y2;
-    }
-    if (abs(den3) > 0.000001) {
-        x += x3;
-        y += y3;
+    if (!solver.solveChecked(ranges, x, y)) {
+        logger.log(LOG_STATUS, "Cannot calculate position - no valid solutions");
+        return;
     }
     
-    x /= validSolutions;
-    y /= validSolutions;
-    
     // Store the raw calculated position
     float rawX = x;
     float rawY = y;
     
     // Filter out negative values or values outside the boundary
     if (rawX < 0 || rawY < 0 || rawX > anchor_x[2] || rawY > anchor_y[1]) {
-        SERIAL_LOG.println(F("Position outside valid boundaries - skipping update"));
+        logger.log(LOG_STATUS, "Position outside valid boundaries - skipping update");
         return;
     }
     
@@ -414,18 +364,29 @@ void calculatePosition() {
     }
     
     // Update the final filtered position
+    float lastX = positionX;
+    float lastY = positionY;
     positionX = avgX;
     positionY = avgY;
+
+    // Speed from the step of the filtered position; the innovation is the
+    // raw fix against the last filtered position, the average's prediction
+    unsigned long now = millis();
+    if (ADAPTIVE_RATE && last_fix_time != 0 && now != last_fix_time) {
+        float dt = (now - last_fix_time) / 1000.0f;
+        float speed = sqrtf((positionX - lastX) * (positionX - lastX) + (positionY - lastY) * (positionY - lastY)) / dt;
+        float innovation = sqrtf((rawX - lastX) * (rawX - lastX) + (rawY - lastY) * (rawY - lastY));
+        if (motionRate.update(now, speed, innovation)) {
+            rangeScheduler.setMinPollInterval(motionRate.getInterval());
+            logger.log(LOG_STATUS, "Ranging every %lu ms", motionRate.getInterval());
+        }
+    }
+    last_fix_time = now;
     
-    SERIAL_LOG.print(F("Raw position: X="));
-    SERIAL_LOG.print(rawX);
-    SERIAL_LOG.print(F(", Y="));
-    SERIAL_LOG.println(rawY);
-    
-    SERIAL_LOG.print(F("Filtered position: X="));
-    SERIAL_LOG.print(positionX);
-    SERIAL_LOG.print(F(", Y="));
-    SERIAL_LOG.println(positionY);
+    #ifdef DEBUG_MODE
+    logger.log(LOG_POSITION, "Raw position: X=%.2f, Y=%.2f", rawX, rawY);
+    logger.log(LOG_POSITION, "Filtered position: X=%.2f, Y=%.2f", positionX, positionY);
+    #endif
 }
 
 // Function for tag to respond to its position
@@ -439,96 +400,66 @@ void tagResponse(float x, float y) {
     // - Detect proximity to points of interest
 }
 
-// Helper function to display anchor distances
-void displayAnchorDistance(int x, int y, int anchorNum, float distance) {
-    display.setCursor(x, y);
-    display.print(F("A"));
-    display.print(anchorNum);
-    display.print(F(": "));
-    if (distance > 0) {
-        display.print(distance, 1);
-    } else {
-        display.print(F("---"));
-    }
-}
-
-// Update the display with the latest distance measurements and position
-// Optimization: Add debug mode definition at top of file (if not already present)
-// Add this near the top of the file: #define DEBUG_MODE  // Comment out to disable debug logging
-
-void updateDistanceDisplay() {
-    if (!display_initialized) {
-        return;
-    }
-    
+// Draw the static parts of the screen once and register the value fields
+void drawDisplayLayout() {
     display.clearDisplay();
-
-    // Display header
     display.setTextSize(1);
+    display.setTextColor(SSD1306_WHITE);
+
+    // Header
     display.setCursor(0, 0);
     display.print(F("TAG "));
     display.println(UWB_INDEX);
     display.drawLine(0, 9, 128, 9, SSD1306_WHITE);
-    
-    // Display distance to A0 and A1
-    // Optimization: Create a helper function to reduce repeated code patterns
-    displayAnchorDistance(0, 12, 0, dist_to_a0);
-    displayAnchorDistance(64, 12, 1, dist_to_a1);
-    
-    // Display distance to A2 and A3
-    displayAnchorDistance(0, 24, 2, dist_to_a2);
-    displayAnchorDistance(64, 24, 3, dist_to_a3);
-    
-    // Display divider
+
+    // Anchor distances, two per row
+    for (uint8_t i = 0; i < 4; i++) {
+        int16_t x = (i % 2) * 64;
+        int16_t y = 12 + (i / 2) * 12;
+        display.setCursor(x, y);
+        display.print(F("A"));
+        display.print(i);
+        display.print(F(": "));
+        distanceFields[i] = screen.addField(x + 24, y, 6);
+    }
+
+    // Divider and position
     display.drawLine(0, 35, 128, 35, SSD1306_WHITE);
-    
-    // Display position
     display.setCursor(0, 40);
     display.println(F("POSITION:"));
-    
     display.setCursor(0, 50);
     display.print(F("X: "));
-    display.print(positionX, 1);
-    
     display.setCursor(64, 50);
     display.print(F("Y: "));
-    display.print(positionY, 1);
-    
-    display.display();
-}
+    xField = screen.addField(18, 50, 7);
+    yField = screen.addField(82, 50, 7);
 
-// Send command to the UWB module and get response
-String sendData(String command, const int timeout, boolean debug)
-{
-    // Optimization: Preallocate response string with estimated size
-    String response;
-    response.reserve(64);  // Reserve space for typical response size
+    screen.pushAll();
+    layout_drawn = true;
+}
 
-    if (debug) {
-        SERIAL_LOG.print(F("CMD: "));
-        SERIAL_LOG.println(command);
+// Update the display with the latest distance measurements and position.
+// Only fields whose text changed are sent to the OLED.
+void updateDistanceDisplay() {
+    if (!display_initialized) {
+        return;
     }
-    
-    SERIAL_AT.println(command);
 
-    unsigned long time = millis();  // Use unsigned for time comparisons
+    if (!layout_drawn) {
+        drawDisplayLayout();
+    }
 
-    // Read until timeout
-    while ((millis() - time) < timeout)  // More efficient time comparison
-    {
-        // Read available bytes in chunks for efficiency
-        while (SERIAL_AT.available())
-        {
-            char c = SERIAL_AT.read();
-            response += c;
+    const float distances[4] = {dist_to_a0, dist_to_a1, dist_to_a2, dist_to_a3};
+    for (uint8_t i = 0; i < 4; i++) {
+        if (distances[i] > 0) {
+            screen.setNumber(distanceFields[i], distances[i], 1);
+        } else {
+            screen.setText(distanceFields[i], "---");
         }
     }
 
-    if (debug && response.length() > 0)
-    {
-        SERIAL_LOG.print(F("RESP: "));
-        SERIAL_LOG.println(response);
-    }
+    screen.setNumber(xField, positionX, 1);
+    screen.setNumber(yField, positionY, 1);
 
-    return response;
-}
\ No newline at end of file
+    screen.push();
+}
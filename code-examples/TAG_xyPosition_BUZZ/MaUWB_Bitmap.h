@@ -0,0 +1,219 @@
+/*
+ * MaUWB_Bitmap.h - Packed 1-bit bitmaps for the SSD1306 framebuffer
+ *
+ * Drawings from drawings-for-SD1306 are exported as C headers holding a
+ * MaUWB_Bitmap in flash. The bytes are in the SSD1306's own page order (one
+ * byte per column of 8 rows, least significant bit on top, page by page),
+ * optionally PackBits-style RLE compressed (see bitmap_pack.js there).
+ *
+ * MaUWB_BitmapBlit copies them into the framebuffer a byte at a time: at a
+ * y that is a multiple of 8 every source byte is one framebuffer byte,
+ * otherwise it is shifted across two. No drawPixel() calls, and RLE data is
+ * unpacked on the fly without a RAM copy.
+ *
+ * Usage:
+ *   #include "MaUWB_Logo.h"
+ *   MaUWB_BitmapBlit::draw(display.getBuffer(), display.width(), display.height(),
+ *                          MaUWB_Logo, 112, 0);
+ *   display.display();
+ *
+ * or screen.drawBitmap(MaUWB_Logo, 112, 0) with MaUWB_Display, which also
+ * marks the area for the next push(). Sprite sheets are one bitmap with the
+ * frames side by side; drawFrame() draws one of them.
+ *
+ * Only needs the C library, so it also builds on a desktop compiler.
+ */
+
+#ifndef MAUWB_BITMAP_H
+#define MAUWB_BITMAP_H
+
+#include <stdint.h>
+#include <string.h>
+#if defined(ARDUINO)
+#include <Arduino.h>   // PROGMEM and pgm_read_byte()
+#endif
+
+// Desktop builds: flash data is ordinary memory
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#ifndef pgm_read_byte
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+#endif
+
+#define MAUWB_BITMAP_RLE 0x01   // flags: data is RLE compressed
+
+struct MaUWB_Bitmap {
+    uint16_t width;         // Pixels
+    uint16_t height;        // Pixels; the data holds (height + 7) / 8 pages
+    uint8_t flags;
+    uint16_t size;          // Bytes of data
+    const uint8_t* data;    // In flash (PROGMEM)
+};
+
+enum MaUWB_BlitMode {
+    MAUWB_BLIT_COPY,        // Lit and dark pixels both replace the framebuffer
+    MAUWB_BLIT_OR,          // Only lit pixels are drawn
+    MAUWB_BLIT_INVERT       // Lit pixels flip the framebuffer
+};
+
+class MaUWB_BitmapBlit {
+public:
+    // Draw the bitmap with its top left corner at (x, y), clipped to the
+    // framebuffer (Adafruit_SSD1306::getBuffer(): width x height pixels)
+    static void draw(uint8_t* buffer, int16_t bufferWidth, int16_t bufferHeight, const MaUWB_Bitmap& bitmap,
+                     int16_t x, int16_t y, MaUWB_BlitMode mode = MAUWB_BLIT_COPY);
+
+    // Draw columns srcX .. srcX + srcWidth - 1 of the bitmap only
+    static void drawPart(uint8_t* buffer, int16_t bufferWidth, int16_t bufferHeight, const MaUWB_Bitmap& bitmap,
+                         int16_t x, int16_t y, uint16_t srcX, uint16_t srcWidth,
+                         MaUWB_BlitMode mode = MAUWB_BLIT_COPY);
+
+    // Frame `frame` of a sprite sheet with frames frameWidth pixels wide
+    static void drawFrame(uint8_t* buffer, int16_t bufferWidth, int16_t bufferHeight, const MaUWB_Bitmap& bitmap,
+                          uint16_t frame, uint16_t frameWidth, int16_t x, int16_t y,
+                          MaUWB_BlitMode mode = MAUWB_BLIT_COPY) {
+        drawPart(buffer, bufferWidth, bufferHeight, bitmap, x, y, frame * frameWidth, frameWidth, mode);
+    }
+
+    // Unpack into RAM in page order (width * pages bytes). Returns the
+    // number of bytes written, at most capacity.
+    static uint16_t unpack(const MaUWB_Bitmap& bitmap, uint8_t* out, uint16_t capacity);
+
+private:
+    // Page-ordered bytes of a bitmap, raw or RLE, read front to back
+    class Reader {
+    public:
+        explicit Reader(const MaUWB_Bitmap& bitmap)
+            : data(bitmap.data), end(bitmap.data + bitmap.size), rle(bitmap.flags & MAUWB_BITMAP_RLE),
+              remaining(0), repeat(false), value(0) {}
+
+        uint8_t next() {
+            if (!rle) {
+                return data < end ? pgm_read_byte(data++) : 0;
+            }
+            if (remaining == 0 && !startRun()) {
+                return 0;
+            }
+            remaining--;
+            if (repeat) {
+                return value;
+            }
+            return data < end ? pgm_read_byte(data++) : 0;
+        }
+
+        void skip(uint16_t count) {
+            if (!rle) {
+                data = count < end - data ? data + count : end;
+                return;
+            }
+            while (count > 0) {
+                if (remaining == 0 && !startRun()) {
+                    return;
+                }
+                uint16_t step = count < remaining ? count : remaining;
+                if (!repeat) {
+                    data = step < end - data ? data + step : end;
+                }
+                remaining -= step;
+                count -= step;
+            }
+        }
+
+    private:
+        bool startRun() {
+            if (data >= end) {
+                return false;
+            }
+            uint8_t control = pgm_read_byte(data++);
+            repeat = control >= 0x80;
+            remaining = repeat ? control - 0x80 + 2 : control + 1;
+            if (repeat) {
+                value = data < end ? pgm_read_byte(data++) : 0;
+            }
+            return true;
+        }
+
+        const uint8_t* data;
+        const uint8_t* end;
+        bool rle;
+        uint16_t remaining;   // Bytes left in the current run
+        bool repeat;
+        uint8_t value;
+    };
+
+    static void write(uint8_t* target, uint8_t bits, uint8_t mask, MaUWB_BlitMode mode) {
+        if (mode == MAUWB_BLIT_COPY) {
+            *target = (*target & ~mask) | (bits & mask);
+        } else if (mode == MAUWB_BLIT_OR) {
+            *target |= bits & mask;
+        } else {
+            *target ^= bits & mask;
+        }
+    }
+};
+
+// Implementation
+
+inline void MaUWB_BitmapBlit::draw(uint8_t* buffer, int16_t bufferWidth, int16_t bufferHeight,
+                                   const MaUWB_Bitmap& bitmap, int16_t x, int16_t y, MaUWB_BlitMode mode) {
+    drawPart(buffer, bufferWidth, bufferHeight, bitmap, x, y, 0, bitmap.width, mode);
+}
+
+inline void MaUWB_BitmapBlit::drawPart(uint8_t* buffer, int16_t bufferWidth, int16_t bufferHeight,
+                                       const MaUWB_Bitmap& bitmap, int16_t x, int16_t y, uint16_t srcX,
+                                       uint16_t srcWidth, MaUWB_BlitMode mode) {
+    if (!buffer || !bitmap.data || srcX >= bitmap.width) return;
+    if (srcWidth > bitmap.width - srcX) srcWidth = bitmap.width - srcX;
+
+    // Columns of the window that land on the screen
+    int16_t firstCol = x < 0 ? -x : 0;
+    int16_t lastCol = srcWidth - 1;
+    if (x + lastCol >= bufferWidth) lastCol = bufferWidth - 1 - x;
+    if (firstCol > lastCol) return;
+
+    int16_t pages = (bitmap.height + 7) / 8;
+    int16_t bufferPages = (bufferHeight + 7) / 8;
+    int16_t shift = y & 7;                  // Row within the page, also for y < 0
+    int16_t targetPage = (y - shift) / 8;   // Page the first source page starts in
+
+    Reader reader(bitmap);
+    for (int16_t page = 0; page < pages; page++, targetPage++) {
+        uint8_t mask = 0xFF;
+        if (page == pages - 1 && (bitmap.height & 7)) {
+            mask = (1 << (bitmap.height & 7)) - 1;   // Rows past the bitmap's height
+        }
+        bool low = targetPage >= 0 && targetPage < bufferPages;
+        bool high = shift && targetPage + 1 >= 0 && targetPage + 1 < bufferPages;
+        if (!low && !high) {
+            reader.skip(bitmap.width);
+            if (targetPage >= bufferPages) return;
+            continue;
+        }
+
+        reader.skip(srcX + firstCol);
+        int32_t row = (int32_t)targetPage * bufferWidth + x;
+        for (int16_t col = firstCol; col <= lastCol; col++) {
+            uint8_t bits = reader.next();
+            if (low) {
+                write(buffer + row + col, bits << shift, mask << shift, mode);
+            }
+            if (high) {
+                write(buffer + row + bufferWidth + col, bits >> (8 - shift), mask >> (8 - shift), mode);
+            }
+        }
+        reader.skip(bitmap.width - srcX - lastCol - 1);
+    }
+}
+
+inline uint16_t MaUWB_BitmapBlit::unpack(const MaUWB_Bitmap& bitmap, uint8_t* out, uint16_t capacity) {
+    uint32_t total = (uint32_t)bitmap.width * ((bitmap.height + 7) / 8);
+    uint16_t count = total < capacity ? (uint16_t)total : capacity;
+    Reader reader(bitmap);
+    for (uint16_t i = 0; i < count; i++) {
+        out[i] = reader.next();
+    }
+    return count;
+}
+
+#endif // MAUWB_BITMAP_H
@@ -0,0 +1,288 @@
+/*
+ * MaUWB_Display.h - Dirty-region rendering for the SSD1306 status screen
+ *
+ * Adafruit_SSD1306::display() sends the whole 1 KB framebuffer on every
+ * call. A status screen changes only a few numbers, so this layer keeps a
+ * list of text fields, redraws a field only when its text changes, and sends
+ * just the page/column windows that were touched.
+ *
+ * The Adafruit framebuffer stays the single picture of the screen: static
+ * parts (header, labels, divider lines) are drawn into it once and sent with
+ * pushAll(); after that push() only sends what the fields changed.
+ *
+ * Usage:
+ *   MaUWB_Display screen;
+ *   screen.begin(&display);
+ *
+ *   display.clearDisplay();
+ *   display.setCursor(0, 12);
+ *   display.print(F("A0: "));
+ *   int8_t a0 = screen.addField(24, 12, 6);
+ *   screen.pushAll();
+ *
+ *   // In loop():
+ *   screen.setNumber(a0, distance, 1);
+ *   screen.push();
+ *
+ * Bitmaps from drawings-for-SD1306 (MaUWB_Bitmap.h) are copied straight into
+ * the framebuffer with drawBitmap() and sent with the next push().
+ *
+ * Fields use the size 1 font (6x8 pixels per character). Assumes display
+ * rotation 0.
+ */
+
+#ifndef MAUWB_DISPLAY_H
+#define MAUWB_DISPLAY_H
+
+#include <Wire.h>
+#include <Adafruit_GFX.h>
+#include <Adafruit_SSD1306.h>
+#include <Arduino.h>
+#include "MaUWB_Bitmap.h"
+
+#ifndef MAUWB_DISPLAY_MAX_FIELDS
+#define MAUWB_DISPLAY_MAX_FIELDS 12
+#endif
+
+// Longest text a field can hold
+#ifndef MAUWB_DISPLAY_FIELD_CHARS
+#define MAUWB_DISPLAY_FIELD_CHARS 12
+#endif
+
+// Bytes per I2C transfer, control byte included. 32 fits every Wire buffer.
+#ifndef MAUWB_DISPLAY_CHUNK
+#define MAUWB_DISPLAY_CHUNK 32
+#endif
+
+// I2C clock for the transfers (the SSD1306 handles 400 kHz)
+#ifndef MAUWB_DISPLAY_I2C_CLOCK
+#define MAUWB_DISPLAY_I2C_CLOCK 400000UL
+#endif
+
+#define MAUWB_DISPLAY_MAX_PAGES 8    // 64 pixel rows
+
+class MaUWB_Display {
+public:
+    MaUWB_Display();
+
+    void begin(Adafruit_SSD1306* display, TwoWire* wire = &Wire, uint8_t address = 0x3C);
+    bool isReady() const { return display != nullptr; }
+
+    // Register a text field at pixel (x, y), chars characters wide.
+    // Returns the field id, or -1 when the table is full.
+    int8_t addField(int16_t x, int16_t y, uint8_t chars);
+    void clearFields() { fieldCount = 0; }
+
+    // Set a field; it is only redrawn when the text differs from what is shown
+    void setText(int8_t field, const char* text);
+    void setNumber(int8_t field, float value, uint8_t decimals, const char* suffix = nullptr);
+
+    // Mark a framebuffer area as changed after drawing into it directly
+    void markDirty(int16_t x, int16_t y, int16_t w, int16_t h);
+
+    // Blit a packed bitmap (or one frame of a sprite sheet) and mark it
+    void drawBitmap(const MaUWB_Bitmap& bitmap, int16_t x, int16_t y, MaUWB_BlitMode mode = MAUWB_BLIT_COPY);
+    void drawFrame(const MaUWB_Bitmap& bitmap, uint16_t frame, uint16_t frameWidth, int16_t x, int16_t y,
+                   MaUWB_BlitMode mode = MAUWB_BLIT_COPY);
+
+    // Send the changed windows / the whole framebuffer
+    void push();
+    void pushAll();
+
+    uint16_t getLastPushBytes() const { return lastPushBytes; }  // Pixel bytes sent by the last push
+
+private:
+    struct Field {
+        int16_t x, y;
+        uint8_t chars;
+        char text[MAUWB_DISPLAY_FIELD_CHARS + 1];
+    };
+
+    Adafruit_SSD1306* display;
+    TwoWire* wire;
+    uint8_t address;
+
+    Field fields[MAUWB_DISPLAY_MAX_FIELDS];
+    uint8_t fieldCount;
+
+    // Changed column span per page; colStart > colEnd when clean
+    uint8_t colStart[MAUWB_DISPLAY_MAX_PAGES];
+    uint8_t colEnd[MAUWB_DISPLAY_MAX_PAGES];
+    uint16_t lastPushBytes;
+
+    uint8_t pageCount() const;
+    void clearDirty();
+    void sendWindow(uint8_t firstPage, uint8_t lastPage, uint8_t firstCol, uint8_t lastCol);
+};
+
+// Implementation
+
+inline MaUWB_Display::MaUWB_Display()
+    : display(nullptr), wire(nullptr), address(0x3C), fieldCount(0), lastPushBytes(0) {
+    clearDirty();
+}
+
+inline void MaUWB_Display::begin(Adafruit_SSD1306* display, TwoWire* wire, uint8_t address) {
+    this->display = display;
+    this->wire = wire;
+    this->address = address;
+    fieldCount = 0;
+    clearDirty();
+}
+
+inline int8_t MaUWB_Display::addField(int16_t x, int16_t y, uint8_t chars) {
+    if (fieldCount >= MAUWB_DISPLAY_MAX_FIELDS) return -1;
+    if (chars > MAUWB_DISPLAY_FIELD_CHARS) chars = MAUWB_DISPLAY_FIELD_CHARS;
+
+    Field& field = fields[fieldCount];
+    field.x = x;
+    field.y = y;
+    field.chars = chars;
+    field.text[0] = '\0';
+    return fieldCount++;
+}
+
+inline void MaUWB_Display::setText(int8_t id, const char* text) {
+    if (!display || id < 0 || id >= fieldCount) return;
+
+    Field& field = fields[id];
+    char clipped[MAUWB_DISPLAY_FIELD_CHARS + 1];
+    strncpy(clipped, text, field.chars);
+    clipped[field.chars] = '\0';
+
+    if (strcmp(clipped, field.text) == 0) return;
+    strcpy(field.text, clipped);
+
+    int16_t width = field.chars * 6;
+    display->fillRect(field.x, field.y, width, 8, SSD1306_BLACK);
+    display->setTextSize(1);
+    display->setTextColor(SSD1306_WHITE);
+    display->setCursor(field.x, field.y);
+    display->print(field.text);
+    markDirty(field.x, field.y, width, 8);
+}
+
+inline void MaUWB_Display::setNumber(int8_t id, float value, uint8_t decimals, const char* suffix) {
+    char text[MAUWB_DISPLAY_FIELD_CHARS + 8];
+    int length = snprintf(text, sizeof(text), "%.*f", decimals, value);
+    if (suffix && length > 0 && length < (int)sizeof(text)) {
+        strncat(text, suffix, sizeof(text) - length - 1);
+    }
+    setText(id, text);
+}
+
+inline void MaUWB_Display::markDirty(int16_t x, int16_t y, int16_t w, int16_t h) {
+    if (!display) return;
+
+    // Clip to the screen
+    int16_t x0 = x < 0 ? 0 : x;
+    int16_t y0 = y < 0 ? 0 : y;
+    int16_t x1 = x + w - 1;
+    int16_t y1 = y + h - 1;
+    if (x1 >= display->width()) x1 = display->width() - 1;
+    if (y1 >= display->height()) y1 = display->height() - 1;
+    if (x0 > x1 || y0 > y1) return;
+
+    for (int16_t page = y0 / 8; page <= y1 / 8 && page < MAUWB_DISPLAY_MAX_PAGES; page++) {
+        if (x0 < colStart[page]) colStart[page] = x0;
+        if (x1 > colEnd[page]) colEnd[page] = x1;
+    }
+}
+
+inline void MaUWB_Display::drawBitmap(const MaUWB_Bitmap& bitmap, int16_t x, int16_t y, MaUWB_BlitMode mode) {
+    if (!display) return;
+    MaUWB_BitmapBlit::draw(display->getBuffer(), display->width(), display->height(), bitmap, x, y, mode);
+    markDirty(x, y, bitmap.width, bitmap.height);
+}
+
+inline void MaUWB_Display::drawFrame(const MaUWB_Bitmap& bitmap, uint16_t frame, uint16_t frameWidth, int16_t x,
+                                     int16_t y, MaUWB_BlitMode mode) {
+    if (!display) return;
+    MaUWB_BitmapBlit::drawFrame(display->getBuffer(), display->width(), display->height(), bitmap, frame,
+                                frameWidth, x, y, mode);
+    markDirty(x, y, frameWidth, bitmap.height);
+}
+
+inline void MaUWB_Display::push() {
+    lastPushBytes = 0;
+    if (!display) return;
+
+    uint8_t pages = pageCount();
+    for (uint8_t page = 0; page < pages; page++) {
+        if (colStart[page] > colEnd[page]) continue;
+
+        // Neighbouring pages with the same span go out as one window
+        uint8_t last = page;
+        while (last + 1 < pages && colStart[last + 1] == colStart[page] &&
+               colEnd[last + 1] == colEnd[page]) {
+            last++;
+        }
+
+        sendWindow(page, last, colStart[page], colEnd[page]);
+        page = last;
+    }
+
+    clearDirty();
+}
+
+inline void MaUWB_Display::pushAll() {
+    if (!display) return;
+    display->display();
+    lastPushBytes = (uint16_t)display->width() * pageCount();
+    clearDirty();
+}
+
+inline uint8_t MaUWB_Display::pageCount() const {
+    uint8_t pages = (display->height() + 7) / 8;
+    return pages > MAUWB_DISPLAY_MAX_PAGES ? MAUWB_DISPLAY_MAX_PAGES : pages;
+}
+
+inline void MaUWB_Display::clearDirty() {
+    for (uint8_t page = 0; page < MAUWB_DISPLAY_MAX_PAGES; page++) {
+        colStart[page] = 0xFF;
+        colEnd[page] = 0;
+    }
+}
+
+// Set the SSD1306 address window (horizontal addressing, as set up by the
+// Adafruit driver) and stream the framebuffer bytes that fall inside it
+inline void MaUWB_Display::sendWindow(uint8_t firstPage, uint8_t lastPage,
+                                      uint8_t firstCol, uint8_t lastCol) {
+    const uint8_t* buffer = display->getBuffer();
+    int16_t width = display->width();
+
+    wire->setClock(MAUWB_DISPLAY_I2C_CLOCK);
+
+    wire->beginTransmission(address);
+    wire->write((uint8_t)0x00);           // Command stream
+    wire->write((uint8_t)SSD1306_COLUMNADDR);
+    wire->write(firstCol);
+    wire->write(lastCol);
+    wire->write((uint8_t)SSD1306_PAGEADDR);
+    wire->write(firstPage);
+    wire->write(lastPage);
+    wire->endTransmission();
+
+    uint8_t inChunk = 0;
+    for (uint8_t page = firstPage; page <= lastPage; page++) {
+        const uint8_t* row = buffer + page * width;
+        for (uint16_t col = firstCol; col <= lastCol; col++) {
+            if (inChunk == 0) {
+                wire->beginTransmission(address);
+                wire->write((uint8_t)0x40);   // Data stream
+                inChunk = 1;
+            }
+            wire->write(row[col]);
+            lastPushBytes++;
+            if (++inChunk == MAUWB_DISPLAY_CHUNK) {
+                wire->endTransmission();
+                inChunk = 0;
+            }
+        }
+    }
+    if (inChunk) {
+        wire->endTransmission();
+    }
+}
+
+#endif // MAUWB_DISPLAY_H
@@ -0,0 +1,316 @@
+/*
+ * MaUWB_Log.h - Deferred, rate-limited logging off the ranging path
+ *
+ * log() does not format or write anything: it stores the format pointer, a
+ * millis() timestamp and up to MAUWB_LOG_ARGS arguments in a fixed-size
+ * record and pushes it into a preallocated ring buffer. drain() formats
+ * the queued records and writes them out later, from loop() once the fix
+ * is done or from a low-priority task, so a slow USB-CDC host never stalls
+ * the parser or solver. A full buffer drops the record and counts it.
+ *
+ * Formats must be string literals (or otherwise outlive the record): only
+ * the pointer is kept, and on the ESP32 literals already live in flash. A
+ * string argument (%s) is copied into the record, up to MAUWB_LOG_TEXT - 1
+ * characters; one per record. Length modifiers (%ld, %lu) are accepted and
+ * ignored, all integers are 32 bit.
+ *
+ * Each category (0..MAUWB_LOG_CATEGORIES-1) can be given a rate limit, a
+ * token bucket of so many records per second with a burst allowance. Records
+ * over the limit are dropped at log() and counted per category.
+ *
+ * Usage:
+ *   MaUWB_Log logger;
+ *   logger.setRateLimit(LOG_MODULE, 10, 5);                  // 10 per second, bursts of 5
+ *   logger.log(LOG_POSITION, "Position: X=%.2f, Y=%.2f", x, y);
+ *   // Later, away from the hot path:
+ *   logger.drain(Serial);
+ *
+ * The buffer is a MaUWB_SpscQueue: log() from one task (the one that runs
+ * the ranging loop) and drain() from one task.
+ */
+
+#ifndef MAUWB_LOG_H
+#define MAUWB_LOG_H
+
+#include <Arduino.h>
+#include "MaUWB_SpscQueue.h"
+
+// Records the buffer holds (power of two)
+#ifndef MAUWB_LOG_RECORDS
+#define MAUWB_LOG_RECORDS 16
+#endif
+
+// Numeric arguments per record
+#ifndef MAUWB_LOG_ARGS
+#define MAUWB_LOG_ARGS 4
+#endif
+
+// Room for the string argument, including terminator
+#ifndef MAUWB_LOG_TEXT
+#define MAUWB_LOG_TEXT 40
+#endif
+
+// Categories with their own rate limit
+#ifndef MAUWB_LOG_CATEGORIES
+#define MAUWB_LOG_CATEGORIES 8
+#endif
+
+// Longest formatted line
+#ifndef MAUWB_LOG_LINE_MAX
+#define MAUWB_LOG_LINE_MAX 128
+#endif
+
+// Records written per drain() call by default
+#ifndef MAUWB_LOG_DRAIN_MAX
+#define MAUWB_LOG_DRAIN_MAX 4
+#endif
+
+struct MaUWB_LogRecord {
+    uint32_t time;                    // millis() at log()
+    const char* format;
+    uint8_t category;
+    uint8_t argCount;
+    uint8_t floats;                   // Bit per argument stored as a float
+    union {
+        int32_t i;
+        float f;
+    } args[MAUWB_LOG_ARGS];
+    char text[MAUWB_LOG_TEXT];        // The %s argument
+};
+
+class MaUWB_Log {
+public:
+    MaUWB_Log();
+
+    // Queue a record. Returns false if it was rate limited or the buffer is full.
+    template <typename... Args>
+    bool log(uint8_t category, const char* format, Args... args) {
+        MaUWB_LogRecord record;
+        if (!begin(record, category, format)) {
+            return false;
+        }
+        int expand[] = {0, (add(record, args), 0)...};
+        (void)expand;
+        return queue.push(record);
+    }
+
+    // Allow rate records per second in the category, bursts of up to burst.
+    // A rate of 0 removes the limit.
+    void setRateLimit(uint8_t category, uint16_t rate, uint16_t burst = 1);
+
+    // Write up to maxRecords queued records, one line each. With onlyIfRoom
+    // it stops once the output's transmit buffer could not take a full line
+    // without blocking (for outputs that report availableForWrite()).
+    // Returns the number written.
+    uint8_t drain(Print& out, uint8_t maxRecords = MAUWB_LOG_DRAIN_MAX, bool onlyIfRoom = false);
+
+    // Prefix each line with its millis() timestamp
+    void setTimestamps(bool enable) { timestamps = enable; }
+
+    // Format a record into out; returns the length
+    static size_t format(const MaUWB_LogRecord& record, char* out, size_t size);
+
+    uint16_t pending() const { return queue.size(); }
+
+    // Records lost because the buffer was full
+    uint32_t getDropped() const { return queue.getDropped(); }
+
+    // Records of the category dropped by its rate limit
+    uint32_t getRateLimited(uint8_t category) const;
+
+private:
+    struct Limit {
+        uint16_t rate;         // Records per second, 0 = unlimited
+        uint16_t burst;
+        uint32_t tokens;       // In thousandths of a record
+        uint32_t refilled;     // millis() of the last refill
+        uint32_t limited;
+    };
+
+    MaUWB_SpscQueue<MaUWB_LogRecord, MAUWB_LOG_RECORDS> queue;
+    Limit limits[MAUWB_LOG_CATEGORIES];
+    uint32_t reportedDrops;    // Drops already announced by drain()
+    bool timestamps;
+
+    bool begin(MaUWB_LogRecord& record, uint8_t category, const char* format);
+
+    static void add(MaUWB_LogRecord& record, int value) { addInteger(record, value); }
+    static void add(MaUWB_LogRecord& record, unsigned int value) { addInteger(record, (int32_t)value); }
+    static void add(MaUWB_LogRecord& record, long value) { addInteger(record, (int32_t)value); }
+    static void add(MaUWB_LogRecord& record, unsigned long value) { addInteger(record, (int32_t)value); }
+    static void add(MaUWB_LogRecord& record, double value) { addFloat(record, (float)value); }
+    static void add(MaUWB_LogRecord& record, float value) { addFloat(record, value); }
+    static void add(MaUWB_LogRecord& record, const char* value);
+    static void addInteger(MaUWB_LogRecord& record, int32_t value);
+    static void addFloat(MaUWB_LogRecord& record, float value);
+};
+
+// Implementation
+
+inline MaUWB_Log::MaUWB_Log() : reportedDrops(0), timestamps(false) {
+    for (uint8_t i = 0; i < MAUWB_LOG_CATEGORIES; i++) {
+        limits[i].rate = 0;
+        limits[i].burst = 1;
+        limits[i].tokens = 0;
+        limits[i].refilled = 0;
+        limits[i].limited = 0;
+    }
+}
+
+inline void MaUWB_Log::setRateLimit(uint8_t category, uint16_t rate, uint16_t burst) {
+    if (category >= MAUWB_LOG_CATEGORIES) {
+        return;
+    }
+    Limit& limit = limits[category];
+    limit.rate = rate;
+    limit.burst = burst > 0 ? burst : 1;
+    limit.tokens = (uint32_t)limit.burst * 1000;
+    limit.refilled = millis();
+}
+
+inline uint32_t MaUWB_Log::getRateLimited(uint8_t category) const {
+    return category < MAUWB_LOG_CATEGORIES ? limits[category].limited : 0;
+}
+
+// Stamp the record and charge the category's bucket
+inline bool MaUWB_Log::begin(MaUWB_LogRecord& record, uint8_t category, const char* format) {
+    uint32_t now = millis();
+    if (category < MAUWB_LOG_CATEGORIES && limits[category].rate > 0) {
+        Limit& limit = limits[category];
+        uint32_t full = (uint32_t)limit.burst * 1000;
+        uint32_t elapsed = now - limit.refilled;
+        limit.refilled = now;
+        // rate per second is rate thousandths per ms
+        uint64_t tokens = limit.tokens + (uint64_t)elapsed * limit.rate;
+        limit.tokens = tokens < full ? (uint32_t)tokens : full;
+        if (limit.tokens < 1000) {
+            limit.limited++;
+            return false;
+        }
+        limit.tokens -= 1000;
+    }
+
+    record.time = now;
+    record.format = format;
+    record.category = category;
+    record.argCount = 0;
+    record.floats = 0;
+    record.text[0] = '\0';
+    return true;
+}
+
+inline void MaUWB_Log::addInteger(MaUWB_LogRecord& record, int32_t value) {
+    if (record.argCount < MAUWB_LOG_ARGS) {
+        record.args[record.argCount++].i = value;
+    }
+}
+
+inline void MaUWB_Log::addFloat(MaUWB_LogRecord& record, float value) {
+    if (record.argCount < MAUWB_LOG_ARGS) {
+        record.floats |= 1 << record.argCount;
+        record.args[record.argCount++].f = value;
+    }
+}
+
+// The string itself goes into the record's text; it still takes an
+// argument slot so the ones after it line up with the format
+inline void MaUWB_Log::add(MaUWB_LogRecord& record, const char* value) {
+    if (record.text[0] == '\0' && value) {
+        strncpy(record.text, value, MAUWB_LOG_TEXT - 1);
+        record.text[MAUWB_LOG_TEXT - 1] = '\0';
+    }
+    addInteger(record, 0);
+}
+
+inline size_t MaUWB_Log::format(const MaUWB_LogRecord& record, char* out, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+
+    size_t length = 0;
+    uint8_t arg = 0;
+    const char* f = record.format;
+    while (*f && length + 1 < size) {
+        if (*f != '%') {
+            out[length++] = *f++;
+            continue;
+        }
+        if (f[1] == '%') {
+            out[length++] = '%';
+            f += 2;
+            continue;
+        }
+
+        // Copy flags, width and precision; drop length modifiers
+        char spec[12];
+        uint8_t n = 0;
+        spec[n++] = *f++;
+        while (*f && !strchr("diouxXcsfFeEgG", *f)) {
+            if (!strchr("lhzjt", *f) && n < sizeof(spec) - 2) {
+                spec[n++] = *f;
+            }
+            f++;
+        }
+        if (!*f) {
+            break;
+        }
+        char conversion = *f++;
+        spec[n++] = conversion;
+        spec[n] = '\0';
+
+        bool isFloat = arg < record.argCount && (record.floats & (1 << arg));
+        float real = arg < record.argCount ? (isFloat ? record.args[arg].f : record.args[arg].i) : 0;
+        int32_t integer = arg < record.argCount ? (isFloat ? (int32_t)record.args[arg].f : record.args[arg].i) : 0;
+        arg++;
+
+        int written;
+        if (conversion == 's') {
+            written = snprintf(out + length, size - length, spec, record.text);
+        } else if (strchr("fFeEgG", conversion)) {
+            written = snprintf(out + length, size - length, spec, (double)real);
+        } else {
+            written = snprintf(out + length, size - length, spec, (int)integer);
+        }
+        if (written < 0) {
+            break;
+        }
+        length += (size_t)written < size - length ? (size_t)written : size - length - 1;
+    }
+    out[length] = '\0';
+    return length;
+}
+
+inline uint8_t MaUWB_Log::drain(Print& out, uint8_t maxRecords, bool onlyIfRoom) {
+    // A longest line plus a timestamp
+    const int room = MAUWB_LOG_LINE_MAX + 12;
+    char line[MAUWB_LOG_LINE_MAX];
+    uint8_t written = 0;
+
+    uint32_t dropped = getDropped();
+    if (dropped != reportedDrops && (!onlyIfRoom || out.availableForWrite() >= room)) {
+        out.print(F("[log] "));
+        out.print(dropped - reportedDrops);
+        out.println(F(" records dropped, buffer full"));
+        reportedDrops = dropped;
+    }
+
+    MaUWB_LogRecord record;
+    while (written < maxRecords) {
+        if (onlyIfRoom && out.availableForWrite() < room) {
+            break;
+        }
+        if (!queue.pop(record)) {
+            break;
+        }
+        if (timestamps) {
+            out.print(record.time);
+            out.print(' ');
+        }
+        format(record, line, sizeof(line));
+        out.println(line);
+        written++;
+    }
+    return written;
+}
+
+#endif // MAUWB_LOG_H
@@ -0,0 +1,280 @@
+/*
+ * MaUWB_Zones.h - Precomputed zone map for position-triggered actions
+ *
+ * Rectangles and polygons are rasterised once at setup into a coarse grid
+ * over the room. Each cell holds a bit per zone, so finding every zone a
+ * fix is in is one array read, however many zones there are (up to
+ * MAUWB_ZONE_MAX).
+ *
+ * A second grid holds each zone grown by the hysteresis margin. A zone is
+ * entered when the fix lands in its cell set and only left once the fix is
+ * outside the grown one, so jitter along an edge does not toggle it. On top
+ * of that a change has to be seen on MAUWB_ZONE_DEBOUNCE fixes in a row
+ * before the enter / exit callback runs.
+ *
+ * Usage:
+ *   MaUWB_ZoneMap zones;
+ *   zones.begin(0, 0, 380, 600);               // Room bounds (cm)
+ *   zones.addRectangle(0, -50, 400, 430, 650); // Zone 0: the far end
+ *   zones.setCallback(handleZone);             // void handleZone(uint8_t zone, bool entered, void*)
+ *   // For every fix:
+ *   zones.update(x, y);
+ *
+ * Resolution is the cell size: edges are placed to the nearest cell, which
+ * is sound for triggers given the ranging noise. A fix outside the grid
+ * counts as the nearest edge cell, so a zone drawn over a wall carries on
+ * past it and fixes outside the room still count. The grids take
+ * 2 x MAUWB_ZONE_CELLS x 2 bytes: 10 KB by default, enough for a 380 x 600 cm
+ * room at 10 cm. A larger room gets larger cells.
+ *
+ * Only needs the C math library, so it also builds on a desktop compiler.
+ */
+
+#ifndef MAUWB_ZONES_H
+#define MAUWB_ZONES_H
+
+#include <stdint.h>
+#include <math.h>
+
+// Zones per map, one bit each
+#define MAUWB_ZONE_MAX 16
+
+// Cells per grid
+#ifndef MAUWB_ZONE_CELLS
+#define MAUWB_ZONE_CELLS 2560
+#endif
+
+// Default cell size (cm)
+#ifndef MAUWB_ZONE_CELL_CM
+#define MAUWB_ZONE_CELL_CM 10.0f
+#endif
+
+// Default distance a fix must move past a zone's edge to leave it (cm)
+#ifndef MAUWB_ZONE_HYSTERESIS
+#define MAUWB_ZONE_HYSTERESIS 15.0f
+#endif
+
+// Default fixes in a row a zone change must be seen on
+#ifndef MAUWB_ZONE_DEBOUNCE
+#define MAUWB_ZONE_DEBOUNCE 2
+#endif
+
+class MaUWB_ZoneMap {
+public:
+    typedef void (*ZoneCallback)(uint8_t zone, bool entered, void* context);
+
+    MaUWB_ZoneMap();
+
+    // Area the grid covers (cm). Clears all zones. Fixes outside take the
+    // zones of the nearest edge cell.
+    void begin(float minX, float minY, float maxX, float maxY, float cellSize = MAUWB_ZONE_CELL_CM);
+
+    // Hysteresis margin (cm) for the zones added after this call, and the
+    // fixes in a row a change must be seen on (1 = no debounce)
+    void setHysteresis(float margin) { this->margin = margin; }
+    void setDebounce(uint8_t fixes) { debounce = fixes > 0 ? fixes : 1; }
+
+    // Add zone id (0..MAUWB_ZONE_MAX-1); several shapes can share an id.
+    // Returns false without begin() or for a bad id.
+    bool addRectangle(uint8_t zone, float x0, float y0, float x1, float y1);
+    bool addPolygon(uint8_t zone, const float* xs, const float* ys, uint8_t points);
+    void clearZones();
+
+    void setCallback(ZoneCallback callback, void* context = nullptr);
+
+    // Feed a fix; runs the callback for every zone entered or left
+    void update(float x, float y);
+
+    // Zones the fix is in now, after hysteresis and debounce (bit per zone)
+    uint16_t getActive() const { return active; }
+    bool isInZone(uint8_t zone) const { return zone < MAUWB_ZONE_MAX && (active & (1 << zone)); }
+
+    // Zones whose cells contain (x, y), without hysteresis
+    uint16_t lookup(float x, float y) const { return at(inner, x, y); }
+
+    bool hasZones() const { return zoneMask != 0; }
+    float getCellSize() const { return cellSize; }
+
+private:
+    float originX, originY;
+    float cellSize;
+    float inverseCell;
+    uint16_t columns, rows;
+    float margin;
+    uint8_t debounce;
+
+    uint16_t inner[MAUWB_ZONE_CELLS];   // Zone bits per cell
+    uint16_t outer[MAUWB_ZONE_CELLS];   // Zone bits per cell, zones grown by their margin
+    uint16_t zoneMask;                  // Zones defined
+
+    uint16_t active;
+    uint16_t candidate;                 // Set waiting out the debounce
+    uint8_t candidateCount;
+
+    ZoneCallback callback;
+    void* callbackContext;
+
+    uint16_t at(const uint16_t* grid, float x, float y) const;
+    static bool contains(const float* xs, const float* ys, uint8_t points, float x, float y);
+    static float edgeDistance(const float* xs, const float* ys, uint8_t points, float x, float y);
+};
+
+// Implementation
+
+inline MaUWB_ZoneMap::MaUWB_ZoneMap()
+    : originX(0), originY(0), cellSize(MAUWB_ZONE_CELL_CM), inverseCell(1 / MAUWB_ZONE_CELL_CM),
+      columns(0), rows(0), margin(MAUWB_ZONE_HYSTERESIS), debounce(MAUWB_ZONE_DEBOUNCE), zoneMask(0),
+      active(0), candidate(0), candidateCount(0), callback(nullptr), callbackContext(nullptr) {
+}
+
+inline void MaUWB_ZoneMap::begin(float minX, float minY, float maxX, float maxY, float cellSize) {
+    if (cellSize <= 0) {
+        cellSize = MAUWB_ZONE_CELL_CM;
+    }
+
+    // Grow the cells until the room fits the grid
+    float width = maxX > minX ? maxX - minX : 0;
+    float height = maxY > minY ? maxY - minY : 0;
+    for (;;) {
+        uint32_t cols = (uint32_t)(width / cellSize) + 1;
+        uint32_t rws = (uint32_t)(height / cellSize) + 1;
+        if (cols * rws <= MAUWB_ZONE_CELLS) {
+            columns = cols;
+            rows = rws;
+            break;
+        }
+        cellSize *= 1.25f;
+    }
+
+    originX = minX;
+    originY = minY;
+    this->cellSize = cellSize;
+    inverseCell = 1 / cellSize;
+    clearZones();
+}
+
+inline void MaUWB_ZoneMap::clearZones() {
+    for (uint16_t i = 0; i < MAUWB_ZONE_CELLS; i++) {
+        inner[i] = 0;
+        outer[i] = 0;
+    }
+    zoneMask = 0;
+    active = 0;
+    candidate = 0;
+    candidateCount = 0;
+}
+
+inline void MaUWB_ZoneMap::setCallback(ZoneCallback callback, void* context) {
+    this->callback = callback;
+    callbackContext = context;
+}
+
+inline bool MaUWB_ZoneMap::addRectangle(uint8_t zone, float x0, float y0, float x1, float y1) {
+    const float xs[4] = {x0, x1, x1, x0};
+    const float ys[4] = {y0, y0, y1, y1};
+    return addPolygon(zone, xs, ys, 4);
+}
+
+// Each cell whose centre lies in the polygon gets the zone's bit; cells
+// whose centre is within the margin of it get the bit in the outer grid
+inline bool MaUWB_ZoneMap::addPolygon(uint8_t zone, const float* xs, const float* ys, uint8_t points) {
+    if (zone >= MAUWB_ZONE_MAX || columns == 0 || points < 3) {
+        return false;
+    }
+
+    const uint16_t bit = 1 << zone;
+    for (uint16_t row = 0; row < rows; row++) {
+        float y = originY + (row + 0.5f) * cellSize;
+        for (uint16_t column = 0; column < columns; column++) {
+            float x = originX + (column + 0.5f) * cellSize;
+            uint16_t cell = row * columns + column;
+            if (contains(xs, ys, points, x, y)) {
+                inner[cell] |= bit;
+                outer[cell] |= bit;
+            } else if (margin > 0 && edgeDistance(xs, ys, points, x, y) <= margin) {
+                outer[cell] |= bit;
+            }
+        }
+    }
+    zoneMask |= bit;
+    return true;
+}
+
+inline uint16_t MaUWB_ZoneMap::at(const uint16_t* grid, float x, float y) const {
+    float u = (x - originX) * inverseCell;
+    float v = (y - originY) * inverseCell;
+    if (columns == 0 || !(u == u && v == v)) {
+        return 0;   // No begin(), or NaN
+    }
+    // Past the edge: the edge cell
+    uint16_t column = u <= 0 ? 0 : (u >= columns ? columns - 1 : (uint16_t)u);
+    uint16_t row = v <= 0 ? 0 : (v >= rows ? rows - 1 : (uint16_t)v);
+    return grid[row * columns + column];
+}
+
+inline void MaUWB_ZoneMap::update(float x, float y) {
+    if (zoneMask == 0) {
+        return;
+    }
+
+    // Stay in a zone while within its margin; enter only on its own cells
+    uint16_t next = (active & at(outer, x, y)) | at(inner, x, y);
+    if (next == active) {
+        candidateCount = 0;
+        return;
+    }
+
+    if (next != candidate || candidateCount == 0) {
+        candidate = next;
+        candidateCount = 1;
+    } else if (candidateCount < 255) {
+        candidateCount++;
+    }
+    if (candidateCount < debounce) {
+        return;
+    }
+
+    uint16_t changed = active ^ next;
+    active = next;
+    candidateCount = 0;
+    if (!callback) {
+        return;
+    }
+    for (uint8_t zone = 0; changed; zone++, changed >>= 1) {
+        if (changed & 1) {
+            callback(zone, (active & (1 << zone)) != 0, callbackContext);
+        }
+    }
+}
+
+// Even-odd rule
+inline bool MaUWB_ZoneMap::contains(const float* xs, const float* ys, uint8_t points, float x, float y) {
+    bool inside = false;
+    for (uint8_t i = 0, j = points - 1; i < points; j = i++) {
+        if ((ys[i] > y) != (ys[j] > y) &&
+            x < (xs[j] - xs[i]) * (y - ys[i]) / (ys[j] - ys[i]) + xs[i]) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+inline float MaUWB_ZoneMap::edgeDistance(const float* xs, const float* ys, uint8_t points, float x, float y) {
+    float best = -1;
+    for (uint8_t i = 0, j = points - 1; i < points; j = i++) {
+        float ex = xs[i] - xs[j];
+        float ey = ys[i] - ys[j];
+        float length2 = ex * ex + ey * ey;
+        float t = length2 > 0 ? ((x - xs[j]) * ex + (y - ys[j]) * ey) / length2 : 0;
+        t = t < 0 ? 0 : (t > 1 ? 1 : t);
+        float dx = x - (xs[j] + t * ex);
+        float dy = y - (ys[j] + t * ey);
+        float distance = sqrtf(dx * dx + dy * dy);
+        if (best < 0 || distance < best) {
+            best = distance;
+        }
+    }
+    return best;
+}
+
+#endif // MAUWB_ZONES_H
@@ -15,6 +15,12 @@ Libraries needed:
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
 #include <Arduino.h>
+#include "MaUWB_AT.h"
+#include "MaUWB_Display.h"
+#include "MaUWB_Scheduler.h"
+#include "MaUWB_Solver.h"
+#include "MaUWB_Log.h"
+#include "MaUWB_Zones.h"
 
 
 
@@ -27,8 +33,9 @@ Libraries needed:
 #define UWB_TAG_COUNT 10
 #define DISPLAY_UPDATE_INTERVAL 50  // Update display every 100ms
 
-// Data request rate in milliseconds
-unsigned long refreshRate = 50;  // Request range data every 500ms
+// Shortest gap between explicit range polls in milliseconds. With
+// auto-report on, polls are only sent if the module stops reporting.
+unsigned long refreshRate = 50;
 
 // Position filtering configuration
 #define POSITION_HISTORY_LENGTH 1  // Number of positions to average
@@ -45,12 +52,36 @@ unsigned long refreshRate = 50;  // Request range data every 500ms
 
 Adafruit_SSD1306 display(128, 64, &Wire, -1);
 
+// Status screen; only changed fields are sent over I2C
+MaUWB_Display screen;
+int8_t distanceFields[4];
+int8_t xField, yField;
+
+// Non-blocking AT command link to the UWB module
+MaUWB_AT uwbAt;
+
+// Log lines are queued on the ranging path and written at the end of loop()
+MaUWB_Log logger;
+enum LogCategory {
+    LOG_POSITION,   // Ranges and position of each fix
+    LOG_MODULE,     // Module lines that are not range reports
+    LOG_STATUS      // Fixes that could not be used
+};
+
+// Listens to the module's auto-reports, polls only when they stop
+MaUWB_RangeScheduler rangeScheduler;
+
 //LED Pin
 int LEDpin = 5;
 
 //threshold
 int yBuzzThreshold = 100;
 
+// Zones the tag reacts to, rasterised once in setup(). Add more with
+// zones.addRectangle() / addPolygon(); each fix costs the same lookup.
+#define BUZZ_ZONE 0
+MaUWB_ZoneMap zones;
+
 // Distance measurements to anchors (using anchors 0-3)
 float dist_to_a0 = 0.0;
 float dist_to_a1 = 0.0;
@@ -65,6 +96,14 @@ float dist_to_a3 = 0.0;
 const float anchor_x[4] = {0, 0, 380, 380};
 const float anchor_y[4] = {0, 600, 600, 0};
 
+// Mounting height of each anchor and height of the tag (cm). When they
+// differ, the ranges are projected onto the tag's plane before solving.
+const float anchor_z[4] = {0, 0, 0, 0};
+const float tag_z = 0;
+
+// Anchor geometry cache for the position solve, loaded in setup()
+MaUWB_Solver solver;
+
 // Position of the tag
 float positionX = 0.0;
 float positionY = 0.0;
@@ -79,10 +118,25 @@ bool position_history_filled = false;
 long last_display_update = 0;
 bool new_data = false;
 bool display_initialized = false;
+bool layout_drawn = false;
 
 void setup()
 {
+    // Load the anchor layout; the solver rebuilds its geometry cache once
+    solver.setAnchorCount(4);
+    for (uint8_t i = 0; i < 4; i++) {
+        solver.setAnchor(i, anchor_x[i], anchor_y[i], anchor_z[i]);
+    }
+    solver.setTagHeight(tag_z);
+    
     pinMode(LEDpin, OUTPUT);
+    
+    // Everything beyond the threshold. The zone is drawn over the walls, and
+    // fixes outside the grid count as its edge cells, so they stay in it as
+    // with y >= threshold.
+    zones.begin(0, 0, anchor_x[2], anchor_y[1]);
+    zones.addRectangle(BUZZ_ZONE, -100, yBuzzThreshold, anchor_x[2] + 100, anchor_y[1] + 100);
+    zones.setCallback(handleZone);
 
     pinMode(RESET, OUTPUT);
     digitalWrite(RESET, HIGH);
@@ -93,7 +147,15 @@ void setup()
     SERIAL_LOG.println(F("\n\n----- ESP32S3 UWB TAG - DISTANCE & POSITION DISPLAY -----"));
     
     // Initialize UWB module serial
+    SERIAL_AT.setRxBufferSize(MAUWB_UART_RX_BUFFER);   // Room for bursts while the display updates
     SERIAL_AT.begin(115200, SERIAL_8N1, IO_RXD2, IO_TXD2);
+    uwbAt.begin(SERIAL_AT);
+    uwbAt.setDebugOutput(&SERIAL_LOG);
+    uwbAt.setLineHandler(handleUwbLine);
+    uwbAt.setReportHandler(handleUwbReport);
+    logger.setRateLimit(LOG_MODULE, 20, 20);
+    logger.setRateLimit(LOG_STATUS, 2, 2);    // A missing anchor would otherwise repeat on every report
+    logger.setRateLimit(LOG_POSITION, 3, 3);  // About one fix a second: distances, raw and filtered
     SERIAL_LOG.println(F("Serial2 initialized"));
 
     // Initialize I2C for display
@@ -110,6 +172,7 @@ void setup()
     }
     
     display_initialized = true;
+    screen.begin(&display);
     SERIAL_LOG.println(F("SSD1306 display initialized successfully"));
     
     display.clearDisplay();
@@ -127,26 +190,32 @@ void setup()
     
     // Configure the UWB module as a tag
     SERIAL_LOG.println(F("Configuring UWB module as TAG..."));
-    SERIAL_AT.println("AT");
-    
-    sendData("AT?", 500, 1);
-    sendData("AT+RESTORE", 1000, 1);
-
-    // Configure as tag (role=0)
-    String cfg = "AT+SETCFG=" + String(UWB_INDEX) + ",0,1,1";  // ID,role,freq,filter
-    SERIAL_LOG.print(F("Config: "));
-    SERIAL_LOG.println(cfg);
-    sendData(cfg, 500, 1);
-    
-    // Set capacity
-    String cap = "AT+SETCAP=" + String(UWB_TAG_COUNT) + ",10,1";  // count,time,mode
-    SERIAL_LOG.print(F("Capacity: "));
-    SERIAL_LOG.println(cap);
-    sendData(cap, 500, 1);
+    MaUWB_ModuleConfig moduleConfig;
+    moduleConfig.id = UWB_INDEX;
+    moduleConfig.role = 0;              // Tag
+    moduleConfig.rate = 1;              // 6.8 Mbps
+    moduleConfig.filter = 1;
+    moduleConfig.capacity = UWB_TAG_COUNT;
+    moduleConfig.slotMs = MAUWB_SLOT_MS;
+    moduleConfig.extMode = 1;
+    moduleConfig.report = 1;
+    moduleConfig.antennaDelay = 0;      // Calibrated on the anchors
+    
+    // Only rewrites and restarts the module if its stored settings differ
+    MaUWB_AT::Result configured = uwbAt.configure(moduleConfig);
+    if (configured == MaUWB_AT::AT_MATCH) {
+        SERIAL_LOG.println(F("Module already configured"));
+    } else if (configured == MaUWB_AT::AT_TIMEOUT) {
+        SERIAL_LOG.println(F("UWB module not answering"));
+    } else if (configured != MaUWB_AT::AT_OK) {
+        SERIAL_LOG.println(F("UWB module setup failed"));
+    }
     
-    sendData("AT+SETRPT=1", 500, 1);
-    sendData("AT+SAVE", 500, 1);
-    sendData("AT+RESTART", 1000, 1);
+    // One report per TDMA cycle of UWB_TAG_COUNT slots
+    rangeScheduler.configure(UWB_TAG_COUNT, MAUWB_SLOT_MS);
+    rangeScheduler.setAutoReport(true);
+    rangeScheduler.setMinPollInterval(refreshRate);
+    rangeScheduler.begin(millis());
     
     // Show display is ready
     display.clearDisplay();
@@ -160,34 +229,12 @@ void setup()
     display.display();
     
     SERIAL_LOG.println(F("Setup complete - Reading distances to anchors"));
-    delay(1000);  // Give the UWB module time to initialize
 }
 
-String response = "";
-
 void loop()
 {
-    // Check for incoming data from UWB module
-    while (SERIAL_AT.available() > 0)
-    {
-        char c = SERIAL_AT.read();
-
-        if (c == '\r')
-            continue;
-        else if (c == '\n') {
-            if (response.length() > 0) {
-                SERIAL_LOG.print(F("UWB RESPONSE: "));
-                SERIAL_LOG.println(response);
-                
-                // Parse any range information in the response
-                parseRangeData(response);
-                response = "";
-            }
-        }
-        else {
-            response += c;
-        }
-    }
+    // Read data from the UWB module and complete any pending command
+    uwbAt.poll();
 
     // Forward commands from Serial Monitor to UWB module
     while (SERIAL_LOG.available() > 0)
@@ -203,133 +250,74 @@ void loop()
         last_display_update = millis();
     }
     
-    // Request range data periodically based on refreshRate
-    static long last_range_request = 0;
-    if (millis() - last_range_request > refreshRate) {
-        SERIAL_LOG.println(F("Requesting range data..."));
-        
-        // Request all ranges at once
-        sendData("AT+RANGE", 100, 1);
+    // Request range data only when the module is not reporting on its own
+    unsigned long currentTime = millis();
+    if (rangeScheduler.pollDue(currentTime) && !uwbAt.isBusy()) {
+        logger.log(LOG_STATUS, "Requesting range data...");
         
-        last_range_request = millis();
+        // Queue the request; the reply is handled by uwbAt.poll()
+        if (uwbAt.send("AT+RANGE", 100, nullptr, nullptr, "AT+RANGE=")) {
+            rangeScheduler.pollSent(currentTime);
+        }
     }
+    
+    // Write what the USB-CDC buffer takes without blocking; the rest waits
+    logger.drain(SERIAL_LOG, MAUWB_LOG_DRAIN_MAX, true);
 }
 
-// Parse range information from UWB module
-void parseRangeData(String data) {
-    // According to the AT command manual, the response format is:
-    // AT+RANGE=tid:x1,mask:x2,seq:x3,range:(x4,x5,x6,x7,x8,x9,x10,x11), rssi:(x12,x13,x14,x15,x16,x17,x18,x19)
-    
-    // Look for "range:(" in the response
-    int range_start = data.indexOf("range:(");
-    if (range_start >= 0) {
-        // Find the end of the range array
-        int range_end = data.indexOf(")", range_start);
-        if (range_end > range_start) {
-            // Extract just the range values
-            String range_values = data.substring(range_start + 7, range_end);
-            SERIAL_LOG.print(F("Range values: "));
-            SERIAL_LOG.println(range_values);
-            
-            // Split the range values by commas
-            int commaIndex = 0;
-            int startIndex = 0;
-            int valueIndex = 0;
-            
-            // We're only interested in the first 4 values (0-3)
-            float distances[4] = {0, 0, 0, 0};
-            
-            // Parse each value
-            while (valueIndex < 4 && startIndex < range_values.length()) {
-                commaIndex = range_values.indexOf(',', startIndex);
-                
-                if (commaIndex == -1) {
-                    // Last value
-                    commaIndex = range_values.length();
-                }
-                
-                String valueStr = range_values.substring(startIndex, commaIndex);
-                distances[valueIndex] = valueStr.toFloat();
-                
-                SERIAL_LOG.print(F("Distance "));
-                SERIAL_LOG.print(valueIndex);
-                SERIAL_LOG.print(F(": "));
-                SERIAL_LOG.println(distances[valueIndex]);
-                
-                valueIndex++;
-                startIndex = commaIndex + 1;
-            }
-            
-            // Update our distance variables
-            dist_to_a0 = distances[0];
-            dist_to_a1 = distances[1];
-            dist_to_a2 = distances[2];
-            dist_to_a3 = distances[3];
-            
-            // Calculate 2D position
-            calculatePosition();
-            
-            // Respond to position data
-            tagResponse(positionX, positionY);
-            
-            new_data = true;
-        }
-    }
+// Handle a line from the UWB module that is neither a command reply nor a range report
+void handleUwbLine(const char* line, uint8_t length, void* context)
+{
+    logger.log(LOG_MODULE, "UWB RESPONSE: %s", line);
+}
+
+// Handle a range report decoded by the AT engine
+// AT+RANGE=tid:x1,mask:x2,seq:x3,range:(x4,x5,x6,x7,x8,x9,x10,x11),rssi:(x12,x13,x14,x15,x16,x17,x18,x19)
+void handleUwbReport(const MaUWB_RangeReport& report, void* context)
+{
+    rangeScheduler.reportReceived(millis());
+    
+    logger.log(LOG_POSITION, "Distances: 0:%.2f 1:%.2f 2:%.2f 3:%.2f",
+               report.range[0], report.range[1], report.range[2], report.range[3]);
+    
+    // We're only interested in the first 4 values (0-3). Each slot is one
+    // anchor; slots not in the mask or missing read 0
+    dist_to_a0 = report.answered(0) ? report.range[0] : 0;
+    dist_to_a1 = report.answered(1) ? report.range[1] : 0;
+    dist_to_a2 = report.answered(2) ? report.range[2] : 0;
+    dist_to_a3 = report.answered(3) ? report.range[3] : 0;
+    
+    // Calculate 2D position
+    calculatePosition();
+    
+    // Respond to position data
+    tagResponse(positionX, positionY);
+    
+    new_data = true;
 }
 
 // Calculate 2D position using simple triangulation
 void calculatePosition() {
     // Check if we have valid distances from all 4 anchors
     if (dist_to_a0 <= 0 || dist_to_a1 <= 0 || dist_to_a2 <= 0 || dist_to_a3 <= 0) {
-        SERIAL_LOG.println(F("Cannot calculate position - need distances from all 4 anchors"));
+        logger.log(LOG_STATUS, "Cannot calculate position - need distances from all 4 anchors");
         return;
     }
     
     // Using simple triangulation with three anchors (A0, A1, A2)
-    // This method uses the first three anchors for a simple triangulation calculation
-    
-    // First, convert distances from cm to m to improve numerical stability
-    float r1 = dist_to_a0 / 100.0;  // A0 distance in meters
-    float r2 = dist_to_a1 / 100.0;  // A1 distance in meters
-    float r3 = dist_to_a2 / 100.0;  // A2 distance in meters
-    
-    // Convert anchor positions to meters
-    float x1 = anchor_x[0] / 100.0;  // A0 x in meters
-    float y1 = anchor_y[0] / 100.0;  // A0 y in meters
-    float x2 = anchor_x[1] / 100.0;  // A1 x in meters
-    float y2 = anchor_y[1] / 100.0;  // A1 y in meters
-    float x3 = anchor_x[2] / 100.0;  // A2 x in meters
-    float y3 = anchor_y[2] / 100.0;  // A2 y in meters
-    
-    // Calculate intermediate values for triangulation
-    float A = 2 * (x2 - x1);
-    float B = 2 * (y2 - y1);
-    float C = r1 * r1 - r2 * r2 - x1 * x1 + x2 * x2 - y1 * y1 + y2 * y2;
-    float D = 2 * (x3 - x2);
-    float E = 2 * (y3 - y2);
-    float F = r2 * r2 - r3 * r3 - x2 * x2 + x3 * x3 - y2 * y2 + y3 * y3;
-    
-    // Calculate position (in meters)
-    float x = 0.0, y = 0.0;
-    
-    // Check if we can solve the system
-    float denominator = (A * E - B * D);
-    if (abs(denominator) < 0.000001) {
-        SERIAL_LOG.println(F("Cannot calculate position - anchors are colinear"));
+    // The triplet's anchor terms are cached in the solver, so only the
+    // squared ranges are computed here
+    const float ranges[4] = {dist_to_a0, dist_to_a1, dist_to_a2, dist_to_a3};
+    
+    float rawX = 0.0, rawY = 0.0;
+    if (!solver.solveTriplet(0, 1, 2, ranges, rawX, rawY)) {
+        logger.log(LOG_STATUS, "Cannot calculate position - anchors are colinear");
         return;
     }
     
-    // Solve for position
-    x = (C * E - F * B) / denominator;
-    y = (A * F - C * D) / denominator;
-    
-    // Convert back to cm and store the raw calculated position
-    float rawX = x * 100.0;
-    float rawY = y * 100.0;
-    
     // Filter out negative values or values outside the boundary
     if (rawX < 0 || rawY < 0 || rawX > anchor_x[2] || rawY > anchor_y[1]) {
-        SERIAL_LOG.println(F("Position outside valid boundaries - skipping update"));
+        logger.log(LOG_STATUS, "Position outside valid boundaries - skipping update");
         return;
     }
     
@@ -360,15 +348,8 @@ void calculatePosition() {
     positionX = avgX;
     positionY = avgY;
     
-    SERIAL_LOG.print(F("Raw position: X="));
-    SERIAL_LOG.print(rawX);
-    SERIAL_LOG.print(F(", Y="));
-    SERIAL_LOG.println(rawY);
-    
-    SERIAL_LOG.print(F("Filtered position: X="));
-    SERIAL_LOG.print(positionX);
-    SERIAL_LOG.print(F(", Y="));
-    SERIAL_LOG.println(positionY);
+    logger.log(LOG_POSITION, "Raw position: X=%.2f, Y=%.2f", rawX, rawY);
+    logger.log(LOG_POSITION, "Filtered position: X=%.2f, Y=%.2f", positionX, positionY);
 }
 
 // Function for tag to respond to its position
@@ -381,114 +362,79 @@ void tagResponse(float x, float y) {
     // - Send position data to other devices
     // - Detect proximity to points of interest
 
-    if(y>=yBuzzThreshold)
-    {
-        digitalWrite(LEDpin, HIGH);
-    }
-    else
+    // Enter / exit go to handleZone(), with hysteresis at the edges
+    zones.update(x, y);
+}
+
+// The tag entered or left a zone
+void handleZone(uint8_t zone, bool entered, void* context)
+{
+    if (zone == BUZZ_ZONE)
     {
-        digitalWrite(LEDpin, LOW);
+        digitalWrite(LEDpin, entered ? HIGH : LOW);
     }
-
-
-
 }
 
-// Update the display with the latest distance measurements and position
-void updateDistanceDisplay() {
-    if (!display_initialized) {
-        return;
-    }
-    
+// Draw the static parts of the screen once and register the value fields
+void drawDisplayLayout() {
     display.clearDisplay();
-
-    // Display header
     display.setTextSize(1);
+    display.setTextColor(SSD1306_WHITE);
+
+    // Header
     display.setCursor(0, 0);
     display.print(F("TAG "));
     display.println(UWB_INDEX);
     display.drawLine(0, 9, 128, 9, SSD1306_WHITE);
-    
-    // Display distance to A0 and A1
-    display.setCursor(0, 12);
-    display.print(F("A0: "));
-    if (dist_to_a0 > 0) {
-        display.print(dist_to_a0, 1);
-    } else {
-        display.print(F("---"));
-    }
-    
-    display.setCursor(64, 12);
-    display.print(F("A1: "));
-    if (dist_to_a1 > 0) {
-        display.print(dist_to_a1, 1);
-    } else {
-        display.print(F("---"));
-    }
-    
-    // Display distance to A2 and A3
-    display.setCursor(0, 24);
-    display.print(F("A2: "));
-    if (dist_to_a2 > 0) {
-        display.print(dist_to_a2, 1);
-    } else {
-        display.print(F("---"));
-    }
-    
-    display.setCursor(64, 24);
-    display.print(F("A3: "));
-    if (dist_to_a3 > 0) {
-        display.print(dist_to_a3, 1);
-    } else {
-        display.print(F("---"));
+
+    // Anchor distances, two per row
+    for (uint8_t i = 0; i < 4; i++) {
+        int16_t x = (i % 2) * 64;
+        int16_t y = 12 + (i / 2) * 12;
+        display.setCursor(x, y);
+        display.print(F("A"));
+        display.print(i);
+        display.print(F(": "));
+        distanceFields[i] = screen.addField(x + 24, y, 6);
     }
-    
-    // Display divider
+
+    // Divider and position
     display.drawLine(0, 35, 128, 35, SSD1306_WHITE);
-    
-    // Display position
     display.setCursor(0, 40);
     display.println(F("POSITION:"));
-    
     display.setCursor(0, 50);
     display.print(F("X: "));
-    display.print(positionX, 1);
-    
     display.setCursor(64, 50);
     display.print(F("Y: "));
-    display.print(positionY, 1);
-    
-    display.display();
-}
+    xField = screen.addField(18, 50, 7);
+    yField = screen.addField(82, 50, 7);
 
-// Send command to the UWB module and get response
-String sendData(String command, const int timeout, boolean debug)
-{
-    String response = "";
+    screen.pushAll();
+    layout_drawn = true;
+}
 
-    if (debug) {
-        SERIAL_LOG.print(F("CMD: "));
-        SERIAL_LOG.println(command);
+// Update the display with the latest distance measurements and position.
+// Only fields whose text changed are sent to the OLED.
+void updateDistanceDisplay() {
+    if (!display_initialized) {
+        return;
     }
-    
-    SERIAL_AT.println(command);
 
-    long int time = millis();
+    if (!layout_drawn) {
+        drawDisplayLayout();
+    }
 
-    while ((time + timeout) > millis())
-    {
-        while (SERIAL_AT.available())
-        {
-            char c = SERIAL_AT.read();
-            response += c;
+    const float distances[4] = {dist_to_a0, dist_to_a1, dist_to_a2, dist_to_a3};
+    for (uint8_t i = 0; i < 4; i++) {
+        if (distances[i] > 0) {
+            screen.setNumber(distanceFields[i], distances[i], 1);
+        } else {
+            screen.setText(distanceFields[i], "---");
         }
     }
 
-    if (debug && response.length() > 0)
-    {
-        SERIAL_LOG.print(F("RESP: "));
-        SERIAL_LOG.println(response);
-    }
+    screen.setNumber(xField, positionX, 1);
+    screen.setNumber(yField, positionY, 1);
 
-    return response;
-}
\ No newline at end of file
+    screen.push();
+}
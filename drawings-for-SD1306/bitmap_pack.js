@@ -0,0 +1,122 @@
+// bitmap_pack.js - Packs 1-bit drawings for MaUWB_Bitmap.h
+//
+// The SSD1306 keeps its picture in pages: one byte covers 8 pixel rows of
+// one column, least significant bit on top. The packed bitmap uses the same
+// order (page by page, column by column), so the firmware copies it into
+// the framebuffer a byte at a time instead of setting single pixels.
+//
+// With RLE the bytes are PackBits-style runs, a control byte and its data:
+//   0x00-0x7F  the next (c + 1) bytes are literal
+//   0x80-0xFF  the next byte repeats (c - 0x80 + 2) times
+// packBitmap() only keeps the RLE form when it is smaller.
+//
+// Works in the browser (the editor) and in node:
+//   const { packBitmap, toHeader } = require("./bitmap_pack.js");
+
+const MAUWB_BITMAP_RLE = 0x01;
+
+// pixels: Uint8Array of width * height, row by row, non-zero = lit
+function packPages(pixels, width, height) {
+  const pages = Math.ceil(height / 8);
+  const bytes = new Uint8Array(pages * width);
+  for (let page = 0; page < pages; page++) {
+    for (let x = 0; x < width; x++) {
+      let b = 0;
+      for (let bit = 0; bit < 8; bit++) {
+        const y = page * 8 + bit;
+        if (y < height && pixels[y * width + x]) b |= 1 << bit;
+      }
+      bytes[page * width + x] = b;
+    }
+  }
+  return bytes;
+}
+
+function encodeRle(bytes) {
+  const out = [];
+  let i = 0;
+  while (i < bytes.length) {
+    // A run of three or more is worth a repeat
+    let run = 1;
+    while (i + run < bytes.length && bytes[i + run] === bytes[i] && run < 129) run++;
+    if (run >= 3) {
+      out.push(0x80 + run - 2, bytes[i]);
+      i += run;
+      continue;
+    }
+    // Literal bytes up to the next run of three
+    let start = i;
+    while (
+      i < bytes.length &&
+      i - start < 128 &&
+      !(i + 2 < bytes.length && bytes[i] === bytes[i + 1] && bytes[i] === bytes[i + 2])
+    ) {
+      i++;
+    }
+    out.push(i - start - 1);
+    for (let k = start; k < i; k++) out.push(bytes[k]);
+  }
+  return new Uint8Array(out);
+}
+
+function decodeRle(data, length) {
+  const out = new Uint8Array(length);
+  let o = 0;
+  for (let i = 0; i < data.length && o < length; ) {
+    const c = data[i++];
+    if (c < 0x80) {
+      for (let k = 0; k <= c && o < length; k++) out[o++] = data[i++];
+    } else {
+      const value = data[i++];
+      for (let k = 0; k < c - 0x80 + 2 && o < length; k++) out[o++] = value;
+    }
+  }
+  return out;
+}
+
+// Returns { width, height, flags, data } ready for toHeader()
+function packBitmap(pixels, width, height, allowRle = true) {
+  const raw = packPages(pixels, width, height);
+  if (allowRle) {
+    const rle = encodeRle(raw);
+    if (rle.length < raw.length) {
+      return { width: width, height: height, flags: MAUWB_BITMAP_RLE, data: rle };
+    }
+  }
+  return { width: width, height: height, flags: 0, data: raw };
+}
+
+// C header with the bitmap in flash, for MaUWB_Bitmap.h
+function toHeader(name, bitmap) {
+  const guard = name.toUpperCase() + "_H";
+  const rows = [];
+  for (let i = 0; i < bitmap.data.length; i += 16) {
+    const row = Array.from(bitmap.data.slice(i, i + 16), (b) => "0x" + b.toString(16).padStart(2, "0"));
+    rows.push("    " + row.join(", ") + ",");
+  }
+  const raw = bitmap.width * Math.ceil(bitmap.height / 8);
+  return [
+    `// ${name}: ${bitmap.width} x ${bitmap.height}, ${bitmap.data.length} bytes` +
+      (bitmap.flags & MAUWB_BITMAP_RLE ? ` (RLE, ${raw} unpacked)` : ""),
+    "// Made with drawings-for-SD1306; draw with MaUWB_BitmapBlit or MaUWB_Display::drawBitmap()",
+    "",
+    `#ifndef ${guard}`,
+    `#define ${guard}`,
+    "",
+    '#include "MaUWB_Bitmap.h"',
+    "",
+    `static const uint8_t ${name}_data[] PROGMEM = {`,
+    ...rows,
+    "};",
+    "",
+    `static const MaUWB_Bitmap ${name} = {${bitmap.width}, ${bitmap.height}, ` +
+      `${bitmap.flags & MAUWB_BITMAP_RLE ? "MAUWB_BITMAP_RLE" : "0"}, sizeof(${name}_data), ${name}_data};`,
+    "",
+    `#endif // ${guard}`,
+    "",
+  ].join("\n");
+}
+
+if (typeof module !== "undefined") {
+  module.exports = { MAUWB_BITMAP_RLE, packPages, encodeRle, decodeRle, packBitmap, toHeader };
+}
@@ -1,80 +1,237 @@
-const grid = document.getElementById('circleGrid');
+const canvas = document.getElementById('drawing');
+const ctx = canvas.getContext('2d');
 const downloadBtn = document.getElementById('downloadBtn');
-
-let isMouseDown = false;
-const totalCircles = 128 * 64;
-
-// Create the grid
-for (let i = 0; i < totalCircles; i++) {
-    const circle = document.createElement('div');
-    circle.classList.add('circle');
-    circle.dataset.active = "false";
-    circle.style.backgroundColor = '#191919';
-
-    circle.addEventListener('click', () => toggleCircle(circle));
-    circle.addEventListener('mouseover', () => {
-        if (isMouseDown) toggleCircle(circle);
-    });
-
-    grid.appendChild(circle);
+const exportBtn = document.getElementById('exportBtn');
+const openInput = document.getElementById('openInput');
+const clearBtn = document.getElementById('clearBtn');
+const invertBtn = document.getElementById('invertBtn');
+const widthInput = document.getElementById('widthInput');
+const heightInput = document.getElementById('heightInput');
+const frameInput = document.getElementById('frameInput');
+const nameInput = document.getElementById('nameInput');
+const rleInput = document.getElementById('rleInput');
+const info = document.getElementById('info');
+
+const CELL = 8;              // Screen pixels per drawing pixel
+const OFF = '#191919';
+const ON = '#f3f3f3';
+const GUIDE = '#4a6fa5';     // Sprite sheet frame borders
+const MAX_SIZE = 1024;
+const MAX_BYTES = 65535;     // MaUWB_Bitmap::size is a uint16_t
+
+// One byte per pixel, row by row; the canvas is only a view of it
+let columns = 128;
+let rows = 64;
+let pixels = new Uint8Array(columns * rows);
+
+let painting = false;
+let paintValue = 1;
+let lastCell = null;
+
+function resize(newColumns, newRows) {
+    const old = pixels;
+    const oldColumns = columns;
+    const oldRows = rows;
+    columns = newColumns;
+    rows = newRows;
+    pixels = new Uint8Array(columns * rows);
+    for (let y = 0; y < Math.min(rows, oldRows); y++) {
+        for (let x = 0; x < Math.min(columns, oldColumns); x++) {
+            pixels[y * columns + x] = old[y * oldColumns + x];
+        }
+    }
+    canvas.width = columns * CELL;
+    canvas.height = rows * CELL;
+    redraw();
 }
 
-// Mouse tracking for drag coloring
-document.addEventListener('mousedown', (e) => {
-    if (!downloadBtn.contains(e.target)) isMouseDown = true;
-});
-document.addEventListener('mouseup', () => {
-    isMouseDown = false;
-});
-
-// Toggle color: black ⇄ white
-function toggleCircle(circle) {
-    const active = circle.dataset.active === "true";
-
-    if (!active) {
-        circle.style.backgroundColor = '#f3f3f3';
-        circle.dataset.active = "true";
-    } else {
-        circle.style.backgroundColor = '#191919';
-        circle.dataset.active = "false";
+function redraw() {
+    ctx.fillStyle = OFF;
+    ctx.fillRect(0, 0, canvas.width, canvas.height);
+    ctx.fillStyle = ON;
+    for (let y = 0; y < rows; y++) {
+        for (let x = 0; x < columns; x++) {
+            if (pixels[y * columns + x]) ctx.fillRect(x * CELL, y * CELL, CELL, CELL);
+        }
     }
+    drawGuides();
+    updateInfo();
 }
 
-// Download as SVG
-downloadBtn.addEventListener('click', () => {
-    const circles = document.querySelectorAll('.circle');
-    const columns = 128;
-    const rows = 64;
-    const circleSize = 8;
-    const padding = 0;
-
-    const width = columns * circleSize + padding * 2;
-    const height = rows * circleSize + padding * 2;
+function drawGuides() {
+    const frame = parseInt(frameInput.value, 10) || 0;
+    if (frame <= 0 || frame >= columns) return;
+    ctx.fillStyle = GUIDE;
+    for (let x = frame; x < columns; x += frame) {
+        ctx.fillRect(x * CELL - 1, 0, 2, canvas.height);
+    }
+}
 
-    let svgContent = `<svg xmlns="http://www.w3.org/2000/svg" width="${width}" height="${height}" viewBox="0 0 ${width} ${height}">`;
+// Only the cell that changed is repainted
+function setPixel(x, y, value) {
+    if (x < 0 || y < 0 || x >= columns || y >= rows) return;
+    const i = y * columns + x;
+    if (pixels[i] === value) return;
+    pixels[i] = value;
+    ctx.fillStyle = value ? ON : OFF;
+    ctx.fillRect(x * CELL, y * CELL, CELL, CELL);
+    const frame = parseInt(frameInput.value, 10) || 0;
+    if (frame > 0 && (x % frame === 0 || (x + 1) % frame === 0)) drawGuides();
+}
 
-    circles.forEach((circle, index) => {
-        const col = index % columns;
-        const row = Math.floor(index / columns);
-        const x = col * circleSize + padding;
-        const y = row * circleSize + padding;
-        const fillColor = circle.dataset.active === "true" ? '#f3f3f3' : '#191919';
+// Every cell between two pointer events, so fast strokes have no gaps
+function paintLine(from, to) {
+    let [x0, y0] = from;
+    const [x1, y1] = to;
+    const dx = Math.abs(x1 - x0);
+    const dy = -Math.abs(y1 - y0);
+    const sx = x0 < x1 ? 1 : -1;
+    const sy = y0 < y1 ? 1 : -1;
+    let error = dx + dy;
+    for (;;) {
+        setPixel(x0, y0, paintValue);
+        if (x0 === x1 && y0 === y1) break;
+        const e2 = 2 * error;
+        if (e2 >= dy) {
+            error += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            error += dx;
+            y0 += sy;
+        }
+    }
+}
 
-        svgContent += `<rect x="${x}" y="${y}" width="${circleSize}" height="${circleSize}" fill="${fillColor}" />`;
-    });
+function cellAt(event) {
+    const rect = canvas.getBoundingClientRect();
+    const x = Math.floor(((event.clientX - rect.left) * canvas.width) / rect.width / CELL);
+    const y = Math.floor(((event.clientY - rect.top) * canvas.height) / rect.height / CELL);
+    return [x, y];
+}
 
-    svgContent += `</svg>`;
+// A stroke paints the opposite of the pixel it starts on: black ⇄ white
+canvas.addEventListener('pointerdown', (e) => {
+    const [x, y] = cellAt(e);
+    if (x < 0 || y < 0 || x >= columns || y >= rows) return;
+    painting = true;
+    paintValue = pixels[y * columns + x] ? 0 : 1;
+    lastCell = [x, y];
+    setPixel(x, y, paintValue);
+    canvas.setPointerCapture(e.pointerId);
+});
+canvas.addEventListener('pointermove', (e) => {
+    if (!painting) return;
+    const cell = cellAt(e);
+    paintLine(lastCell, cell);
+    lastCell = cell;
+});
+['pointerup', 'pointercancel'].forEach((type) =>
+    canvas.addEventListener(type, () => {
+        if (painting) updateInfo();
+        painting = false;
+    })
+);
+
+function updateInfo() {
+    const packed = packBitmap(pixels, columns, rows, rleInput.checked);
+    const raw = columns * Math.ceil(rows / 8);
+    info.textContent =
+        `${columns} x ${rows}: ${packed.data.length} bytes` +
+        (packed.flags & MAUWB_BITMAP_RLE ? ` (RLE, ${raw} unpacked)` : '');
+}
 
-    const blob = new Blob([svgContent], { type: "image/svg+xml;charset=utf-8" });
+function download(content, type, filename) {
+    const blob = new Blob([content], { type: type });
     const url = URL.createObjectURL(blob);
 
     const link = document.createElement('a');
     link.href = url;
-    link.download = 'play_full_canvas.svg';
+    link.download = filename;
     document.body.appendChild(link);
     link.click();
     document.body.removeChild(link);
 
     URL.revokeObjectURL(url);
+}
+
+// Download as SVG: the dark background and one rect per lit pixel
+downloadBtn.addEventListener('click', () => {
+    const width = columns * CELL;
+    const height = rows * CELL;
+
+    const parts = [
+        `<svg xmlns="http://www.w3.org/2000/svg" width="${width}" height="${height}" viewBox="0 0 ${width} ${height}">`,
+        `<rect x="0" y="0" width="${width}" height="${height}" fill="${OFF}" />`,
+    ];
+    for (let y = 0; y < rows; y++) {
+        for (let x = 0; x < columns; x++) {
+            if (pixels[y * columns + x]) {
+                parts.push(`<rect x="${x * CELL}" y="${y * CELL}" width="${CELL}" height="${CELL}" fill="${ON}" />`);
+            }
+        }
+    }
+    parts.push(`</svg>`);
+
+    download(parts.join(''), 'image/svg+xml;charset=utf-8', 'play_full_canvas.svg');
+});
+
+// Export as a C header for MaUWB_Bitmap.h, page ordered and in flash
+exportBtn.addEventListener('click', () => {
+    const name = nameInput.value.replace(/[^A-Za-z0-9_]/g, '_').replace(/^([0-9])/, '_$1') || 'drawing';
+    const packed = packBitmap(pixels, columns, rows, rleInput.checked);
+    download(toHeader(name, packed), 'text/plain;charset=utf-8', `${name}.h`);
 });
 
+// Open an image (PNG, an SVG downloaded from here, ...) scaled to the
+// drawing size; light pixels are lit
+openInput.addEventListener('change', () => {
+    const file = openInput.files[0];
+    if (!file) return;
+    const image = new Image();
+    const url = URL.createObjectURL(file);
+    image.onload = () => {
+        const scratch = document.createElement('canvas');
+        scratch.width = columns;
+        scratch.height = rows;
+        const scratchCtx = scratch.getContext('2d');
+        scratchCtx.imageSmoothingEnabled = false;
+        scratchCtx.drawImage(image, 0, 0, columns, rows);
+        const data = scratchCtx.getImageData(0, 0, columns, rows).data;
+        for (let i = 0; i < pixels.length; i++) {
+            const light = (data[i * 4] + data[i * 4 + 1] + data[i * 4 + 2]) / 3;
+            pixels[i] = data[i * 4 + 3] > 127 && light > 127 ? 1 : 0;
+        }
+        URL.revokeObjectURL(url);
+        openInput.value = '';
+        redraw();
+    };
+    image.src = url;
+});
+
+clearBtn.addEventListener('click', () => {
+    pixels.fill(0);
+    redraw();
+});
+
+invertBtn.addEventListener('click', () => {
+    for (let i = 0; i < pixels.length; i++) pixels[i] = pixels[i] ? 0 : 1;
+    redraw();
+});
+
+// The unpacked pages (width * pages bytes) must fit MAX_BYTES; RLE is only
+// kept when smaller, so that bounds the exported size too
+function sizeFromInputs() {
+    const clamp = (value, fallback, max) => Math.min(max, Math.max(1, parseInt(value, 10) || fallback));
+    widthInput.value = clamp(widthInput.value, columns, MAX_SIZE);
+    const maxHeight = Math.min(MAX_SIZE, Math.floor(MAX_BYTES / widthInput.value) * 8);
+    heightInput.max = maxHeight;
+    heightInput.value = clamp(heightInput.value, rows, maxHeight);
+    resize(parseInt(widthInput.value, 10), parseInt(heightInput.value, 10));
+}
+widthInput.addEventListener('change', sizeFromInputs);
+heightInput.addEventListener('change', sizeFromInputs);
+frameInput.addEventListener('change', redraw);
+rleInput.addEventListener('change', updateInfo);
+
+resize(columns, rows);
@@ -4,7 +4,8 @@ let SCREEN_Y = 600;
 let port;
 let reader;
 let writer;
-let inputBuffer = "";
+// Ask the anchor for binary frames instead of JSON lines (see uwb_frame.js)
+const USE_BINARY_FRAMES = true;
 let isConnected = false;
 
 // Calibration parameters
@@ -176,6 +177,9 @@ async function connectSerial() {
     // Send begin command
     const encoder = new TextEncoder();
     await writer.write(encoder.encode("begin\n"));
+    if (USE_BINARY_FRAMES) {
+      await writer.write(encoder.encode("#bin\n"));
+    }
     
     isConnected = true;
     statusDiv.html('Status: Connected');
@@ -199,7 +203,6 @@ async function connectSerial() {
 async function readSerial() {
   if (!port) return;
   
-  const decoder = new TextDecoder();
   reader = port.readable.getReader();
   
   try {
@@ -207,7 +210,7 @@ async function readSerial() {
       const { value, done } = await reader.read();
       if (done) break;
       
-      processSerialData(decoder.decode(value));
+      uwbDecoder.push(value);
     }
   } catch (error) {
     console.error("Error reading from serial:", error);
@@ -218,37 +221,22 @@ async function readSerial() {
   }
 }
 
-function processSerialData(text) {
-  inputBuffer += text;
-  
-  const lines = inputBuffer.split("\n");
-  inputBuffer = lines.pop() || "";
-  
-  for (const line of lines) {
-    if (!line.trim()) continue;
-    
-    if (line.includes('AT+RANGE')) {
-      const sections = line.split(',')
-    }
-    
-    try {
-      const data = JSON.parse(line);
-      
-      if (data.range && Array.isArray(data.range)) {
-        const distance = data.range[anchorIndex];
-        if (distance > 0) {
-          addReading(distance);
-        }
-      }
-    } catch (e) {
-      // Log non-JSON messages
-      console.log("[LOG] " + line);
-      
-      // Check for AT command responses
-      if (line.includes("OK") || line.includes("ERROR")) {
-        console.log("[AT Response] " + line);
-      }
-    }
+// Range reports (JSON lines or binary frames) and log lines from the anchor
+const uwbDecoder = new UwbSerialDecoder(handleReport, handleLogLine);
+
+function handleReport(data) {
+  const distance = data.range[anchorIndex];
+  if (distance > 0) {
+    addReading(distance);
+  }
+}
+
+function handleLogLine(line) {
+  console.log("[LOG] " + line);
+
+  // Check for AT command responses
+  if (line.includes("OK") || line.includes("ERROR")) {
+    console.log("[AT Response] " + line);
   }
 }
 
@@ -0,0 +1,146 @@
+// uwb_frame.js - Decoder for the anchor's serial output
+//
+// The anchor sends range reports either as JSON lines
+//   {"id":1,"range":[0,0,30,0,0,0,0,0]}
+// or, after "#bin", as 28-byte binary frames (see MaUWB_Frame.h):
+//   0xA5, tid, seq, 8 x uint16 range (cm, little endian), 8 x int8 RSSI, CRC-8
+// With position output ("#pos") the anchor solves the tags itself and sends
+//   {"id":1,"x":250,"y":610}
+// or 9-byte position frames:
+//   0xA6, tid, seq, int16 x, int16 y (cm, little endian), anchor mask, CRC-8
+// All of these can be mixed with plain text log lines. UwbSerialDecoder takes
+// the raw bytes from the serial port and calls onReport() for every report,
+// with { id, seq, range, rssi } for ranges and { id, seq, x, y, mask } for
+// positions, and onLine(text) for everything else.
+//
+// This file is copied into every p5 sketch folder; keep the copies identical.
+
+const UWB_FRAME_SYNC = 0xa5;
+const UWB_FRAME_SLOTS = 8;
+const UWB_FRAME_LENGTH = 3 + UWB_FRAME_SLOTS * 2 + UWB_FRAME_SLOTS + 1;
+const UWB_POSITION_SYNC = 0xa6;
+const UWB_POSITION_LENGTH = 9;
+
+// CRC-8, polynomial 0x07, initial value 0
+const UWB_CRC8_TABLE = (() => {
+  const table = new Uint8Array(256);
+  for (let i = 0; i < 256; i++) {
+    let crc = i;
+    for (let bit = 0; bit < 8; bit++) {
+      crc = crc & 0x80 ? ((crc << 1) ^ 0x07) & 0xff : (crc << 1) & 0xff;
+    }
+    table[i] = crc;
+  }
+  return table;
+})();
+
+function uwbCrc8(bytes, start, end) {
+  let crc = 0;
+  for (let i = start; i < end; i++) {
+    crc = UWB_CRC8_TABLE[crc ^ bytes[i]];
+  }
+  return crc;
+}
+
+class UwbSerialDecoder {
+  constructor(onReport, onLine) {
+    this.onReport = onReport;
+    this.onLine = onLine || (() => {});
+    this.frame = new Uint8Array(UWB_FRAME_LENGTH);
+    this.frameFill = 0;
+    this.frameLength = 0;
+    this.line = "";
+    this.framesReceived = 0;
+    this.crcErrors = 0;
+  }
+
+  // Feed a chunk (Uint8Array) as returned by reader.read()
+  push(bytes) {
+    for (let i = 0; i < bytes.length; i++) {
+      this.pushByte(bytes[i]);
+    }
+  }
+
+  pushByte(b) {
+    if (this.frameFill > 0) {
+      this.frame[this.frameFill++] = b;
+      if (this.frameFill === this.frameLength) {
+        this.finishFrame();
+      }
+      return;
+    }
+
+    if (b === UWB_FRAME_SYNC || b === UWB_POSITION_SYNC) {
+      this.frame[0] = b;
+      this.frameFill = 1;
+      this.frameLength = b === UWB_FRAME_SYNC ? UWB_FRAME_LENGTH : UWB_POSITION_LENGTH;
+      return;
+    }
+
+    if (b === 0x0a) {
+      this.finishLine();
+    } else if (b !== 0x0d) {
+      this.line += String.fromCharCode(b);
+    }
+  }
+
+  finishFrame() {
+    const f = this.frame;
+    const length = this.frameLength;
+    this.frameFill = 0;
+
+    if (uwbCrc8(f, 1, length - 1) !== f[length - 1]) {
+      // Not a frame after all (or a damaged one); rescan what followed the sync byte
+      this.crcErrors++;
+      const rest = f.slice(1, length);
+      this.push(rest);
+      return;
+    }
+
+    if (f[0] === UWB_POSITION_SYNC) {
+      const x = f[3] | (f[4] << 8);
+      const y = f[5] | (f[6] << 8);
+      this.framesReceived++;
+      this.onReport({
+        id: f[1],
+        seq: f[2],
+        x: x > 32767 ? x - 65536 : x,
+        y: y > 32767 ? y - 65536 : y,
+        mask: f[7],
+      });
+      return;
+    }
+
+    const range = new Array(UWB_FRAME_SLOTS);
+    const rssi = new Array(UWB_FRAME_SLOTS);
+    for (let i = 0; i < UWB_FRAME_SLOTS; i++) {
+      range[i] = f[3 + i * 2] | (f[4 + i * 2] << 8);
+      const level = f[3 + UWB_FRAME_SLOTS * 2 + i];
+      rssi[i] = level > 127 ? level - 256 : level;
+    }
+
+    this.framesReceived++;
+    this.onReport({ id: f[1], seq: f[2], range: range, rssi: rssi });
+  }
+
+  finishLine() {
+    const line = this.line;
+    this.line = "";
+    if (!line.trim()) return;
+
+    // Only lines that look like JSON are worth a JSON.parse
+    if (line.charCodeAt(0) === 0x7b) {
+      try {
+        const data = JSON.parse(line);
+        if (data.id !== undefined && (Array.isArray(data.range) || data.x !== undefined)) {
+          this.onReport(data);
+          return;
+        }
+      } catch (e) {
+        // Fall through and report it as text
+      }
+    }
+
+    this.onLine(line);
+  }
+}
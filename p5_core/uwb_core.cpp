@@ -0,0 +1,155 @@
+/*
+uwb_core.cpp - Positioning core for the p5 sketches, built to WebAssembly
+
+The same tracker as the anchor (MaUWB_Tracker.h: weighted least squares
+and a Kalman filter per tag) with a C interface for uwb_worker.js. Reports
+are passed in batches through two fixed buffers in the module's memory, so
+a batch costs one call from JavaScript:
+
+  input   UWB_CORE_BATCH reports of UWB_CORE_REPORT_FLOATS floats:
+          tid, seq, mask, range[8] (cm, 0 = no reply), rssi[8] (dBm)
+  output  one fix per solved report, UWB_CORE_FIX_FLOATS floats:
+          tid, x, y, seq (cm)
+
+BUILD (Emscripten; see CMakeLists.txt and README.md):
+  emcmake cmake -S p5_core -B build-wasm && cmake --build build-wasm
+writes uwb_core.js and uwb_core.wasm and copies them into the sketches.
+A native build runs the self-test instead (ctest).
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+#include "MaUWB_Tracker.h"
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten/emscripten.h>
+#define UWB_CORE_EXPORT EMSCRIPTEN_KEEPALIVE
+#else
+#define UWB_CORE_EXPORT
+#endif
+
+// Reports per call of uwb_core_solve(); uwb_worker.js reads these back
+#define UWB_CORE_BATCH 256
+#define UWB_CORE_REPORT_FLOATS (3 + 2 * MAUWB_RANGE_SLOTS)
+#define UWB_CORE_FIX_FLOATS 4
+
+static MaUWB_TagTracker tracker;
+static float input[UWB_CORE_BATCH * UWB_CORE_REPORT_FLOATS];
+static float output[UWB_CORE_BATCH * UWB_CORE_FIX_FLOATS];
+
+extern "C" {
+
+UWB_CORE_EXPORT int uwb_core_batch() { return UWB_CORE_BATCH; }
+UWB_CORE_EXPORT float* uwb_core_input() { return input; }
+UWB_CORE_EXPORT float* uwb_core_output() { return output; }
+
+UWB_CORE_EXPORT void uwb_core_set_anchor_count(int count) {
+    tracker.getSolver().setAnchorCount((uint8_t)count);
+}
+
+// Anchor position and mounting height (cm)
+UWB_CORE_EXPORT void uwb_core_set_anchor(int index, float x, float y, float z) {
+    tracker.getSolver().setAnchor((uint8_t)index, x, y, z);
+}
+
+UWB_CORE_EXPORT void uwb_core_set_tag_height(float z) {
+    tracker.getSolver().setTagHeight(z);
+}
+
+UWB_CORE_EXPORT void uwb_core_set_filtering(int enable) {
+    tracker.setFiltering(enable != 0);
+}
+
+UWB_CORE_EXPORT void uwb_core_clear() {
+    tracker.clear();
+}
+
+// Solve count reports from the input buffer, received at now (ms). Returns
+// the number of fixes written to the output buffer.
+UWB_CORE_EXPORT int uwb_core_solve(int count, uint32_t now) {
+    if (count > UWB_CORE_BATCH) count = UWB_CORE_BATCH;
+
+    int fixes = 0;
+    MaUWB_RangeReport report;
+    for (int i = 0; i < count; i++) {
+        const float* in = input + i * UWB_CORE_REPORT_FLOATS;
+        report.tid = (uint16_t)in[0];
+        report.seq = (uint16_t)in[1];
+        report.mask = (uint8_t)in[2];
+        report.rangeCount = MAUWB_RANGE_SLOTS;
+        report.rssiCount = MAUWB_RANGE_SLOTS;
+        for (uint8_t slot = 0; slot < MAUWB_RANGE_SLOTS; slot++) {
+            report.range[slot] = in[3 + slot];
+            report.rssi[slot] = in[3 + MAUWB_RANGE_SLOTS + slot];
+        }
+
+        const MaUWB_TagState* tag = tracker.update(report, now);
+        if (tag) {
+            float* out = output + fixes++ * UWB_CORE_FIX_FLOATS;
+            out[0] = tag->tid;
+            out[1] = tag->x;
+            out[2] = tag->y;
+            out[3] = tag->seq;
+        }
+    }
+    return fixes;
+}
+
+}  // extern "C"
+
+#ifndef __EMSCRIPTEN__
+// Native self-test: a batch for two tags through the C interface, as
+// uwb_worker.js fills it
+int main() {
+    static const float anchorX[4] = {0, 0, 540, 540};
+    static const float anchorY[4] = {0, 1270, 1270, 0};
+    static const float tagX[2] = {120, 400};
+    static const float tagY[2] = {300, 1000};
+
+    uwb_core_set_anchor_count(4);
+    for (int i = 0; i < 4; i++) {
+        uwb_core_set_anchor(i, anchorX[i], anchorY[i], 0);
+    }
+
+    const int reports = 20;
+    for (int r = 0; r < reports; r++) {
+        float* in = uwb_core_input() + r * UWB_CORE_REPORT_FLOATS;
+        int t = r % 2;
+        in[0] = (float)(t + 1);
+        in[1] = (float)(r / 2);
+        in[2] = 0x0F;
+        for (int slot = 0; slot < MAUWB_RANGE_SLOTS; slot++) {
+            float d = slot < 4 ? hypotf(tagX[t] - anchorX[slot], tagY[t] - anchorY[slot]) : 0;
+            in[3 + slot] = d;
+            in[3 + MAUWB_RANGE_SLOTS + slot] = slot < 4 ? -78.0f : 0;
+        }
+    }
+
+    int failures = 0;
+    int fixes = uwb_core_solve(reports, 1000);
+    if (fixes != reports) {
+        printf("FAIL: %d of %d reports solved\n", fixes, reports);
+        failures++;
+    }
+    for (int f = fixes - 2; f >= 0 && f < fixes; f++) {
+        const float* out = uwb_core_output() + f * UWB_CORE_FIX_FLOATS;
+        int t = (int)out[0] - 1;
+        if (t < 0 || t > 1 || hypotf(out[1] - tagX[t], out[2] - tagY[t]) > 1.0f) {
+            printf("FAIL: fix %d is tag %d at %.1f, %.1f\n", f, (int)out[0], out[1], out[2]);
+            failures++;
+        }
+    }
+
+    // A report with two anchors gives no fix
+    float* in = uwb_core_input();
+    in[2] = 0x03;
+    if (uwb_core_solve(1, 1100) != 0) {
+        printf("FAIL: fix from two anchors\n");
+        failures++;
+    }
+
+    printf("uwb_core self-test: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
+#endif
@@ -0,0 +1,357 @@
+// uwb_worker.js - Serial decoding and position solving off the main thread
+//
+// Runs as a Web Worker next to a p5 sketch (see uwb_core_client.js). The
+// sketch hands it the raw serial chunks; here they are decoded with
+// UwbSerialDecoder (uwb_frame.js) and range reports are solved to positions
+// with the firmware's tracker compiled to WebAssembly (uwb_core.cpp). Until
+// uwb_core.wasm has loaded, or if it was never built, a JavaScript port of
+// the same steps is used instead: RSSI and consistency weights, weighted
+// least squares, the plausibility check (anchor bounds plus the solver's
+// margin) with the first plausible anchor triplet as fallback and, with
+// filtering on, a Kalman filter per tag. Like the tracker's default solver
+// it has no outlier search and no height estimation. Positions the anchor
+// already solved ("#pos") are passed through.
+//
+// Messages in:
+//   { type: "anchors", anchors: [[x, y, z], ...] }    layout in cm
+//   { type: "bytes", bytes: Uint8Array }              a chunk from reader.read()
+//   { type: "config", batchMs, filtering }
+// Messages out:
+//   { type: "positions", data: Float32Array }         tid, x, y, seq per fix
+//   { type: "lines", lines: [...] }                   log lines from the anchor
+//   { type: "stats", reports, fixes, crcErrors, core } once a second; core
+//                                  is "wasm", "js loading" or "js fallback"
+//
+// This file is copied into every p5 sketch folder that uses it; keep the
+// copies identical.
+
+importScripts("uwb_frame.js");
+
+const UWB_FIX_FLOATS = 4;
+const UWB_REPORT_FLOATS = 3 + 2 * UWB_FRAME_SLOTS;
+
+// JavaScript solver: the defaults of MaUWB_Solver.h and MaUWB_Filter.h
+const UWB_RSSI_GOOD = -80;               // dBm, full weight at or above
+const UWB_RSSI_FLOOR = -100;             // dBm, UWB_WEIGHT_MIN at or below
+const UWB_WEIGHT_MIN = 0.05;
+const UWB_CONSISTENCY_TOLERANCE = 20;    // cm
+const UWB_SOLVER_MARGIN = 100;           // cm outside the anchors still accepted
+const UWB_KALMAN_PROCESS_NOISE = 2000;   // cm^2/s^3
+const UWB_KALMAN_MEASUREMENT_NOISE = 100; // cm^2
+const UWB_KALMAN_RESTART_GAP = 2;        // s
+
+let anchors = [];
+let batchMs = 16;
+let filtering = true;
+
+// Fixes waiting to be posted, flushed at most every batchMs
+let fixes = new Float32Array(256 * UWB_FIX_FLOATS);
+let fixCount = 0;
+let lines = [];
+let flushTimer = null;
+
+// Range reports waiting for the solver, solved once per incoming chunk
+let pending = [];
+
+const stats = { reports: 0, fixes: 0 };
+let wasm = null;
+let wasmLoading = false;
+
+// Kalman state per tag id for the JavaScript solver
+let tracks = new Map();
+
+// WebAssembly core, if uwb_core.js / uwb_core.wasm sit next to this file
+try {
+  importScripts("uwb_core.js");
+} catch (e) {
+  // Not built: stay on the JavaScript solver
+}
+if (typeof createUwbCore === "function") {
+  wasmLoading = true;
+  createUwbCore().then((module) => {
+    wasm = {
+      module: module,
+      batch: module._uwb_core_batch(),
+      input: module._uwb_core_input() >> 2,
+      output: module._uwb_core_output() >> 2,
+    };
+    loadAnchors();
+  });
+}
+
+const decoder = new UwbSerialDecoder(
+  (data) => {
+    stats.reports++;
+    if (data.x !== undefined) {
+      addFix(data.id, data.x, data.y, data.seq !== undefined ? data.seq : 0);
+    } else {
+      pending.push(data);
+    }
+  },
+  (line) => {
+    lines.push(line);
+    scheduleFlush();
+  }
+);
+
+onmessage = (event) => {
+  const message = event.data;
+  if (message.type === "bytes") {
+    decoder.push(message.bytes);
+    solvePending();
+  } else if (message.type === "anchors") {
+    anchors = message.anchors.map((a) => [a[0], a[1], a[2] || 0]);
+    tracks.clear();
+    loadAnchors();
+  } else if (message.type === "config") {
+    if (message.batchMs !== undefined) batchMs = message.batchMs;
+    if (message.filtering !== undefined) {
+      filtering = message.filtering;
+      tracks.clear();
+      if (wasm) wasm.module._uwb_core_set_filtering(filtering ? 1 : 0);
+    }
+  }
+};
+
+function loadAnchors() {
+  if (!wasm) return;
+  const core = wasm.module;
+  core._uwb_core_set_anchor_count(anchors.length);
+  for (let i = 0; i < anchors.length; i++) {
+    core._uwb_core_set_anchor(i, anchors[i][0], anchors[i][1], anchors[i][2]);
+  }
+  core._uwb_core_set_filtering(filtering ? 1 : 0);
+  core._uwb_core_clear();
+}
+
+function solvePending() {
+  if (pending.length === 0) return;
+  if (wasm && anchors.length >= 3) {
+    solveWasm(pending);
+  } else {
+    const now = Date.now();
+    for (const report of pending) {
+      const fix = solveFallback(report);
+      if (!fix) continue;
+      if (filtering) filterFix(report.id, fix, now);
+      addFix(report.id, fix[0], fix[1], report.seq || 0);
+    }
+  }
+  pending = [];
+}
+
+// Copy the reports into the module's input buffer, one call per batch
+function solveWasm(reports) {
+  const core = wasm.module;
+  const heap = core.HEAPF32;
+  for (let start = 0; start < reports.length; start += wasm.batch) {
+    const count = Math.min(wasm.batch, reports.length - start);
+    for (let r = 0; r < count; r++) {
+      const report = reports[start + r];
+      const base = wasm.input + r * UWB_REPORT_FLOATS;
+      heap[base] = report.id;
+      heap[base + 1] = report.seq || 0;
+      heap[base + 2] = 0;   // No mask in the host output; 0 = use the ranges
+      for (let slot = 0; slot < UWB_FRAME_SLOTS; slot++) {
+        heap[base + 3 + slot] = report.range[slot] || 0;
+        heap[base + 3 + UWB_FRAME_SLOTS + slot] = report.rssi ? report.rssi[slot] || 0 : 0;
+      }
+    }
+    const solved = core._uwb_core_solve(count, Date.now() >>> 0);
+    for (let f = 0; f < solved; f++) {
+      const base = wasm.output + f * UWB_FIX_FLOATS;
+      addFix(heap[base], heap[base + 1], heap[base + 2], heap[base + 3]);
+    }
+  }
+}
+
+// JavaScript solver, as MaUWB_TagTracker::update() with the solver's
+// defaults: weight each reply, solve, and check the fix is plausible
+function solveFallback(report) {
+  const count = Math.min(anchors.length, report.range.length);
+  const weights = computeWeights(report.range, report.rssi, count);
+  const fix = solveLeastSquares(report.range, weights, count);
+  if (fix && isPlausible(fix[0], fix[1])) return fix;
+
+  // A single bad range can pull the fix out of the room; take the first
+  // anchor triplet that gives a plausible position, as the solver does
+  const range = report.range;
+  for (let i = 0; i + 2 < count; i++) {
+    for (let j = i + 1; j + 1 < count; j++) {
+      for (let k = j + 1; k < count; k++) {
+        if (!(range[i] > 0 && range[j] > 0 && range[k] > 0)) continue;
+        const three = new Array(count).fill(0);
+        three[i] = three[j] = three[k] = 1;
+        const triplet = solveLeastSquares(range, three, count);
+        if (triplet && isPlausible(triplet[0], triplet[1])) return triplet;
+      }
+    }
+  }
+  return null;
+}
+
+// RSSI sets the weight of each reply; a pair of ranges that breaks the
+// triangle inequality halves both, so the bad one ends up lowest
+function computeWeights(range, rssi, count) {
+  const weights = new Array(count).fill(0);
+  for (let i = 0; i < count; i++) {
+    if (!(range[i] > 0)) continue;
+    const level = rssi ? rssi[i] : undefined;
+    if (level !== undefined && level < UWB_RSSI_GOOD) {
+      const t = Math.max(0, (level - UWB_RSSI_FLOOR) / (UWB_RSSI_GOOD - UWB_RSSI_FLOOR));
+      weights[i] = UWB_WEIGHT_MIN + (1 - UWB_WEIGHT_MIN) * t;
+    } else {
+      weights[i] = 1;
+    }
+  }
+  for (let i = 0; i < count; i++) {
+    if (!(range[i] > 0)) continue;
+    for (let j = i + 1; j < count; j++) {
+      if (!(range[j] > 0)) continue;
+      const between = Math.hypot(anchors[i][0] - anchors[j][0], anchors[i][1] - anchors[j][1]);
+      if (Math.abs(range[i] - range[j]) > between + UWB_CONSISTENCY_TOLERANCE ||
+          range[i] + range[j] < between - UWB_CONSISTENCY_TOLERANCE) {
+        weights[i] *= 0.5;
+        weights[j] *= 0.5;
+      }
+    }
+  }
+  return weights;
+}
+
+// Linearised weighted least squares: each equation is the difference of one
+// anchor's circle to the best weighted one's
+function solveLeastSquares(range, weights, count) {
+  let ref = -1;
+  let used = 0;
+  for (let i = 0; i < count; i++) {
+    if (weights[i] <= 0) continue;
+    if (ref < 0 || weights[i] > weights[ref]) ref = i;
+    used++;
+  }
+  if (used < 3) return null;
+
+  const [x0, y0, z0] = anchors[ref];
+  const r0 = range[ref];
+  let a11 = 0, a12 = 0, a22 = 0, b1 = 0, b2 = 0;
+  for (let i = 0; i < count; i++) {
+    if (i === ref || weights[i] <= 0) continue;
+    const [xi, yi, zi] = anchors[i];
+    const r = range[i];
+    const w = weights[i];
+    const ax = 2 * (xi - x0);
+    const ay = 2 * (yi - y0);
+    const b = r0 * r0 - r * r + xi * xi - x0 * x0 + yi * yi - y0 * y0 + zi * zi - z0 * z0;
+    a11 += w * ax * ax;
+    a12 += w * ax * ay;
+    a22 += w * ay * ay;
+    b1 += w * ax * b;
+    b2 += w * ay * b;
+  }
+  const det = a11 * a22 - a12 * a12;
+  if (Math.abs(det) < 1e-6) return null;
+  return [(b1 * a22 - b2 * a12) / det, (a11 * b2 - a12 * b1) / det];
+}
+
+// Within UWB_SOLVER_MARGIN of the anchors' bounding box, as
+// MaUWB_Solver::isPlausible()
+function isPlausible(x, y) {
+  if (!Number.isFinite(x) || !Number.isFinite(y)) return false;
+  let minX = Infinity, maxX = -Infinity, minY = Infinity, maxY = -Infinity;
+  for (const [ax, ay] of anchors) {
+    minX = Math.min(minX, ax);
+    maxX = Math.max(maxX, ax);
+    minY = Math.min(minY, ay);
+    maxY = Math.max(maxY, ay);
+  }
+  return x >= minX - UWB_SOLVER_MARGIN && x <= maxX + UWB_SOLVER_MARGIN &&
+         y >= minY - UWB_SOLVER_MARGIN && y <= maxY + UWB_SOLVER_MARGIN;
+}
+
+// Constant-velocity Kalman filter per tag, as MaUWB_KalmanFilterT; fix is
+// replaced by the filtered position
+function filterFix(id, fix, now) {
+  let track = tracks.get(id);
+  const dt = track ? (now - track.time) / 1000 : 0;
+  if (!track || dt <= 0 || dt > UWB_KALMAN_RESTART_GAP) {
+    // Start at the fix with unknown velocity, (100 cm/s)^2
+    tracks.set(id, {
+      time: now, x: fix[0], y: fix[1], vx: 0, vy: 0,
+      p00: UWB_KALMAN_MEASUREMENT_NOISE, p01: 0, p11: 1e4,
+    });
+    return;
+  }
+  track.time = now;
+
+  // Predict: x' = x + v dt, P' = F P F^T + Q (white acceleration)
+  track.x += track.vx * dt;
+  track.y += track.vy * dt;
+  const qdt = UWB_KALMAN_PROCESS_NOISE * dt;
+  const n00 = track.p00 + 2 * dt * track.p01 + dt * dt * track.p11 + qdt * dt * dt / 3;
+  const n01 = track.p01 + dt * track.p11 + qdt * dt / 2;
+  const n11 = track.p11 + qdt;
+
+  // Update with the position measurement; same gain for both axes
+  const k0 = n00 / (n00 + UWB_KALMAN_MEASUREMENT_NOISE);
+  const k1 = n01 / (n00 + UWB_KALMAN_MEASUREMENT_NOISE);
+  const innovX = fix[0] - track.x;
+  const innovY = fix[1] - track.y;
+  track.x += k0 * innovX;
+  track.y += k0 * innovY;
+  track.vx += k1 * innovX;
+  track.vy += k1 * innovY;
+  track.p00 = (1 - k0) * n00;
+  track.p01 = (1 - k0) * n01;
+  track.p11 = n11 - k1 * n01;
+
+  fix[0] = track.x;
+  fix[1] = track.y;
+}
+
+function addFix(id, x, y, seq) {
+  if (fixCount * UWB_FIX_FLOATS >= fixes.length) {
+    const grown = new Float32Array(fixes.length * 2);
+    grown.set(fixes);
+    fixes = grown;
+  }
+  const base = fixCount * UWB_FIX_FLOATS;
+  fixes[base] = id;
+  fixes[base + 1] = x;
+  fixes[base + 2] = y;
+  fixes[base + 3] = seq;
+  fixCount++;
+  stats.fixes++;
+  scheduleFlush();
+}
+
+function scheduleFlush() {
+  if (flushTimer === null) {
+    flushTimer = setTimeout(flush, batchMs);
+  }
+}
+
+// One message per batch; the fix buffer is transferred, not copied
+function flush() {
+  flushTimer = null;
+  if (fixCount > 0) {
+    const data = fixes.slice(0, fixCount * UWB_FIX_FLOATS);
+    postMessage({ type: "positions", data: data }, [data.buffer]);
+    fixCount = 0;
+  }
+  if (lines.length > 0) {
+    postMessage({ type: "lines", lines: lines });
+    lines = [];
+  }
+}
+
+setInterval(() => {
+  postMessage({
+    type: "stats",
+    reports: stats.reports,
+    fixes: stats.fixes,
+    crcErrors: decoder.crcErrors,
+    core: wasm ? "wasm" : wasmLoading ? "js loading" : "js fallback",
+  });
+  stats.reports = 0;
+  stats.fixes = 0;
+}, 1000);
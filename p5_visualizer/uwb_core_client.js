@@ -0,0 +1,88 @@
+// uwb_core_client.js - Main-thread side of uwb_worker.js
+//
+// Reading the serial port stays here (a SerialPort cannot be handed to a
+// worker), but each chunk goes straight to the worker without being looked
+// at. Decoding and solving happen there, and fixes come back in batches of
+// tid, x, y, seq (a Float32Array, UWB_FIX_FLOATS per fix), at most one
+// message every batchMs. draw() then only has to place the tags.
+//
+//   const uwbCore = new UwbCoreClient(handlePositions, (line) => console.log(line));
+//   uwbCore.setAnchors([[0, 0], [0, 1270], [540, 1270], [540, 0]]);
+//   ...after port.open():
+//   uwbCore.readPort(port);
+//
+//   function handlePositions(batch) {
+//     for (let i = 0; i < batch.length; i += UWB_FIX_FLOATS) {
+//       const id = batch[i], x = batch[i + 1], y = batch[i + 2];
+//     }
+//   }
+//
+// The page has to be served over http(s) (the p5 editor, or a local web
+// server): browsers do not start workers from file:// pages.
+//
+// This file is copied into every p5 sketch folder that uses it; keep the
+// copies identical.
+
+const UWB_FIX_FLOATS = 4;
+
+class UwbCoreClient {
+  constructor(onPositions, onLine, options) {
+    this.onPositions = onPositions;
+    this.onLine = onLine || (() => {});
+    this.onStats = (options && options.onStats) || (() => {});
+    this.stats = { reports: 0, fixes: 0, crcErrors: 0, core: "js fallback" };
+
+    this.worker = new Worker("uwb_worker.js");
+    this.worker.onmessage = (event) => this.handleMessage(event.data);
+    if (options) {
+      this.worker.postMessage({ type: "config", batchMs: options.batchMs, filtering: options.filtering });
+    }
+  }
+
+  // Anchor layout in cm, [x, y] or [x, y, z] per anchor
+  setAnchors(anchors) {
+    this.worker.postMessage({ type: "anchors", anchors: anchors });
+  }
+
+  // Forward everything the port sends until it closes
+  async readPort(port) {
+    const reader = port.readable.getReader();
+    try {
+      while (true) {
+        const { value, done } = await reader.read();
+        if (done) break;
+        // Transferred: the chunk's buffer moves to the worker without a copy
+        this.worker.postMessage({ type: "bytes", bytes: value }, [value.buffer]);
+      }
+    } catch (error) {
+      console.error("Error reading from serial:", error);
+    } finally {
+      reader.releaseLock();
+    }
+  }
+
+  // True while the worker solves in JavaScript instead of uwb_core.wasm
+  usingFallback() {
+    return this.stats.core !== "wasm";
+  }
+
+  // For the stats line; the fallback is spelled out so it is not missed
+  solverLabel() {
+    if (this.stats.core === "wasm") return "wasm";
+    if (this.stats.core === "js loading") return "JS fallback (uwb_core.wasm loading)";
+    return "JS FALLBACK (uwb_core.wasm not built)";
+  }
+
+  handleMessage(message) {
+    if (message.type === "positions") {
+      this.onPositions(message.data);
+    } else if (message.type === "lines") {
+      for (const line of message.lines) {
+        this.onLine(line);
+      }
+    } else if (message.type === "stats") {
+      this.stats = message;
+      this.onStats(message);
+    }
+  }
+}
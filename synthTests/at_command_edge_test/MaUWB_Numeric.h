@@ -0,0 +1,147 @@
+/*
+ * MaUWB_Numeric.h - Numeric policy for the solver and position filters
+ *
+ * MaUWB_SolverT and the filters in MaUWB_Filter.h are templates on the
+ * number type they compute with. MaUWB_Real picks it at compile time:
+ *
+ *   float        default; single precision only, no double promotion
+ *   MaUWB_Q16    Q16.16 fixed point, when MAUWB_FIXED_POINT is defined,
+ *                for MCUs without an FPU
+ *
+ * MaUWB_Q16 holds values in -32768..32767 with a resolution of 1/65536.
+ * Products and quotients go through 64-bit integers and saturate instead of
+ * wrapping; square roots are integer-only. The solver works in metres
+ * relative to the centre of the anchor layout with it (see
+ * MaUWB_Numeric<T>::unit()), so layouts up to about 20 m across stay in
+ * range. The interfaces of both stay in float cm; only the per-fix math
+ * changes.
+ *
+ * Only needs the C library, so it also builds on a desktop compiler.
+ */
+
+#ifndef MAUWB_NUMERIC_H
+#define MAUWB_NUMERIC_H
+
+#include <stdint.h>
+#include <math.h>
+
+class MaUWB_Q16 {
+public:
+    int32_t raw;   // value * 65536
+
+    constexpr MaUWB_Q16() : raw(0) {}
+    constexpr MaUWB_Q16(int value) : raw((int32_t)value * 65536) {}
+    constexpr MaUWB_Q16(float value)
+        : raw(value >= 32767.99998f ? INT32_MAX
+              : value <= -32768.0f  ? INT32_MIN
+                                    : (int32_t)(value * 65536.0f + (value < 0 ? -0.5f : 0.5f))) {}
+
+    static MaUWB_Q16 fromRaw(int32_t raw) {
+        MaUWB_Q16 q;
+        q.raw = raw;
+        return q;
+    }
+
+    float toFloat() const { return raw / 65536.0f; }
+
+    friend MaUWB_Q16 operator+(MaUWB_Q16 a, MaUWB_Q16 b) { return fromRaw(saturate((int64_t)a.raw + b.raw)); }
+    friend MaUWB_Q16 operator-(MaUWB_Q16 a, MaUWB_Q16 b) { return fromRaw(saturate((int64_t)a.raw - b.raw)); }
+    friend MaUWB_Q16 operator-(MaUWB_Q16 a) { return fromRaw(saturate(-(int64_t)a.raw)); }
+
+    friend MaUWB_Q16 operator*(MaUWB_Q16 a, MaUWB_Q16 b) {
+        int64_t product = (int64_t)a.raw * b.raw;
+        return fromRaw(saturate((product + 32768) >> 16));
+    }
+
+    // Rounded to nearest; division by zero saturates towards the dividend's sign
+    friend MaUWB_Q16 operator/(MaUWB_Q16 a, MaUWB_Q16 b) {
+        if (b.raw == 0) {
+            return fromRaw(a.raw >= 0 ? INT32_MAX : INT32_MIN);
+        }
+        int64_t numerator = (int64_t)a.raw * 65536;
+        int64_t half = (b.raw < 0 ? -(int64_t)b.raw : b.raw) / 2;
+        numerator += (numerator < 0) != (b.raw < 0) ? -half : half;
+        return fromRaw(saturate(numerator / b.raw));
+    }
+
+    MaUWB_Q16& operator+=(MaUWB_Q16 b) { return *this = *this + b; }
+    MaUWB_Q16& operator-=(MaUWB_Q16 b) { return *this = *this - b; }
+    MaUWB_Q16& operator*=(MaUWB_Q16 b) { return *this = *this * b; }
+    MaUWB_Q16& operator/=(MaUWB_Q16 b) { return *this = *this / b; }
+
+    friend bool operator==(MaUWB_Q16 a, MaUWB_Q16 b) { return a.raw == b.raw; }
+    friend bool operator!=(MaUWB_Q16 a, MaUWB_Q16 b) { return a.raw != b.raw; }
+    friend bool operator<(MaUWB_Q16 a, MaUWB_Q16 b) { return a.raw < b.raw; }
+    friend bool operator<=(MaUWB_Q16 a, MaUWB_Q16 b) { return a.raw <= b.raw; }
+    friend bool operator>(MaUWB_Q16 a, MaUWB_Q16 b) { return a.raw > b.raw; }
+    friend bool operator>=(MaUWB_Q16 a, MaUWB_Q16 b) { return a.raw >= b.raw; }
+
+    // Bit-by-bit integer square root of raw << 16
+    static MaUWB_Q16 sqrt(MaUWB_Q16 v) {
+        if (v.raw <= 0) {
+            return MaUWB_Q16();
+        }
+        uint64_t n = (uint64_t)v.raw << 16;
+        uint64_t root = 0;
+        uint64_t bit = (uint64_t)1 << 46;   // n < 2^47
+        while (bit > n) {
+            bit >>= 2;
+        }
+        while (bit) {
+            if (n >= root + bit) {
+                n -= root + bit;
+                root = (root >> 1) + bit;
+            } else {
+                root >>= 1;
+            }
+            bit >>= 2;
+        }
+        return fromRaw((int32_t)root);
+    }
+
+private:
+    static int32_t saturate(int64_t value) {
+        return value > INT32_MAX ? INT32_MAX : value < INT32_MIN ? INT32_MIN : (int32_t)value;
+    }
+};
+
+// Per-type helpers used by the templated solver and filters
+template <typename T>
+struct MaUWB_Numeric;
+
+template <>
+struct MaUWB_Numeric<float> {
+    static float fromFloat(float v) { return v; }
+    static float toFloat(float v) { return v; }
+    static float sqrt(float v) { return sqrtf(v); }
+    static float abs(float v) { return fabsf(v); }
+
+    // cm per solver unit
+    static float unit() { return 1.0f; }
+
+    // Relative size below which a determinant counts as singular
+    static float tiny() { return 1e-6f; }
+};
+
+template <>
+struct MaUWB_Numeric<MaUWB_Q16> {
+    static MaUWB_Q16 fromFloat(float v) { return MaUWB_Q16(v); }
+    static float toFloat(MaUWB_Q16 v) { return v.toFloat(); }
+    static MaUWB_Q16 sqrt(MaUWB_Q16 v) { return MaUWB_Q16::sqrt(v); }
+    static MaUWB_Q16 abs(MaUWB_Q16 v) { return v.raw < 0 ? -v : v; }
+
+    // Metres, so squared room-scale ranges fit in 16 integer bits
+    static float unit() { return 100.0f; }
+
+    // Seven steps of 1/65536
+    static MaUWB_Q16 tiny() { return MaUWB_Q16::fromRaw(7); }
+};
+
+// Number type of the solver and filters
+#ifdef MAUWB_FIXED_POINT
+typedef MaUWB_Q16 MaUWB_Real;
+#else
+typedef float MaUWB_Real;
+#endif
+
+#endif // MAUWB_NUMERIC_H
@@ -34,6 +34,8 @@ All distances are in centimeters.
 */
 
 #include <Arduino.h>
+#include "MaUWB_RangeParser.h"
+#include "MaUWB_Solver.h"
 
 // Define AT command response format
 #define AT_RESP_PREFIX "AT+RANGE=tid:1,mask:0x0F,seq:0,range:("
@@ -47,6 +49,9 @@ All distances are in centimeters.
 const float anchor_x[4] = {0, 0, 380, 380};
 const float anchor_y[4] = {0, 600, 600, 0};
 
+// Anchor geometry cache for the position solve, loaded in setup()
+MaUWB_Solver solver;
+
 // Distance measurements to anchors
 float dist_to_a0 = 0.0;
 float dist_to_a1 = 0.0;
@@ -97,46 +102,13 @@ void calculatePosition() {
     float x2 = 0, y2 = 0;  // Position calculated from anchors 0,1,3
     float x3 = 0, y3 = 0;  // Position calculated from anchors 0,2,3
     
-    // Precompute squared distances and other repeated values
-    float dist_to_a0_sq = dist_to_a0 * dist_to_a0;
-    float dist_to_a1_sq = dist_to_a1 * dist_to_a1;
-    float dist_to_a2_sq = dist_to_a2 * dist_to_a2;
-    float dist_to_a3_sq = dist_to_a3 * dist_to_a3;
-    
-    // Precompute anchor position terms
-    float a0_sq = anchor_x[0] * anchor_x[0] + anchor_y[0] * anchor_y[0];
-    float a1_sq = anchor_x[1] * anchor_x[1] + anchor_y[1] * anchor_y[1];
-    float a2_sq = anchor_x[2] * anchor_x[2] + anchor_y[2] * anchor_y[2];
-    float a3_sq = anchor_x[3] * anchor_x[3] + anchor_y[3] * anchor_y[3];
-    
-    // Common calculations for equations involving anchors 0-1
-    float A_01 = 2 * (anchor_x[1] - anchor_x[0]);
-    float B_01 = 2 * (anchor_y[1] - anchor_y[0]);
-    float C_01 = dist_to_a0_sq - dist_to_a1_sq - a0_sq + a1_sq;
-    
-    // Common calculations for other anchor pairs
-    float A_12 = 2 * (anchor_x[2] - anchor_x[1]);
-    float B_12 = 2 * (anchor_y[2] - anchor_y[1]);
-    float C_12 = dist_to_a1_sq - dist_to_a2_sq - a1_sq + a2_sq;
-    
-    float A_13 = 2 * (anchor_x[3] - anchor_x[1]);
-    float B_13 = 2 * (anchor_y[3] - anchor_y[1]);
-    float C_13 = dist_to_a1_sq - dist_to_a3_sq - a1_sq + a3_sq;
-    
-    float A_02 = 2 * (anchor_x[2] - anchor_x[0]);
-    float B_02 = 2 * (anchor_y[2] - anchor_y[0]);
-    float C_02 = dist_to_a0_sq - dist_to_a2_sq - a0_sq + a2_sq;
-    
-    float A_23 = 2 * (anchor_x[3] - anchor_x[2]);
-    float B_23 = 2 * (anchor_y[3] - anchor_y[2]);
-    float C_23 = dist_to_a2_sq - dist_to_a3_sq - a2_sq + a3_sq;
+    // The anchor terms of each triplet are cached in the solver and only
+    // rebuilt when the layout changes; a fix needs just the squared ranges
+    const float ranges[4] = {dist_to_a0, dist_to_a1, dist_to_a2, dist_to_a3};
     
     // Solve using anchors 0,1,2
-    float den1 = (A_01 * B_12 - B_01 * A_12);
-    if (abs(den1) > 0.000001) {
-        x1 = (C_01 * B_12 - C_12 * B_01) / den1;
-        y1 = (A_01 * C_12 - C_01 * A_12) / den1;
-        
+    bool valid1 = solver.solveTriplet(0, 1, 2, ranges, x1, y1);
+    if (valid1) {
         Serial.print("Position from anchors 0,1,2: (");
         Serial.print(x1);
         Serial.print(", ");
@@ -145,11 +117,8 @@ void calculatePosition() {
     }
     
     // Solve using anchors 0,1,3
-    float den2 = (A_01 * B_13 - B_01 * A_13);
-    if (abs(den2) > 0.000001) {
-        x2 = (C_01 * B_13 - C_13 * B_01) / den2;
-        y2 = (A_01 * C_13 - C_01 * A_13) / den2;
-        
+    bool valid2 = solver.solveTriplet(0, 1, 3, ranges, x2, y2);
+    if (valid2) {
         Serial.print("Position from anchors 0,1,3: (");
         Serial.print(x2);
         Serial.print(", ");
@@ -158,11 +127,8 @@ void calculatePosition() {
     }
     
     // Solve using anchors 0,2,3
-    float den3 = (A_02 * B_23 - B_02 * A_23);
-    if (abs(den3) > 0.000001) {
-        x3 = (C_02 * B_23 - C_23 * B_02) / den3;
-        y3 = (A_02 * C_23 - C_02 * A_23) / den3;
-        
+    bool valid3 = solver.solveTriplet(0, 2, 3, ranges, x3, y3);
+    if (valid3) {
         Serial.print("Position from anchors 0,2,3: (");
         Serial.print(x3);
         Serial.print(", ");
@@ -172,9 +138,9 @@ void calculatePosition() {
     
     // Count valid solutions
     int validSolutions = 0;
-    if (abs(den1) > 0.000001) validSolutions++;
-    if (abs(den2) > 0.000001) validSolutions++;
-    if (abs(den3) > 0.000001) validSolutions++;
+    if (valid1) validSolutions++;
+    if (valid2) validSolutions++;
+    if (valid3) validSolutions++;
     
     if (validSolutions == 0) {
         Serial.println("Cannot calculate position - no valid solutions");
@@ -184,15 +150,15 @@ void calculatePosition() {
     // Calculate position as average of valid solutions
     float x = 0.0, y = 0.0;
     
-    if (abs(den1) > 0.000001) {
+    if (valid1) {
         x += x1;
         y += y1;
     }
-    if (abs(den2) > 0.000001) {
+    if (valid2) {
         x += x2;
         y += y2;
     }
-    if (abs(den3) > 0.000001) {
+    if (valid3) {
         x += x3;
         y += y3;
     }
@@ -214,64 +180,40 @@ void calculatePosition() {
 }
 
 // Parse range information from AT command response
-void parseRangeData(String data) {
+void parseRangeData(const String& data) {
     // According to the AT command manual, the response format is:
     // AT+RANGE=tid:x1,mask:x2,seq:x3,range:(x4,x5,x6,x7,x8,x9,x10,x11), rssi:(x12,x13,x14,x15,x16,x17,x18,x19)
+    // Decoded with the same parser the tag sketches use
+    MaUWB_RangeReport report;
+    if (!MaUWB_RangeParser::parse(data.c_str(), report)) {
+        return;
+    }
     
-    // Look for "range:(" in the response
-    int range_start = data.indexOf("range:(");
-    if (range_start >= 0) {
-        // Find the end of the range array
-        int range_end = data.indexOf(")", range_start);
-        if (range_end > range_start) {
-            // We're only interested in the first 4 values (0-3)
-            float distances[4] = {0, 0, 0, 0};
-            
-            // Parse directly from the original string without creating substrings
-            int startIndex = range_start + 7;  // Skip "range:("
-            int valueIndex = 0;
-            
-            Serial.print("Range values: ");
-            
-            // Parse each value directly
-            while (valueIndex < 4 && startIndex < range_end) {
-                // Find the next comma or the end parenthesis
-                int commaIndex = data.indexOf(',', startIndex);
-                if (commaIndex == -1 || commaIndex > range_end) {
-                    commaIndex = range_end;
-                }
-                
-                // Convert this segment directly to float
-                char buffer[10]; // Temporary buffer for number conversion
-                int len = commaIndex - startIndex;
-                if (len < 10) {
-                    strncpy(buffer, data.c_str() + startIndex, len);
-                    buffer[len] = '\0';
-                    distances[valueIndex] = atof(buffer);
-                }
-                
-                Serial.print(distances[valueIndex]);
-                if (valueIndex < 3) Serial.print(", ");
-                
-                valueIndex++;
-                startIndex = commaIndex + 1;
-            }
-            
-            Serial.println();
-            
-            // Update our distance variables
-            dist_to_a0 = distances[0];
-            dist_to_a1 = distances[1];
-            dist_to_a2 = distances[2];
-            dist_to_a3 = distances[3];
-            
-            // Calculate 2D position
-            calculatePosition();
-        }
+    // We're only interested in the first 4 values (0-3)
+    Serial.print("Range values: ");
+    for (int i = 0; i < 4; i++) {
+        Serial.print(report.range[i]);
+        if (i < 3) Serial.print(", ");
     }
+    Serial.println();
+    
+    // Update our distance variables
+    dist_to_a0 = report.range[0];
+    dist_to_a1 = report.range[1];
+    dist_to_a2 = report.range[2];
+    dist_to_a3 = report.range[3];
+    
+    // Calculate 2D position
+    calculatePosition();
 }
 
 void setup() {
+    // Load the anchor layout; the solver rebuilds its geometry cache once
+    solver.setAnchorCount(4);
+    for (uint8_t i = 0; i < 4; i++) {
+        solver.setAnchor(i, anchor_x[i], anchor_y[i]);
+    }
+    
     Serial.begin(115200);
     delay(1000);
     
@@ -0,0 +1,195 @@
+/*
+Fixed-Point Position Pipeline Test
+This sketch checks the Q16.16 build of the solver and filters against float.
+
+PURPOSE:
+MaUWB_SolverT and the filters in MaUWB_Filter.h compute with either float or
+MaUWB_Q16 (see MaUWB_Numeric.h; MAUWB_FIXED_POINT selects Q16.16 for the
+whole build). This sketch runs both side by side on the same synthetic
+ranges and reports how far the fixed-point positions drift from float ones,
+plus the time per fix for each.
+
+TESTS:
+1. Grid over the 380 x 600 cm test area (plus 50 cm outside), with a few cm
+   of deterministic range noise: solve(), solveWeighted() and solveChecked(),
+   without and with Gauss-Newton refinement
+2. A moving tag through the Kalman filter and the moving average
+
+EXPECTED:
+Every test reports a maximum deviation below MAX_DEVIATION_CM (1 cm).
+Measured on the host: about 0.25 cm for the weighted solve without
+refinement, 0.05 cm or less for the others.
+
+USAGE:
+- Run this sketch on an ESP32 and open the serial monitor at 115200
+- 'run' repeats the tests
+
+All distances are in centimeters.
+*/
+
+#include <Arduino.h>
+#include <math.h>
+#include "MaUWB_Solver.h"
+#include "MaUWB_Filter.h"
+
+// Deviation from float accepted for the fixed-point build (cm)
+#define MAX_DEVIATION_CM 1.0f
+
+// Anchor positions in cm
+// A0 is top left (0,0)
+// A1 is left bottom (0,600)
+// A2 is right bottom (380,600)
+// A3 is top right (380,0)
+const float anchor_x[4] = {0, 0, 380, 380};
+const float anchor_y[4] = {0, 600, 600, 0};
+
+MaUWB_SolverT<float> floatSolver;
+MaUWB_SolverT<MaUWB_Q16> fixedSolver;
+
+bool allPassed = true;
+
+float calculateDistance(float x1, float y1, float x2, float y2) {
+    return sqrtf((x2-x1)*(x2-x1) + (y2-y1)*(y2-y1));
+}
+
+void report(const char* name, float maxDeviation, uint32_t floatMicros, uint32_t fixedMicros, uint16_t fixes) {
+    bool passed = maxDeviation < MAX_DEVIATION_CM;
+    if (!passed) allPassed = false;
+
+    Serial.print(passed ? "PASS " : "FAIL ");
+    Serial.print(name);
+    Serial.print(": max deviation ");
+    Serial.print(maxDeviation, 3);
+    Serial.print(" cm");
+    if (fixes > 0) {
+        Serial.print(", float ");
+        Serial.print((float)floatMicros / fixes, 1);
+        Serial.print(" us/fix, Q16.16 ");
+        Serial.print((float)fixedMicros / fixes, 1);
+        Serial.print(" us/fix");
+    }
+    Serial.println();
+}
+
+// 0 = solve(), 1 = solveWeighted(), 2 = solveChecked()
+void testGrid(const char* name, uint8_t method, uint8_t iterations) {
+    floatSolver.setRefinementIterations(iterations);
+    fixedSolver.setRefinementIterations(iterations);
+
+    const float weights[4] = {1.0f, 0.5f, 0.8f, 1.0f};
+    float maxDeviation = 0;
+    uint32_t floatMicros = 0, fixedMicros = 0;
+    uint16_t fixes = 0;
+
+    for (int x = -50; x <= 430; x += 10) {
+        for (int y = -50; y <= 650; y += 10) {
+            // -4..+4 cm of repeatable noise per range
+            float ranges[4];
+            for (uint8_t i = 0; i < 4; i++) {
+                ranges[i] = calculateDistance(x, y, anchor_x[i], anchor_y[i]) + ((x * 7 + y * 3 + i * 11) % 9 - 4);
+            }
+
+            float floatX, floatY, fixedX, fixedY;
+            bool floatSolved, fixedSolved;
+
+            uint32_t start = micros();
+            if (method == 0) floatSolved = floatSolver.solve(ranges, floatX, floatY);
+            else if (method == 1) floatSolved = floatSolver.solveWeighted(ranges, weights, floatX, floatY);
+            else floatSolved = floatSolver.solveChecked(ranges, floatX, floatY);
+            floatMicros += micros() - start;
+
+            start = micros();
+            if (method == 0) fixedSolved = fixedSolver.solve(ranges, fixedX, fixedY);
+            else if (method == 1) fixedSolved = fixedSolver.solveWeighted(ranges, weights, fixedX, fixedY);
+            else fixedSolved = fixedSolver.solveChecked(ranges, fixedX, fixedY);
+            fixedMicros += micros() - start;
+
+            if (floatSolved != fixedSolved) {
+                Serial.print("Only one build solved (");
+                Serial.print(x);
+                Serial.print(", ");
+                Serial.print(y);
+                Serial.println(")");
+                allPassed = false;
+                continue;
+            }
+            if (!floatSolved) continue;
+
+            float deviation = calculateDistance(floatX, floatY, fixedX, fixedY);
+            if (deviation > maxDeviation) maxDeviation = deviation;
+            fixes++;
+        }
+    }
+
+    report(name, maxDeviation, floatMicros, fixedMicros, fixes);
+}
+
+void testFilters() {
+    MaUWB_KalmanFilterT<float> floatKalman;
+    MaUWB_KalmanFilterT<MaUWB_Q16> fixedKalman;
+    MaUWB_MovingAverageT<float> floatAverage(5);
+    MaUWB_MovingAverageT<MaUWB_Q16> fixedAverage(5);
+
+    float kalmanDeviation = 0, averageDeviation = 0;
+
+    // 100 s of a tag wandering around the area at 20 Hz, with noise
+    for (int i = 0; i < 2000; i++) {
+        float t = i * 0.05f;
+        float x = 190 + 150 * sinf(t * 0.3f) + ((i * 37) % 11 - 5);
+        float y = 300 + 250 * cosf(t * 0.2f) + ((i * 53) % 13 - 6);
+
+        float floatX, floatY, fixedX, fixedY;
+        floatKalman.update(x, y, 0.05f, floatX, floatY);
+        fixedKalman.update(x, y, 0.05f, fixedX, fixedY);
+        float deviation = calculateDistance(floatX, floatY, fixedX, fixedY);
+        if (deviation > kalmanDeviation) kalmanDeviation = deviation;
+
+        floatAverage.update(x, y, 0.05f, floatX, floatY);
+        fixedAverage.update(x, y, 0.05f, fixedX, fixedY);
+        deviation = calculateDistance(floatX, floatY, fixedX, fixedY);
+        if (deviation > averageDeviation) averageDeviation = deviation;
+    }
+
+    report("Kalman filter", kalmanDeviation, 0, 0, 0);
+    report("Moving average", averageDeviation, 0, 0, 0);
+}
+
+void runTests() {
+    allPassed = true;
+    Serial.println("\n----- FIXED-POINT VS FLOAT -----");
+
+    testGrid("solve()", 0, 0);
+    testGrid("solveWeighted()", 1, 0);
+    testGrid("solveChecked()", 2, 0);
+    testGrid("solve(), 3 refinement steps", 0, 3);
+    testGrid("solveWeighted(), 3 refinement steps", 1, 3);
+    testFilters();
+
+    Serial.println(allPassed ? "All tests passed" : "Some tests FAILED");
+}
+
+void setup() {
+    floatSolver.setAnchorCount(4);
+    fixedSolver.setAnchorCount(4);
+    for (uint8_t i = 0; i < 4; i++) {
+        floatSolver.setAnchor(i, anchor_x[i], anchor_y[i]);
+        fixedSolver.setAnchor(i, anchor_x[i], anchor_y[i]);
+    }
+
+    Serial.begin(115200);
+    delay(2000);
+
+    runTests();
+    Serial.println("Type 'run' to repeat the tests");
+}
+
+void loop() {
+    if (Serial.available()) {
+        String command = Serial.readStringUntil('\n');
+        command.trim();
+        if (command == "run") {
+            runTests();
+        }
+    }
+    delay(10);
+}
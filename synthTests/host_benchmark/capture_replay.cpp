@@ -0,0 +1,251 @@
+/*
+Capture Replay Driver
+Feeds a recorded AT+RANGE stream into the parser and solver on a desktop.
+
+PURPOSE:
+The synthTests only see ideal generated strings. A capture (MaUWB_Capture.h,
+recorded with MaUWB_AT::setCaptureOutput() or "#cap" on an anchor) holds
+real room data with dropouts, zero fields and mask changes. This replays
+it as fast as the host allows, through the same tracker the anchors use
+(MaUWB_TagTracker: computeWeights, solveChecked, Kalman filter per tag),
+so parser and solver changes can be profiled and tuned on real data.
+
+REPORTS:
+- Records, range reports and other lines; CRC errors from a noisy serial dump
+- Per tag: reports, fixes, reports lost (sequence gaps), mask changes and
+  zero ranges from anchors in the mask
+- Per tag and anchor: share of the tag's reports with a range from it
+- Parse-only and full-pipeline time per report, and the replay speed
+  relative to the capture's own duration
+
+USAGE:
+  ./build/capture_replay room.cap
+  ./build/capture_replay room.cap --anchor 0,0 --anchor 0,1270 --anchor 540,1270 --anchor 540,0
+  ./build/capture_replay room.cap --csv > fixes.csv
+  ./build/capture_replay room.cap --unweighted --outliers 10
+
+The file can be a plain port dump: text outside the records is skipped.
+Without --anchor the MaUWB_TAG default layout (380 x 600 cm) is used.
+
+All distances are in centimeters.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+#include "MaUWB_RangeParser.h"
+#include "MaUWB_Capture.h"
+#include "MaUWB_LinkStats.h"
+
+// One entry per tag id a room is likely to use
+#define MAUWB_TRACKER_MAX_TAGS 64
+#include "MaUWB_Tracker.h"
+
+struct TagStats {
+    uint32_t reports;
+    uint32_t fixes;
+    uint32_t maskChanges;
+    uint32_t zeroRanges;    // Anchor in the mask but range 0
+    uint8_t lastMask;
+    bool seen;
+    MaUWB_LinkStats link;
+};
+
+static double nowNs() {
+    using namespace std::chrono;
+    return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static bool readFile(const char* path, std::vector<uint8_t>& data) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    uint8_t chunk[4096];
+    size_t count;
+    while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        data.insert(data.end(), chunk, chunk + count);
+    }
+    fclose(file);
+    return true;
+}
+
+static void usage(const char* name) {
+    printf("usage: %s <capture> [--anchor x,y]... [--csv] [--unweighted] [--unfiltered] [--outliers n]\n", name);
+}
+
+int main(int argc, char** argv) {
+    const char* path = nullptr;
+    float anchors[MAUWB_SOLVER_MAX_ANCHORS][2];
+    uint8_t anchorCount = 0;
+    bool csv = false;
+    bool weighting = true;
+    bool filtering = true;
+    int outliers = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--anchor") == 0 && i + 1 < argc) {
+            if (anchorCount >= MAUWB_SOLVER_MAX_ANCHORS ||
+                sscanf(argv[++i], "%f,%f", &anchors[anchorCount][0], &anchors[anchorCount][1]) != 2) {
+                printf("Bad anchor: %s\n", argv[i]);
+                return 2;
+            }
+            anchorCount++;
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            csv = true;
+        } else if (strcmp(argv[i], "--unweighted") == 0) {
+            weighting = false;
+        } else if (strcmp(argv[i], "--unfiltered") == 0) {
+            filtering = false;
+        } else if (strcmp(argv[i], "--outliers") == 0 && i + 1 < argc) {
+            outliers = atoi(argv[++i]);
+        } else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!path) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (anchorCount == 0) {
+        static const float defaults[4][2] = {{0, 0}, {0, 600}, {380, 600}, {380, 0}};
+        memcpy(anchors, defaults, sizeof(defaults));
+        anchorCount = 4;
+    }
+
+    std::vector<uint8_t> data;
+    if (!readFile(path, data)) {
+        printf("Cannot read %s\n", path);
+        return 2;
+    }
+
+    // Stats go to stderr with --csv so stdout stays a clean table
+    FILE* info = csv ? stderr : stdout;
+
+    // Pass 1: decode and parse only
+    MaUWB_CaptureReader reader;
+    MaUWB_RangeReport report;
+    uint32_t reports = 0, lines = 0;
+    uint64_t duration = 0;
+
+    double start = nowNs();
+    for (size_t i = 0; i < data.size(); i++) {
+        if (reader.feed(data[i]) == MaUWB_CaptureReader::RECORD) {
+            if (MaUWB_RangeParser::parse(reader.line(), report)) {
+                reports++;
+            } else {
+                lines++;
+            }
+            duration = reader.timestamp();
+        }
+    }
+    double parseNs = nowNs() - start;
+    uint32_t records = reader.getRecords();
+    uint32_t crcErrors = reader.getCrcErrors();
+
+    if (records == 0) {
+        fprintf(info, "No capture records in %s (%u bytes)\n", path, (unsigned)data.size());
+        return 1;
+    }
+
+    // Pass 2: the full anchor-side pipeline, on the capture's own clock
+    MaUWB_TagTracker* tracker = new MaUWB_TagTracker();
+    MaUWB_Solver& solver = tracker->getSolver();
+    solver.setAnchorCount(anchorCount);
+    for (uint8_t i = 0; i < anchorCount; i++) {
+        solver.setAnchor(i, anchors[i][0], anchors[i][1]);
+    }
+    solver.setOutlierRejection((uint8_t)outliers);
+    tracker->setWeighting(weighting);
+    tracker->setFiltering(filtering);
+
+    static TagStats stats[MAUWB_TRACKER_MAX_TAGS];
+    uint32_t fixes = 0;
+    uint32_t otherTids = 0;
+    if (csv) {
+        printf("time_ms,tid,seq,mask,x,y,raw_x,raw_y\n");
+    }
+
+    reader.reset();
+    start = nowNs();
+    for (size_t i = 0; i < data.size(); i++) {
+        if (reader.feed(data[i]) != MaUWB_CaptureReader::RECORD ||
+            !MaUWB_RangeParser::parse(reader.line(), report)) {
+            continue;
+        }
+
+        uint32_t now = (uint32_t)(reader.timestamp() / 1000);
+        const MaUWB_TagState* tag = tracker->update(report, now);
+
+        if (report.tid >= MAUWB_TRACKER_MAX_TAGS) {
+            otherTids++;
+        } else {
+            TagStats& s = stats[report.tid];
+            if (s.seen && s.lastMask != report.mask) s.maskChanges++;
+            s.seen = true;
+            s.lastMask = report.mask;
+            s.reports++;
+            s.link.update(report);
+            for (uint8_t a = 0; a < report.rangeCount && a < 8; a++) {
+                if ((report.mask & (1 << a)) && report.range[a] <= 0) s.zeroRanges++;
+            }
+            if (tag) s.fixes++;
+        }
+
+        if (tag) {
+            fixes++;
+            if (csv) {
+                printf("%u,%u,%u,0x%02X,%.1f,%.1f,%.1f,%.1f\n", (unsigned)now, tag->tid, tag->seq,
+                       tag->mask, tag->x, tag->y, tag->rawX, tag->rawY);
+            }
+        }
+    }
+    double pipelineNs = nowNs() - start;
+
+    fprintf(info, "----- CAPTURE REPLAY: %s -----\n", path);
+    fprintf(info, "%u bytes, %u records (%u range reports, %u other lines), %u CRC errors\n",
+            (unsigned)data.size(), (unsigned)records, (unsigned)reports, (unsigned)lines, (unsigned)crcErrors);
+    fprintf(info, "Capture length %.1f s, %u anchors, weighting %s, filter %s, outlier rejection %d\n",
+            duration / 1e6, anchorCount, weighting ? "on" : "off", filtering ? "on" : "off", outliers);
+
+    fprintf(info, "\n tid  reports    fixes     lost  mask changes  zero ranges\n");
+    for (uint16_t t = 0; t < MAUWB_TRACKER_MAX_TAGS; t++) {
+        if (!stats[t].seen) continue;
+        const MaUWB_TagState* tag = tracker->find(t);
+        fprintf(info, "%4u %8u %8u %8u %13u %12u\n", t, (unsigned)stats[t].reports, (unsigned)stats[t].fixes,
+                tag ? (unsigned)tag->missed : 0, (unsigned)stats[t].maskChanges, (unsigned)stats[t].zeroRanges);
+    }
+
+    fprintf(info, "\n tid  delivery per anchor (%% of reports)\n");
+    for (uint16_t t = 0; t < MAUWB_TRACKER_MAX_TAGS; t++) {
+        if (!stats[t].seen) continue;
+        fprintf(info, "%4u", t);
+        for (uint8_t a = 0; a < anchorCount && a < MAUWB_RANGE_SLOTS; a++) {
+            fprintf(info, "  A%u %5.1f", a, 100.0 * stats[t].link.getDelivered(a) / stats[t].reports);
+        }
+        fprintf(info, "\n");
+    }
+    if (otherTids > 0) {
+        fprintf(info, "%u reports from tag ids >= %u not listed\n", (unsigned)otherTids, MAUWB_TRACKER_MAX_TAGS);
+    }
+    if (tracker->getTableFullDrops() > 0) {
+        fprintf(info, "%u reports dropped: tracker table full\n", (unsigned)tracker->getTableFullDrops());
+    }
+
+    fprintf(info, "\nDecode + parse    %8.1f ns/report\n", reports ? parseNs / reports : 0);
+    fprintf(info, "Full pipeline     %8.1f ns/report, %u fixes\n", reports ? pipelineNs / reports : 0,
+            (unsigned)fixes);
+    if (duration > 0) {
+        fprintf(info, "Replay speed      %8.0f x real time\n", duration * 1000.0 / pipelineNs);
+    }
+
+    delete tracker;
+    return 0;
+}
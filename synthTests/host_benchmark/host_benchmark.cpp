@@ -0,0 +1,770 @@
+/*
+Host Benchmark for the Positioning Core
+Builds the parser, solver and filters on a desktop and measures them.
+
+PURPOSE:
+The synthTests sketches only run on the board and print one or two
+hand-picked points. This runs the same pipeline as
+MaUWB_TAG::calculatePosition() (parse, computeWeights, solveChecked,
+Kalman filter) on a PC, so speed and accuracy regressions show up before
+flashing.
+
+REPORTS:
+1. ns per parsed AT+RANGE line, for parse() and byte-wise feed()
+2. Fixes per second for each solver path, in float and Q16.16
+3. Position error over a 5 cm grid of the 380 x 600 cm room at several
+   range noise levels (Gaussian, in cm), for the full pipeline
+4. The same with the anchors mounted at different heights (3D mode), the
+   tag height known or estimated
+5. Anchor self-survey (MaUWB_Survey.h): layout error from noisy
+   anchor-to-anchor ranges
+6. Motion-adaptive rate (MaUWB_Motion.h): fixes taken by a tag that
+   rests, walks and rests again, against a fixed rate, and how fast it
+   notices that it started moving
+7. Bitmap blit (MaUWB_Bitmap.h): raw and RLE bitmaps drawn at every
+   alignment against setting each pixel, checked pixel for pixel
+8. Zone map (MaUWB_Zones.h): fixes past the room's walls, hysteresis at
+   a zone edge and the debounce, checked case by case, and ns per fix
+
+USAGE:
+  cmake -S . -B build && cmake --build build
+  ./build/host_benchmark           full run
+  ./build/host_benchmark --quick   coarse grid, fewer repetitions (ctest)
+
+Exits with 1 if the noise-free error on the grid goes above
+MAX_CLEAN_ERROR_CM, or a noisy level above its limit, so it can gate CI.
+Timings depend on the host CPU; compare runs on the same machine.
+
+All distances are in centimeters.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include "MaUWB_RangeParser.h"
+#include "MaUWB_Solver.h"
+#include "MaUWB_Filter.h"
+#include "MaUWB_Survey.h"
+#include "MaUWB_Motion.h"
+#include "MaUWB_Bitmap.h"
+#include "MaUWB_Logo.h"
+#include "MaUWB_Zones.h"
+
+// Largest error accepted on the noise-free grid (cm)
+#define MAX_CLEAN_ERROR_CM 1.0f
+
+// Anchor positions in cm, as in the synthTests
+// A0 is top left (0,0)
+// A1 is left bottom (0,600)
+// A2 is right bottom (380,600)
+// A3 is top right (380,0)
+static const float anchor_x[4] = {0, 0, 380, 380};
+static const float anchor_y[4] = {0, 600, 600, 0};
+static const uint8_t ANCHORS = 4;
+
+// 3D mode: anchor mounting heights and the tag's height (cm)
+static const float anchor_z[4] = {250, 200, 260, 180};
+static const float TAG_Z = 100;
+
+// 0 = flat (everything at z = 0), 1 = anchor heights, tag height known,
+// 2 = anchor heights, tag height estimated
+static uint8_t heightMode = 0;
+
+// Range noise levels for the grid (standard deviation, cm) and the mean
+// error each may reach before the run fails
+static const float noiseLevels[] = {0, 2, 5, 10, 20};
+static const float noiseLimits[] = {MAX_CLEAN_ERROR_CM, 4, 8, 15, 30};
+static const uint8_t NOISE_LEVELS = sizeof(noiseLevels) / sizeof(noiseLevels[0]);
+
+static bool quick = false;
+
+// Each timing runs for at least this long (ns); --quick divides it by 10
+static const double MIN_RUN_NS = 200e6;
+
+// Keeps the optimiser from dropping benchmarked work
+static volatile float sink;
+
+static double nowNs() {
+    using namespace std::chrono;
+    return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// xorshift32 with Box-Muller, fixed seed so runs are repeatable
+static uint32_t randomState = 0x2545F491;
+
+static float uniform() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return (randomState >> 8) * (1.0f / 16777216.0f);
+}
+
+static float gaussian(float sigma) {
+    float u = uniform();
+    if (u < 1e-7f) u = 1e-7f;
+    return sigma * sqrtf(-2.0f * logf(u)) * cosf(6.2831853f * uniform());
+}
+
+static float calculateDistance(float x1, float y1, float x2, float y2) {
+    return sqrtf((x2-x1)*(x2-x1) + (y2-y1)*(y2-y1));
+}
+
+static void makeRanges(float x, float y, float sigma, float* ranges) {
+    for (uint8_t i = 0; i < ANCHORS; i++) {
+        float planar = calculateDistance(x, y, anchor_x[i], anchor_y[i]);
+        float dz = heightMode ? anchor_z[i] - TAG_Z : 0;
+        ranges[i] = sqrtf(planar * planar + dz * dz) + (sigma > 0 ? gaussian(sigma) : 0);
+        if (ranges[i] < 1) ranges[i] = 1;
+    }
+}
+
+// AT+RANGE line as the module sends it
+static void makeReport(char* line, size_t size, uint16_t seq, const float* ranges) {
+    snprintf(line, size,
+             "AT+RANGE=tid:1,mask:0F,seq:%u,range:(%d,%d,%d,%d,0,0,0,0),"
+             "rssi:(-77.93,-78.10,-76.52,-81.40,0.00,0.00,0.00,0.00)\r\n",
+             seq, (int)ranges[0], (int)ranges[1], (int)ranges[2], (int)ranges[3]);
+}
+
+template <typename T>
+static void setupSolver(MaUWB_SolverT<T>& solver) {
+    solver.setAnchorCount(ANCHORS);
+    for (uint8_t i = 0; i < ANCHORS; i++) {
+        solver.setAnchor(i, anchor_x[i], anchor_y[i], heightMode ? anchor_z[i] : 0);
+    }
+    if (heightMode == 1) {
+        solver.setTagHeight(TAG_Z);
+    } else if (heightMode == 2) {
+        // From a rough first guess; later fixes start from the last height
+        solver.setTagHeight(TAG_Z - 50);
+        solver.setHeightEstimation(true, 0, 250);
+    }
+}
+
+static void benchmarkParser() {
+    const uint16_t LINES = 64;
+    static char lines[LINES][MAUWB_RANGE_LINE_MAX];
+    for (uint16_t i = 0; i < LINES; i++) {
+        float ranges[ANCHORS];
+        makeRanges(uniform() * 380, uniform() * 600, 0, ranges);
+        makeReport(lines[i], sizeof(lines[i]), i, ranges);
+    }
+
+    const double target = quick ? MIN_RUN_NS / 10 : MIN_RUN_NS;
+    MaUWB_RangeReport report;
+    float total = 0;
+
+    uint32_t parsed = 0;
+    double start = nowNs(), elapsed = 0;
+    while (elapsed < target) {
+        for (uint16_t i = 0; i < LINES; i++) {
+            if (MaUWB_RangeParser::parse(lines[i], report)) {
+                total += report.range[0];
+            }
+        }
+        parsed += LINES;
+        elapsed = nowNs() - start;
+    }
+    double parseNs = elapsed / parsed;
+
+    MaUWB_RangeParser parser;
+    uint32_t fed = 0;
+    start = nowNs();
+    elapsed = 0;
+    while (elapsed < target) {
+        for (uint16_t i = 0; i < LINES; i++) {
+            for (const char* p = lines[i]; *p; p++) {
+                if (parser.feed(*p) == MaUWB_RangeParser::REPORT) {
+                    total += parser.report().range[1];
+                }
+            }
+        }
+        fed += LINES;
+        elapsed = nowNs() - start;
+    }
+    double feedNs = elapsed / fed;
+    sink = total;
+
+    printf("\n--- Parser (AT+RANGE lines of %u bytes) ---\n", (unsigned)strlen(lines[0]));
+    printf("parse()                 %8.1f ns/line\n", parseNs);
+    printf("feed(), byte by byte    %8.1f ns/line\n", feedNs);
+}
+
+// 0 = solve(), 1 = computeWeights() + solveWeighted(), 2 = full pipeline:
+// computeWeights() + solveChecked() + Kalman filter
+template <typename T>
+static double measureFixes(uint8_t path, uint8_t iterations, uint8_t ransac) {
+    const uint16_t SETS = 256;
+    static float ranges[SETS][ANCHORS];
+    static float rssi[ANCHORS] = {-77.9f, -78.1f, -76.5f, -81.4f};
+    for (uint16_t i = 0; i < SETS; i++) {
+        makeRanges(uniform() * 380, uniform() * 600, 5, ranges[i]);
+    }
+
+    MaUWB_SolverT<T> solver;
+    setupSolver(solver);
+    solver.setRefinementIterations(iterations);
+    solver.setOutlierRejection(ransac);
+    MaUWB_KalmanFilterT<T> filter;
+
+    const double target = quick ? MIN_RUN_NS / 10 : MIN_RUN_NS;
+    float weights[ANCHORS];
+    float total = 0;
+    uint32_t fixes = 0;
+
+    double start = nowNs(), elapsed = 0;
+    while (elapsed < target) {
+        for (uint16_t i = 0; i < SETS; i++) {
+            float x, y;
+            bool solved;
+            if (path == 0) {
+                solved = solver.solve(ranges[i], x, y);
+            } else if (path == 1) {
+                solver.computeWeights(ranges[i], rssi, weights);
+                solved = solver.solveWeighted(ranges[i], weights, x, y);
+            } else {
+                solver.computeWeights(ranges[i], rssi, weights);
+                solved = solver.solveChecked(ranges[i], x, y, weights);
+                if (solved) {
+                    filter.update(x, y, 0.05f, x, y);
+                }
+            }
+            if (solved) {
+                total += x + y;
+                fixes++;
+            }
+        }
+        elapsed = nowNs() - start;
+    }
+    sink = total;
+
+    return fixes > 0 ? fixes * 1e9 / elapsed : 0;
+}
+
+template <typename T>
+static void benchmarkSolverType(const char* type) {
+    printf("%-8s solve()                    %10.0f fixes/s\n", type, measureFixes<T>(0, 0, 0));
+    printf("%-8s solve(), 3 refinements     %10.0f fixes/s\n", type, measureFixes<T>(0, 3, 0));
+    printf("%-8s weighted                   %10.0f fixes/s\n", type, measureFixes<T>(1, 0, 0));
+    printf("%-8s pipeline                   %10.0f fixes/s\n", type, measureFixes<T>(2, 0, 0));
+    printf("%-8s pipeline, RANSAC 10        %10.0f fixes/s\n", type, measureFixes<T>(2, 0, 10));
+
+    // 3D budget: a known height adds a sqrt per anchor, estimating it at
+    // most MAUWB_SOLVER_Z_ITERATIONS more solves
+    double flat = measureFixes<T>(2, 0, 0);
+    heightMode = 1;
+    double known = measureFixes<T>(2, 0, 0);
+    heightMode = 2;
+    double estimated = measureFixes<T>(2, 0, 0);
+    heightMode = 0;
+    printf("%-8s pipeline, 3D known height  %10.0f fixes/s  (%.2fx the 2D cost)\n", type, known, flat / known);
+    printf("%-8s pipeline, 3D estimated z   %10.0f fixes/s  (%.2fx the 2D cost)\n", type, estimated,
+           flat / estimated);
+}
+
+static void benchmarkSolver() {
+    printf("\n--- Solver (random points, 5 cm noise) ---\n");
+    benchmarkSolverType<float>("float");
+    benchmarkSolverType<MaUWB_Q16>("Q16.16");
+}
+
+struct GridError {
+    float mean;
+    float p95;
+    float max;
+    float zMean;     // Height error, heightMode 2
+    uint32_t points;
+    uint32_t failed;
+};
+
+// Full pipeline at every grid point; each point is solved a few times with
+// fresh noise through a freshly reset filter, and the last output is scored
+template <typename T>
+static GridError measureGrid(float sigma) {
+    MaUWB_SolverT<T> solver;
+    setupSolver(solver);
+    MaUWB_KalmanFilterT<T> filter;
+
+    const int step = quick ? 20 : 5;
+    const uint8_t samples = sigma > 0 ? 8 : 1;
+    static float errors[(380 / 5 + 1) * (600 / 5 + 1)];
+    const float rssi[ANCHORS] = {-77.9f, -78.1f, -76.5f, -81.4f};
+
+    GridError result = {0, 0, 0, 0, 0, 0};
+    double sum = 0, zSum = 0;
+    for (int gx = 0; gx <= 380; gx += step) {
+        for (int gy = 0; gy <= 600; gy += step) {
+            filter.reset();
+            float outX = 0, outY = 0;
+            bool any = false;
+            for (uint8_t s = 0; s < samples; s++) {
+                float ranges[ANCHORS];
+                float weights[ANCHORS];
+                float x, y;
+                makeRanges(gx, gy, sigma, ranges);
+                solver.computeWeights(ranges, rssi, weights);
+                if (solver.solveChecked(ranges, x, y, weights)) {
+                    filter.update(x, y, 0.05f, outX, outY);
+                    any = true;
+                }
+            }
+            if (!any) {
+                result.failed++;
+                continue;
+            }
+
+            float error = calculateDistance(outX, outY, gx, gy);
+            errors[result.points++] = error;
+            sum += error;
+            zSum += fabsf(solver.getLastZ() - TAG_Z);
+            if (error > result.max) result.max = error;
+        }
+    }
+    if (result.points == 0) {
+        return result;
+    }
+    result.mean = sum / result.points;
+    result.zMean = zSum / result.points;
+
+    // 95th percentile: count below a bisected threshold, no sort needed
+    float low = 0, high = result.max;
+    for (uint8_t i = 0; i < 30; i++) {
+        float mid = (low + high) / 2;
+        uint32_t below = 0;
+        for (uint32_t p = 0; p < result.points; p++) {
+            if (errors[p] <= mid) below++;
+        }
+        if (below >= result.points * 0.95f) high = mid;
+        else low = mid;
+    }
+    result.p95 = high;
+    return result;
+}
+
+template <typename T>
+static bool reportGrid(const char* type) {
+    bool passed = true;
+    for (uint8_t i = 0; i < NOISE_LEVELS; i++) {
+        GridError error = measureGrid<T>(noiseLevels[i]);
+        bool ok = error.failed == 0 && error.mean <= noiseLimits[i] &&
+                  (noiseLevels[i] > 0 || error.max <= MAX_CLEAN_ERROR_CM);
+        if (!ok) passed = false;
+
+        printf("%-8s noise %4.1f cm: mean %6.2f  p95 %6.2f  max %6.2f cm  (%u points, %u failed) %s",
+               type, noiseLevels[i], error.mean, error.p95, error.max,
+               (unsigned)error.points, (unsigned)error.failed, ok ? "ok" : "FAIL");
+        if (heightMode == 2) {
+            printf("  z error %.2f cm", error.zMean);
+        }
+        printf("\n");
+    }
+    return passed;
+}
+
+// Survey the 3D layout from samples per pair of noisy anchor-to-anchor
+// ranges; one sample in eight is a 150 cm multipath outlier. Reports the
+// largest anchor position error over several runs.
+static bool reportSurvey() {
+    const uint8_t runs = quick ? 20 : 200;
+    const uint8_t samplesPerPair = 8;
+    static const float surveyNoise[] = {0, 2, 5, 10};
+    static const float surveyLimits[] = {2, 6, 12, 25};
+    bool passed = true;
+
+    for (uint8_t level = 0; level < sizeof(surveyNoise) / sizeof(surveyNoise[0]); level++) {
+        float worst = 0, sumError = 0, sumRms = 0;
+        uint16_t failed = 0;
+        for (uint8_t run = 0; run < runs; run++) {
+            MaUWB_Survey survey;
+            survey.begin(ANCHORS);
+            for (uint8_t i = 0; i < ANCHORS; i++) {
+                survey.setHeight(i, anchor_z[i]);
+            }
+            for (uint8_t k = 0; k < samplesPerPair; k++) {
+                for (uint8_t j = 1; j < ANCHORS; j++) {
+                    for (uint8_t i = 0; i < j; i++) {
+                        float dx = anchor_x[i] - anchor_x[j], dy = anchor_y[i] - anchor_y[j];
+                        float dz = anchor_z[i] - anchor_z[j];
+                        float d = sqrtf(dx * dx + dy * dy + dz * dz) + gaussian(surveyNoise[level]);
+                        survey.addRange(j, i, k == 3 ? d + 150 : d);
+                    }
+                }
+            }
+            if (survey.solve() != MAUWB_SURVEY_OK) {
+                failed++;
+                continue;
+            }
+            float runWorst = 0;
+            for (uint8_t i = 0; i < ANCHORS; i++) {
+                float error = calculateDistance(survey.getX(i), survey.getY(i), anchor_x[i], anchor_y[i]);
+                if (error > runWorst) runWorst = error;
+            }
+            sumError += runWorst;
+            sumRms += survey.getRms();
+            if (runWorst > worst) worst = runWorst;
+        }
+        uint16_t solved = runs - failed;
+        float mean = solved ? sumError / solved : 0;
+        bool ok = failed == 0 && mean <= surveyLimits[level];
+        if (!ok) passed = false;
+        printf("noise %4.1f cm: worst anchor error mean %6.2f  max %6.2f cm, fit rms %5.2f cm  (%u runs, %u failed) %s\n",
+               surveyNoise[level], mean, worst, solved ? sumRms / solved : 0, (unsigned)runs, (unsigned)failed,
+               ok ? "ok" : "FAIL");
+    }
+    return passed;
+}
+
+// One minute: at rest for 20 s, a 10 s walk at 80 cm/s around a circle of
+// 1 m radius, at rest again. The tag ranges in whole TDMA cycles of
+// MOTION_CYCLE_MS at the interval the motion rate asks for.
+static const unsigned long MOTION_CYCLE_MS = 100;
+static const unsigned long WALK_START_MS = 20000;
+static const unsigned long WALK_END_MS = 30000;
+static const unsigned long MOTION_RUN_MS = 60000;
+
+static void motionPosition(unsigned long t, float& x, float& y) {
+    if (t > WALK_END_MS) t = WALK_END_MS;
+    float angle = t > WALK_START_MS ? (t - WALK_START_MS) * 0.0008f : 0;
+    x = 190 + 100 * cosf(angle);
+    y = 300 + 100 * sinf(angle);
+}
+
+static bool reportMotion() {
+    static const float motionNoise[] = {2, 5, 10};
+    const float rssi[ANCHORS] = {-77.9f, -78.1f, -76.5f, -81.4f};
+    const unsigned long fixedFixes = MOTION_RUN_MS / MOTION_CYCLE_MS;
+    bool passed = true;
+
+    for (uint8_t level = 0; level < sizeof(motionNoise) / sizeof(motionNoise[0]); level++) {
+        MaUWB_Solver solver;
+        setupSolver(solver);
+        MaUWB_KalmanFilter filter;
+        filter.setSmoothing(5);
+        MaUWB_MotionRate motion;
+        motion.configure(MOTION_CYCLE_MS, MAUWB_MOTION_SLOW_MS);
+        motion.begin(0);
+
+        uint32_t fixes = 0, walkFixes = 0, falseWakeups = 0;
+        unsigned long wakeDelay = MOTION_RUN_MS, last = 0;
+        double walkError = 0;
+        float lastX = 0, lastY = 0;
+        for (unsigned long t = 0; t < MOTION_RUN_MS;) {
+            float tx, ty, x, y, outX, outY;
+            float ranges[ANCHORS], weights[ANCHORS];
+            motionPosition(t, tx, ty);
+            makeRanges(tx, ty, motionNoise[level], ranges);
+            solver.computeWeights(ranges, rssi, weights);
+            if (solver.solveChecked(ranges, x, y, weights)) {
+                // Innovation: the fix against the filter's prediction for it
+                float dt = (t - last) / 1000.0f;
+                float ix = 0, iy = 0;
+                if (fixes > 0) {
+                    ix = x - (lastX + filter.getVelocityX() * dt);
+                    iy = y - (lastY + filter.getVelocityY() * dt);
+                }
+                filter.update(x, y, dt, outX, outY);
+                lastX = outX;
+                lastY = outY;
+                last = t;
+                fixes++;
+
+                float vx = filter.getVelocityX(), vy = filter.getVelocityY();
+                bool wasMoving = motion.isMoving();
+                motion.update(t, sqrtf(vx * vx + vy * vy), sqrtf(ix * ix + iy * iy));
+                if (!wasMoving && motion.isMoving()) {
+                    if (t >= WALK_START_MS && t <= WALK_END_MS && wakeDelay == MOTION_RUN_MS) {
+                        wakeDelay = t - WALK_START_MS;
+                    } else {
+                        falseWakeups++;
+                    }
+                }
+                if (t > WALK_START_MS && t <= WALK_END_MS) {
+                    walkError += calculateDistance(outX, outY, tx, ty);
+                    walkFixes++;
+                }
+            }
+            unsigned long cycles = (motion.getInterval() + MOTION_CYCLE_MS - 1) / MOTION_CYCLE_MS;
+            t += (cycles ? cycles : 1) * MOTION_CYCLE_MS;
+        }
+
+        // Half the fixes or fewer, moving again within two slow intervals,
+        // and no wakeups from noise alone
+        bool ok = fixes * 2 <= fixedFixes && wakeDelay <= 2 * MAUWB_MOTION_SLOW_MS && falseWakeups == 0;
+        if (!ok) passed = false;
+        printf("noise %4.1f cm: %4u fixes (fixed rate %lu, %4.1f%%), moving after %4lu ms, "
+               "%u false wakeups, walk error %5.1f cm %s\n",
+               motionNoise[level], (unsigned)fixes, fixedFixes, 100.0f * fixes / fixedFixes, wakeDelay,
+               (unsigned)falseWakeups, walkFixes ? walkError / walkFixes : 0, ok ? "ok" : "FAIL");
+    }
+    return passed;
+}
+
+// 128 x 64 framebuffer as the Adafruit driver keeps it
+static const int16_t SCREEN_W = 128;
+static const int16_t SCREEN_H = 64;
+
+static void setPixel(uint8_t* buffer, int16_t x, int16_t y, bool on) {
+    if (x < 0 || y < 0 || x >= SCREEN_W || y >= SCREEN_H) return;
+    uint8_t& b = buffer[x + (y / 8) * SCREEN_W];
+    b = on ? (b | (1 << (y & 7))) : (b & ~(1 << (y & 7)));
+}
+
+// The per-pixel way: unpack each bit and set or clear it
+static void drawPixels(uint8_t* buffer, const uint8_t* pages, uint16_t width, uint16_t height, int16_t x,
+                       int16_t y) {
+    for (uint16_t row = 0; row < height; row++) {
+        for (uint16_t col = 0; col < width; col++) {
+            setPixel(buffer, x + col, y + row, pages[(row / 8) * width + col] & (1 << (row & 7)));
+        }
+    }
+}
+
+// PackBits as in drawings-for-SD1306/bitmap_pack.js
+static uint16_t encodeRle(const uint8_t* in, uint16_t length, uint8_t* out) {
+    uint16_t o = 0, i = 0;
+    while (i < length) {
+        uint16_t run = 1;
+        while (i + run < length && in[i + run] == in[i] && run < 129) run++;
+        if (run >= 3) {
+            out[o++] = 0x80 + run - 2;
+            out[o++] = in[i];
+            i += run;
+            continue;
+        }
+        uint16_t start = i;
+        while (i < length && i - start < 128 && !(i + 2 < length && in[i] == in[i + 1] && in[i] == in[i + 2])) {
+            i++;
+        }
+        out[o++] = i - start - 1;
+        while (start < i) out[o++] = in[start++];
+    }
+    return o;
+}
+
+static bool reportBitmap() {
+    const uint16_t W = 40, H = 21;   // Height not a multiple of 8: the last page is masked
+    const uint16_t BYTES = W * ((H + 7) / 8);
+    static uint8_t pages[BYTES], packed[2 * BYTES];
+
+    // Blocks with runs of empty and full bytes, like a drawing
+    for (uint16_t i = 0; i < BYTES; i++) {
+        uint16_t col = i % W;
+        pages[i] = col < 8 ? 0x00 : col < 20 ? 0xFF : (uint8_t)(uniform() * 256);
+    }
+    MaUWB_Bitmap raw = {W, H, 0, BYTES, pages};
+    MaUWB_Bitmap rle = {W, H, MAUWB_BITMAP_RLE, encodeRle(pages, BYTES, packed), packed};
+
+    // Every alignment, partly off every edge, raw and RLE, whole and a part
+    bool passed = true;
+    uint32_t checked = 0;
+    static uint8_t expected[SCREEN_W * SCREEN_H / 8], actual[SCREEN_W * SCREEN_H / 8];
+    for (int16_t y = -H; y <= SCREEN_H; y += 3) {
+        for (int16_t x = -W; x <= SCREEN_W; x += 7) {
+            for (uint8_t r = 0; r < 2; r++) {
+                for (uint8_t part = 0; part < 2; part++) {
+                    for (uint16_t i = 0; i < sizeof(expected); i++) {
+                        expected[i] = actual[i] = (uint8_t)(i * 37);
+                    }
+                    uint16_t srcX = part ? 11 : 0, srcW = part ? 16 : W;
+                    for (uint16_t row = 0; row < H; row++) {
+                        for (uint16_t col = 0; col < srcW; col++) {
+                            setPixel(expected, x + col, y + row, pages[(row / 8) * W + srcX + col] & (1 << (row & 7)));
+                        }
+                    }
+                    MaUWB_BitmapBlit::drawPart(actual, SCREEN_W, SCREEN_H, r ? rle : raw, x, y, srcX, srcW);
+                    if (memcmp(expected, actual, sizeof(expected)) != 0) {
+                        if (passed) {
+                            printf("FAIL: %s bitmap at %d,%d, columns %u-%u\n", r ? "RLE" : "raw", x, y, srcX,
+                                   srcX + srcW - 1);
+                        }
+                        passed = false;
+                    }
+                    checked++;
+                }
+            }
+        }
+    }
+
+    // The shipped logo unpacks to the drawing it came from
+    uint8_t logo[32];
+    if (MaUWB_BitmapBlit::unpack(MaUWB_Logo, logo, sizeof(logo)) != 32 || logo[7] != 0x64 || logo[23] != 0xf2) {
+        printf("FAIL: MaUWB_Logo did not unpack\n");
+        passed = false;
+    }
+
+    // Timing: a full screen bitmap, per pixel and blitted
+    static uint8_t screen[SCREEN_W * SCREEN_H / 8], full[SCREEN_W * SCREEN_H / 8], fullPacked[2 * sizeof(full)];
+    for (uint16_t i = 0; i < sizeof(full); i++) {
+        full[i] = (i / 16) % 3 ? 0x00 : (uint8_t)(uniform() * 256);
+    }
+    MaUWB_Bitmap fullRaw = {SCREEN_W, SCREEN_H, 0, sizeof(full), full};
+    MaUWB_Bitmap fullRle = {SCREEN_W, SCREEN_H, MAUWB_BITMAP_RLE, encodeRle(full, sizeof(full), fullPacked),
+                            fullPacked};
+
+    const double target = quick ? MIN_RUN_NS / 10 : MIN_RUN_NS;
+    double ns[4];
+    for (uint8_t method = 0; method < 4; method++) {
+        uint32_t draws = 0;
+        double start = nowNs(), elapsed = 0;
+        while (elapsed < target) {
+            for (uint8_t i = 0; i < 16; i++) {
+                int16_t y = method == 3 ? 3 : 0;
+                if (method == 0) {
+                    drawPixels(screen, full, SCREEN_W, SCREEN_H, 0, 0);
+                } else {
+                    MaUWB_BitmapBlit::draw(screen, SCREEN_W, SCREEN_H, method == 2 ? fullRle : fullRaw, 0, y);
+                }
+            }
+            draws += 16;
+            elapsed = nowNs() - start;
+        }
+        ns[method] = elapsed / draws;
+        sink = screen[draws % sizeof(screen)];
+    }
+
+    printf("%u placements checked against per-pixel drawing: %s\n", (unsigned)checked, passed ? "ok" : "FAIL");
+    printf("per pixel (drawPixel)   %8.1f ns/screen\n", ns[0]);
+    printf("blit, raw               %8.1f ns/screen (%4.1fx)\n", ns[1], ns[0] / ns[1]);
+    printf("blit, RLE (%4u bytes)  %8.1f ns/screen (%4.1fx)\n", (unsigned)fullRle.size, ns[2], ns[0] / ns[2]);
+    printf("blit, raw, y = 3        %8.1f ns/screen (%4.1fx)\n", ns[3], ns[0] / ns[3]);
+    return passed;
+}
+
+// Zone map checks: each case feeds fixes and compares the active set
+static uint32_t zoneEvents;
+
+static void countZoneEvent(uint8_t, bool, void*) {
+    zoneEvents++;
+}
+
+static bool expectZone(MaUWB_ZoneMap& zones, const char* what, float x, float y, uint8_t fixes, bool inZone) {
+    for (uint8_t i = 0; i < fixes; i++) {
+        zones.update(x, y);
+    }
+    if (zones.isInZone(0) != inZone) {
+        printf("FAIL: %s: fix at %.0f,%.0f is %s zone 0\n", what, x, y, inZone ? "outside" : "in");
+        return false;
+    }
+    return true;
+}
+
+static bool reportZones() {
+    static MaUWB_ZoneMap zones;
+    bool passed = true;
+
+    // Before begin() there are no zones
+    if (zones.lookup(100, 100) != 0) {
+        printf("FAIL: zones before begin()\n");
+        passed = false;
+    }
+
+    // A zone drawn over three walls of the 380 x 600 cm room, as in
+    // TAG_xyPosition_BUZZ: fixes past the walls stay in it
+    zones.begin(0, 0, 380, 600);
+    zones.setDebounce(1);
+    zones.addRectangle(0, -100, 100, 480, 700);
+    passed = expectZone(zones, "inside", 200, 590, 1, true) && passed;
+    passed = expectZone(zones, "past the far wall", 200, 615, 1, true) && passed;
+    passed = expectZone(zones, "past the side wall", -20, 300, 1, true) && passed;
+    passed = expectZone(zones, "far past the corner", 900, 2000, 1, true) && passed;
+    passed = expectZone(zones, "NaN", NAN, NAN, 1, false) && passed;
+    passed = expectZone(zones, "before the threshold", 200, 50, 1, false) && passed;
+    passed = expectZone(zones, "past the near wall", 200, -40, 1, false) && passed;
+
+    // Hysteresis: entered on the zone's own cells, left 15 cm past its edge
+    zones.begin(0, 0, 380, 600);
+    zones.setHysteresis(15);
+    zones.setDebounce(1);
+    zones.addRectangle(0, 100, 100, 200, 200);
+    passed = expectZone(zones, "hysteresis, outside", 205, 150, 1, false) && passed;
+    passed = expectZone(zones, "hysteresis, entered", 150, 150, 1, true) && passed;
+    passed = expectZone(zones, "hysteresis, within the margin", 205, 150, 1, true) && passed;
+    passed = expectZone(zones, "hysteresis, past the margin", 225, 150, 1, false) && passed;
+    passed = expectZone(zones, "hysteresis, margin does not enter", 205, 150, 1, false) && passed;
+
+    // Debounce: one stray fix changes nothing, two in a row do
+    zones.setDebounce(2);
+    zones.setCallback(countZoneEvent);
+    zoneEvents = 0;
+    passed = expectZone(zones, "debounce, one fix", 150, 150, 1, false) && passed;
+    passed = expectZone(zones, "debounce, two fixes", 150, 150, 1, true) && passed;
+    passed = expectZone(zones, "debounce, stray fix", 300, 300, 1, true) && passed;
+    passed = expectZone(zones, "debounce, back", 150, 150, 1, true) && passed;
+    passed = expectZone(zones, "debounce, left", 300, 300, 2, false) && passed;
+    if (zoneEvents != 2) {
+        printf("FAIL: %u zone callbacks, expected 2\n", (unsigned)zoneEvents);
+        passed = false;
+    }
+    zones.setCallback(nullptr);
+
+    // Timing: 16 zones, fixes all over and around the room
+    zones.begin(0, 0, 380, 600);
+    for (uint8_t zone = 0; zone < MAUWB_ZONE_MAX; zone++) {
+        zones.addRectangle(zone, zone * 20.0f, zone * 30.0f, zone * 20.0f + 120, zone * 30.0f + 150);
+    }
+    static float fixX[256], fixY[256];
+    for (uint16_t i = 0; i < 256; i++) {
+        fixX[i] = uniform() * 480 - 50;
+        fixY[i] = uniform() * 700 - 50;
+    }
+    const double target = quick ? MIN_RUN_NS / 10 : MIN_RUN_NS;
+    uint32_t fixes = 0;
+    double start = nowNs(), elapsed = 0;
+    while (elapsed < target) {
+        for (uint16_t i = 0; i < 256; i++) {
+            zones.update(fixX[i], fixY[i]);
+        }
+        fixes += 256;
+        elapsed = nowNs() - start;
+    }
+    sink = zones.getActive();
+
+    printf("edges, hysteresis and debounce: %s\n", passed ? "ok" : "FAIL");
+    printf("update, %u zones          %8.1f ns/fix\n", MAUWB_ZONE_MAX, elapsed / fixes);
+    return passed;
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else {
+            printf("usage: %s [--quick]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    printf("----- MaUWB POSITIONING CORE BENCHMARK%s -----\n", quick ? " (quick)" : "");
+
+    benchmarkParser();
+    benchmarkSolver();
+
+    printf("\n--- Grid error, 380 x 600 cm, %d cm step, through the Kalman filter ---\n", quick ? 20 : 5);
+    bool passed = reportGrid<float>("float");
+    passed = reportGrid<MaUWB_Q16>("Q16.16") && passed;
+
+    printf("\n--- Grid error, 3D: anchors at %.0f-%.0f cm, tag at %.0f cm ---\n", 180.0f, 260.0f, TAG_Z);
+    heightMode = 1;
+    passed = reportGrid<float>("known z") && passed;
+    heightMode = 2;
+    passed = reportGrid<float>("est. z") && passed;
+    heightMode = 0;
+
+    printf("\n--- Anchor survey, %u anchors at 180-260 cm, 8 samples per pair ---\n", ANCHORS);
+    passed = reportSurvey() && passed;
+
+    printf("\n--- Motion-adaptive rate, %lu ms cycle, %u-%lu ms intervals, rest-walk-rest ---\n",
+           MOTION_CYCLE_MS, (unsigned)MOTION_CYCLE_MS, (unsigned long)MAUWB_MOTION_SLOW_MS);
+    passed = reportMotion() && passed;
+
+    printf("\n--- Bitmap blit, %d x %d framebuffer ---\n", SCREEN_W, SCREEN_H);
+    passed = reportBitmap() && passed;
+
+    printf("\n--- Zone map, 380 x 600 cm room, %.0f cm cells ---\n", MAUWB_ZONE_CELL_CM);
+    passed = reportZones() && passed;
+
+    printf("\n%s\n", passed ? "All accuracy limits met" : "Accuracy limit exceeded");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,408 @@
+/*
+Fleet Load Generator and Soak Benchmark
+Drives the anchor-side pipeline with a room full of synthetic tags.
+
+PURPOSE:
+The other host tools replay one tag or one recorded room. Deployments are
+judged on what the anchor keeps up with when dozens of tags report at once,
+and whether it still does after hours. This generates the module's side of
+the link for a whole fleet (MaUWB_SynthFleet: tags walking the room, range
+noise, the robust_multilateration_test noise patterns, anchors that miss a
+reply, reports lost on the air), feeds it byte by byte through
+MaUWB_RangeParser and the same work as the anchor's range_analy() (a JSON
+line or binary frame per report, or the tracker and a position), and
+measures it on a simulated clock that starts just before the micros() wrap.
+
+REPORTS:
+- Offered load: reports/s and the share of the module's 115200 baud link
+  it takes, and the host output it produces
+- Time per report (parse + range_analy work), percentiles, and the
+  capacity: reports/s a core sustains against the offered load
+- Reports received and missing (seq gaps) against what the fleet lost
+- With --positions, the position error against the tags' true positions
+- With --soak, the same per window over a long run: time per report,
+  heap in use (glibc), so creep and leaks show up
+
+USAGE:
+  ./build/load_generator                       64 tags at 1.5 Hz, 60 s simulated
+  ./build/load_generator --tags 16 --rate 10 --positions --pattern 3
+  ./build/load_generator --soak 3600           an hour of windows
+  ./build/load_generator --out --realtime > /dev/pts/5
+                                               anchor output in real time, for
+                                               the p5 visualizers
+  ./build/load_generator --quick               short run (ctest)
+
+Exits with 1 if a report is lost between the generator and the parser,
+the heap grows during the run, or a soak window is more than
+MAX_CREEP times slower than the first.
+
+All distances are in centimeters.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <thread>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#include "MaUWB_RangeParser.h"
+#include "MaUWB_Frame.h"
+#include "MaUWB_SynthLoad.h"
+
+// One entry per tag id the fleet can use
+#define MAUWB_TRACKER_MAX_TAGS MAUWB_SYNTH_MAX_TAGS
+#include "MaUWB_Tracker.h"
+
+// The module's UART (bytes per second at 8N1)
+#define MODULE_BAUD 115200
+
+// A soak window may be this much slower (median time per report) than the first
+#define MAX_CREEP 2.0
+
+struct Options {
+    MaUWB_SynthConfig config;
+    double seconds;      // Simulated run length
+    double soak;         // Wall-clock soak length, 0 for none
+    double window;       // Soak window (wall-clock s)
+    bool positions;
+    bool binary;
+    bool out;            // Anchor output to stdout
+    bool realtime;
+};
+
+// What range_analy() sends for one report
+struct Output {
+    uint32_t bytes;
+    uint32_t fixes;
+    double errorSum;     // Position error against the true position (cm)
+    float errorMax;
+};
+
+static volatile uint32_t sink;
+
+static double nowNs() {
+    using namespace std::chrono;
+    return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static size_t heapInUse() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return mallinfo2().uordblks;
+#elif defined(__GLIBC__)
+    return (size_t)mallinfo().uordblks;
+#else
+    return 0;
+#endif
+}
+
+static void usage(const char* name) {
+    printf("usage: %s [--tags n] [--rate hz] [--jitter f] [--sigma cm] [--pattern n] [--share f]\n"
+           "          [--dropout f] [--loss f] [--speed cm/s] [--room w,h] [--seconds s] [--soak s]\n"
+           "          [--window s] [--positions] [--binary] [--out] [--realtime] [--quick]\n",
+           name);
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+    MaUWB_SynthConfig& config = options.config;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool value = i + 1 < argc;
+        if (strcmp(arg, "--tags") == 0 && value) {
+            int tags = atoi(argv[++i]);
+            config.tags = (uint8_t)(tags < 1 ? 1 : tags > MAUWB_SYNTH_MAX_TAGS ? MAUWB_SYNTH_MAX_TAGS : tags);
+        } else if (strcmp(arg, "--rate") == 0 && value) {
+            config.rateHz = (float)atof(argv[++i]);
+        } else if (strcmp(arg, "--jitter") == 0 && value) {
+            config.jitter = (float)atof(argv[++i]);
+        } else if (strcmp(arg, "--sigma") == 0 && value) {
+            config.sigma = (float)atof(argv[++i]);
+        } else if (strcmp(arg, "--pattern") == 0 && value) {
+            config.pattern = (uint8_t)atoi(argv[++i]);
+        } else if (strcmp(arg, "--share") == 0 && value) {
+            config.patternShare = (float)atof(argv[++i]);
+        } else if (strcmp(arg, "--dropout") == 0 && value) {
+            config.dropout = (float)atof(argv[++i]);
+        } else if (strcmp(arg, "--loss") == 0 && value) {
+            config.loss = (float)atof(argv[++i]);
+        } else if (strcmp(arg, "--speed") == 0 && value) {
+            config.speed = (float)atof(argv[++i]);
+        } else if (strcmp(arg, "--room") == 0 && value) {
+            if (sscanf(argv[++i], "%f,%f", &config.width, &config.height) != 2) {
+                printf("Bad room: %s\n", argv[i]);
+                return false;
+            }
+        } else if (strcmp(arg, "--seconds") == 0 && value) {
+            options.seconds = atof(argv[++i]);
+        } else if (strcmp(arg, "--soak") == 0 && value) {
+            options.soak = atof(argv[++i]);
+        } else if (strcmp(arg, "--window") == 0 && value) {
+            options.window = atof(argv[++i]);
+        } else if (strcmp(arg, "--positions") == 0) {
+            options.positions = true;
+        } else if (strcmp(arg, "--binary") == 0) {
+            options.binary = true;
+        } else if (strcmp(arg, "--out") == 0) {
+            options.out = true;
+        } else if (strcmp(arg, "--realtime") == 0) {
+            options.realtime = true;
+        } else if (strcmp(arg, "--quick") == 0) {
+            options.seconds = 20;
+            options.soak = 3;
+            options.window = 1;
+        } else {
+            return false;
+        }
+    }
+    if (config.rateHz <= 0 || config.pattern >= MAUWB_NOISE_PATTERNS || options.seconds <= 0 || options.window <= 0) {
+        return false;
+    }
+    return true;
+}
+
+// The anchor's range_analy(): JSON line or binary frame per report, or
+// the tracker and a position
+static void rangeAnaly(const Options& options, MaUWB_TagTracker& tracker, const MaUWB_SynthFleet& fleet,
+                       const MaUWB_RangeReport& report, uint32_t nowMs, Output& output) {
+    char line[64];
+    uint8_t frame[MAUWB_FRAME_LENGTH];
+    uint32_t length = 0;
+    bool text = !options.binary;
+
+    if (options.positions) {
+        const MaUWB_TagState* tag = tracker.update(report, nowMs);
+        if (!tag) return;
+        MaUWB_PositionReport position;
+        position.tid = tag->tid;
+        position.seq = tag->seq;
+        position.x = (int16_t)lroundf(tag->x);
+        position.y = (int16_t)lroundf(tag->y);
+        position.mask = tag->mask;
+        if (options.binary) {
+            length = MaUWB_Frame::encodePosition(position, frame);
+        } else {
+            length = snprintf(line, sizeof(line), "{\"id\":%u,\"x\":%d,\"y\":%d}\n", position.tid, position.x,
+                              position.y);
+        }
+        float x, y;
+        if (fleet.getTruth(report.tid, x, y)) {
+            float error = sqrtf((tag->x - x) * (tag->x - x) + (tag->y - y) * (tag->y - y));
+            output.errorSum += error;
+            if (error > output.errorMax) output.errorMax = error;
+        }
+        output.fixes++;
+    } else if (options.binary) {
+        length = MaUWB_Frame::encode(report, frame);
+    } else {
+        length = snprintf(line, sizeof(line), "{\"id\":%u,\"range\":[%d,%d,%d,%d,%d,%d,%d,%d]}\n", report.tid,
+                          (int)report.range[0], (int)report.range[1], (int)report.range[2], (int)report.range[3],
+                          (int)report.range[4], (int)report.range[5], (int)report.range[6], (int)report.range[7]);
+    }
+
+    output.bytes += length;
+    if (options.out) {
+        fwrite(text ? (const void*)line : (const void*)frame, 1, length, stdout);
+    } else {
+        sink += text ? (uint8_t)line[length - 1] : frame[length - 1];
+    }
+}
+
+// State of one run through the pipeline
+struct Run {
+    MaUWB_SynthFleet fleet;
+    MaUWB_SynthMonitor monitor;
+    MaUWB_RangeParser parser;
+    MaUWB_TagTracker tracker;
+    MaUWB_LatencyHistogram perReport;   // ns
+    Output output;
+    uint64_t simUs;
+    uint32_t emitted;
+    uint32_t badLines;
+};
+
+static void setupRun(const Options& options, Run& run) {
+    const MaUWB_SynthConfig& config = options.config;
+    const float anchors[4][3] = {{0, 0, 0}, {0, config.height, 0}, {config.width, config.height, 0}, {config.width, 0, 0}};
+    run.fleet.begin(config, anchors, 4);
+    run.monitor.reset(run.fleet.getPeriod());
+    MaUWB_Solver& solver = run.tracker.getSolver();
+    solver.setAnchorCount(4);
+    for (uint8_t i = 0; i < 4; i++) {
+        solver.setAnchor(i, anchors[i][0], anchors[i][1]);
+    }
+    run.tracker.clear();
+    run.perReport.reset();
+    memset(&run.output, 0, sizeof(run.output));
+    // 5 s before micros() wraps, so every run crosses it
+    run.simUs = 0xFFFFFFFFULL - 5000000ULL;
+    run.emitted = 0;
+    run.badLines = 0;
+}
+
+// Advance the simulated clock by seconds, handling every line on the way
+static void step(const Options& options, Run& run, double seconds) {
+    uint64_t end = run.simUs + (uint64_t)(seconds * 1e6);
+    double wallStart = nowNs();
+    uint64_t simStart = run.simUs;
+    char line[MAUWB_SYNTH_LINE_MAX];
+
+    while (run.simUs < end) {
+        uint32_t now = (uint32_t)run.simUs;
+        uint16_t length = run.fleet.poll(now, line, sizeof(line));
+        if (length == 0) {
+            uint32_t wait = run.fleet.timeToNext(now);
+            run.simUs += wait ? wait : 1;
+            if (options.realtime) {
+                double due = wallStart + (run.simUs - simStart) * 1e3;
+                double ahead = due - nowNs();
+                if (ahead > 0) std::this_thread::sleep_for(std::chrono::nanoseconds((int64_t)ahead));
+                if (options.out) fflush(stdout);
+            }
+            continue;
+        }
+        run.emitted++;
+
+        double start = nowNs();
+        for (uint16_t i = 0; i < length; i++) {
+            MaUWB_RangeParser::Event event = run.parser.feed(line[i]);
+            if (event == MaUWB_RangeParser::REPORT) {
+                rangeAnaly(options, run.tracker, run.fleet, run.parser.report(), (uint32_t)(run.simUs / 1000),
+                           run.output);
+                run.monitor.onReport(run.parser.report(), now);
+            } else if (event == MaUWB_RangeParser::LINE) {
+                run.badLines++;
+            }
+        }
+        run.perReport.record((uint32_t)(nowNs() - start));
+    }
+}
+
+// Every lost report shows as a seq gap, except those before a tag's first
+// report or after its last one
+static bool gapsMatch(Run& run) {
+    uint32_t missing = run.monitor.getMissing();
+    uint32_t lost = run.fleet.getLost();
+    return missing <= lost && lost - missing <= 2u * run.fleet.getConfig().tags;
+}
+
+static void printTiming(FILE* info, const char* label, MaUWB_LatencyHistogram& histogram) {
+    fprintf(info, "%-18s p50 %6u  p90 %6u  p99 %6u  max %8u ns\n", label, (unsigned)histogram.getPercentile(0.5f),
+           (unsigned)histogram.getPercentile(0.9f), (unsigned)histogram.getPercentile(0.99f),
+           (unsigned)histogram.getMax());
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    options.seconds = 60;
+    options.soak = 0;
+    options.window = 10;
+    options.positions = false;
+    options.binary = false;
+    options.out = false;
+    options.realtime = false;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return 2;
+    }
+    // Stats go to stderr with --out so stdout is only the anchor's output
+    FILE* info = options.out ? stderr : stdout;
+    const MaUWB_SynthConfig& config = options.config;
+    fprintf(info, "----- FLEET LOAD: %u tags at %.1f Hz, %s%s -----\n", config.tags, config.rateHz,
+            options.positions ? "positions" : "ranges", options.binary ? " binary" : " JSON");
+    fprintf(info, "Noise %.1f cm, pattern %u on %.0f%%, dropout %.0f%%, loss %.1f%%, %.0f x %.0f cm room\n",
+            config.sigma, config.pattern, config.patternShare * 100, config.dropout * 100, config.loss * 100,
+            config.width, config.height);
+
+    // After the first output, which allocates the stdio buffer
+    static Run run;
+    setupRun(options, run);
+    size_t heapStart = heapInUse();
+
+    double wallStart = nowNs();
+    step(options, run, options.seconds);
+    double wallNs = nowNs() - wallStart;
+    double simSeconds = options.seconds;
+
+    double offered = config.tags * config.rateHz;
+    double lineBytes = run.emitted ? (double)run.fleet.getBytes() / run.emitted : 0;
+    double linkShare = offered * (1 - config.loss) * lineBytes * 10 / MODULE_BAUD;
+    bool ok = true;
+    fprintf(info, "\nOffered           %8.0f reports/s, %.0f bytes/line: %.0f%% of a %u baud module link\n", offered,
+            lineBytes, linkShare * 100, MODULE_BAUD);
+    fprintf(info, "Host output       %8.0f bytes/s (%.0f%% of %u baud)\n", run.output.bytes / simSeconds,
+            run.output.bytes / simSeconds * 10 * 100 / MODULE_BAUD, MODULE_BAUD);
+    if (linkShare > 1) {
+        fprintf(info, "                  more than the module link carries: lower --rate or --tags\n");
+    }
+
+    fprintf(info, "\n");
+    printTiming(info, "Per report", run.perReport);
+    if (!options.realtime) {
+        double capacity = run.emitted * 1e9 / wallNs;
+        fprintf(info, "Capacity          %8.0f reports/s on this core, %.0f x the offered load\n", capacity,
+                capacity / offered);
+    }
+
+    uint32_t received = run.monitor.getReports();
+    fprintf(info, "\nGenerated %u, lost on the air %u, received %u, missing %u (seq gaps), %u other lines\n",
+            (unsigned)run.fleet.getGenerated(), (unsigned)run.fleet.getLost(), (unsigned)received,
+            (unsigned)run.monitor.getMissing(), (unsigned)run.badLines);
+    fprintf(info, "Arrival jitter    p50 %6u  p99 %6u us (period %u us)\n",
+            (unsigned)run.monitor.getJitter().getPercentile(0.5f), (unsigned)run.monitor.getJitter().getPercentile(0.99f),
+            (unsigned)run.fleet.getPeriod());
+    if (received != run.emitted || run.badLines || !gapsMatch(run)) {
+        fprintf(info, "FAIL: reports lost or damaged between the generator and the parser\n");
+        ok = false;
+    }
+    if (options.positions) {
+        fprintf(info, "Fixes %u, mean error %.1f cm, max %.1f cm, %u dropped (tracker table full)\n",
+                (unsigned)run.output.fixes, run.output.fixes ? run.output.errorSum / run.output.fixes : 0,
+                run.output.errorMax, (unsigned)run.tracker.getTableFullDrops());
+    }
+
+    // Soak: the same load on, window by window
+    if (options.soak > 0 && !options.realtime) {
+        fprintf(info, "\n----- SOAK: %.0f s in %.0f s windows -----\n", options.soak, options.window);
+        fprintf(info, "window   reports   simulated     p50     p99     max ns   heap bytes\n");
+        double firstP50 = 0;
+        uint32_t windows = 0;
+        double soakStart = nowNs();
+        while (nowNs() - soakStart < options.soak * 1e9) {
+            run.perReport.reset();
+            uint32_t emitted = run.emitted;
+            double windowStart = nowNs();
+            while (nowNs() - windowStart < options.window * 1e9) {
+                step(options, run, 1.0);
+                simSeconds += 1.0;
+            }
+            double p50 = run.perReport.getPercentile(0.5f);
+            size_t heap = heapInUse();
+            fprintf(info, "%6u %9u %9.0f s %7u %7u %10u %12ld\n", (unsigned)windows, (unsigned)(run.emitted - emitted),
+                    simSeconds, (unsigned)p50, (unsigned)run.perReport.getPercentile(0.99f),
+                    (unsigned)run.perReport.getMax(), (long)heap - (long)heapStart);
+            if (windows == 0) {
+                firstP50 = p50;
+            } else if (p50 > firstP50 * MAX_CREEP) {
+                fprintf(info, "FAIL: time per report crept from %.0f to %.0f ns\n", firstP50, p50);
+                ok = false;
+            }
+            windows++;
+        }
+        if (!gapsMatch(run)) {
+            fprintf(info, "FAIL: %u reports missing, the fleet lost %u\n", (unsigned)run.monitor.getMissing(),
+                    (unsigned)run.fleet.getLost());
+            ok = false;
+        }
+        fprintf(info, "%.0f s simulated (micros() wrapped %u times), %u reports\n", simSeconds,
+                (unsigned)((run.simUs >> 32)), (unsigned)run.monitor.getReports());
+    }
+
+    if (heapInUse() != heapStart) {
+        fprintf(info, "FAIL: heap grew by %ld bytes\n", (long)heapInUse() - (long)heapStart);
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,259 @@
+/*
+Position Stream Listener
+Collects the UDP position packets tags send with MaUWB_UdpSink.
+
+PURPOSE:
+A room with dozens of tags is too much for one anchor's serial port. Tags
+that stream their own fixes (MaUWB_TAG::setStreamSink(), MaUWB_Stream.h)
+send batched packets to this listener, which decodes them and writes one
+line per sample in the anchors' position format, so the output can be fed
+to anything that reads an anchor's port.
+
+REPORTS:
+- stdout: {"id":1,"x":250,"y":610} per sample, or CSV with --csv
+- stderr, every --stats seconds: per tag packets, samples, packets lost
+  (sequence gaps) and the newest fix; bad packets
+
+USAGE:
+  ./build/stream_listener                      listen on port 47800
+  ./build/stream_listener --port 5000 --csv > fixes.csv
+  ./build/stream_listener --stats 10
+  ./build/stream_listener --self-test          codec and loss counting check (ctest)
+
+All distances are in centimeters.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "MaUWB_Stream.h"
+
+// Default of MaUWB_StreamSink.h
+#define MAUWB_STREAM_UDP_PORT 47800
+
+#define MAX_TAGS 256
+
+struct TagStats {
+    bool seen;
+    uint16_t lastSeq;
+    uint32_t packets;
+    uint32_t samples;
+    uint32_t lost;
+    MaUWB_StreamSample last;
+};
+
+static TagStats tags[MAX_TAGS];
+static uint32_t badPackets = 0;
+
+// Count a decoded packet; a forward jump of the seq is lost packets, a
+// backward one (tag restarted) is not
+static void countPacket(const MaUWB_StreamPacket& packet) {
+    if (packet.tid >= MAX_TAGS) {
+        return;
+    }
+    TagStats& tag = tags[packet.tid];
+    uint16_t step = packet.seq - tag.lastSeq;
+    if (tag.seen && step > 1 && step < 0x8000) {
+        tag.lost += step - 1;
+    }
+    tag.seen = true;
+    tag.lastSeq = packet.seq;
+    tag.packets++;
+    tag.samples += packet.count;
+    if (packet.count > 0) {
+        tag.last = packet.samples[packet.count - 1];
+    }
+}
+
+static void printSample(uint16_t tid, const MaUWB_StreamSample& sample, bool csv) {
+    if (csv) {
+        printf("%u,%lu,%d,%d,%d,%u\n", tid, (unsigned long)sample.time, sample.x, sample.y, sample.z,
+               sample.mask);
+    } else {
+        printf("{\"id\":%u,\"x\":%d,\"y\":%d}\n", tid, sample.x, sample.y);
+    }
+}
+
+static void printStats() {
+    for (int i = 0; i < MAX_TAGS; i++) {
+        if (!tags[i].seen) {
+            continue;
+        }
+        uint32_t sent = tags[i].packets + tags[i].lost;
+        fprintf(stderr, "tag %3d: %7lu packets %8lu samples %5lu lost (%5.2f%%)  last %d,%d,%d\n", i,
+                (unsigned long)tags[i].packets, (unsigned long)tags[i].samples, (unsigned long)tags[i].lost,
+                sent ? 100.0 * tags[i].lost / sent : 0.0, tags[i].last.x, tags[i].last.y, tags[i].last.z);
+    }
+    fprintf(stderr, "bad packets %lu\n", (unsigned long)badPackets);
+}
+
+// Keeps the packets a streamer hands it, dropping every dropEvery-th
+class MemorySink : public MaUWB_StreamSink {
+public:
+    explicit MemorySink(int dropEvery) : dropEvery(dropEvery), calls(0), count(0) {}
+
+    bool send(const uint8_t* data, uint16_t length) override {
+        calls++;
+        if (dropEvery > 0 && calls % dropEvery == 0) {
+            return true;   // Lost on the air
+        }
+        if (count < 64) {
+            memcpy(packets[count], data, length);
+            lengths[count++] = length;
+        }
+        return true;
+    }
+
+    int dropEvery;
+    int calls;
+    int count;
+    uint8_t packets[64][MAUWB_STREAM_PACKET_MAX];
+    uint16_t lengths[64];
+};
+
+static int selfTest() {
+    int failures = 0;
+
+    // Round trip, including a partial batch sent by poll()
+    MemorySink sink(0);
+    MaUWB_PositionStreamer streamer;
+    streamer.begin(&sink, 7);
+    const int fixes = 2 * MAUWB_STREAM_BATCH + 3;
+    for (int i = 0; i < fixes; i++) {
+        streamer.add(1000 + i * 10, i * 12.4f, -i * 3.6f, 150.0f, 0x0F);
+    }
+    streamer.poll(1000 + fixes * 10 + MAUWB_STREAM_MAX_AGE_MS);
+
+    int decoded = 0;
+    for (int p = 0; p < sink.count; p++) {
+        MaUWB_StreamPacket packet;
+        if (!MaUWB_StreamCodec::decode(sink.packets[p], sink.lengths[p], packet) || packet.tid != 7 ||
+            packet.seq != p) {
+            printf("FAIL: packet %d did not decode\n", p);
+            failures++;
+            continue;
+        }
+        for (uint8_t s = 0; s < packet.count; s++, decoded++) {
+            const MaUWB_StreamSample& sample = packet.samples[s];
+            if (sample.time != (uint32_t)(1000 + decoded * 10) ||
+                sample.x != MaUWB_StreamCodec::toCm(decoded * 12.4f) ||
+                sample.y != MaUWB_StreamCodec::toCm(-decoded * 3.6f) || sample.z != 150 || sample.mask != 0x0F) {
+                printf("FAIL: sample %d differs\n", decoded);
+                failures++;
+            }
+        }
+    }
+    if (decoded != fixes) {
+        printf("FAIL: %d of %d samples arrived\n", decoded, fixes);
+        failures++;
+    }
+
+    // A corrupted byte fails the CRC
+    sink.packets[0][MAUWB_STREAM_HEADER + 3] ^= 0x10;
+    MaUWB_StreamPacket packet;
+    if (MaUWB_StreamCodec::decode(sink.packets[0], sink.lengths[0], packet)) {
+        printf("FAIL: corrupted packet decoded\n");
+        failures++;
+    }
+
+    // Every fourth packet lost: the seq gaps count them
+    MemorySink lossy(4);
+    MaUWB_PositionStreamer tag;
+    tag.begin(&lossy, 3);
+    for (int i = 0; i < 16 * MAUWB_STREAM_BATCH; i++) {
+        tag.add(i * 10, 0, 0, 0, 0x07);
+    }
+    memset(tags, 0, sizeof(tags));
+    for (int p = 0; p < lossy.count; p++) {
+        if (MaUWB_StreamCodec::decode(lossy.packets[p], lossy.lengths[p], packet)) {
+            countPacket(packet);
+        }
+    }
+    // Packets 3, 7, 11 were lost; 15 was the last and is not seen as a gap
+    if (tags[3].packets != 12 || tags[3].lost != 3) {
+        printf("FAIL: %lu packets, %lu lost (expected 12, 3)\n", (unsigned long)tags[3].packets,
+               (unsigned long)tags[3].lost);
+        failures++;
+    }
+
+    printf("stream self-test: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
+
+static void usage(const char* name) {
+    printf("usage: %s [--port n] [--csv] [--stats seconds] [--self-test]\n", name);
+}
+
+int main(int argc, char** argv) {
+    int port = MAUWB_STREAM_UDP_PORT;
+    bool csv = false;
+    int statsInterval = 5;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            csv = true;
+        } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            statsInterval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--self-test") == 0) {
+            return selfTest();
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        perror("socket");
+        return 1;
+    }
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons((uint16_t)port);
+    if (bind(sock, (sockaddr*)&address, sizeof(address)) < 0) {
+        perror("bind");
+        close(sock);
+        return 1;
+    }
+    // Wake up at least once a second to print the statistics
+    timeval timeout = {1, 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    fprintf(stderr, "Listening on UDP port %d\n", port);
+    if (csv) {
+        printf("tid,time_ms,x,y,z,mask\n");
+    }
+
+    time_t lastStats = time(nullptr);
+    uint8_t buffer[1500];
+    MaUWB_StreamPacket packet;
+    for (;;) {
+        ssize_t length = recv(sock, buffer, sizeof(buffer), 0);
+        if (length > 0) {
+            if (MaUWB_StreamCodec::decode(buffer, (uint16_t)length, packet)) {
+                countPacket(packet);
+                for (uint8_t i = 0; i < packet.count; i++) {
+                    printSample(packet.tid, packet.samples[i], csv);
+                }
+                fflush(stdout);
+            } else {
+                badPackets++;
+            }
+        }
+
+        time_t now = time(nullptr);
+        if (statsInterval > 0 && now - lastStats >= statsInterval) {
+            printStats();
+            lastStats = now;
+        }
+    }
+}
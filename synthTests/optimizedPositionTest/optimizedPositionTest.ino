@@ -21,6 +21,8 @@ IMPROVEMENTS OVER BASIC VERSION:
 3. Better handling of edge cases and potential numerical issues
 4. Enhanced error detection with clear diagnostic messages
 5. Optimization of mathematical operations to reduce overhead
+6. Anchor-only terms of each triplet cached in MaUWB_Solver and rebuilt only
+   when the anchor layout changes
 
 This test file demonstrates the final, optimized position calculation algorithm
 that is implemented in the main UWB tag code.
@@ -28,6 +30,7 @@ that is implemented in the main UWB tag code.
 
 #include <Arduino.h>
 #include <math.h>
+#include "MaUWB_Solver.h"
 
 // Anchor positions in cm
 // A0 is top left (0,0)
@@ -37,6 +40,9 @@ that is implemented in the main UWB tag code.
 const float anchor_x[4] = {0, 0, 380, 380};
 const float anchor_y[4] = {0, 600, 600, 0};
 
+// Anchor geometry cache for the position solve, loaded in setup()
+MaUWB_Solver solver;
+
 // Distance measurements to anchors (using anchors 0-3)
 float dist_to_a0 = 0.0;
 float dist_to_a1 = 0.0;
@@ -66,45 +72,13 @@ void calculateOptimizedPosition() {
     float x2 = 0, y2 = 0;  // Position calculated from anchors 0,1,3
     float x3 = 0, y3 = 0;  // Position calculated from anchors 0,2,3
     
-    // Precompute squared distances and other repeated values
-    float dist_to_a0_sq = dist_to_a0 * dist_to_a0;
-    float dist_to_a1_sq = dist_to_a1 * dist_to_a1;
-    float dist_to_a2_sq = dist_to_a2 * dist_to_a2;
-    float dist_to_a3_sq = dist_to_a3 * dist_to_a3;
-    
-    // Precompute anchor position terms
-    float a0_sq = anchor_x[0] * anchor_x[0] + anchor_y[0] * anchor_y[0];
-    float a1_sq = anchor_x[1] * anchor_x[1] + anchor_y[1] * anchor_y[1];
-    float a2_sq = anchor_x[2] * anchor_x[2] + anchor_y[2] * anchor_y[2];
-    float a3_sq = anchor_x[3] * anchor_x[3] + anchor_y[3] * anchor_y[3];
-    
-    // Common calculations for equations involving anchors 0-1
-    float A_01 = 2 * (anchor_x[1] - anchor_x[0]);
-    float B_01 = 2 * (anchor_y[1] - anchor_y[0]);
-    float C_01 = dist_to_a0_sq - dist_to_a1_sq - a0_sq + a1_sq;
-    
-    // Common calculations for other anchor pairs
-    float A_12 = 2 * (anchor_x[2] - anchor_x[1]);
-    float B_12 = 2 * (anchor_y[2] - anchor_y[1]);
-    float C_12 = dist_to_a1_sq - dist_to_a2_sq - a1_sq + a2_sq;
-    
-    float A_13 = 2 * (anchor_x[3] - anchor_x[1]);
-    float B_13 = 2 * (anchor_y[3] - anchor_y[1]);
-    float C_13 = dist_to_a1_sq - dist_to_a3_sq - a1_sq + a3_sq;
-    
-    float A_02 = 2 * (anchor_x[2] - anchor_x[0]);
-    float B_02 = 2 * (anchor_y[2] - anchor_y[0]);
-    float C_02 = dist_to_a0_sq - dist_to_a2_sq - a0_sq + a2_sq;
-    
-    float A_23 = 2 * (anchor_x[3] - anchor_x[2]);
-    float B_23 = 2 * (anchor_y[3] - anchor_y[2]);
-    float C_23 = dist_to_a2_sq - dist_to_a3_sq - a2_sq + a3_sq;
+    // The anchor terms of each triplet are cached in the solver and only
+    // rebuilt when the layout changes; a fix needs just the squared ranges
+    const float ranges[4] = {dist_to_a0, dist_to_a1, dist_to_a2, dist_to_a3};
     
     // Solve using anchors 0,1,2
-    float den1 = (A_01 * B_12 - B_01 * A_12);
-    if (abs(den1) > 0.000001) {
-        x1 = (C_01 * B_12 - C_12 * B_01) / den1;
-        y1 = (A_01 * C_12 - C_01 * A_12) / den1;
+    bool valid1 = solver.solveTriplet(0, 1, 2, ranges, x1, y1);
+    if (valid1) {
         Serial.print("Position from anchors 0,1,2: (");
         Serial.print(x1);
         Serial.print(", ");
@@ -113,10 +87,8 @@ void calculateOptimizedPosition() {
     }
     
     // Solve using anchors 0,1,3
-    float den2 = (A_01 * B_13 - B_01 * A_13);
-    if (abs(den2) > 0.000001) {
-        x2 = (C_01 * B_13 - C_13 * B_01) / den2;
-        y2 = (A_01 * C_13 - C_01 * A_13) / den2;
+    bool valid2 = solver.solveTriplet(0, 1, 3, ranges, x2, y2);
+    if (valid2) {
         Serial.print("Position from anchors 0,1,3: (");
         Serial.print(x2);
         Serial.print(", ");
@@ -125,10 +97,8 @@ void calculateOptimizedPosition() {
     }
     
     // Solve using anchors 0,2,3
-    float den3 = (A_02 * B_23 - B_02 * A_23);
-    if (abs(den3) > 0.000001) {
-        x3 = (C_02 * B_23 - C_23 * B_02) / den3;
-        y3 = (A_02 * C_23 - C_02 * A_23) / den3;
+    bool valid3 = solver.solveTriplet(0, 2, 3, ranges, x3, y3);
+    if (valid3) {
         Serial.print("Position from anchors 0,2,3: (");
         Serial.print(x3);
         Serial.print(", ");
@@ -138,9 +108,9 @@ void calculateOptimizedPosition() {
     
     // Count valid solutions
     int validSolutions = 0;
-    if (abs(den1) > 0.000001) validSolutions++;
-    if (abs(den2) > 0.000001) validSolutions++;
-    if (abs(den3) > 0.000001) validSolutions++;
+    if (valid1) validSolutions++;
+    if (valid2) validSolutions++;
+    if (valid3) validSolutions++;
     
     if (validSolutions == 0) {
         Serial.println("Cannot calculate position - no valid solutions");
@@ -150,15 +120,15 @@ void calculateOptimizedPosition() {
     // Calculate position as average of valid solutions
     float x = 0.0, y = 0.0;
     
-    if (abs(den1) > 0.000001) {
+    if (valid1) {
         x += x1;
         y += y1;
     }
-    if (abs(den2) > 0.000001) {
+    if (valid2) {
         x += x2;
         y += y2;
     }
-    if (abs(den3) > 0.000001) {
+    if (valid3) {
         x += x3;
         y += y3;
     }
@@ -300,6 +270,12 @@ void calculateOriginalPosition() {
 }
 
 void setup() {
+    // Load the anchor layout; the solver rebuilds its geometry cache once
+    solver.setAnchorCount(4);
+    for (uint8_t i = 0; i < 4; i++) {
+        solver.setAnchor(i, anchor_x[i], anchor_y[i]);
+    }
+    
     Serial.begin(115200);
     delay(2000);
     
@@ -0,0 +1,1135 @@
+/*
+ * MaUWB_Solver.h - Least-squares 2D multilateration over N anchors
+ *
+ * Subtracting the anchor mean from the range equations
+ *
+ *   (x - xi)^2 + (y - yi)^2 = ri^2
+ *
+ * gives the linear system 2 (pi - p_mean) . p = (|pi|^2 - mean|p|^2) - (ri^2 - mean r^2).
+ * Its least-squares solution only depends on the anchor layout through
+ *
+ *   Pi = (A^T A)^-1 * 2 (pi - p_mean)     c = sum(Pi * |pi|^2)
+ *
+ * so the geometry is prepared once after the anchors change, and each fix is
+ *
+ *   p = c - sum(Pi * ri^2)
+ *
+ * i.e. two multiply-adds per anchor. An optional Gauss-Newton refinement
+ * then minimises the true range residuals, which the linearised form
+ * weights unevenly.
+ *
+ * A range of 0 or less means the anchor did not reply. The geometry is
+ * cached for the set of anchors used in the last fix, so a lost anchor
+ * costs one re-preparation, not one per fix.
+ *
+ * solveTriplet() gives the exact fix from three anchors. The inverted
+ * pair-difference matrix of every triplet is cached with the rest of the
+ * geometry, along with a flag for the collinear ones.
+ *
+ * solveWeighted() takes a confidence per anchor. computeWeights() derives
+ * one from the RSSI of each reply and from the triangle inequality against
+ * every other anchor (|ri - rj| <= dij <= ri + rj), so a blocked (NLOS)
+ * anchor whose range came back too long carries little weight in the fix.
+ *
+ * With outlier rejection on, solveChecked() checks the fix against every
+ * range and, if some disagree, runs RANSAC over anchor triplets: each
+ * triplet's exact fix is scored by how many of the other ranges it
+ * explains, the best one's outliers are dropped and the rest re-solved.
+ * The number of triplets tried is capped, so a fix costs at most
+ * cap x (one triplet solve + one distance per anchor).
+ *
+ * Anchors can be given a height. The ranges are then projected onto the
+ * horizontal plane at the tag's height, r' = sqrt(r^2 - (zi - z)^2), and the
+ * 2D solve runs on them unchanged. The tag height is either known
+ * (setTagHeight()) or estimated (setHeightEstimation()): after each 2D fix
+ * every range gives a height zi +/- sqrt(r^2 - d^2), the branch nearer the
+ * current height is taken, their weighted mean becomes the new height and
+ * the fix is solved again, at most MAUWB_SOLVER_Z_ITERATIONS times. A known
+ * height costs one sqrt per anchor; estimating it at most that many extra
+ * solves. The height only comes out well when the anchors sit at clearly
+ * different heights. With every anchor and the tag at z = 0 (the default)
+ * nothing changes.
+ *
+ * Changing the layout only marks the cache dirty; it is rebuilt on the
+ * next solve, so setting up N anchors costs one rebuild, not N.
+ *
+ * MaUWB_SolverT is a template on the number type of the per-fix math
+ * (MaUWB_Numeric.h); MaUWB_Solver uses MaUWB_Real, i.e. float or, with
+ * MAUWB_FIXED_POINT, Q16.16. Ranges and positions are float cm either way.
+ * The geometry cache, the height projection and the height estimate are
+ * float. On the synthTests grids the Q16.16 build stays within 1 cm of
+ * the float one (fixed_point_test).
+ *
+ * Only needs the C math library, so it also builds on a desktop compiler.
+ */
+
+#ifndef MAUWB_SOLVER_H
+#define MAUWB_SOLVER_H
+
+#include <stdint.h>
+#include <math.h>
+#include "MaUWB_Numeric.h"
+
+// Anchors a solver has room for by default (at most 16, one bit each in a mask)
+#ifndef MAUWB_SOLVER_MAX_ANCHORS
+#define MAUWB_SOLVER_MAX_ANCHORS 10
+#endif
+
+// Distance outside the anchor bounding box still accepted as a fix (cm)
+#ifndef MAUWB_SOLVER_MARGIN
+#define MAUWB_SOLVER_MARGIN 100.0f
+#endif
+
+// computeWeights(): RSSI (dBm) at or above which a reply gets full weight,
+// and at which it reaches MAUWB_WEIGHT_MIN
+#ifndef MAUWB_RSSI_GOOD
+#define MAUWB_RSSI_GOOD -80.0f
+#endif
+#ifndef MAUWB_RSSI_FLOOR
+#define MAUWB_RSSI_FLOOR -100.0f
+#endif
+
+// Triangle-inequality violations smaller than this are ranging noise (cm)
+#ifndef MAUWB_CONSISTENCY_TOLERANCE
+#define MAUWB_CONSISTENCY_TOLERANCE 20.0f
+#endif
+
+// Outlier rejection: a range within this distance of the fix agrees with it (cm)
+#ifndef MAUWB_RANSAC_THRESHOLD
+#define MAUWB_RANSAC_THRESHOLD 30.0f
+#endif
+
+// Lowest weight computeWeights() gives an anchor that replied
+#ifndef MAUWB_WEIGHT_MIN
+#define MAUWB_WEIGHT_MIN 0.05f
+#endif
+
+// Height estimation: re-solves after the first fix, and the height change
+// below which it stops early (cm)
+#ifndef MAUWB_SOLVER_Z_ITERATIONS
+#define MAUWB_SOLVER_Z_ITERATIONS 3
+#endif
+#ifndef MAUWB_SOLVER_Z_SETTLED
+#define MAUWB_SOLVER_Z_SETTLED 1.0f
+#endif
+
+// N is the storage size: anchors 0..N-1, and a triplet cache of C(N, 3)
+// entries. A room with a fixed layout can size it exactly.
+template <typename T, uint8_t N = MAUWB_SOLVER_MAX_ANCHORS>
+class MaUWB_SolverT {
+    static_assert(N >= 3 && N <= 16, "3 to 16 anchors");
+
+public:
+    static const uint8_t MAX_ANCHORS = N;
+    static const uint16_t TRIPLETS = N * (N - 1) * (N - 2) / 6;
+
+    MaUWB_SolverT();
+
+    // Anchor layout; a change marks the geometry cache for rebuild
+    void setAnchorCount(uint8_t count);
+    void setAnchor(uint8_t index, float x, float y, float z = 0);
+
+    uint8_t getAnchorCount() const { return count; }
+    float getAnchorX(uint8_t index) const { return anchorX[index]; }
+    float getAnchorY(uint8_t index) const { return anchorY[index]; }
+    float getAnchorZ(uint8_t index) const { return anchorZ[index]; }
+
+    // Known height of the tag (cm, default 0); ranges are projected onto
+    // the plane at this height. Also the first guess for estimation.
+    void setTagHeight(float z);
+
+    // Estimate the tag height in solveChecked(), kept within minZ..maxZ
+    void setHeightEstimation(bool enable, float minZ = 0, float maxZ = 300);
+
+    // Height the last solveChecked() fix was solved at (known or estimated)
+    float getLastZ() const { return height; }
+
+    // Gauss-Newton steps applied after the linear solve (0 = linear only)
+    void setRefinementIterations(uint8_t iterations) { refineIterations = iterations; }
+
+    // Margin around the anchor bounding box for isPlausible()
+    void setMargin(float margin);
+
+    // Solve from one range per anchor (cm, <= 0 for no reply). Needs at
+    // least three anchors that are not on one line. Returns false otherwise.
+    bool solve(const float* ranges, float& x, float& y);
+
+    // Exact fix from anchors a, b and c (any order). Returns false if one of
+    // the ranges is missing or the three anchors are on one line.
+    bool solveTriplet(uint8_t a, uint8_t b, uint8_t c, const float* ranges, float& x, float& y);
+
+    // True if anchors a, b and c are (nearly) collinear
+    bool isTripletDegenerate(uint8_t a, uint8_t b, uint8_t c);
+
+    // True if (x, y) lies within the anchor bounding box plus the margin
+    bool isPlausible(float x, float y) const;
+
+    // Weighted least squares: weights[i] is the confidence in anchor i's
+    // range (0 = ignore). Gauss-Newton refinement uses the same weights.
+    bool solveWeighted(const float* ranges, const float* weights, float& x, float& y);
+
+    // Weight per anchor from the RSSI (dBm, 0 = unknown) and the triangle
+    // inequality between each pair of ranges. Anchors without a range get 0.
+    void computeWeights(const float* ranges, const float* rssi, float* weights);
+
+    // solve() (or solveWeighted() if weights are given), and if that fix is
+    // missing or implausible the first anchor triplet that gives a plausible
+    // one. Returns false if none does. With outlier rejection on, anchors
+    // whose ranges disagree with the fix are dropped first.
+    bool solveChecked(const float* ranges, float& x, float& y, const float* weights = nullptr);
+
+    // Outlier rejection in solveChecked(): try at most maxTriplets anchor
+    // triplets (every one if there are no more than that, a pseudo-random
+    // sample otherwise). A range within threshold cm of a fix agrees with
+    // it. 0 turns it off (default).
+    void setOutlierRejection(uint8_t maxTriplets, float threshold = MAUWB_RANSAC_THRESHOLD);
+
+    // Anchors dropped as outliers by the last solveChecked() (bit i = anchor i)
+    uint16_t getRejectedMask() const { return rejectedMask; }
+
+    // Triplets the last solveChecked() tried; at most the configured cap
+    uint8_t getLastTriplets() const { return lastTriplets; }
+
+    // Anchors used by the last successful solve (bit i = anchor i)
+    uint16_t getLastMask() const { return lastMask; }
+
+private:
+    typedef MaUWB_Numeric<T> Num;
+
+    float anchorX[N];
+    float anchorY[N];
+    float anchorZ[N];
+    uint8_t count;
+
+    // 3D: ranges are projected onto the plane z = height before solving
+    bool heightAware;     // An anchor or the tag is off z = 0, or z is estimated
+    bool estimateZ;
+    float tagHeight;
+    float minZ, maxZ;
+    float height;
+
+    // Anchor bounding box
+    float minX, maxX, minY, maxY;
+    float margin;
+
+    uint8_t refineIterations;
+
+    // Geometry cache, rebuilt by rebuildGeometry() when dirty. All of it is
+    // in solver units relative to the centre of the bounding box.
+    bool geometryDirty;
+    float centreX, centreY;
+    T localX[N];
+    T localY[N];
+    T limitMinX, limitMaxX, limitMinY, limitMaxY;   // Bounding box plus margin
+
+    // Exact solution of one triplet: p = offset + inverse * (ra^2 - rb^2, ra^2 - rc^2)
+    struct Triplet {
+        T invXX, invXY, invYX, invYY;   // Inverse of the pair-difference matrix
+        T offsetX, offsetY;             // Anchor-only part of the solution
+        bool valid;                     // false for collinear anchors
+    };
+    Triplet triplets[TRIPLETS];
+
+    // Least-squares geometry prepared for preparedMask
+    uint16_t preparedMask;
+    bool preparedValid;      // false if those anchors are degenerate
+    T gainX[N];
+    T gainY[N];
+    T offsetX, offsetY;
+
+    uint16_t lastMask;
+
+    // Outlier rejection
+    uint8_t ransacTriplets;
+    float ransacThreshold;
+    uint16_t rejectedMask;
+    uint8_t lastTriplets;
+    uint32_t randomState;
+
+    // Distance between each pair of anchors, for computeWeights()
+    T anchorDistance[N][N];
+
+    // Conversions between float cm and solver units
+    T toUnits(float cm) const { return Num::fromFloat(cm / Num::unit()); }
+    float toCmX(T x) const { return Num::toFloat(x) * Num::unit() + centreX; }
+    float toCmY(T y) const { return Num::toFloat(y) * Num::unit() + centreY; }
+    void loadRanges(const float* ranges, T* out) const;
+    void loadWeights(const float* weights, T* out) const;
+
+    void layoutChanged();
+    void updateHeightMode();
+    float estimateHeight(const float* ranges, const float* weights, float x, float y) const;
+    void updateLimits();
+    void rebuildGeometry();
+    void prepareTriplet(uint8_t a, uint8_t b, uint8_t c, const float* lx, const float* ly,
+                        Triplet& triplet) const;
+    static uint16_t tripletIndex(uint8_t& a, uint8_t& b, uint8_t& c);
+    bool prepare(uint16_t mask);
+
+    // Per-fix math in solver units
+    bool isInside(T x, T y) const;
+    bool solveLinear(const T* ranges, T& x, T& y);
+    bool solveWeightedLocal(const T* ranges, const T* weights, T& x, T& y);
+    bool solveTripletLocal(uint8_t a, uint8_t b, uint8_t c, const T* ranges, T& x, T& y);
+    bool solveFallback(const T* ranges, const T* weights, T& x, T& y);
+    bool solveRobust(const T* ranges, const T* weights, T& x, T& y);
+    uint8_t countAgreeing(const T* ranges, uint16_t mask, T x, T y, uint16_t& agreeing, T& residualSq) const;
+    void refine(const T* ranges, const T* weights, uint16_t mask, T& x, T& y) const;
+};
+
+// Float or Q16.16, see MaUWB_Numeric.h
+typedef MaUWB_SolverT<MaUWB_Real> MaUWB_Solver;
+
+// Implementation
+
+template <typename T, uint8_t N>
+inline MaUWB_SolverT<T, N>::MaUWB_SolverT()
+    : count(0), heightAware(false), estimateZ(false), tagHeight(0), minZ(0), maxZ(300), height(0), minX(0), maxX(0), minY(0), maxY(0), margin(MAUWB_SOLVER_MARGIN),
+      refineIterations(0), geometryDirty(true), centreX(0), centreY(0),
+      preparedMask(0), preparedValid(false), offsetX(0), offsetY(0), lastMask(0),
+      ransacTriplets(0), ransacThreshold(MAUWB_RANSAC_THRESHOLD), rejectedMask(0), lastTriplets(0),
+      randomState(0x2545F491) {
+    for (uint8_t i = 0; i < N; i++) {
+        anchorX[i] = 0;
+        anchorY[i] = 0;
+        anchorZ[i] = 0;
+        gainX[i] = 0;
+        gainY[i] = 0;
+    }
+    for (uint16_t i = 0; i < TRIPLETS; i++) {
+        triplets[i].valid = false;
+    }
+}
+
+template <typename T, uint8_t N>
+inline void MaUWB_SolverT<T, N>::setAnchorCount(uint8_t count) {
+    if (count <= N && count != this->count) {
+        this->count = count;
+        layoutChanged();
+    }
+}
+
+template <typename T, uint8_t N>
+inline void MaUWB_SolverT<T, N>::setAnchor(uint8_t index, float x, float y, float z) {
+    if (index >= N) {
+        return;
+    }
+    if (anchorZ[index] != z) {
+        // Heights only enter the projection, not the cached geometry
+        anchorZ[index] = z;
+        updateHeightMode();
+    }
+    if (anchorX[index] != x || anchorY[index] != y) {
+        anchorX[index] = x;
+        anchorY[index] = y;
+        layoutChanged();
+    }
+}
+
+template <typename T, uint8_t N>
+inline void MaUWB_SolverT<T, N>::setTagHeight(float z) {
+    tagHeight = z;
+    height = z;
+    updateHeightMode();
+}
+
+template <typename T, uint8_t N>
+inline void MaUWB_SolverT<T, N>::setHeightEstimation(bool enable, float minZ, float maxZ) {
+    estimateZ = enable;
+    this->minZ = minZ;
+    this->maxZ = maxZ;
+    height = tagHeight;
+    updateHeightMode();
+}
+
+template <typename T, uint8_t N>
+inline void MaUWB_SolverT<T, N>::updateHeightMode() {
+    heightAware = estimateZ || tagHeight != 0;
+    for (uint8_t i = 0; i < count && !heightAware; i++) {
+        heightAware = anchorZ[i] != 0;
+    }
+}
+
+template <typename T, uint8_t N>
+inline void MaUWB_SolverT<T, N>::setMargin(float margin) {
+    this->margin = margin;
+    geometryDirty = true;
+}
+
+template <typename T, uint8_t N>
+inline void MaUWB_SolverT<T, N>::loadRanges(const float* ranges, T* out) const {
+    if (!heightAware) {
+        for (uint8_t i = 0; i < count; i++) {
+            out[i] = ranges[i] > 0 ? toUnits(ranges[i]) : T(0);
+        }
+        return;
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        if (ranges[i] <= 0) {
+            out[i] = 0;
+            continue;
+        }
+        // A range shorter than the height difference is noise around a
+        // tag right below the anchor; keep it as a reply 1 cm away
+        float dz = anchorZ[i] - height;
+        float planar = ranges[i] * ranges[i] - dz * dz;
+        out[i] = toUnits(planar > 1.0f ? sqrtf(planar) : 1.0f);
+    }
+}
+
+template <typename T, uint8_t N>
+inline void MaUWB_SolverT<T, N>::loadWeights(const float* weights, T* out) const {
+    for (uint8_t i = 0; i < count; i++) {
+        out[i] = Num::fromFloat(weights[i]);
+    }
+}
+
+template <typename T, uint8_t N>
+inline bool MaUWB_SolverT<T, N>::solve(const float* ranges, float& x, float& y) {
+    if (geometryDirty) {
+        rebuildGeometry();
+    }
+    T local[N];
+    loadRanges(ranges, local);
+
+    T solX, solY;
+    if (!solveLinear(local, solX, solY)) {
+        return false;
+    }
+    x = toCmX(solX);
+    y = toCmY(solY);
+    return true;
+}
+
+template <typename T, uint8_t N>
+inline bool MaUWB_SolverT<T, N>::solveWeighted(const float* ranges, const float* weights, float& x, float& y) {
+    if (geometryDirty) {
+        rebuildGeometry();
+    }
+    T local[N];
+    T localWeights[N];
+    loadRanges(ranges, local);
+    loadWeights(weights, localWeights);
+
+    T solX, solY;
+    if (!solveWeightedLocal(local, localWeights, solX, solY)) {
+        return false;
+    }
+    x = toCmX(solX);
+    y = toCmY(solY);
+    return true;
+}
+
+template <typename T, uint8_t N>
+inline bool MaUWB_SolverT<T, N>::solveTriplet(uint8_t a, uint8_t b, uint8_t c, const float* ranges,
+                                           float& x, float& y) {
+    if (geometryDirty) {
+        rebuildGeometry();
+    }
+    T local[N];
+    loadRanges(ranges, local);
+
+    T solX, solY;
+    if (!solveTripletLocal(a, b, c, local, solX, solY)) {
+        return false;
+    }
+    x = toCmX(solX);
+    y = toCmY(solY);
+    return true;
+}
+
+template <typename T, uint8_t N>
+inline bool MaUWB_SolverT<T, N>::solveChecked(const float* ranges, float& x, float& y, const float* weights) {
+    rejectedMask = 0;
+    lastTriplets = 0;
+    if (geometryDirty) {
+        rebuildGeometry();
+    }
+
+    T local[N];
+    T localWeights[N];
+    if (weights) {
+        loadWeights(weights, localWeights);
+    }
+
+    // Estimation starts from the last fix's height; the tag rarely jumps
+    if (!estimateZ) {
+        height = tagHeight;
+    }
+
+    T solX, solY;
+    for (uint8_t pass = 0; ; pass++) {
+        loadRanges(ranges, local);
+        rejectedMask = 0;
+        bool solved = ransacTriplets > 0
+            ? solveRobust(local, weights ? localWeights : nullptr, solX, solY)
+            : solveFallback(local, weights ? localWeights : nullptr, solX, solY);
+        if (!solved) {
+            return false;
+        }
+        if (!estimateZ || pass >= MAUWB_SOLVER_Z_ITERATIONS) {
+            break;
+        }
+
+        float z = estimateHeight(ranges, weights, toCmX(solX), toCmY(solY));
+        bool settled = fabsf(z - height) < MAUWB_SOLVER_Z_SETTLED;
+        height = z;
+        if (settled) {
+            break;
+        }
+    }
+    x = toCmX(solX);
+    y = toCmY(solY);
+    return true;
+}
+
+// Each range puts the tag at zi +/- sqrt(r^2 - d^2) for the horizontal
+// distance d to the fix. The branch nearer the current height is taken;
+// a range mostly vertical pins the height down best, so it is weighted by
+// (vertical / r)^2.
+template <typename T, uint8_t N>
+inline float MaUWB_SolverT<T, N>::estimateHeight(const float* ranges, const float* weights, float x,
+                                              float y) const {
+    float sum = 0, total = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (ranges[i] <= 0 || (rejectedMask & ((uint16_t)1 << i)) || (weights && weights[i] <= 0)) {
+            continue;
+        }
+        float dx = x - anchorX[i];
+        float dy = y - anchorY[i];
+        float r2 = ranges[i] * ranges[i];
+        float vertical2 = r2 - dx * dx - dy * dy;
+        if (vertical2 <= 0) {
+            continue;
+        }
+        float vertical = sqrtf(vertical2);
+        float below = anchorZ[i] - vertical;
+        float above = anchorZ[i] + vertical;
+        float z = fabsf(below - height) <= fabsf(above - height) ? below : above;
+        float weight = vertical2 / r2 * (weights ? weights[i] : 1.0f);
+        sum += weight * z;
+        total += weight;
+    }
+    if (total <= 0) {
+        return height;
+    }
+
+    float z = sum / total;
+    return z < minZ ? minZ : (z > maxZ ? maxZ : z);
+}
+
+template <typename T, uint8_t N>
+inline void MaUWB_SolverT<T, N>::computeWeights(const float* ranges, const float* rssi, float* weights) {
+    if (geometryDirty) {
+        rebuildGeometry();
+    }
+    T local[N];
+    T localWeights[N];
+    loadRanges(ranges, local);
+
+    const T floor = Num::fromFloat(MAUWB_RSSI_FLOOR);
+    const T span = Num::fromFloat(MAUWB_RSSI_GOOD - MAUWB_RSSI_FLOOR);
+    const T good = Num::fromFloat(MAUWB_RSSI_GOOD);
+    const T minimum = Num::fromFloat(MAUWB_WEIGHT_MIN);
+    const T tolerance = toUnits(MAUWB_CONSISTENCY_TOLERANCE);
+    const T half = Num::fromFloat(0.5f);
+
+    for (uint8_t i = 0; i < count; i++) {
+        if (local[i] <= 0) {
+            localWeights[i] = 0;
+            continue;
+        }
+
+        T weight = 1;
+        if (rssi) {
+            T level = Num::fromFloat(rssi[i]);
+            if (level < good) {
+                T t = (level - floor) / span;
+                weight = minimum + (T(1) - minimum) * (t < 0 ? T(0) : t);
+            }
+        }
+        localWeights[i] = weight;
+    }
+
+    // A pair of ranges that cannot both be right halves the weight of both;
+    // the bad range breaks the inequality with most anchors, so it ends up lowest
+    for (uint8_t i = 0; i < count; i++) {
+        if (local[i] <= 0) continue;
+        for (uint8_t j = i + 1; j < count; j++) {
+            if (local[j] <= 0) continue;
+
+            T between = anchorDistance[i][j];
+            T difference = Num::abs(local[i] - local[j]);
+            if (difference > between + tolerance || local[i] + local[j] < between - tolerance) {
+                localWeights[i] *= half;
+                localWeights[j] *= half;
+            }
+        }
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        if (local[i] > 0 && localWeights[i] < minimum) {
+            localWeights[i] = minimum;
+        }
+        weights[i] = Num::toFloat(localWeights[i]);
+    }
+}
+
+template <typename T, uint8_t N>
+inline bool MaUWB_SolverT<T, N>::isTripletDegenerate(uint8_t a, uint8_t b, uint8_t c) {
+    if (a >= count || b >= count || c >= count || a == b || b == c || a == c) {
+        return true;
+    }
+    if (geometryDirty) {
+        rebuildGeometry();
+    }
+    return !triplets[tripletIndex(a, b, c)].valid;
+}
+
+template <typename T, uint8_t N>
+inline bool MaUWB_SolverT<T, N>::isPlausible(float x, float y) const {
+    return x >= minX - margin && x <= maxX + margin &&
+           y >= minY - margin && y <= maxY + margin;
+}
+
+template <typename T, uint8_t N>
+inline void MaUWB_SolverT<T, N>::setOutlierRejection(uint8_t maxTriplets, float threshold) {
+    ransacTriplets = maxTriplets;
+    ransacThreshold = threshold;
+}
+
+template <typename T, uint8_t N>
+inline bool MaUWB_SolverT<T, N>::isInside(T x, T y) const {
+    return x >= limitMinX && x <= limitMaxX && y >= limitMinY && y <= limitMaxY;
+}
+
+template <typename T, uint8_t N>
+inline bool MaUWB_SolverT<T, N>::solveLinear(const T* ranges, T& x, T& y) {
+    uint16_t mask = 0;
+    uint8_t used = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (ranges[i] > 0) {
+            mask |= (uint16_t)1 << i;
+            used++;
+        }
+    }
+    if (used < 3) {
+        return false;
+    }
+
+    if (mask != preparedMask) {
+        prepare(mask);
+    }
+    if (!preparedValid) {
+        return false;
+    }
+
+    T solX = offsetX;
+    T solY = offsetY;
+    for (uint8_t i = 0; i < count; i++) {
+        if (mask & ((uint16_t)1 << i)) {
+            T rangeSq = ranges[i] * ranges[i];
+            solX -= gainX[i] * rangeSq;
+            solY -= gainY[i] * rangeSq;
+        }
+    }
+
+    if (refineIterations > 0) {
+        refine(ranges, nullptr, mask, solX, solY);
+    }
+
+    x = solX;
+    y = solY;
+    lastMask = mask;
+    return true;
+}
+
+// Same linearisation as solve(), centred on the weighted anchor mean so the
+// mean terms still drop out: p = 1/2 (sum w d d^T)^-1 sum w d (|pi|^2 - ri^2).
+// The sums are taken relative to the trace of the normal matrix so they
+// stay small enough for fixed point.
+template <typename T, uint8_t N>
+inline bool MaUWB_SolverT<T, N>::solveWeightedLocal(const T* ranges, const T* weights, T& x, T& y) {
+    uint16_t mask = 0;
+    uint8_t used = 0;
+    T sumW = 0, meanX = 0, meanY = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (ranges[i] > 0 && weights[i] > 0) {
+            mask |= (uint16_t)1 << i;
+            used++;
+            sumW += weights[i];
+            meanX += weights[i] * localX[i];
+            meanY += weights[i] * localY[i];
+        }
+    }
+    if (used < 3) {
+        return false;
+    }
+    meanX /= sumW;
+    meanY /= sumW;
+
+    T trace = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (mask & ((uint16_t)1 << i)) {
+            T dx = localX[i] - meanX;
+            T dy = localY[i] - meanY;
+            trace += weights[i] * (dx * dx + dy * dy);
+        }
+    }
+    if (trace <= 0) {
+        return false;
+    }
+
+    T sxx = 0, sxy = 0, syy = 0;
+    T bx = 0, by = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (mask & ((uint16_t)1 << i)) {
+            T w = weights[i] / trace;
+            T dx = localX[i] - meanX;
+            T dy = localY[i] - meanY;
+            T b = localX[i] * localX[i] + localY[i] * localY[i] - ranges[i] * ranges[i];
+            sxx += w * dx * dx;
+            sxy += w * dx * dy;
+            syy += w * dy * dy;
+            bx += w * dx * b;
+            by += w * dy * b;
+        }
+    }
+
+    // sxx + syy = 1 now, so det is relative to the spread
+    T det = sxx * syy - sxy * sxy;
+    if (det <= Num::tiny()) {
+        return false;
+    }
+
+    T solX = (syy * bx - sxy * by) / (det * 2);
+    T solY = (sxx * by - sxy * bx) / (det * 2);
+
+    if (refineIterations > 0) {
+        refine(ranges, weights, mask, solX, solY);
+    }
+
+    x = solX;
+    y = solY;
+    lastMask = mask;
+    return true;
+}
+
+template <typename T, uint8_t N>
+inline bool MaUWB_SolverT<T, N>::solveTripletLocal(uint8_t a, uint8_t b, uint8_t c, const T* ranges,
+                                                T& x, T& y) {
+    if (a >= count || b >= count || c >= count || a == b || b == c || a == c) {
+        return false;
+    }
+    if (ranges[a] <= 0 || ranges[b] <= 0 || ranges[c] <= 0) {
+        return false;
+    }
+
+    uint8_t first = a, second = b, third = c;
+    const Triplet& triplet = triplets[tripletIndex(first, second, third)];
+    if (!triplet.valid) {
+        return false;
+    }
+
+    T firstSq = ranges[first] * ranges[first];
+    T u = firstSq - ranges[second] * ranges[second];
+    T v = firstSq - ranges[third] * ranges[third];
+    x = triplet.offsetX + triplet.invXX * u + triplet.invXY * v;
+    y = triplet.offsetY + triplet.invYX * u + triplet.invYY * v;
+    return true;
+}
+
+template <typename T, uint8_t N>
+inline bool MaUWB_SolverT<T, N>::solveFallback(const T* ranges, const T* weights, T& x, T& y) {
+    bool solved = weights ? solveWeightedLocal(ranges, weights, x, y) : solveLinear(ranges, x, y);
+    if (solved && isInside(x, y)) {
+        return true;
+    }
+
+    // A single bad range can pull the least-squares fix out of the room;
+    // fall back to the first anchor triplet that gives a plausible position
+    for (uint8_t i = 0; i + 2 < count; i++) {
+        for (uint8_t j = i + 1; j + 1 < count; j++) {
+            for (uint8_t k = j + 1; k < count; k++) {
+                // Uses the cached triplet geometry; skips collinear triplets
+                if (solveTripletLocal(i, j, k, ranges, x, y) && isInside(x, y)) {
+                    lastMask = (1 << i) | (1 << j) | (1 << k);
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+// Anchors in mask whose range is within the threshold of |p - pi|. Returns
+// their count; residualSq sums their squared residuals.
+template <typename T, uint8_t N>
+inline uint8_t MaUWB_SolverT<T, N>::countAgreeing(const T* ranges, uint16_t mask, T x, T y,
+                                               uint16_t& agreeing, T& residualSq) const {
+    const T threshold = toUnits(ransacThreshold);
+    uint8_t agreeingCount = 0;
+    agreeing = 0;
+    residualSq = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (!(mask & ((uint16_t)1 << i))) continue;
+
+        T dx = x - localX[i];
+        T dy = y - localY[i];
+        T residual = Num::sqrt(dx * dx + dy * dy) - ranges[i];
+        if (Num::abs(residual) <= threshold) {
+            agreeing |= (uint16_t)1 << i;
+            agreeingCount++;
+            residualSq += residual * residual;
+        }
+    }
+    return agreeingCount;
+}
+
+template <typename T, uint8_t N>
+inline bool MaUWB_SolverT<T, N>::solveRobust(const T* ranges, const T* weights, T& x, T& y) {
+    uint8_t present[N];
+    uint8_t n = 0;
+    uint16_t presentMask = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (ranges[i] > 0 && (!weights || weights[i] > 0)) {
+            present[n++] = i;
+            presentMask |= (uint16_t)1 << i;
+        }
+    }
+
+    // Three ranges always agree with their own fix; nothing to reject
+    T fixX = 0, fixY = 0;
+    bool haveFix = solveFallback(ranges, weights, fixX, fixY);
+    if (n < 4) {
+        x = fixX;
+        y = fixY;
+        return haveFix;
+    }
+
+    // Usual case: every range agrees with the plain fix
+    uint16_t agreeing;
+    T residualSq;
+    if (haveFix && countAgreeing(ranges, presentMask, fixX, fixY, agreeing, residualSq) == n) {
+        x = fixX;
+        y = fixY;
+        return true;
+    }
+
+    uint16_t tripletCount = (uint16_t)n * (n - 1) * (n - 2) / 6;
+    bool exhaustive = tripletCount <= ransacTriplets;
+    uint16_t tries = exhaustive ? tripletCount : ransacTriplets;
+
+    uint8_t bestCount = 0;
+    uint16_t bestAgreeing = 0;
+    T bestResidualSq = 0;
+    T bestX = 0, bestY = 0;
+
+    uint8_t i = 0, j = 1, k = 2;   // Positions in present[] of the next triplet
+    for (uint16_t attempt = 0; attempt < tries && bestCount < n; attempt++) {
+        if (!exhaustive) {
+            // xorshift32; a fixed seed keeps runs repeatable
+            uint8_t pick[3];
+            for (uint8_t p = 0; p < 3; p++) {
+                bool repeated;
+                do {
+                    randomState ^= randomState << 13;
+                    randomState ^= randomState >> 17;
+                    randomState ^= randomState << 5;
+                    pick[p] = (uint8_t)(randomState % n);
+                    repeated = (p > 0 && pick[p] == pick[0]) || (p > 1 && pick[p] == pick[1]);
+                } while (repeated);
+            }
+            i = pick[0];
+            j = pick[1];
+            k = pick[2];
+        }
+
+        lastTriplets++;
+        T candX, candY;
+        if (solveTripletLocal(present[i], present[j], present[k], ranges, candX, candY) &&
+            isInside(candX, candY)) {
+            uint8_t agreeingCount = countAgreeing(ranges, presentMask, candX, candY, agreeing, residualSq);
+            if (agreeingCount > bestCount ||
+                (agreeingCount == bestCount && residualSq < bestResidualSq)) {
+                bestCount = agreeingCount;
+                bestAgreeing = agreeing;
+                bestResidualSq = residualSq;
+                bestX = candX;
+                bestY = candY;
+            }
+        }
+
+        if (exhaustive) {
+            // Next triplet in lexicographic order
+            if (++k == n) {
+                if (++j == n - 1) {
+                    i++;
+                    j = i + 1;
+                }
+                k = j + 1;
+            }
+        }
+    }
+
+    if (bestCount < 3) {
+        // No triplet gave a plausible fix; keep the plain one if there is one
+        x = fixX;
+        y = fixY;
+        return haveFix;
+    }
+
+    // Re-solve over the anchors that agree with the best triplet
+    T inliers[N];
+    for (uint8_t a = 0; a < count; a++) {
+        inliers[a] = (bestAgreeing & ((uint16_t)1 << a)) ? ranges[a] : T(0);
+    }
+    bool solved = weights ? solveWeightedLocal(inliers, weights, x, y) : solveLinear(inliers, x, y);
+    if (!solved || !isInside(x, y)) {
+        x = bestX;
+        y = bestY;
+    }
+
+    lastMask = bestAgreeing;
+    rejectedMask = presentMask & ~bestAgreeing;
+    return true;
+}
+
+// Update the bounding box and mark the cached geometry stale
+template <typename T, uint8_t N>
+inline void MaUWB_SolverT<T, N>::layoutChanged() {
+    if (count == 0) {
+        minX = maxX = minY = maxY = 0;
+    } else {
+        minX = maxX = anchorX[0];
+        minY = maxY = anchorY[0];
+        for (uint8_t i = 1; i < count; i++) {
+            if (anchorX[i] < minX) minX = anchorX[i];
+            if (anchorX[i] > maxX) maxX = anchorX[i];
+            if (anchorY[i] < minY) minY = anchorY[i];
+            if (anchorY[i] > maxY) maxY = anchorY[i];
+        }
+    }
+
+    updateHeightMode();
+    geometryDirty = true;
+}
+
+template <typename T, uint8_t N>
+inline void MaUWB_SolverT<T, N>::updateLimits() {
+    limitMinX = Num::fromFloat((minX - margin - centreX) / Num::unit());
+    limitMaxX = Num::fromFloat((maxX + margin - centreX) / Num::unit());
+    limitMinY = Num::fromFloat((minY - margin - centreY) / Num::unit());
+    limitMaxY = Num::fromFloat((maxY + margin - centreY) / Num::unit());
+}
+
+// Rebuild the triplet table and the least-squares geometry for all anchors
+template <typename T, uint8_t N>
+inline void MaUWB_SolverT<T, N>::rebuildGeometry() {
+    centreX = (minX + maxX) / 2;
+    centreY = (minY + maxY) / 2;
+    updateLimits();
+
+    // Float copy of the centred layout for building the cache
+    float lx[N];
+    float ly[N];
+    for (uint8_t i = 0; i < count; i++) {
+        lx[i] = (anchorX[i] - centreX) / Num::unit();
+        ly[i] = (anchorY[i] - centreY) / Num::unit();
+        localX[i] = Num::fromFloat(lx[i]);
+        localY[i] = Num::fromFloat(ly[i]);
+    }
+
+    for (uint8_t c = 2; c < count; c++) {
+        for (uint8_t b = 1; b < c; b++) {
+            for (uint8_t a = 0; a < b; a++) {
+                uint8_t first = a, second = b, third = c;
+                prepareTriplet(a, b, c, lx, ly, triplets[tripletIndex(first, second, third)]);
+            }
+        }
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        for (uint8_t j = 0; j < count; j++) {
+            float dx = lx[i] - lx[j];
+            float dy = ly[i] - ly[j];
+            anchorDistance[i][j] = Num::fromFloat(sqrtf(dx * dx + dy * dy));
+        }
+    }
+
+    geometryDirty = false;
+    prepare(count > 0 ? (uint16_t)((1UL << count) - 1) : 0);
+}
+
+// Subtracting anchor a's circle from b's and c's gives the linear system
+//   2 (pb - pa) . p = (ra^2 - rb^2) + (|pb|^2 - |pa|^2)
+//   2 (pc - pa) . p = (ra^2 - rc^2) + (|pc|^2 - |pa|^2)
+template <typename T, uint8_t N>
+inline void MaUWB_SolverT<T, N>::prepareTriplet(uint8_t a, uint8_t b, uint8_t c, const float* lx,
+                                             const float* ly, Triplet& triplet) const {
+    float m00 = 2 * (lx[b] - lx[a]);
+    float m01 = 2 * (ly[b] - ly[a]);
+    float m10 = 2 * (lx[c] - lx[a]);
+    float m11 = 2 * (ly[c] - ly[a]);
+
+    // |det| = |u| |v| sin(angle); treat angles under ~0.06 degrees as collinear
+    float det = m00 * m11 - m01 * m10;
+    float lengths = (m00 * m00 + m01 * m01) * (m10 * m10 + m11 * m11);
+    if (lengths <= 0 || det * det <= 1e-6f * lengths) {
+        triplet.valid = false;
+        return;
+    }
+
+    float invXX = m11 / det;
+    float invXY = -m01 / det;
+    float invYX = -m10 / det;
+    float invYY = m00 / det;
+
+    float normA = lx[a] * lx[a] + ly[a] * ly[a];
+    float normB = lx[b] * lx[b] + ly[b] * ly[b];
+    float normC = lx[c] * lx[c] + ly[c] * ly[c];
+
+    triplet.invXX = Num::fromFloat(invXX);
+    triplet.invXY = Num::fromFloat(invXY);
+    triplet.invYX = Num::fromFloat(invYX);
+    triplet.invYY = Num::fromFloat(invYY);
+    triplet.offsetX = Num::fromFloat(invXX * (normB - normA) + invXY * (normC - normA));
+    triplet.offsetY = Num::fromFloat(invYX * (normB - normA) + invYY * (normC - normA));
+    triplet.valid = true;
+}
+
+// Sort a < b < c and return the triplet's slot: C(c,3) + C(b,2) + C(a,1)
+template <typename T, uint8_t N>
+inline uint16_t MaUWB_SolverT<T, N>::tripletIndex(uint8_t& a, uint8_t& b, uint8_t& c) {
+    uint8_t t;
+    if (a > b) { t = a; a = b; b = t; }
+    if (b > c) { t = b; b = c; c = t; }
+    if (a > b) { t = a; a = b; b = t; }
+    return c * (c - 1) * (c - 2) / 6 + b * (b - 1) / 2 + a;
+}
+
+// Build the per-anchor gains and offset for the anchors in mask. Runs in
+// float: it only happens when the layout or the set of replying anchors changes.
+template <typename T, uint8_t N>
+inline bool MaUWB_SolverT<T, N>::prepare(uint16_t mask) {
+    preparedMask = mask;
+    preparedValid = false;
+
+    float lx[N];
+    float ly[N];
+    for (uint8_t i = 0; i < count; i++) {
+        lx[i] = (anchorX[i] - centreX) / Num::unit();
+        ly[i] = (anchorY[i] - centreY) / Num::unit();
+    }
+
+    // Anchor mean
+    float meanX = 0, meanY = 0;
+    uint8_t used = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (mask & ((uint16_t)1 << i)) {
+            meanX += lx[i];
+            meanY += ly[i];
+            used++;
+        }
+    }
+    if (used < 3) {
+        return false;
+    }
+    meanX /= used;
+    meanY /= used;
+
+    // Normal matrix A^T A = 4 * sum(d d^T), with d = pi - p_mean
+    float sxx = 0, sxy = 0, syy = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (mask & ((uint16_t)1 << i)) {
+            float dx = lx[i] - meanX;
+            float dy = ly[i] - meanY;
+            sxx += dx * dx;
+            sxy += dx * dy;
+            syy += dy * dy;
+        }
+    }
+
+    // Collinear anchors: determinant vanishes relative to the spread
+    float det = sxx * syy - sxy * sxy;
+    float trace = sxx + syy;
+    if (trace <= 0 || det <= 1e-6f * trace * trace) {
+        return false;
+    }
+
+    // Pi = (4 S)^-1 * 2 d = S^-1 d / 2
+    float invXX = syy / (2 * det);
+    float invXY = -sxy / (2 * det);
+    float invYY = sxx / (2 * det);
+
+    float sumX = 0, sumY = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (mask & ((uint16_t)1 << i)) {
+            float dx = lx[i] - meanX;
+            float dy = ly[i] - meanY;
+            float gx = invXX * dx + invXY * dy;
+            float gy = invXY * dx + invYY * dy;
+            gainX[i] = Num::fromFloat(gx);
+            gainY[i] = Num::fromFloat(gy);
+
+            float normSq = lx[i] * lx[i] + ly[i] * ly[i];
+            sumX += gx * normSq;
+            sumY += gy * normSq;
+        } else {
+            gainX[i] = 0;
+            gainY[i] = 0;
+        }
+    }
+    offsetX = Num::fromFloat(sumX);
+    offsetY = Num::fromFloat(sumY);
+
+    preparedValid = true;
+    return true;
+}
+
+// Gauss-Newton on sum(wi (|p - pi| - ri)^2), starting from the linear solution
+template <typename T, uint8_t N>
+inline void MaUWB_SolverT<T, N>::refine(const T* ranges, const T* weights, uint16_t mask,
+                                     T& x, T& y) const {
+    const T nearAnchor = toUnits(0.01f);
+    const T converged = toUnits(0.1f);
+
+    for (uint8_t iteration = 0; iteration < refineIterations; iteration++) {
+        T jxx = 0, jxy = 0, jyy = 0;   // J^T J
+        T gx = 0, gy = 0;              // J^T e
+
+        for (uint8_t i = 0; i < count; i++) {
+            if (!(mask & ((uint16_t)1 << i))) continue;
+
+            T dx = x - localX[i];
+            T dy = y - localY[i];
+            T dist = Num::sqrt(dx * dx + dy * dy);
+            if (dist < nearAnchor) continue;   // On top of an anchor: no direction
+
+            T ux = dx / dist;
+            T uy = dy / dist;
+            T residual = dist - ranges[i];
+            T w = weights ? weights[i] : T(1);
+
+            jxx += w * ux * ux;
+            jxy += w * ux * uy;
+            jyy += w * uy * uy;
+            gx += w * ux * residual;
+            gy += w * uy * residual;
+        }
+
+        T det = jxx * jyy - jxy * jxy;
+        if (det < Num::tiny()) break;
+
+        T stepX = -(jyy * gx - jxy * gy) / det;
+        T stepY = -(jxx * gy - jxy * gx) / det;
+        x += stepX;
+        y += stepY;
+
+        // Converged to well below the ranging resolution
+        if (Num::abs(stepX) + Num::abs(stepY) < converged) break;
+    }
+}
+
+#endif // MAUWB_SOLVER_H
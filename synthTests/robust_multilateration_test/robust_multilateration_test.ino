@@ -21,6 +21,9 @@ NOISE PATTERNS TESTED:
 - Multipath error (systematically longer distances)
 - Progressive error (gradual increase in noise)
 - Triangle inequality violation (physically impossible measurements)
+The patterns are MaUWB_SynthNoise (MaUWB_SynthLoad.h), which the fleet load
+generator (host_benchmark/load_generator, SYNTH_LOAD in ANCHOR_default) also
+lays over its reports.
 
 USAGE:
 - Run this sketch on an ESP32 and open serial monitor
@@ -37,6 +40,9 @@ All distances are in centimeters.
 */
 
 #include <Arduino.h>
+#include "MaUWB_RangeParser.h"
+#include "MaUWB_Solver.h"
+#include "MaUWB_SynthLoad.h"
 
 // Define AT command response format
 #define AT_RESP_PREFIX "AT+RANGE=tid:1,mask:0x0F,seq:0,range:("
@@ -50,6 +56,12 @@ All distances are in centimeters.
 const float anchor_x[4] = {0, 0, 380, 380};
 const float anchor_y[4] = {0, 600, 600, 0};
 
+// Anchor geometry cache for the position solve, loaded in setup()
+MaUWB_Solver solver;
+
+// Range noise for the test patterns
+MaUWB_SynthRandom noiseRandom;
+
 // Distance measurements to anchors
 float dist_to_a0 = 0.0;
 float dist_to_a1 = 0.0;
@@ -172,50 +184,15 @@ void calculatePosition() {
     float x2 = 0, y2 = 0;  // Position calculated from anchors 0,1,3
     float x3 = 0, y3 = 0;  // Position calculated from anchors 0,2,3
     
-    // Precompute squared distances and other repeated values
-    float dist_to_a0_sq = dist_to_a0 * dist_to_a0;
-    float dist_to_a1_sq = dist_to_a1 * dist_to_a1;
-    float dist_to_a2_sq = dist_to_a2 * dist_to_a2;
-    float dist_to_a3_sq = dist_to_a3 * dist_to_a3;
-    
-    // Precompute anchor position terms
-    float a0_sq = anchor_x[0] * anchor_x[0] + anchor_y[0] * anchor_y[0];
-    float a1_sq = anchor_x[1] * anchor_x[1] + anchor_y[1] * anchor_y[1];
-    float a2_sq = anchor_x[2] * anchor_x[2] + anchor_y[2] * anchor_y[2];
-    float a3_sq = anchor_x[3] * anchor_x[3] + anchor_y[3] * anchor_y[3];
-    
-    // Common calculations for equations involving anchors 0-1
-    float A_01 = 2 * (anchor_x[1] - anchor_x[0]);
-    float B_01 = 2 * (anchor_y[1] - anchor_y[0]);
-    float C_01 = dist_to_a0_sq - dist_to_a1_sq - a0_sq + a1_sq;
-    
-    // Common calculations for other anchor pairs
-    float A_12 = 2 * (anchor_x[2] - anchor_x[1]);
-    float B_12 = 2 * (anchor_y[2] - anchor_y[1]);
-    float C_12 = dist_to_a1_sq - dist_to_a2_sq - a1_sq + a2_sq;
-    
-    float A_13 = 2 * (anchor_x[3] - anchor_x[1]);
-    float B_13 = 2 * (anchor_y[3] - anchor_y[1]);
-    float C_13 = dist_to_a1_sq - dist_to_a3_sq - a1_sq + a3_sq;
-    
-    float A_02 = 2 * (anchor_x[2] - anchor_x[0]);
-    float B_02 = 2 * (anchor_y[2] - anchor_y[0]);
-    float C_02 = dist_to_a0_sq - dist_to_a2_sq - a0_sq + a2_sq;
-    
-    float A_23 = 2 * (anchor_x[3] - anchor_x[2]);
-    float B_23 = 2 * (anchor_y[3] - anchor_y[2]);
-    float C_23 = dist_to_a2_sq - dist_to_a3_sq - a2_sq + a3_sq;
+    // The anchor terms of each triplet are cached in the solver and only
+    // rebuilt when the layout changes; a fix needs just the squared ranges
+    const float ranges[4] = {dist_to_a0, dist_to_a1, dist_to_a2, dist_to_a3};
     
     // Solve using anchors 0,1,2 with weight as product of quality values
     float weight1 = quality_a0 * quality_a1 * quality_a2;
-    float den1 = (A_01 * B_12 - B_01 * A_12);
-    bool valid1 = false;
+    bool valid1 = solver.solveTriplet(0, 1, 2, ranges, x1, y1);
     
-    if (abs(den1) > 0.000001) {
-        x1 = (C_01 * B_12 - C_12 * B_01) / den1;
-        y1 = (A_01 * C_12 - C_01 * A_12) / den1;
-        valid1 = true;
-        
+    if (valid1) {
         Serial.print("Position from anchors 0,1,2: (");
         Serial.print(x1);
         Serial.print(", ");
@@ -226,14 +203,9 @@ void calculatePosition() {
     
     // Solve using anchors 0,1,3 with weight
     float weight2 = quality_a0 * quality_a1 * quality_a3;
-    float den2 = (A_01 * B_13 - B_01 * A_13);
-    bool valid2 = false;
+    bool valid2 = solver.solveTriplet(0, 1, 3, ranges, x2, y2);
     
-    if (abs(den2) > 0.000001) {
-        x2 = (C_01 * B_13 - C_13 * B_01) / den2;
-        y2 = (A_01 * C_13 - C_01 * A_13) / den2;
-        valid2 = true;
-        
+    if (valid2) {
         Serial.print("Position from anchors 0,1,3: (");
         Serial.print(x2);
         Serial.print(", ");
@@ -244,14 +216,9 @@ void calculatePosition() {
     
     // Solve using anchors 0,2,3 with weight
     float weight3 = quality_a0 * quality_a2 * quality_a3;
-    float den3 = (A_02 * B_23 - B_02 * A_23);
-    bool valid3 = false;
+    bool valid3 = solver.solveTriplet(0, 2, 3, ranges, x3, y3);
     
-    if (abs(den3) > 0.000001) {
-        x3 = (C_02 * B_23 - C_23 * B_02) / den3;
-        y3 = (A_02 * C_23 - C_02 * A_23) / den3;
-        valid3 = true;
-        
+    if (valid3) {
         Serial.print("Position from anchors 0,2,3: (");
         Serial.print(x3);
         Serial.print(", ");
@@ -330,68 +297,45 @@ void calculatePosition() {
 }
 
 // Parse range information from AT command response
-void parseRangeData(String data) {
+void parseRangeData(const String& data) {
     // According to the AT command manual, the response format is:
     // AT+RANGE=tid:x1,mask:x2,seq:x3,range:(x4,x5,x6,x7,x8,x9,x10,x11), rssi:(x12,x13,x14,x15,x16,x17,x18,x19)
+    // Decoded with the same parser the tag sketches use
+    MaUWB_RangeReport report;
+    if (!MaUWB_RangeParser::parse(data.c_str(), report)) {
+        return;
+    }
     
-    // Look for "range:(" in the response
-    int range_start = data.indexOf("range:(");
-    if (range_start >= 0) {
-        // Find the end of the range array
-        int range_end = data.indexOf(")", range_start);
-        if (range_end > range_start) {
-            // We're only interested in the first 4 values (0-3)
-            float distances[4] = {0, 0, 0, 0};
-            
-            // Parse directly from the original string without creating substrings
-            int startIndex = range_start + 7;  // Skip "range:("
-            int valueIndex = 0;
-            
-            Serial.print("Range values: ");
-            
-            // Parse each value directly
-            while (valueIndex < 4 && startIndex < range_end) {
-                // Find the next comma or the end parenthesis
-                int commaIndex = data.indexOf(',', startIndex);
-                if (commaIndex == -1 || commaIndex > range_end) {
-                    commaIndex = range_end;
-                }
-                
-                // Convert this segment directly to float
-                char buffer[10]; // Temporary buffer for number conversion
-                int len = commaIndex - startIndex;
-                if (len < 10) {
-                    strncpy(buffer, data.c_str() + startIndex, len);
-                    buffer[len] = '\0';
-                    distances[valueIndex] = atof(buffer);
-                }
-                
-                Serial.print(distances[valueIndex]);
-                if (valueIndex < 3) Serial.print(", ");
-                
-                valueIndex++;
-                startIndex = commaIndex + 1;
-            }
-            
-            Serial.println();
-            
-            // Update our distance variables
-            dist_to_a0 = distances[0];
-            dist_to_a1 = distances[1];
-            dist_to_a2 = distances[2];
-            dist_to_a3 = distances[3];
-            
-            // Calculate 2D position
-            calculatePosition();
-        }
+    // We're only interested in the first 4 values (0-3)
+    Serial.print("Range values: ");
+    for (int i = 0; i < 4; i++) {
+        Serial.print(report.range[i]);
+        if (i < 3) Serial.print(", ");
     }
+    Serial.println();
+    
+    // Update our distance variables
+    dist_to_a0 = report.range[0];
+    dist_to_a1 = report.range[1];
+    dist_to_a2 = report.range[2];
+    dist_to_a3 = report.range[3];
+    
+    // Calculate 2D position
+    calculatePosition();
 }
 
 void setup() {
+    // Load the anchor layout; the solver rebuilds its geometry cache once
+    solver.setAnchorCount(4);
+    for (uint8_t i = 0; i < 4; i++) {
+        solver.setAnchor(i, anchor_x[i], anchor_y[i]);
+    }
+    
     Serial.begin(115200);
     delay(1000);
     
     randomSeed(analogRead(0));  // Initialize random seed
+    noiseRandom.seed(random(1, 0x7FFFFFFF));
     
     Serial.println("\n\n----- ROBUST MULTILATERATION TESTER -----");
     Serial.println("This sketch tests improved multilateration techniques for noisy UWB data.");
@@ -401,84 +345,57 @@ void setup() {
 // Inject a specified noise pattern into measurements
 void injectNoisePattern(int patternType, float tagX, float tagY) {
     // Calculate ideal distances
-    float ideal_d0 = calculateDistance(tagX, tagY, anchor_x[0], anchor_y[0]);
-    float ideal_d1 = calculateDistance(tagX, tagY, anchor_x[1], anchor_y[1]);
-    float ideal_d2 = calculateDistance(tagX, tagY, anchor_x[2], anchor_y[2]);
-    float ideal_d3 = calculateDistance(tagX, tagY, anchor_x[3], anchor_y[3]);
-    
-    // Start with ideal distances
-    dist_to_a0 = ideal_d0;
-    dist_to_a1 = ideal_d1;
-    dist_to_a2 = ideal_d2;
-    dist_to_a3 = ideal_d3;
-    
-    switch (patternType) {
-        case 1: // Random noise
-            dist_to_a0 *= (1.0 + random(-10, 10) / 100.0);
-            dist_to_a1 *= (1.0 + random(-10, 10) / 100.0);
-            dist_to_a2 *= (1.0 + random(-10, 10) / 100.0);
-            dist_to_a3 *= (1.0 + random(-10, 10) / 100.0);
-            Serial.println("Applied random noise (±10%)");
-            break;
+    float ideal[4];
+    for (uint8_t i = 0; i < 4; i++) {
+        ideal[i] = calculateDistance(tagX, tagY, anchor_x[i], anchor_y[i]);
+    }
+    float distances[4];
+
+    // The patterns are shared with the fleet load generator (MaUWB_SynthLoad.h)
+    if (patternType == MAUWB_NOISE_PROGRESSIVE) {
+        for (int i = 0; i < 10; i++) {
+            // Start with small noise, gradually increase: 2% to 20%
+            memcpy(distances, ideal, sizeof(distances));
+            MaUWB_SynthNoise::apply(patternType, distances, 4, i, noiseRandom);
             
-        case 2: // One bad measurement
-            dist_to_a0 *= 1.5;  // 50% error on first measurement
-            Serial.println("Applied 50% error to anchor 0 measurement");
-            break;
+            Serial.print("Progressive noise test iteration ");
+            Serial.print(i + 1);
+            Serial.print(" with ");
+            Serial.print((i + 1) * 2.0);
+            Serial.println("% noise");
             
-        case 3: // Multipath error (systematically longer distances)
-            dist_to_a0 *= 1.2;
-            dist_to_a1 *= 1.15;
-            dist_to_a2 *= 1.25;
-            dist_to_a3 *= 1.18;
-            Serial.println("Applied multipath error (all distances too long)");
-            break;
+            // Update distances
+            dist_to_a0 = distances[0];
+            dist_to_a1 = distances[1];
+            dist_to_a2 = distances[2];
+            dist_to_a3 = distances[3];
             
-        case 4: // Progressive error (gradual increase in noise)
-            for (int i = 0; i < 10; i++) {
-                // Start with small noise, gradually increase
-                float noise_factor = (i + 1) * 0.02;  // 2% to 20%
-                
-                float d0 = ideal_d0 * (1.0 + noise_factor);
-                float d1 = ideal_d1 * (1.0 + noise_factor);
-                float d2 = ideal_d2 * (1.0 + noise_factor);
-                float d3 = ideal_d3 * (1.0 + noise_factor);
-                
-                Serial.print("Progressive noise test iteration ");
-                Serial.print(i + 1);
-                Serial.print(" with ");
-                Serial.print(noise_factor * 100.0);
-                Serial.println("% noise");
-                
-                // Update distances
-                dist_to_a0 = d0;
-                dist_to_a1 = d1;
-                dist_to_a2 = d2;
-                dist_to_a3 = d3;
-                
-                // Generate AT command and calculate position
-                String atResp = generateATResponse(dist_to_a0, dist_to_a1, dist_to_a2, dist_to_a3);
-                parseRangeData(atResp);
-                
-                // Calculate error
-                float errorX = abs(positionX - tagX);
-                float errorY = abs(positionY - tagY);
-                float errorTotal = sqrt(errorX*errorX + errorY*errorY);
-                
-                Serial.print("Position error: Total=");
-                Serial.print(errorTotal);
-                Serial.println(" cm");
-                
-                delay(500);
-            }
-            return;  // Return early as we've already processed this pattern
+            // Generate AT command and calculate position
+            String atResp = generateATResponse(dist_to_a0, dist_to_a1, dist_to_a2, dist_to_a3);
+            parseRangeData(atResp);
+            
+            // Calculate error
+            float errorX = abs(positionX - tagX);
+            float errorY = abs(positionY - tagY);
+            float errorTotal = sqrt(errorX*errorX + errorY*errorY);
             
-        case 5: // Triangle inequality violation
-            // Create distances that violate the triangle inequality
-            dist_to_a0 = ideal_d0 * 0.5;  // Make one distance too short
-            Serial.println("Applied triangle inequality violation");
-            break;
+            Serial.print("Position error: Total=");
+            Serial.print(errorTotal);
+            Serial.println(" cm");
+            
+            delay(500);
+        }
+        return;  // Return early as we've already processed this pattern
     }
+
+    memcpy(distances, ideal, sizeof(distances));
+    const char* applied = MaUWB_SynthNoise::apply(patternType, distances, 4, 0, noiseRandom);
+    Serial.print("Applied ");
+    Serial.println(applied);
+    dist_to_a0 = distances[0];
+    dist_to_a1 = distances[1];
+    dist_to_a2 = distances[2];
+    dist_to_a3 = distances[3];
     
     // Generate AT command
     String atResp = generateATResponse(dist_to_a0, dist_to_a1, dist_to_a2, dist_to_a3);